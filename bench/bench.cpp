@@ -0,0 +1,280 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "bench.h"
+
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+time_run (BenchFunc func, void *data, long iterations)
+{
+  double start = now_seconds ();
+
+  func (iterations, data);
+  return now_seconds () - start;
+}
+
+Bench::Bench()
+  : _seconds(0.5),
+    _repetitions(10),
+    _output(NULL),
+    _baseline(NULL),
+    _threshold(0.10),
+    _filters(NULL),
+    _num_filters(0),
+    _num_results(0)
+{
+}
+
+bool
+Bench::parse_args(int argc, char **argv)
+{
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i += 2) {
+    if (i + 1 >= argc) {
+      warnx("%s needs a value", argv[i]);
+      return false;
+    }
+    if (strcmp(argv[i], "-t") == 0)
+      _seconds = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "-r") == 0)
+      _repetitions = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-o") == 0)
+      _output = argv[i + 1];
+    else if (strcmp(argv[i], "-b") == 0)
+      _baseline = argv[i + 1];
+    else if (strcmp(argv[i], "-x") == 0)
+      _threshold = atof(argv[i + 1]) / 100;
+    else {
+      warnx("Unknown option %s", argv[i]);
+      return false;
+    }
+  }
+
+  if (_seconds <= 0 || _repetitions < 1 || _repetitions > MAX_BENCH_REPETITIONS) {
+    warnx("Need a positive time and 1 to %d repetitions", MAX_BENCH_REPETITIONS);
+    return false;
+  }
+
+  _filters = argv + i;
+  _num_filters = argc - i;
+  return true;
+}
+
+bool
+Bench::wants(const char *name) const
+{
+  if (_num_filters == 0)
+    return true;
+  for (int i = 0; i < _num_filters; i++)
+    if (strstr(name, _filters[i]))
+      return true;
+  return false;
+}
+
+/* Returns whether the benchmark was run, rather than filtered out */
+bool
+Bench::run(const char *name, BenchFunc func, void *data)
+{
+  double per_repetition = _seconds / _repetitions;
+  double times[MAX_BENCH_REPETITIONS];
+  long iterations = 1;
+  BenchResult *result;
+  double t;
+
+  if (!wants(name) || _num_results >= MAX_BENCH_RESULTS)
+    return false;
+
+  // Grow the count until one repetition takes long enough to time
+  while ((t = time_run(func, data, iterations)) < per_repetition && iterations < LONG_MAX / 100) {
+    double scale = t > 0 ? 1.2 * per_repetition / t : 100;
+    iterations = (long) (iterations * std::min(std::max(scale, 2.0), 100.0));
+  }
+
+  time_run(func, data, iterations);
+
+  for (int r = 0; r < _repetitions; r++)
+    times[r] = time_run(func, data, iterations) * 1e9 / iterations;
+  std::sort(times, times + _repetitions);
+
+  result = &_results[_num_results++];
+  result->num_counters = 0;
+  snprintf(result->name, sizeof(result->name), "%s", name);
+  result->iterations = iterations;
+  result->repetitions = _repetitions;
+  result->min_ns = times[0];
+  result->median_ns = _repetitions % 2 ? times[_repetitions / 2]
+    : (times[_repetitions / 2 - 1] + times[_repetitions / 2]) / 2;
+
+  if (_num_results == 1)
+    printf("%-32s %14s %14s %12s\n", "benchmark", "min (ns)", "median (ns)", "iterations");
+  printf("%-32s %14.1f %14.1f %12ld\n",
+         result->name, result->min_ns, result->median_ns, result->iterations);
+  fflush(stdout);
+  return true;
+}
+
+void
+Bench::counter(const char *name, double value)
+{
+  BenchResult *result;
+
+  if (_num_results == 0)
+    return;
+  result = &_results[_num_results - 1];
+  if (result->num_counters >= MAX_BENCH_COUNTERS)
+    return;
+  result->counter_names[result->num_counters] = name;
+  result->counters[result->num_counters++] = value;
+  printf("  %-30s %14.1f\n", name, value);
+}
+
+/*
+ * Writes the results out and compares them with the baseline.  Returns
+ * the exit status: 1 if anything regressed or couldn't be written.
+ */
+int
+Bench::finish()
+{
+  BenchResult *base;
+  int num_base, regressions = 0;
+
+  if (_output && !bench_write_json(_output, _results, _num_results)) {
+    warn("Could not write %s", _output);
+    return 1;
+  }
+  if (!_baseline)
+    return 0;
+
+  base = new BenchResult[MAX_BENCH_RESULTS];
+  num_base = bench_read_json(_baseline, base, MAX_BENCH_RESULTS);
+  if (num_base < 0) {
+    warn("Could not read %s", _baseline);
+    delete[] base;
+    return 1;
+  }
+
+  printf("\n%-32s %14s %14s %9s\n", "compared to baseline", "baseline (ns)", "median (ns)", "change");
+  for (int i = 0; i < _num_results; i++) {
+    const BenchResult *r = &_results[i];
+    const BenchResult *b = NULL;
+    double change;
+
+    for (int j = 0; j < num_base && !b; j++)
+      if (strcmp(base[j].name, r->name) == 0)
+        b = &base[j];
+    if (!b || b->median_ns <= 0) {
+      printf("%-32s %14s %14.1f %9s\n", r->name, "-", r->median_ns, "new");
+      continue;
+    }
+
+    change = r->median_ns / b->median_ns - 1;
+    printf("%-32s %14.1f %14.1f %+8.1f%%%s\n", r->name, b->median_ns, r->median_ns,
+           change * 100, change > _threshold ? "  REGRESSION" : "");
+    if (change > _threshold)
+      regressions++;
+  }
+
+  if (regressions)
+    printf("%d of %d benchmarks regressed by more than %.0f%%\n",
+           regressions, _num_results, _threshold * 100);
+  delete[] base;
+  return regressions ? 1 : 0;
+}
+
+/*
+ * One result to a line, so bench_read_json() doesn't need a real JSON
+ * parser; it only has to read back what this writes.  Counters come
+ * last, and aren't read back.
+ */
+bool
+bench_write_json(const char *filename, const BenchResult *results, int count)
+{
+  FILE *fp = fopen(filename, "w");
+
+  if (!fp)
+    return false;
+
+  fprintf(fp, "{\n  \"benchmarks\": [\n");
+  for (int i = 0; i < count; i++) {
+    const BenchResult *r = &results[i];
+    fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %ld, \"repetitions\": %d, "
+            "\"min_ns\": %.3f, \"median_ns\": %.3f",
+            r->name, r->iterations, r->repetitions, r->min_ns, r->median_ns);
+    if (r->num_counters) {
+      fprintf(fp, ", \"counters\": {");
+      for (int c = 0; c < r->num_counters; c++)
+        fprintf(fp, "%s\"%s\": %.3f", c ? ", " : "", r->counter_names[c], r->counters[c]);
+      fprintf(fp, "}");
+    }
+    fprintf(fp, "}%s\n", i + 1 < count ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+  return fclose(fp) == 0;
+}
+
+/* Returns the number of results read, or -1 if the file can't be opened */
+int
+bench_read_json(const char *filename, BenchResult *results, int max)
+{
+  FILE *fp = fopen(filename, "r");
+  char line[1024];
+  int count = 0;
+
+  if (!fp)
+    return -1;
+
+  while (count < max && fgets(line, sizeof(line), fp)) {
+    BenchResult *r = &results[count];
+    if (sscanf(line, " {\"name\": \"%63[^\"]\", \"iterations\": %ld, \"repetitions\": %d, "
+               "\"min_ns\": %lf, \"median_ns\": %lf}",
+               r->name, &r->iterations, &r->repetitions, &r->min_ns, &r->median_ns) == 5)
+      count++;
+  }
+
+  fclose(fp);
+  return count;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
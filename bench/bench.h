@@ -0,0 +1,111 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#define MAX_BENCH_RESULTS     (64)
+#define MAX_BENCH_NAME        (64)
+#define MAX_BENCH_REPETITIONS (100)
+#define MAX_BENCH_COUNTERS    (8)
+
+// Runs the body @iterations times; the harness times the whole call
+typedef void (*BenchFunc) (long iterations, void *data);
+
+typedef struct
+{
+  char    name[MAX_BENCH_NAME];
+  long    iterations;             /// Per repetition
+  int     repetitions;
+  double  min_ns;                 /// Per iteration
+  double  median_ns;
+  int     num_counters;
+  const char *counter_names[MAX_BENCH_COUNTERS];  /// Must outlive the results; use literals
+  double  counters[MAX_BENCH_COUNTERS];
+} BenchResult;
+
+/*
+ * A small benchmark harness.  Each benchmark is run until its iteration
+ * count fills a repetition's share of the time, once more to warm up,
+ * and then for the given number of timed repetitions.
+ *
+ *   bench_x [-t SECONDS] [-r REPETITIONS] [-o FILE] [-b BASELINE] [-x PERCENT] [NAME...]
+ *
+ * Names given on the command line pick out the benchmarks whose names
+ * contain them.  Results are written as JSON to -o; with -b they are
+ * compared against an earlier file and medians more than -x percent
+ * slower are flagged as regressions.  Counters, like the work a
+ * benchmark did per iteration, can be attached to the result of the
+ * last run(); they are printed and written out, but not compared.
+ */
+class Bench {
+public:
+  Bench();
+
+  bool   parse_args(int argc, char **argv);
+  bool   wants(const char *name) const;
+  bool   run(const char *name, BenchFunc func, void *data);
+  void   counter(const char *name, double value);
+  int    finish();
+
+  const BenchResult *result(int i) const { return &_results[i]; }
+  int    count() const { return _num_results; }
+
+private:
+  double       _seconds;          /// Timed per benchmark, over all repetitions
+  int          _repetitions;
+  const char  *_output;
+  const char  *_baseline;
+  double       _threshold;        /// Fraction slower that counts as a regression
+  char       **_filters;
+  int          _num_filters;
+  BenchResult  _results[MAX_BENCH_RESULTS];
+  int          _num_results;
+};
+
+bool bench_write_json(const char *filename, const BenchResult *results, int count);
+int  bench_read_json(const char *filename, BenchResult *results, int max);
+
+/* Makes the compiler produce @value, without it costing anything */
+template <typename T>
+inline void
+bench_do_not_optimize (const T &value)
+{
+  asm volatile ("" : : "r,m" (value) : "memory");
+}
+
+/* Makes the compiler assume all memory was read and written */
+inline void
+bench_clobber (void)
+{
+  asm volatile ("" : : : "memory");
+}
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,322 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the simulation's hot paths on a headless game: whole ticks
+ * with various numbers of missiles in flight, and the physics, collision
+ * and high score functions a tick or a game over leans on.  Frames are
+ * drawn to an image surface; built with COUNT_CAIRO_CALLS, each frame
+ * benchmark also reports the cairo calls and pixels a frame took.
+ *
+ *   bench_game [-t SECONDS] [-r REPETITIONS] [-o FILE] [-b BASELINE] [-x PERCENT] [NAME...]
+ */
+
+#include "bench.h"
+#include "game.h"
+#include "game-math.h"
+#include "render-counters.h"
+#include "score.h"
+
+#include <cairo.h>
+
+#include <err.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Inputs are cycled through so no one case gets the branch predictor's help
+#define BENCH_INPUTS  (256)
+
+Game *game;
+
+static physics_t  bodies[BENCH_INPUTS];
+static physics_t  others[BENCH_INPUTS];
+static GameObject objects[BENCH_INPUTS];
+static double     dx[BENCH_INPUTS];
+static double     dy[BENCH_INPUTS];
+
+static guint32 seed = 1;
+
+/* A fixed sequence, so every run measures the same game */
+static double
+uniform (double lo, double hi)
+{
+  seed = seed * 1664525 + 1013904223;
+  return lo + (hi - lo) * (seed >> 8) / (double) (1 << 24);
+}
+
+static void
+random_body (physics_t *p)
+{
+  p->pos[0] = (int) uniform (0, WIDTH * FIXED_POINT_SCALE_FACTOR);
+  p->pos[1] = (int) uniform (0, HEIGHT * FIXED_POINT_SCALE_FACTOR);
+  p->radius = MISSILE_RADIUS;
+}
+
+/*
+ * Puts a missile somewhere between the shield and the edge of the
+ * field, flying in any direction.  Those heading inwards will hit the
+ * rings; the others wrap around and might hit the ship.
+ */
+static void
+spawn_missile (GameObject *m)
+{
+  double angle = uniform (0, TWO_PI);
+  double distance = uniform (100, HEIGHT / 2 - 20);
+  double heading = uniform (0, TWO_PI);
+
+  m->p.pos[0] = (int) ((WIDTH / 2 + distance * cos (angle)) * FIXED_POINT_SCALE_FACTOR);
+  m->p.pos[1] = (int) ((HEIGHT / 2 + distance * sin (angle)) * FIXED_POINT_SCALE_FACTOR);
+  m->p.vel[0] = (int) (MISSILE_SPEED * FIXED_POINT_SCALE_FACTOR * cos (heading));
+  m->p.vel[1] = (int) (MISSILE_SPEED * FIXED_POINT_SCALE_FACTOR * sin (heading));
+  m->p.radius = MISSILE_RADIUS;
+  m->energy = MISSILE_TICKS_TO_LIVE;
+  m->has_exploded = FALSE;
+}
+
+/*
+ * Undoes the damage of the last tick, so every tick sees intact rings,
+ * live ships and @live missiles.  This is a small, fixed part of what
+ * the tick benchmarks measure.
+ */
+static void
+keep_populated (int live)
+{
+  game->init_rings_array ();
+  game->player->energy = SHIP_MAX_ENERGY;
+  game->cannon->energy = SHIP_MAX_ENERGY;
+  game->cannon->ticks_until_can_fire = TICKS_BETWEEN_FIRE;
+  for (int i = 0; i < live; i++)
+    if (!game->missiles[i].is_alive())
+      spawn_missile (&game->missiles[i]);
+}
+
+static void
+bench_tick (long iterations, void *data)
+{
+  int live = *(int *) data;
+
+  for (long n = 0; n < iterations; n++) {
+    keep_populated (live);
+    game->tick ();
+  }
+  bench_clobber ();
+}
+
+typedef struct
+{
+  int      live;
+  cairo_t *cr;
+} FrameBench;
+
+/* The same scene every frame; the starfield's chunks stay cached */
+static void
+bench_redraw (long iterations, void *data)
+{
+  FrameBench *frame = (FrameBench *) data;
+
+  for (long n = 0; n < iterations; n++) {
+    keep_populated (frame->live);
+    game->redraw (frame->cr);
+    render_counters_end_frame ();
+  }
+  cairo_surface_flush (cairo_get_target (frame->cr));
+}
+
+static void
+report_render_counters (Bench *bench)
+{
+  const RenderCounts &counts = render_counters_frame ();
+  const long *calls = counts.calls;
+
+  bench->counter ("cairo calls/frame", render_counters_total (counts));
+  bench->counter ("state changes/frame", calls[RENDER_SAVE] + calls[RENDER_RESTORE] +
+                  calls[RENDER_TRANSFORM] + calls[RENDER_SOURCE]);
+  bench->counter ("fills/frame", calls[RENDER_FILL]);
+  bench->counter ("strokes/frame", calls[RENDER_STROKE]);
+  bench->counter ("pixels/frame", counts.pixels);
+}
+
+static void
+bench_apply_physics_to_player (long iterations, void *data)
+{
+  GameObject *player = game->player;
+
+  (void) data;
+  for (long n = 0; n < iterations; n++) {
+    game->apply_physics_to_player (player);
+    bench_do_not_optimize (player->p);
+  }
+}
+
+static void
+bench_check_for_collision (long iterations, void *data)
+{
+  (void) data;
+  for (long n = 0; n < iterations; n++) {
+    int i = n & (BENCH_INPUTS - 1);
+    bench_do_not_optimize (game->check_for_collision (&bodies[i], &others[i]));
+  }
+}
+
+static void
+bench_check_for_ring_collision (long iterations, void *data)
+{
+  physics_t *ring = &game->rings[0].p;
+
+  (void) data;
+  for (long n = 0; n < iterations; n++) {
+    int i = n & (BENCH_INPUTS - 1);
+    bench_do_not_optimize (game->check_for_ring_collision (ring, &bodies[i]));
+  }
+}
+
+static void
+bench_ring_segment_hit (long iterations, void *data)
+{
+  GameObject *ring = &game->rings[0];
+
+  (void) data;
+  for (long n = 0; n < iterations; n++) {
+    int i = n & (BENCH_INPUTS - 1);
+    bench_do_not_optimize (game->ring_segment_hit (ring, &objects[i]));
+  }
+}
+
+static void
+bench_arctan (long iterations, void *data)
+{
+  (void) data;
+  for (long n = 0; n < iterations; n++) {
+    int i = n & (BENCH_INPUTS - 1);
+    bench_do_not_optimize (arctan (dy[i], dx[i]));
+  }
+}
+
+/* Every score beats the lot, so each insert moves the whole table down */
+static void
+bench_high_scores_insert (long iterations, void *data)
+{
+  HighScores *table = (HighScores *) data;
+  Score score = table->get (0);
+
+  for (long n = 0; n < iterations; n++) {
+    score += 1;
+    bench_do_not_optimize (table->insert (score));
+  }
+}
+
+static void
+bench_high_scores_load (long iterations, void *data)
+{
+  const char *filename = (const char *) data;
+  HighScores table;
+
+  for (long n = 0; n < iterations; n++) {
+    if (!table.load (filename))
+      errx (1, "Could not load %s", filename);
+    bench_do_not_optimize (table);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int missile_counts[] = { 0, 15, 30, MAX_NUMBER_OF_MISSILES };
+  static const int frame_missile_counts[] = { 0, MAX_NUMBER_OF_MISSILES };
+  cairo_surface_t *surface;
+  FrameBench frame;
+  static HighScores table;
+  char scores_file[] = "/tmp/bench-scores-XXXXXX";
+  char *game_argv[] = { argv[0], NULL };
+  Bench bench;
+  int fd;
+
+  if (!bench.parse_args (argc, argv))
+    return 2;
+
+  game = new Game (1, game_argv, TRUE);
+
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+    random_body (&bodies[i]);
+    random_body (&others[i]);
+    objects[i].p = bodies[i];
+    dx[i] = uniform (-WIDTH, WIDTH) * FIXED_POINT_SCALE_FACTOR;
+    dy[i] = uniform (-HEIGHT, HEIGHT) * FIXED_POINT_SCALE_FACTOR;
+  }
+
+  // The ship sits out of the way in a corner, with the cannon holding fire
+  game->player->p.pos[0] = 60 * FIXED_POINT_SCALE_FACTOR;
+  game->player->p.pos[1] = 60 * FIXED_POINT_SCALE_FACTOR;
+  game->player->p.vel[0] = game->player->p.vel[1] = 0;
+  for (int i = 0; i < ARRAY_LENGTH (missile_counts); i++) {
+    char name[MAX_BENCH_NAME];
+    snprintf (name, sizeof (name), "Game::tick/%d", missile_counts[i]);
+    game->init_missiles_array ();
+    bench.run (name, bench_tick, (void *) &missile_counts[i]);
+  }
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, WIDTH, HEIGHT);
+  frame.cr = cairo_create (surface);
+  for (int i = 0; i < ARRAY_LENGTH (frame_missile_counts); i++) {
+    char name[MAX_BENCH_NAME];
+    snprintf (name, sizeof (name), "Game::redraw/%d", frame_missile_counts[i]);
+    game->init_missiles_array ();
+    frame.live = frame_missile_counts[i];
+    if (bench.run (name, bench_redraw, &frame) && render_counters_enabled ())
+      report_render_counters (&bench);
+  }
+  cairo_destroy (frame.cr);
+  cairo_surface_destroy (surface);
+
+  game->player->is_thrusting = TRUE;
+  game->player->p.rotation_speed = 1;
+  bench.run ("apply_physics_to_player", bench_apply_physics_to_player, NULL);
+
+  bench.run ("check_for_collision", bench_check_for_collision, NULL);
+  bench.run ("check_for_ring_collision", bench_check_for_ring_collision, NULL);
+  bench.run ("ring_segment_hit", bench_ring_segment_hit, NULL);
+  bench.run ("arctan", bench_arctan, NULL);
+
+  for (int i = 0; i < HighScores::MAX_SCORES; i++) {
+    Score score;
+    score.record ((int) uniform (1, 1000000), i % 10, "bench");
+    table.insert (score);
+  }
+  if ((fd = mkstemp (scores_file)) < 0 || !table.save (scores_file))
+    err (1, "Could not write %s", scores_file);
+  close (fd);
+  bench.run ("HighScores::load", bench_high_scores_load, scores_file);
+  bench.run ("HighScores::insert", bench_high_scores_insert, &table);
+  unlink (scores_file);
+
+  return bench.finish ();
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
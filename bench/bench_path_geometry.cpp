@@ -0,0 +1,181 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the path geometry kernels over the sprite art, as a frame's
+ * worth of objects each transformed, bounded and flattened.
+ *
+ *   bench_path_geometry [-t SECONDS] [-n OBJECTS]
+ */
+
+#include "assets.h"
+#include "path-geometry.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SPRITE_DIR
+#define SPRITE_DIR "data/sprites"
+#endif
+
+#define MAX_BENCH_PATHS    (MAX_SPRITES * MAX_SPRITE_PATHS)
+#define MAX_BENCH_SEGMENTS (4096)
+#define BENCH_MATRICES     (64)
+
+typedef struct
+{
+  const PathSegment *segments;
+  int                count;
+} BenchPath;
+
+static BenchPath paths[MAX_BENCH_PATHS];
+static int       num_paths = 0;
+
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Runs @func over @objects objects per frame until @min_seconds have
+ * passed, and returns the average milliseconds per frame.
+ */
+static double
+time_frames (void (*func) (int object, const BenchPath *path), int objects, double min_seconds)
+{
+  double start = now_seconds ();
+  double elapsed;
+  long frames = 0;
+
+  do {
+    for (int i = 0; i < objects; i++)
+      func (i, &paths[i % num_paths]);
+    frames++;
+    elapsed = now_seconds () - start;
+  } while (elapsed < min_seconds);
+
+  return elapsed * 1000 / frames;
+}
+
+static cairo_matrix_t matrices[BENCH_MATRICES];
+static PathSegment  scratch[MAX_BENCH_SEGMENTS];
+static FlattenCache cache;
+static Polyline     flat;
+static double       sink;
+
+static void
+transform_object (int object, const BenchPath *path)
+{
+  path_transform (path->segments, scratch, path->count, &matrices[object % BENCH_MATRICES]);
+  sink += scratch[0].pt[0];
+}
+
+static void
+bound_object (int object, const BenchPath *path)
+{
+  PathBounds b;
+
+  (void) object;
+  if (path_bounds (path->segments, path->count, &b))
+    sink += b.x2;
+}
+
+static void
+flatten_object (int object, const BenchPath *path)
+{
+  (void) object;
+  path_flatten (path->segments, path->count, 0.25, &flat);
+  sink += flat.num_points;
+}
+
+static void
+flatten_cached_object (int object, const BenchPath *path)
+{
+  (void) object;
+  const Polyline *p = cache.get (path->segments, path->count, 0.25);
+  sink += p->num_points;
+}
+
+int
+main (int argc, char **argv)
+{
+  double min_seconds = 1.0;
+  int objects = 2000;
+  long segments = 0;
+  AssetSet assets;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp (argv[i], "-t") == 0)
+      min_seconds = atof (argv[i + 1]);
+    else if (strcmp (argv[i], "-n") == 0)
+      objects = atoi (argv[i + 1]);
+  }
+
+  for (int i = 0; i < BENCH_MATRICES; i++) {
+    double a = i * 2 * M_PI / BENCH_MATRICES;
+    cairo_matrix_init (&matrices[i], cos(a), sin(a), -sin(a), cos(a), i, i);
+  }
+
+  assets.load (SPRITE_DIR, NULL);
+  for (int s = 0; s < assets.count (); s++) {
+    const Sprite *sprite = assets.sprite (s);
+    for (int p = 0; p < (int) sprite->num_paths; p++) {
+      const SpritePath *sp = assets.path (sprite, p);
+      if (sp->num_segments > MAX_BENCH_SEGMENTS)
+        continue;
+      paths[num_paths].segments = assets.segments (sp);
+      paths[num_paths].count = sp->num_segments;
+      segments += sp->num_segments;
+      num_paths++;
+    }
+  }
+
+  if (num_paths == 0 || objects <= 0) {
+    fprintf (stderr, "No paths found\n");
+    return 1;
+  }
+
+  printf ("%d objects per frame over %d sprite paths (%.1f segments each)\n",
+          objects, num_paths, (double) segments / num_paths);
+  printf ("transform       %8.3f ms/frame\n", time_frames (transform_object, objects, min_seconds));
+  printf ("bounds          %8.3f ms/frame\n", time_frames (bound_object, objects, min_seconds));
+  printf ("flatten         %8.3f ms/frame\n", time_frames (flatten_object, objects, min_seconds));
+  double cached = time_frames (flatten_cached_object, objects, min_seconds);
+  printf ("flatten, cached %8.3f ms/frame (%ld hits, %ld misses)\n",
+          cached, cache.hits (), cache.misses ());
+
+  return sink == 42.0;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
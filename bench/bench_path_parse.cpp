@@ -0,0 +1,320 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures SVG path data parsing throughput.
+ *
+ *   bench_path_parse [-t SECONDS] [-s MB | -d | FILE.svg ...]
+ *
+ * By default the corpus is synthetic: SYNTHETIC_CORPUS_MB of made-up
+ * path data written the way Inkscape saves it, from a fixed seed, so
+ * runs are comparable.  -s sets its size.  -d parses every .svg in the
+ * sprite directory instead, which is only a few KB of hand-written art
+ * and too small to time much more than the cache; files named on the
+ * command line are parsed as given.  Each path is parsed into a Path,
+ * then streamed into a sink that only counts segments, whole and in
+ * small chunks.
+ */
+
+#include "path.h"
+#include "path-stream.h"
+
+#include <glib.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SPRITE_DIR
+#define SPRITE_DIR "data/sprites"
+#endif
+
+#define MAX_CORPUS_PATHS (16384)
+#define STREAM_CHUNK     (64)
+
+// Default size of the synthetic corpus, and the most any one path gets
+#define SYNTHETIC_CORPUS_MB  (4)
+#define SYNTHETIC_PATH_MAX   (4096)
+
+static char *corpus[MAX_CORPUS_PATHS];
+static int   corpus_paths = 0;
+static long  corpus_bytes = 0;
+
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Pulls the d attributes out of a file's path elements.  Not a real XML
+ * parser, but it copes with anything Inkscape writes.
+ */
+static void
+load_svg (const char *filename)
+{
+  gchar *contents;
+  const char *p;
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL)) {
+    fprintf (stderr, "Can't read %s\n", filename);
+    return;
+  }
+
+  for (p = contents; (p = strstr (p, "d=\"")); p += 3) {
+    if (p == contents || !g_ascii_isspace (p[-1]))
+      continue;
+
+    const char *start = p + 3;
+    const char *end = strchr (start, '"');
+    if (!end || corpus_paths >= MAX_CORPUS_PATHS)
+      break;
+
+    corpus[corpus_paths++] = g_strndup (start, end - start);
+    corpus_bytes += end - start;
+  }
+
+  g_free (contents);
+}
+
+static void
+load_sprite_dir (const char *dirname)
+{
+  GDir *dir = g_dir_open (dirname, 0, NULL);
+  const gchar *name;
+
+  if (!dir) {
+    fprintf (stderr, "Can't open %s\n", dirname);
+    return;
+  }
+
+  while ((name = g_dir_read_name (dir))) {
+    if (g_str_has_suffix (name, ".svg")) {
+      gchar *filename = g_build_filename (dirname, name, NULL);
+      load_svg (filename);
+      g_free (filename);
+    }
+  }
+  g_dir_close (dir);
+}
+
+// xorshift32, returning a value in [0, 1)
+static double
+next_random (unsigned int *state)
+{
+  unsigned int x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x / 4294967296.0;
+}
+
+/*
+ * Appends a coordinate pair the way Inkscape 0.48 writes them: up to
+ * eight significant digits, the odd integer, and the odd value small
+ * enough to come out with an exponent.
+ */
+static int
+print_pair (char *buf, size_t size, unsigned int *state, double range)
+{
+  double v[2];
+
+  for (int i = 0; i < 2; i++) {
+    double r = next_random (state);
+    v[i] = (next_random (state) - 0.5) * range;
+    if (r < 0.05)
+      v[i] = floor (v[i]);
+    else if (r < 0.06)
+      v[i] *= 1e-7;
+  }
+  return snprintf (buf, size, " %.8g,%.8g", v[0], v[1]);
+}
+
+/*
+ * Adds @bytes of synthetic path data to the corpus, in paths of a few
+ * hundred bytes to a few KB.  Mostly relative curves and lines with
+ * implicit repeats, broken into closed subpaths, like traced art.
+ */
+static void
+generate_corpus (long bytes)
+{
+  unsigned int state = 0x5ca57e;
+  // Room for the last command to run past the path's length
+  char path[SYNTHETIC_PATH_MAX + 1024];
+
+  while (corpus_bytes < bytes && corpus_paths < MAX_CORPUS_PATHS) {
+    size_t limit = 256 + (size_t) (next_random (&state) * (SYNTHETIC_PATH_MAX - 256));
+    size_t len = snprintf (path, sizeof(path), "m");
+
+    len += print_pair (path + len, sizeof(path) - len, &state, 1000.0);
+    while (len < limit) {
+      double r = next_random (&state);
+      int repeats = 1 + (int) (next_random (&state) * 4);
+
+      if (r < 0.55) {
+        len += snprintf (path + len, sizeof(path) - len, " c");
+        for (int i = 0; i < repeats * 3; i++)
+          len += print_pair (path + len, sizeof(path) - len, &state, 40.0);
+      } else if (r < 0.85) {
+        len += snprintf (path + len, sizeof(path) - len, " l");
+        for (int i = 0; i < repeats; i++)
+          len += print_pair (path + len, sizeof(path) - len, &state, 40.0);
+      } else if (r < 0.93) {
+        len += snprintf (path + len, sizeof(path) - len, " %c %.8g",
+                         r < 0.89 ? 'h' : 'v', (next_random (&state) - 0.5) * 40.0);
+      } else {
+        len += snprintf (path + len, sizeof(path) - len, " z m");
+        len += print_pair (path + len, sizeof(path) - len, &state, 40.0);
+      }
+    }
+    len += snprintf (path + len, sizeof(path) - len, " z");
+
+    corpus[corpus_paths++] = g_strndup (path, len);
+    corpus_bytes += len;
+  }
+}
+
+class CountingSink {
+public:
+  long segments;
+
+  CountingSink() : segments(0) {}
+  void move_to(double, double) { segments++; }
+  void line_to(double, double) { segments++; }
+  void curve_to(double, double, double, double, double, double) { segments++; }
+  void close_path() { segments++; }
+};
+
+typedef enum {
+  PARSE_PATH,
+  PARSE_STREAM,
+  PARSE_CHUNKED,
+  PARSE_MODES
+} ParseMode;
+
+static const char *mode_names[PARSE_MODES] = { "Path", "stream", "chunked" };
+
+static long
+parse_corpus (ParseMode mode)
+{
+  CountingSink sink;
+  long segments = 0;
+
+  for (int i = 0; i < corpus_paths; i++) {
+    if (mode == PARSE_PATH) {
+      Path *path = sp_svg_read_path (corpus[i]);
+      segments += path->segment_count;
+      delete path;
+    } else if (mode == PARSE_STREAM) {
+      svg_parse_path (corpus[i], sink);
+    } else {
+      PathStreamParser<CountingSink> parser(sink);
+      const char *p = corpus[i];
+      size_t left = strlen (p);
+
+      for (; left > STREAM_CHUNK; p += STREAM_CHUNK, left -= STREAM_CHUNK)
+        parser.feed (p, STREAM_CHUNK);
+      parser.feed (p, left);
+      parser.finish ();
+    }
+  }
+  return segments + sink.segments;
+}
+
+int
+main (int argc, char **argv)
+{
+  double min_seconds = 1.0;
+  double start, elapsed;
+  long iterations, segments;
+  double synthetic_mb = SYNTHETIC_CORPUS_MB;
+  bool sprites = false;
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp (argv[i], "-t") == 0 && i + 1 < argc)
+      min_seconds = atof (argv[++i]);
+    else if (strcmp (argv[i], "-s") == 0 && i + 1 < argc)
+      synthetic_mb = atof (argv[++i]);
+    else if (strcmp (argv[i], "-d") == 0)
+      sprites = true;
+    else {
+      fprintf (stderr, "Usage: %s [-t SECONDS] [-s MB | -d | FILE.svg ...]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (i < argc) {
+    for (; i < argc; i++)
+      load_svg (argv[i]);
+  } else if (sprites) {
+    load_sprite_dir (SPRITE_DIR);
+  } else {
+    generate_corpus ((long) (synthetic_mb * 1024 * 1024));
+    printf ("Synthetic corpus; ");
+  }
+
+  if (corpus_paths == 0) {
+    fprintf (stderr, "No path data found\n");
+    return 1;
+  }
+
+  printf ("%d paths, %ld bytes of path data\n", corpus_paths, corpus_bytes);
+
+  for (int mode = 0; mode < PARSE_MODES; mode++) {
+    // Warm the caches before timing
+    parse_corpus ((ParseMode) mode);
+
+    iterations = 0;
+    segments = 0;
+    start = now_seconds ();
+    do {
+      segments += parse_corpus ((ParseMode) mode);
+      iterations++;
+      elapsed = now_seconds () - start;
+    } while (elapsed < min_seconds);
+
+    printf ("%-8s %ld passes in %.3fs, %.2f MB/s, %.2f Msegments/s\n",
+            mode_names[mode], iterations, elapsed,
+            corpus_bytes * iterations / elapsed / 1e6,
+            segments / elapsed / 1e6);
+  }
+
+  for (i = 0; i < corpus_paths; i++)
+    g_free (corpus[i]);
+
+  return 0;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,411 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <errno.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "alloc-tracker.h"
+#include "trace.h"
+
+/*
+ * Zones are told apart by the address of their name, which is a string
+ * literal, and found by open addressing.  A slot is claimed once, with a
+ * compare and swap, and never given up; so counting takes no locks and,
+ * being called from inside malloc, never allocates.
+ */
+typedef struct
+{
+  std::atomic<const char *> name;
+  std::atomic<guint64>      count;
+  std::atomic<guint64>      bytes;
+} ZoneSlot;
+
+static ZoneSlot zones[MAX_ALLOC_ZONES];
+static ZoneSlot other_zones;        /// Once the table is full
+
+static const char outside_zones[] = "(outside zones)";
+
+static thread_local AllocCount thread_total;
+
+/*
+ * The excluded libraries' code, as address ranges.  They're only ever
+ * added to, and each is filled in before the count that takes it in.
+ */
+typedef struct
+{
+  uintptr_t start;
+  uintptr_t end;
+} CodeRange;
+
+static CodeRange excluded[MAX_ALLOC_EXCLUDED];
+static std::atomic<int> num_excluded;
+
+#ifdef TRACK_ALLOCATIONS
+
+static ZoneSlot *
+find_zone (const char *name)
+{
+  uintptr_t hash = ((uintptr_t) name >> 3) * 2654435761u;
+
+  for (int i = 0; i < MAX_ALLOC_ZONES; i++) {
+    ZoneSlot *slot = &zones[(hash + i) % MAX_ALLOC_ZONES];
+    const char *seen = slot->name.load (std::memory_order_acquire);
+
+    if (!seen && slot->name.compare_exchange_strong (seen, name))
+      return slot;
+    // A failed exchange leaves whoever beat us to the slot in seen
+    if (seen == name)
+      return slot;
+  }
+  return &other_zones;
+}
+
+extern "C" {
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t n, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+void *__libc_memalign (size_t alignment, size_t size);
+void  __libc_free (void *ptr);
+}
+
+static inline bool
+is_excluded (const void *caller)
+{
+  uintptr_t address = (uintptr_t) caller;
+  int n = num_excluded.load (std::memory_order_acquire);
+
+  for (int i = 0; i < n; i++)
+    if (address >= excluded[i].start && address < excluded[i].end)
+      return true;
+  return false;
+}
+
+static inline void
+count_allocation (size_t size, const void *caller)
+{
+  const char *zone;
+  ZoneSlot *slot;
+
+  if (is_excluded (caller))
+    return;
+  zone = trace_current_zone ();
+  slot = find_zone (zone ? zone : outside_zones);
+
+  thread_total.count++;
+  thread_total.bytes += size;
+  slot->count.fetch_add (1, std::memory_order_relaxed);
+  slot->bytes.fetch_add (size, std::memory_order_relaxed);
+}
+
+// glibc lets the program's own malloc stand in for its one, for every
+// library; the real allocator stays reachable as __libc_*
+
+extern "C" void *
+malloc (size_t size) noexcept
+{
+  count_allocation (size, __builtin_return_address (0));
+  return __libc_malloc (size);
+}
+
+extern "C" void *
+calloc (size_t n, size_t size) noexcept
+{
+  count_allocation (n * size, __builtin_return_address (0));
+  return __libc_calloc (n, size);
+}
+
+extern "C" void *
+realloc (void *ptr, size_t size) noexcept
+{
+  if (size)
+    count_allocation (size, __builtin_return_address (0));
+  return __libc_realloc (ptr, size);
+}
+
+extern "C" void *
+memalign (size_t alignment, size_t size) noexcept
+{
+  count_allocation (size, __builtin_return_address (0));
+  return __libc_memalign (alignment, size);
+}
+
+extern "C" void *
+aligned_alloc (size_t alignment, size_t size) noexcept
+{
+  count_allocation (size, __builtin_return_address (0));
+  return __libc_memalign (alignment, size);
+}
+
+extern "C" int
+posix_memalign (void **ptr, size_t alignment, size_t size) noexcept
+{
+  void *p;
+
+  count_allocation (size, __builtin_return_address (0));
+  if (!(p = __libc_memalign (alignment, size)))
+    return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+
+extern "C" void
+free (void *ptr) noexcept
+{
+  __libc_free (ptr);
+}
+
+// operator new goes straight to the real allocator, so it isn't counted twice
+
+static void *
+new_allocation (size_t size, size_t alignment, const void *caller)
+{
+  void *p;
+
+  count_allocation (size, caller);
+  if (size == 0)
+    size = 1;
+  p = alignment ? __libc_memalign (alignment, size) : __libc_malloc (size);
+  if (!p)
+    throw std::bad_alloc ();
+  return p;
+}
+
+void *
+operator new (size_t size)
+{
+  return new_allocation (size, 0, __builtin_return_address (0));
+}
+
+void *
+operator new[] (size_t size)
+{
+  return new_allocation (size, 0, __builtin_return_address (0));
+}
+
+void *
+operator new (size_t size, std::align_val_t alignment)
+{
+  return new_allocation (size, (size_t) alignment, __builtin_return_address (0));
+}
+
+void *
+operator new[] (size_t size, std::align_val_t alignment)
+{
+  return new_allocation (size, (size_t) alignment, __builtin_return_address (0));
+}
+
+void *
+operator new (size_t size, const std::nothrow_t &) noexcept
+{
+  count_allocation (size, __builtin_return_address (0));
+  return __libc_malloc (size ? size : 1);
+}
+
+void *
+operator new[] (size_t size, const std::nothrow_t &) noexcept
+{
+  count_allocation (size, __builtin_return_address (0));
+  return __libc_malloc (size ? size : 1);
+}
+
+void operator delete (void *ptr) noexcept { __libc_free (ptr); }
+void operator delete[] (void *ptr) noexcept { __libc_free (ptr); }
+void operator delete (void *ptr, size_t) noexcept { __libc_free (ptr); }
+void operator delete[] (void *ptr, size_t) noexcept { __libc_free (ptr); }
+void operator delete (void *ptr, std::align_val_t) noexcept { __libc_free (ptr); }
+void operator delete[] (void *ptr, std::align_val_t) noexcept { __libc_free (ptr); }
+void operator delete (void *ptr, size_t, std::align_val_t) noexcept { __libc_free (ptr); }
+void operator delete[] (void *ptr, size_t, std::align_val_t) noexcept { __libc_free (ptr); }
+
+bool
+alloc_tracker_enabled (void)
+{
+  return true;
+}
+
+#else
+
+bool
+alloc_tracker_enabled (void)
+{
+  return false;
+}
+
+#endif
+
+static int
+add_library_code (struct dl_phdr_info *info, size_t, void *data)
+{
+  const char *name = (const char *) data;
+  int found = 0;
+
+  if (!strstr (info->dlpi_name, name))
+    return 0;
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+    int n = num_excluded.load (std::memory_order_relaxed);
+
+    if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X))
+      continue;
+    if (n == MAX_ALLOC_EXCLUDED)
+      break;
+    excluded[n].start = info->dlpi_addr + phdr->p_vaddr;
+    excluded[n].end = excluded[n].start + phdr->p_memsz;
+    num_excluded.store (n + 1, std::memory_order_release);
+    found = 1;
+  }
+  return found;
+}
+
+bool
+alloc_tracker_exclude_library (const char *name)
+{
+  return dl_iterate_phdr (add_library_code, (void *) name) != 0;
+}
+
+/* What the calling thread has allocated since it started */
+AllocCount
+alloc_tracker_thread_total (void)
+{
+  return thread_total;
+}
+
+/* Fills in the zones that have allocated anything, most allocations first */
+int
+alloc_tracker_zones (const char **names, AllocCount *counts, int max)
+{
+  int order[MAX_ALLOC_ZONES + 1];
+  ZoneSlot *slots[MAX_ALLOC_ZONES + 1];
+  int n = 0;
+
+  for (int i = 0; i < MAX_ALLOC_ZONES; i++)
+    if (zones[i].name.load (std::memory_order_acquire) && zones[i].count.load ())
+      slots[n++] = &zones[i];
+  if (other_zones.count.load ())
+    slots[n++] = &other_zones;
+
+  for (int i = 0; i < n; i++)
+    order[i] = i;
+  std::sort (order, order + n, [&] (int a, int b) {
+      return slots[a]->count.load () > slots[b]->count.load ();
+    });
+
+  n = std::min (n, max);
+  for (int i = 0; i < n; i++) {
+    ZoneSlot *slot = slots[order[i]];
+    names[i] = slot == &other_zones ? "(other zones)" : slot->name.load ();
+    counts[i].count = slot->count.load ();
+    counts[i].bytes = slot->bytes.load ();
+  }
+  return n;
+}
+
+void
+alloc_tracker_reset_zones (void)
+{
+  for (int i = 0; i < MAX_ALLOC_ZONES; i++) {
+    zones[i].count.store (0);
+    zones[i].bytes.store (0);
+  }
+  other_zones.count.store (0);
+  other_zones.bytes.store (0);
+}
+
+void
+alloc_tracker_dump (FILE *fp, const AllocPeriod *periods, int num_periods)
+{
+  const char *names[MAX_ALLOC_ZONES + 1];
+  AllocCount counts[MAX_ALLOC_ZONES + 1];
+  int n;
+
+  if (!alloc_tracker_enabled ()) {
+    fprintf (fp, "Allocations aren't tracked in this build\n");
+    return;
+  }
+
+  fprintf (fp, "%-18s %10s %12s %12s %12s %14s\n",
+           "allocations", "periods", "count", "per period", "worst", "bytes/period");
+  for (int i = 0; i < num_periods; i++) {
+    const AllocPeriod *p = &periods[i];
+    guint64 divisor = p->periods ? p->periods : 1;
+
+    fprintf (fp, "%-18s %10llu %12llu %12.2f %12llu %14.1f\n", p->name,
+             (unsigned long long) p->periods, (unsigned long long) p->total.count,
+             p->total.count / (double) divisor, (unsigned long long) p->worst.count,
+             p->total.bytes / (double) divisor);
+  }
+
+  n = alloc_tracker_zones (names, counts, MAX_ALLOC_ZONES + 1);
+  fprintf (fp, "%-32s %12s %14s\n", "zone", "count", "bytes");
+  for (int i = 0; i < n; i++)
+    fprintf (fp, "%-32s %12llu %14llu\n", names[i],
+             (unsigned long long) counts[i].count, (unsigned long long) counts[i].bytes);
+}
+
+void
+alloc_period_init (AllocPeriod *period, const char *name)
+{
+  memset (period, 0, sizeof (*period));
+  period->name = name;
+}
+
+void
+alloc_period_begin (AllocPeriod *period)
+{
+  period->start = thread_total;
+}
+
+/* Adds up the period just ended, and returns what it allocated */
+AllocCount
+alloc_period_end (AllocPeriod *period)
+{
+  AllocCount now = thread_total;
+  AllocCount delta;
+
+  delta.count = now.count - period->start.count;
+  delta.bytes = now.bytes - period->start.bytes;
+
+  period->periods++;
+  period->total.count += delta.count;
+  period->total.bytes += delta.bytes;
+  period->worst.count = std::max (period->worst.count, delta.count);
+  period->worst.bytes = std::max (period->worst.bytes, delta.bytes);
+  period->start = now;
+  return delta;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
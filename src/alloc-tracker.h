@@ -0,0 +1,88 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ALLOC_TRACKER_H__
+#define __ALLOC_TRACKER_H__
+
+#include <glib.h>
+
+#include <stdio.h>
+
+// Distinct trace zones counted; any more are lumped together
+#define MAX_ALLOC_ZONES  (64)
+
+// Code segments whose allocations can be left out of the counts
+#define MAX_ALLOC_EXCLUDED  (16)
+
+typedef struct
+{
+  guint64  count;
+  guint64  bytes;
+} AllocCount;
+
+/*
+ * One thread's allocations over a run of periods, like ticks or frames.
+ * Wrap each period in alloc_period_begin() and alloc_period_end().
+ */
+typedef struct
+{
+  const char *name;
+  guint64     periods;
+  AllocCount  total;
+  AllocCount  worst;          /// Most in any one period
+  AllocCount  start;          /// The thread's total when this one began
+} AllocPeriod;
+
+/*
+ * Counts heap allocations when built with TRACK_ALLOCATIONS, by
+ * replacing malloc and the global operator new.  Each is put down to the
+ * innermost trace zone of the thread that made it.  Without it, nothing
+ * is replaced and every count stays at zero.
+ */
+bool       alloc_tracker_enabled(void);
+AllocCount alloc_tracker_thread_total(void);
+int        alloc_tracker_zones(const char **names, AllocCount *counts, int max);
+void       alloc_tracker_reset_zones(void);
+void       alloc_tracker_dump(FILE *fp, const AllocPeriod *periods, int num_periods);
+
+/*
+ * Leaves out allocations made straight from a loaded library's code,
+ * picked by a part of its file name, like "libcairo".  Only the direct
+ * caller is looked at, so the game's own allocations still count even
+ * when they happen inside a library's callback.  Returns whether the
+ * library was found.
+ */
+bool       alloc_tracker_exclude_library(const char *name);
+
+void       alloc_period_init(AllocPeriod *period, const char *name);
+void       alloc_period_begin(AllocPeriod *period);
+AllocCount alloc_period_end(AllocPeriod *period);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,708 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cairo.h>
+#include <glib.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assets.h"
+#include "debug.h"
+
+#define ASSET_CACHE_MAGIC       "SCSC"
+#define ASSET_CACHE_BYTE_ORDER  (0x01020304)
+
+// Nesting of <g> elements followed for their transforms
+#define MAX_GROUP_DEPTH         (16)
+
+static size_t
+align8 (size_t size)
+{
+  return (size + 7) & ~(size_t) 7;
+}
+
+/*
+ * One sprite file as parsed by a pool thread.  Segments live in the
+ * sprite's own arena, so threads never share an allocator.
+ */
+typedef struct
+{
+  gchar      *filename;
+  char        name[SPRITE_NAME_LENGTH];
+  double      width, height;
+  int         num_paths;
+  Path       *paths[MAX_SPRITE_PATHS];
+  SpritePath  styles[MAX_SPRITE_PATHS];
+  PathArena   arena;
+  bool        ok;
+} SpriteSource;
+
+/* FNV-1a, good enough to notice that a sprite file changed */
+static guint64
+stamp_bytes (guint64 hash, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char *) data;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= G_GUINT64_CONSTANT(1099511628211);
+  }
+  return hash;
+}
+
+static gint
+compare_names (gconstpointer a, gconstpointer b)
+{
+  return strcmp((const char *) a, (const char *) b);
+}
+
+/*
+ * Lists the .svg files of @sprite_dir in name order, and hashes their
+ * names, sizes and modification times into @stamp.  Returns NULL if the
+ * directory can't be opened or has no .svg files.
+ */
+static GSList *
+list_sprites (const char *sprite_dir, guint64 *stamp)
+{
+  GDir *dir = g_dir_open (sprite_dir, 0, NULL);
+  GSList *names = NULL;
+  const gchar *name;
+  guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+  if (!dir)
+    return NULL;
+
+  while ((name = g_dir_read_name (dir)) != NULL) {
+    if (g_str_has_suffix (name, ".svg"))
+      names = g_slist_insert_sorted (names, g_strdup (name), compare_names);
+  }
+  g_dir_close (dir);
+
+  hash = stamp_bytes (hash, sprite_dir, strlen(sprite_dir));
+  for (GSList *l = names; l; l = l->next) {
+    gchar *filename = g_build_filename (sprite_dir, (const char *) l->data, NULL);
+    struct stat st;
+
+    hash = stamp_bytes (hash, l->data, strlen((const char *) l->data) + 1);
+    if (stat(filename, &st) == 0) {
+      gint64 mtime = (gint64) st.st_mtime;
+      gint64 size = (gint64) st.st_size;
+      hash = stamp_bytes (hash, &mtime, sizeof(mtime));
+      hash = stamp_bytes (hash, &size, sizeof(size));
+    }
+    g_free (filename);
+  }
+
+  *stamp = hash;
+  return names;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SVG scanning                                                            */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * This is not an XML parser.  It understands exactly what the sprite
+ * files use: the root's width and height, <g> translate() and matrix()
+ * transforms, and <path> elements with d and a style attribute.
+ */
+
+/**
+ * Copies the value of attribute @name of the element starting at @tag
+ * (and ending at @end) into a new string, or returns NULL.
+ */
+static gchar *
+element_attribute (const char *tag, const char *end, const char *name)
+{
+  size_t len = strlen(name);
+
+  for (const char *p = tag; p + len + 2 < end; p++) {
+    if (!g_ascii_isspace (*p) || strncmp(p + 1, name, len) != 0 || p[len + 1] != '=')
+      continue;
+
+    const char *value = p + len + 2;
+    char quote = *value;
+    if (quote != '"' && quote != '\'')
+      continue;
+    const char *close = (const char *) memchr(value + 1, quote, end - value - 1);
+    if (!close)
+      return NULL;
+    return g_strndup (value + 1, close - value - 1);
+  }
+  return NULL;
+}
+
+/**
+ * Finds property @name in a CSS style string and returns a pointer to
+ * its value, or NULL.
+ */
+static const char *
+style_property (const char *style, const char *name)
+{
+  size_t len = strlen(name);
+
+  for (const char *p = style; p && *p; ) {
+    while (*p == ';' || g_ascii_isspace (*p))
+      p++;
+    if (strncmp(p, name, len) == 0 && p[len] == ':')
+      return p + len + 1;
+    p = strchr(p, ';');
+  }
+  return NULL;
+}
+
+static int
+hex_digit (char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/**
+ * Reads a #rrggbb or #rgb color into @rgba, leaving alpha alone.
+ * "none" sets alpha to zero.  Returns false for anything else.
+ */
+static bool
+read_color (const char *value, double *rgba)
+{
+  int digits[6];
+  int n = 0;
+
+  if (strncmp(value, "none", 4) == 0) {
+    rgba[3] = 0.0;
+    return true;
+  }
+  if (*value++ != '#')
+    return false;
+
+  while (n < 6 && hex_digit(value[n]) >= 0) {
+    digits[n] = hex_digit(value[n]);
+    n++;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (n == 6)
+      rgba[i] = (digits[2*i] * 16 + digits[2*i + 1]) / 255.0;
+    else if (n == 3)
+      rgba[i] = digits[i] * 17 / 255.0;
+    else
+      return false;
+  }
+  return true;
+}
+
+static void
+read_style (const char *style, SpritePath *sp)
+{
+  const char *value;
+
+  // SVG defaults: black fill, no stroke
+  sp->fill[0] = sp->fill[1] = sp->fill[2] = 0.0;
+  sp->fill[3] = 1.0;
+  sp->stroke[0] = sp->stroke[1] = sp->stroke[2] = sp->stroke[3] = 0.0;
+  sp->stroke_width = 1.0;
+
+  if (!style)
+    return;
+
+  if ((value = style_property (style, "fill")))
+    read_color (value, sp->fill);
+  if ((value = style_property (style, "stroke"))) {
+    sp->stroke[3] = 1.0;
+    if (!read_color (value, sp->stroke))
+      sp->stroke[3] = 0.0;
+  }
+  if ((value = style_property (style, "fill-opacity")) && sp->fill[3] > 0.0)
+    sp->fill[3] = g_ascii_strtod (value, NULL);
+  if ((value = style_property (style, "stroke-opacity")) && sp->stroke[3] > 0.0)
+    sp->stroke[3] = g_ascii_strtod (value, NULL);
+  if ((value = style_property (style, "stroke-width")))
+    sp->stroke_width = g_ascii_strtod (value, NULL);
+}
+
+/**
+ * Reads a translate() or matrix() transform attribute, as Inkscape
+ * writes them, into @m.  Anything else is taken as the identity.
+ */
+static void
+read_transform (const char *value, cairo_matrix_t *m)
+{
+  double v[6] = { 0.0 };
+  int n = 0;
+  const char *p;
+
+  cairo_matrix_init_identity (m);
+  if (!value || !(p = strchr(value, '(')))
+    return;
+
+  for (p++; n < 6 && *p && *p != ')'; n++) {
+    char *next;
+    v[n] = g_ascii_strtod (p, &next);
+    if (next == p)
+      break;
+    p = next;
+    while (*p == ',' || g_ascii_isspace (*p))
+      p++;
+  }
+
+  if (g_str_has_prefix (value, "translate") && n >= 1)
+    cairo_matrix_init_translate (m, v[0], v[1]);
+  else if (g_str_has_prefix (value, "matrix") && n == 6)
+    cairo_matrix_init (m, v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+static void
+transform_point (const cairo_matrix_t *m, Point &pt)
+{
+  double x = pt[0], y = pt[1];
+
+  cairo_matrix_transform_point (m, &x, &y);
+  pt[0] = x;
+  pt[1] = y;
+}
+
+static void
+scan_sprite (SpriteSource *src, const char *data)
+{
+  cairo_matrix_t groups[MAX_GROUP_DEPTH + 1];
+  int depth = 0;
+
+  cairo_matrix_init_identity (&groups[0]);
+
+  for (const char *tag = strchr(data, '<'); tag; tag = strchr(tag + 1, '<')) {
+    const char *end = strchr(tag, '>');
+    if (!end)
+      break;
+
+    if (strncmp(tag, "<svg", 4) == 0 && g_ascii_isspace (tag[4])) {
+      gchar *w = element_attribute (tag, end, "width");
+      gchar *h = element_attribute (tag, end, "height");
+      src->width = w ? g_ascii_strtod (w, NULL) : 0.0;
+      src->height = h ? g_ascii_strtod (h, NULL) : 0.0;
+      g_free (w);
+      g_free (h);
+
+      // Put the origin in the middle of the document
+      cairo_matrix_init_translate (&groups[0], -src->width / 2, -src->height / 2);
+    } else if (strncmp(tag, "<g", 2) == 0 && (g_ascii_isspace (tag[2]) || tag[2] == '>')) {
+      if (end[-1] == '/' || depth >= MAX_GROUP_DEPTH)
+        continue;
+      gchar *value = element_attribute (tag, end, "transform");
+      cairo_matrix_t local;
+      read_transform (value, &local);
+      cairo_matrix_multiply (&groups[depth + 1], &local, &groups[depth]);
+      depth++;
+      g_free (value);
+    } else if (strncmp(tag, "</g", 3) == 0) {
+      if (depth > 0)
+        depth--;
+    } else if (strncmp(tag, "<path", 5) == 0 && g_ascii_isspace (tag[5])) {
+      if (src->num_paths >= MAX_SPRITE_PATHS) {
+        dbg("%s: more than %d paths, ignoring the rest\n", src->filename, MAX_SPRITE_PATHS);
+        break;
+      }
+
+      gchar *d = element_attribute (tag, end, "d");
+      gchar *style = element_attribute (tag, end, "style");
+      if (d) {
+        Path *path = sp_svg_read_path (d, &src->arena);
+        for (int i = 0; i < path->segment_count; i++) {
+          transform_point (&groups[depth], path->segments[i].c1);
+          transform_point (&groups[depth], path->segments[i].c2);
+          transform_point (&groups[depth], path->segments[i].pt);
+        }
+        read_style (style, &src->styles[src->num_paths]);
+        src->paths[src->num_paths++] = path;
+      }
+      g_free (d);
+      g_free (style);
+    }
+    tag = end;
+  }
+}
+
+/* Thread pool worker: parses one sprite file */
+static void
+load_sprite (gpointer data, gpointer user_data)
+{
+  SpriteSource *src = (SpriteSource *) data;
+  gchar *contents = NULL;
+
+  (void) user_data;
+
+  if (!g_file_get_contents (src->filename, &contents, NULL, NULL))
+    return;
+
+  scan_sprite (src, contents);
+  src->ok = (src->width > 0.0 && src->height > 0.0);
+  g_free (contents);
+}
+
+/* ---------------------------------------------------------------------- */
+/* AssetSet                                                                */
+/* ---------------------------------------------------------------------- */
+
+AssetSet::AssetSet()
+  : _image(NULL), _size(0), _mapped(false), _load_millis(0.0),
+    _header(NULL), _sprites(NULL), _paths(NULL), _segments(NULL)
+{
+}
+
+AssetSet::~AssetSet()
+{
+  unload();
+}
+
+void
+AssetSet::unload()
+{
+  if (_mapped)
+    munmap(_image, _size);
+  else
+    g_free (_image);
+
+  _image = NULL;
+  _size = 0;
+  _mapped = false;
+  _header = NULL;
+  _sprites = NULL;
+  _paths = NULL;
+  _segments = NULL;
+}
+
+/*
+ * Checks that a cache image was written by this build from the current
+ * sprite files and is complete, then takes it over.  Mapped images are
+ * unmapped and others freed if they don't pass.
+ */
+bool
+AssetSet::use_image(char *image, size_t size, bool mapped, guint64 stamp)
+{
+  const AssetCacheHeader *h = (const AssetCacheHeader *) image;
+  size_t paths_offset, segments_offset, needed = 0;
+
+  if (size >= sizeof(AssetCacheHeader) &&
+      memcmp(h->magic, ASSET_CACHE_MAGIC, 4) == 0 &&
+      h->version == ASSET_CACHE_VERSION &&
+      h->byte_order == ASSET_CACHE_BYTE_ORDER &&
+      h->segment_size == sizeof(PathSegment) &&
+      h->source_stamp == stamp &&
+      h->num_sprites <= MAX_SPRITES &&
+      h->num_paths <= MAX_SPRITES * MAX_SPRITE_PATHS) {
+    paths_offset = align8(sizeof(AssetCacheHeader)) + align8(h->num_sprites * sizeof(Sprite));
+    segments_offset = paths_offset + align8(h->num_paths * sizeof(SpritePath));
+    needed = segments_offset + (size_t) h->num_segments * sizeof(PathSegment);
+  }
+
+  if (needed == 0 || size < needed) {
+    if (mapped)
+      munmap(image, size);
+    else
+      g_free (image);
+    return false;
+  }
+
+  const Sprite *sprites = (const Sprite *) (image + align8(sizeof(AssetCacheHeader)));
+  const SpritePath *paths = (const SpritePath *) (image + paths_offset);
+
+  // Don't trust indices from disk
+  for (guint32 i = 0; i < h->num_sprites; i++) {
+    if (sprites[i].first_path + (guint64) sprites[i].num_paths > h->num_paths)
+      needed = 0;
+  }
+  for (guint32 i = 0; i < h->num_paths; i++) {
+    if (paths[i].first_segment + (guint64) paths[i].num_segments > h->num_segments)
+      needed = 0;
+  }
+  if (needed == 0) {
+    if (mapped)
+      munmap(image, size);
+    else
+      g_free (image);
+    return false;
+  }
+
+  unload();
+  _image = image;
+  _size = size;
+  _mapped = mapped;
+  _header = h;
+  _sprites = sprites;
+  _paths = paths;
+  _segments = (const PathSegment *) (image + segments_offset);
+  return true;
+}
+
+bool
+AssetSet::map_cache(const char *cache_file, guint64 stamp)
+{
+  struct stat st;
+  void *image;
+  int fd;
+
+  if (!cache_file || (fd = open(cache_file, O_RDONLY)) < 0)
+    return false;
+
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(AssetCacheHeader)) {
+    close(fd);
+    return false;
+  }
+
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+    return false;
+
+  return use_image((char *) image, st.st_size, true, stamp);
+}
+
+/*
+ * Parses every sprite on a thread pool, one task per file, then packs
+ * the results into a cache image.  The image is written out for next
+ * time and kept in memory for this run.
+ */
+bool
+AssetSet::build(const char *sprite_dir, const char *cache_file, GSList *names, guint64 stamp)
+{
+  SpriteSource *sources[MAX_SPRITES];
+  int num_sources = 0;
+  GThreadPool *pool;
+  guint32 num_sprites = 0, num_paths = 0, num_segments = 0;
+
+  pool = g_thread_pool_new (load_sprite, NULL, g_get_num_processors (), FALSE, NULL);
+
+  for (GSList *l = names; l; l = l->next) {
+    if (num_sources >= MAX_SPRITES) {
+      dbg("More than %d sprites, ignoring the rest\n", MAX_SPRITES);
+      break;
+    }
+
+    SpriteSource *src = new SpriteSource();
+    src->filename = g_build_filename (sprite_dir, (const char *) l->data, NULL);
+    g_strlcpy (src->name, (const char *) l->data, sizeof(src->name));
+    char *suffix = g_strrstr (src->name, ".svg");
+    if (suffix)
+      *suffix = '\0';
+    sources[num_sources++] = src;
+
+    if (pool)
+      g_thread_pool_push (pool, src, NULL);
+    else
+      load_sprite (src, NULL);
+  }
+
+  // Waits for every queued file to be parsed
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (int i = 0; i < num_sources; i++) {
+    if (!sources[i]->ok) {
+      dbg("Could not load sprite %s\n", sources[i]->filename);
+      continue;
+    }
+    num_sprites++;
+    num_paths += sources[i]->num_paths;
+    for (int p = 0; p < sources[i]->num_paths; p++)
+      num_segments += sources[i]->paths[p]->segment_count;
+  }
+
+  size_t paths_offset = align8(sizeof(AssetCacheHeader)) + align8(num_sprites * sizeof(Sprite));
+  size_t segments_offset = paths_offset + align8(num_paths * sizeof(SpritePath));
+  size_t size = segments_offset + (size_t) num_segments * sizeof(PathSegment);
+  char *image = (char *) g_malloc0 (size);
+
+  AssetCacheHeader *h = (AssetCacheHeader *) image;
+  Sprite *sprite = (Sprite *) (image + align8(sizeof(AssetCacheHeader)));
+  SpritePath *path = (SpritePath *) (image + paths_offset);
+  PathSegment *segment = (PathSegment *) (image + segments_offset);
+
+  memcpy(h->magic, ASSET_CACHE_MAGIC, 4);
+  h->version = ASSET_CACHE_VERSION;
+  h->byte_order = ASSET_CACHE_BYTE_ORDER;
+  h->segment_size = sizeof(PathSegment);
+  h->source_stamp = stamp;
+  h->num_sprites = num_sprites;
+  h->num_paths = num_paths;
+  h->num_segments = num_segments;
+
+  guint32 next_path = 0, next_segment = 0;
+  for (int i = 0; i < num_sources; i++) {
+    SpriteSource *src = sources[i];
+
+    if (src->ok) {
+      memcpy(sprite->name, src->name, sizeof(sprite->name));
+      sprite->first_path = next_path;
+      sprite->num_paths = src->num_paths;
+      sprite->width = src->width;
+      sprite->height = src->height;
+      sprite++;
+
+      for (int p = 0; p < src->num_paths; p++) {
+        *path = src->styles[p];
+        path->first_segment = next_segment;
+        path->num_segments = src->paths[p]->segment_count;
+        for (int s = 0; s < src->paths[p]->segment_count; s++)
+          segment[next_segment++] = src->paths[p]->segments[s];
+        path++;
+        next_path++;
+      }
+    }
+
+    for (int p = 0; p < src->num_paths; p++)
+      delete src->paths[p];
+    g_free (src->filename);
+    delete src;
+  }
+
+  // An empty cache would pass for good until the files changed
+  if (cache_file && num_sprites > 0) {
+    gchar *dir = g_path_get_dirname (cache_file);
+    GError *error = NULL;
+
+    g_mkdir_with_parents (dir, 0755);
+    if (!g_file_set_contents (cache_file, image, size, &error)) {
+      dbg("Could not write sprite cache: %s\n", error->message);
+      g_error_free (error);
+    }
+    g_free (dir);
+  }
+
+  return use_image(image, size, false, stamp) && num_sprites > 0;
+}
+
+/**
+ * Loads the sprites in @sprite_dir, from @cache_file if it is up to
+ * date and otherwise by parsing them and rewriting the cache.  Pass a
+ * NULL @cache_file to always parse and never write a cache.  Returns
+ * false if @sprite_dir can't be read or none of its sprites load.
+ */
+bool
+AssetSet::load(const char *sprite_dir, const char *cache_file)
+{
+  gint64 start = g_get_monotonic_time ();
+  guint64 stamp = 0;
+  GSList *names = list_sprites (sprite_dir, &stamp);
+  bool ok;
+
+  if (!names) {
+    dbg("No sprites in %s\n", sprite_dir);
+    unload();
+    return false;
+  }
+
+  ok = map_cache(cache_file, stamp) || build(sprite_dir, cache_file, names, stamp);
+  g_slist_free_full (names, g_free);
+
+  _load_millis = (g_get_monotonic_time () - start) / 1000.0;
+  dbg("Loaded %d sprites from %s in %.2f ms\n",
+      count(), _mapped ? "cache" : sprite_dir, _load_millis);
+  return ok;
+}
+
+int
+AssetSet::count() const
+{
+  return _header ? _header->num_sprites : 0;
+}
+
+const Sprite *
+AssetSet::sprite(int index) const
+{
+  if (index < 0 || index >= count())
+    return NULL;
+  return &_sprites[index];
+}
+
+const Sprite *
+AssetSet::find(const char *name) const
+{
+  for (int i = 0; i < count(); i++) {
+    if (strncmp(_sprites[i].name, name, SPRITE_NAME_LENGTH) == 0)
+      return &_sprites[i];
+  }
+  return NULL;
+}
+
+const SpritePath *
+AssetSet::path(const Sprite *sprite, int index) const
+{
+  if (index < 0 || index >= (int) sprite->num_paths)
+    return NULL;
+  return &_paths[sprite->first_path + index];
+}
+
+const PathSegment *
+AssetSet::segments(const SpritePath *path) const
+{
+  return &_segments[path->first_segment];
+}
+
+/**
+ * Draws a sprite centered on the current origin, one unit per pixel of
+ * its document.
+ */
+void
+AssetSet::draw(cairo_t *cr, const Sprite *sprite) const
+{
+  for (guint32 i = 0; i < sprite->num_paths; i++) {
+    const SpritePath *p = &_paths[sprite->first_path + i];
+
+    cairo_new_path (cr);
+    path_draw_segments (cr, &_segments[p->first_segment], p->num_segments);
+
+    if (p->fill[3] > 0.0) {
+      cairo_set_source_rgba (cr, p->fill[0], p->fill[1], p->fill[2], p->fill[3]);
+      cairo_fill_preserve (cr);
+    }
+    if (p->stroke[3] > 0.0) {
+      cairo_set_source_rgba (cr, p->stroke[0], p->stroke[1], p->stroke[2], p->stroke[3]);
+      cairo_set_line_width (cr, p->stroke_width);
+      cairo_stroke_preserve (cr);
+    }
+  }
+  cairo_new_path (cr);
+}
+
+/**
+ * Returns the default cache file, under the user's cache directory.
+ */
+gchar *
+asset_cache_filename(void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "spacecastle", "sprites.cache", NULL);
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,127 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ASSETS_H__
+#define __ASSETS_H__
+
+#include <glib.h>
+
+#include "forward.h"
+#include "path.h"
+
+#define MAX_SPRITES          (64)
+#define MAX_SPRITE_PATHS     (32)
+#define SPRITE_NAME_LENGTH   (32)
+
+// Bump whenever the layout of the cache records changes
+#define ASSET_CACHE_VERSION  (1)
+
+/*
+ * Records of the binary sprite cache.  The cache is a header followed
+ * by arrays of Sprite, SpritePath and PathSegment records, all in host
+ * byte order, and is used in place once mapped.
+ */
+typedef struct
+{
+  char     name[SPRITE_NAME_LENGTH];  /// File name without .svg
+  guint32  first_path;                /// Index of the sprite's first SpritePath
+  guint32  num_paths;
+  double   width;                     /// Document size; the origin is its center
+  double   height;
+} Sprite;
+
+typedef struct
+{
+  guint32  first_segment;             /// Index of the path's first PathSegment
+  guint32  num_segments;
+  double   fill[4];                   /// RGBA, alpha zero for no fill
+  double   stroke[4];                 /// RGBA, alpha zero for no stroke
+  double   stroke_width;
+} SpritePath;
+
+typedef struct
+{
+  char     magic[4];
+  guint32  version;
+  guint32  byte_order;                /// Reads as ASSET_CACHE_BYTE_ORDER if native
+  guint32  segment_size;              /// sizeof(PathSegment) when written
+  guint64  source_stamp;              /// Hash of the sprite files' names, sizes and times
+  guint32  num_sprites;
+  guint32  num_paths;
+  guint32  num_segments;
+  guint32  reserved;
+} AssetCacheHeader;
+
+/*
+ * The game's sprite art.
+ *
+ * load() reads every .svg in a directory.  Files are parsed in
+ * parallel on a thread pool, and the result is flattened into the cache
+ * format and written to the cache file.  While the sprite files haven't
+ * changed, later loads just map the cache file and use it in place
+ * without parsing anything.
+ */
+class AssetSet {
+public:
+  AssetSet();
+  ~AssetSet();
+
+  bool          load(const char *sprite_dir, const char *cache_file);
+  void          unload();
+
+  int           count() const;
+  const Sprite *sprite(int index) const;
+  const Sprite *find(const char *name) const;
+  const SpritePath  *path(const Sprite *sprite, int index) const;
+  const PathSegment *segments(const SpritePath *path) const;
+  void          draw(cairo_t *cr, const Sprite *sprite) const;
+
+  bool          from_cache() const { return _mapped; }
+  double        load_millis() const { return _load_millis; }
+
+private:
+  char                   *_image;     /// Cache contents, mapped or in memory
+  size_t                  _size;
+  bool                    _mapped;
+  double                  _load_millis;
+
+  const AssetCacheHeader *_header;
+  const Sprite           *_sprites;
+  const SpritePath       *_paths;
+  const PathSegment      *_segments;
+
+  bool use_image(char *image, size_t size, bool mapped, guint64 stamp);
+  bool map_cache(const char *cache_file, guint64 stamp);
+  bool build(const char *sprite_dir, const char *cache_file, GSList *names, guint64 stamp);
+};
+
+gchar *asset_cache_filename(void);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
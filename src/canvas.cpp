@@ -17,6 +17,7 @@
  */
 
 #include "canvas.h"
+#include "counted-cairo.h"
 
 #include <glib.h>
 #include <cairo.h>
@@ -27,9 +28,15 @@ add_color_stop (cairo_pattern_t* pat, double offset, RGB_t color, double alpha)
   cairo_pattern_add_color_stop_rgba (pat, offset, color.r, color.g, color.b, alpha);
 }
 
+void
+set_source_color (cairo_t *cr, RGB_t color, double alpha)
+{
+  cairo_set_source_rgba (cr, color.r, color.g, color.b, alpha);
+}
+
 
 CanvasItem::CanvasItem (canvas_item_draw f)
-  : pos(0,0), rotation(0.0), scale(1.0), draw_func(f)
+  : draw_func(f)
 {
 }
 
@@ -40,9 +47,7 @@ CanvasItem::draw (cairo_t * cr)
     return;
 
   cairo_save (cr);
-  cairo_translate (cr, this->pos[0], this->pos[1]);
-  cairo_rotate (cr, this->rotation);
-  cairo_scale (cr, this->scale, this->scale);
+  cairo_set_matrix (cr, &world_matrix());
   (*draw_func) (cr, this);
   cairo_restore (cr);
 }
@@ -55,38 +60,60 @@ CanvasItem::set_theme(RGB_t primary, RGB_t secondary)
   secondary_color = secondary;
 }
 
-Canvas::Canvas(int w, int h): width(w), height(h), debug_scale_factor(1.0)
+Canvas::Canvas(int w, int h)
+  : width(w), height(h),
+    render_width(w), render_height(h),
+    offscreen(NULL),
+    debug_scale_factor(1.0)
 {
 }
 
-void
-Canvas::scale_for_aspect_ratio(cairo_t *cr, int window_width, int window_height)
+Canvas::~Canvas()
 {
-  double scale;
-  int playfield_width, playfield_height;
-  int tx, ty;
-  gboolean is_window_wider;
-
-  cairo_save (cr);
+  if (offscreen)
+    cairo_surface_destroy (offscreen);
+}
 
-  is_window_wider = (window_width * height) > (width * window_height);
+/*
+ * Works out where the playfield goes in a window: the largest area of
+ * the playfield's aspect ratio, centered.  Returns the scale from
+ * playfield units to window pixels.
+ */
+double
+Canvas::playfield_rect(int window_width, int window_height,
+                       int *x, int *y, int *playfield_width, int *playfield_height)
+{
+  gboolean is_window_wider = (window_width * height) > (width * window_height);
 
   if (is_window_wider)
   {
-    scale = ((double) window_height) / height;
-    playfield_width = (width * window_height) / height;
-    playfield_height = window_height;
-    tx = (window_width - playfield_width) / 2;
-    ty = 0;
+    *playfield_width = (width * window_height) / height;
+    *playfield_height = window_height;
+    *x = (window_width - *playfield_width) / 2;
+    *y = 0;
+    return ((double) window_height) / height;
   }
   else
   {
-    scale = ((double) window_width) / width;
-    playfield_width = window_width;
-    playfield_height = (height * window_width) / width;
-    tx = 0;
-    ty = (window_height - playfield_height) / 2;
+    *playfield_width = window_width;
+    *playfield_height = (height * window_width) / width;
+    *x = 0;
+    *y = (window_height - *playfield_height) / 2;
+    return ((double) window_width) / width;
   }
+}
+
+void
+Canvas::scale_for_aspect_ratio(cairo_t *cr, int window_width, int window_height)
+{
+  int playfield_width, playfield_height;
+  int tx, ty;
+  double scale;
+
+  cairo_save (cr);
+
+  scale = playfield_rect (window_width, window_height,
+                          &tx, &ty, &playfield_width, &playfield_height);
 
   cairo_translate (cr, tx, ty);
   cairo_rectangle (cr, 0, 0, playfield_width, playfield_height);
@@ -97,6 +124,102 @@ Canvas::scale_for_aspect_ratio(cairo_t *cr, int window_width, int window_height)
   cairo_scale (cr, debug_scale_factor, debug_scale_factor);
 }
 
+/**
+ * Sets the size the playfield is rendered at before being scaled to the
+ * window.  Zero for either means render at the window's own resolution.
+ */
+void
+Canvas::set_render_size(int w, int h)
+{
+  render_width = w;
+  render_height = h;
+}
+
+/**
+ * Returns a context for drawing the next frame in playfield units.
+ *
+ * If the render size, scaled by @resolution, is smaller than the
+ * playfield's area in the window, the frame is drawn into an offscreen
+ * image of that size and end_frame() blits it up to the window, so
+ * filling costs the same however big the window is.  Otherwise this
+ * draws straight into @window_cr.
+ */
+cairo_t *
+Canvas::begin_frame(cairo_t *window_cr, int window_width, int window_height, double resolution)
+{
+  int tx, ty, playfield_width, playfield_height;
+  int w, h;
+  cairo_t *cr;
+
+  playfield_rect (window_width, window_height, &tx, &ty, &playfield_width, &playfield_height);
+
+  if (render_width > 0 && render_height > 0) {
+    w = (int) (render_width * resolution + 0.5);
+    h = (int) (render_height * resolution + 0.5);
+  } else {
+    w = (int) (playfield_width * resolution + 0.5);
+    h = (int) (playfield_height * resolution + 0.5);
+  }
+
+  if (w <= 0 || h <= 0 || (w >= playfield_width && h >= playfield_height)) {
+    scale_for_aspect_ratio (window_cr, window_width, window_height);
+    return window_cr;
+  }
+
+  if (!offscreen ||
+      cairo_image_surface_get_width (offscreen) != w ||
+      cairo_image_surface_get_height (offscreen) != h) {
+    if (offscreen)
+      cairo_surface_destroy (offscreen);
+    offscreen = cairo_image_surface_create (CAIRO_FORMAT_RGB24, w, h);
+  }
+
+  offscreen_rect[0] = tx;
+  offscreen_rect[1] = ty;
+  offscreen_rect[2] = playfield_width;
+  offscreen_rect[3] = playfield_height;
+
+  cr = cairo_create (offscreen);
+  cairo_scale (cr, ((double) w) / width, ((double) h) / height);
+  cairo_scale (cr, debug_scale_factor, debug_scale_factor);
+  return cr;
+}
+
+/**
+ * Finishes a frame started with begin_frame(), putting it on
+ * @window_cr if it was drawn offscreen.
+ */
+void
+Canvas::end_frame(cairo_t *cr, cairo_t *window_cr)
+{
+  cairo_pattern_t *pat;
+  double sx, sy;
+
+  if (cr == window_cr) {
+    cairo_restore (window_cr);
+    return;
+  }
+  cairo_destroy (cr);
+
+  sx = ((double) offscreen_rect[2]) / cairo_image_surface_get_width (offscreen);
+  sy = ((double) offscreen_rect[3]) / cairo_image_surface_get_height (offscreen);
+
+  cairo_save (window_cr);
+  cairo_translate (window_cr, offscreen_rect[0], offscreen_rect[1]);
+  cairo_rectangle (window_cr, 0, 0, offscreen_rect[2], offscreen_rect[3]);
+  cairo_scale (window_cr, sx, sy);
+  cairo_set_source_surface (window_cr, offscreen, 0, 0);
+
+  // Bilinear is plenty for upscaling, and the edges mustn't fade out
+  pat = cairo_get_source (window_cr);
+  cairo_pattern_set_filter (pat, CAIRO_FILTER_BILINEAR);
+  cairo_pattern_set_extend (pat, CAIRO_EXTEND_PAD);
+
+  cairo_set_operator (window_cr, CAIRO_OPERATOR_SOURCE);
+  cairo_fill (window_cr);
+  cairo_restore (window_cr);
+}
+
 /*
   Local Variables:
   mode:c++
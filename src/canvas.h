@@ -19,8 +19,11 @@
 #ifndef __CANVAS_H__
 #define __CANVAS_H__
 
+#include <stddef.h>
+
 #include "forward.h"
 #include "point.h"
+#include "scene-node.h"
 
 typedef void   (* canvas_item_draw) (cairo_t * cr, CanvasItem * item);
 
@@ -35,22 +38,19 @@ struct _RGB
 typedef struct _RGB RGB_t;
 
 void add_color_stop (cairo_pattern_t* pat, double offset, RGB_t color, double alpha);
+void set_source_color (cairo_t *cr, RGB_t color, double alpha);
 
-class CanvasItem {
+class CanvasItem : public SceneNode {
 private:
 
 public:
-    Point pos;
-    float rotation;
-    float scale;
     canvas_item_draw  draw_func;
 
     RGB_t primary_color;
     RGB_t secondary_color;
 
     void draw(cairo_t * cr);
-    CanvasItem() { CanvasItem(NULL); }
-    CanvasItem(canvas_item_draw f);
+    CanvasItem(canvas_item_draw f = NULL);
     void set_theme(RGB_t primary, RGB_t secondary);
 };
 
@@ -58,14 +58,27 @@ class Canvas {
 private:
     int      width;
     int      height;
+    int      render_width;
+    int      render_height;
+
+    cairo_surface_t *offscreen;
+    int      offscreen_rect[4];   /// Where the offscreen image goes in the window
+
+    double playfield_rect(int window_width, int window_height,
+                          int *x, int *y, int *playfield_width, int *playfield_height);
 
 public:
     double   debug_scale_factor;
 
     Canvas(int w, int h);
-    ~Canvas() { }
+    ~Canvas();
 
     void   scale_for_aspect_ratio(cairo_t *cr, int window_width, int window_height);
+
+    void     set_render_size(int w, int h);
+    cairo_t *begin_frame(cairo_t *window_cr, int window_width, int window_height,
+                         double resolution);
+    void     end_frame(cairo_t *cr, cairo_t *window_cr);
 };
 
 #endif
@@ -0,0 +1,478 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "collision.h"
+#include "debug.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// Cross products smaller than this count as collinear
+#define COLLISION_EPSILON  (1e-9)
+
+// Node pairs waiting to be visited while testing two shapes
+#define COLLISION_STACK_SIZE  (4 * COLLISION_MAX_PIECES)
+
+long CollisionShape::piece_tests = 0;
+
+typedef struct
+{
+  int n;
+  int v[COLLISION_MAX_PIECE_VERTICES];   /// Indices into the outline
+} Polygon;
+
+static double
+cross (const Point &o, const Point &a, const Point &b)
+{
+  return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+static bool
+in_triangle (const Point &p, const Point &a, const Point &b, const Point &c)
+{
+  return (cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0);
+}
+
+static bool
+is_convex (const Point *points, const Polygon *poly)
+{
+  for (int i = 0; i < poly->n; i++) {
+    const Point &a = points[poly->v[i]];
+    const Point &b = points[poly->v[(i + 1) % poly->n]];
+    const Point &c = points[poly->v[(i + 2) % poly->n]];
+    if (cross(a, b, c) < -COLLISION_EPSILON)
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Joins @b into @a if they share an edge and the result is convex and
+ * small enough for a piece.
+ */
+static bool
+merge_polygons (const Point *points, Polygon *a, const Polygon *b)
+{
+  for (int i = 0; i < a->n; i++) {
+    int u = a->v[i];
+    int w = a->v[(i + 1) % a->n];
+
+    for (int j = 0; j < b->n; j++) {
+      if (b->v[j] != w || b->v[(j + 1) % b->n] != u)
+        continue;
+
+      Polygon merged;
+      merged.n = a->n + b->n - 2;
+      if (merged.n > COLLISION_MAX_PIECE_VERTICES)
+        return false;
+
+      // All of a from w round to u, then b's vertices between u and w
+      int k = 0;
+      for (int s = 0; s < a->n; s++)
+        merged.v[k++] = a->v[(i + 1 + s) % a->n];
+      for (int s = 2; s < b->n; s++)
+        merged.v[k++] = b->v[(j + s) % b->n];
+
+      if (!is_convex(points, &merged))
+        return false;
+      *a = merged;
+      return true;
+    }
+  }
+  return false;
+}
+
+CollisionShape::CollisionShape()
+  : _num_pieces(0), _num_nodes(0), _radius(0.0)
+{
+}
+
+void
+CollisionShape::clear()
+{
+  _num_pieces = 0;
+  _num_nodes = 0;
+  _radius = 0.0;
+}
+
+/*
+ * Splits one closed outline into convex pieces: ear clipping into
+ * triangles, then merging neighbours for as long as they stay convex
+ * (Hertel-Mehlhorn).  Returns false if the pieces don't fit.
+ */
+bool
+CollisionShape::add_outline(const Point *input, int count)
+{
+  Point points[COLLISION_MAX_OUTLINE];
+  Polygon polys[COLLISION_MAX_OUTLINE];
+  int idx[COLLISION_MAX_OUTLINE];
+  int n = 0, num_polys = 0;
+  double area = 0.0;
+
+  if (count > COLLISION_MAX_OUTLINE)
+    return false;
+
+  // Drop repeated and collinear points
+  for (int i = 0; i < count; i++) {
+    const Point &p = input[i];
+    if (n > 0 && p[0] == points[n - 1][0] && p[1] == points[n - 1][1])
+      continue;
+    if (n > 1 && fabs(cross(points[n - 2], points[n - 1], p)) < COLLISION_EPSILON)
+      n--;
+    points[n++] = p;
+  }
+  while (n > 2 && ((points[n - 1][0] == points[0][0] && points[n - 1][1] == points[0][1]) ||
+                   fabs(cross(points[n - 2], points[n - 1], points[0])) < COLLISION_EPSILON))
+    n--;
+  if (n < 3)
+    return true;
+
+  for (int i = 0; i < n; i++)
+    area += cross(Point(0, 0), points[i], points[(i + 1) % n]);
+
+  // Wind every outline the same way
+  for (int i = 0; i < n; i++)
+    idx[i] = (area > 0) ? i : n - 1 - i;
+
+  // Ear clipping
+  for (int m = n; m > 2; ) {
+    int ear = -1;
+
+    for (int i = 0; i < m && ear < 0; i++) {
+      const Point &a = points[idx[(i + m - 1) % m]];
+      const Point &b = points[idx[i]];
+      const Point &c = points[idx[(i + 1) % m]];
+
+      if (cross(a, b, c) <= COLLISION_EPSILON)
+        continue;
+
+      ear = i;
+      for (int k = 0; k < m; k++) {
+        int v = idx[k];
+        if (v == idx[(i + m - 1) % m] || v == idx[i] || v == idx[(i + 1) % m])
+          continue;
+        if (in_triangle(points[v], a, b, c)) {
+          ear = -1;
+          break;
+        }
+      }
+    }
+
+    // Self-intersecting or degenerate; clip whatever is first
+    if (ear < 0)
+      ear = 0;
+
+    Polygon *t = &polys[num_polys++];
+    t->n = 3;
+    t->v[0] = idx[(ear + m - 1) % m];
+    t->v[1] = idx[ear];
+    t->v[2] = idx[(ear + 1) % m];
+
+    for (int k = ear; k < m - 1; k++)
+      idx[k] = idx[k + 1];
+    m--;
+  }
+
+  // Merge triangles back into larger convex pieces
+  for (bool merged = true; merged; ) {
+    merged = false;
+    for (int a = 0; a < num_polys; a++) {
+      for (int b = a + 1; b < num_polys; b++) {
+        if (merge_polygons(points, &polys[a], &polys[b])) {
+          polys[b] = polys[--num_polys];
+          merged = true;
+          b = a;
+        }
+      }
+    }
+  }
+
+  if (_num_pieces + num_polys > COLLISION_MAX_PIECES)
+    return false;
+
+  for (int i = 0; i < num_polys; i++) {
+    CollisionPiece *piece = &_pieces[_num_pieces];
+
+    // Skip slivers left over from degenerate outlines
+    if (!is_convex(points, &polys[i]))
+      continue;
+
+    piece->num_vertices = polys[i].n;
+    piece->x1 = piece->y1 = HUGE_VAL;
+    piece->x2 = piece->y2 = -HUGE_VAL;
+    for (int k = 0; k < polys[i].n; k++) {
+      const Point &p = points[polys[i].v[k]];
+      piece->vertices[k] = p;
+      piece->x1 = MIN(piece->x1, p[0]);
+      piece->y1 = MIN(piece->y1, p[1]);
+      piece->x2 = MAX(piece->x2, p[0]);
+      piece->y2 = MAX(piece->y2, p[1]);
+    }
+    _num_pieces++;
+  }
+  return true;
+}
+
+/*
+ * Builds the hierarchy over pieces [first, first + count), reordering
+ * them as it goes, and returns the index of its root node.
+ */
+int
+CollisionShape::build_node(int first, int count)
+{
+  CollisionNode *node = &_nodes[_num_nodes];
+  int index = _num_nodes++;
+
+  node->x1 = node->y1 = HUGE_VAL;
+  node->x2 = node->y2 = -HUGE_VAL;
+  for (int i = first; i < first + count; i++) {
+    node->x1 = MIN(node->x1, _pieces[i].x1);
+    node->y1 = MIN(node->y1, _pieces[i].y1);
+    node->x2 = MAX(node->x2, _pieces[i].x2);
+    node->y2 = MAX(node->y2, _pieces[i].y2);
+  }
+
+  node->left = node->right = -1;
+  node->first = first;
+  node->count = count;
+  if (count <= 2)
+    return index;
+
+  // Sort along the longer side and split in the middle
+  int axis = (node->x2 - node->x1 >= node->y2 - node->y1) ? 0 : 1;
+  for (int i = first + 1; i < first + count; i++) {
+    CollisionPiece key = _pieces[i];
+    double k = axis ? key.y1 + key.y2 : key.x1 + key.x2;
+    int j = i - 1;
+    while (j >= first && (axis ? _pieces[j].y1 + _pieces[j].y2
+                               : _pieces[j].x1 + _pieces[j].x2) > k) {
+      _pieces[j + 1] = _pieces[j];
+      j--;
+    }
+    _pieces[j + 1] = key;
+  }
+
+  int left = build_node(first, count / 2);
+  int right = build_node(first + count / 2, count - count / 2);
+  _nodes[index].left = left;
+  _nodes[index].right = right;
+  return index;
+}
+
+/**
+ * Rebuilds the shape from the closed runs of a flattened path, scaled
+ * by @scale.  Open runs are ignored.  Returns false if the outline was
+ * too complex, leaving whatever pieces did fit.
+ */
+bool
+CollisionShape::build(const Polyline &outline, double scale)
+{
+  Point points[COLLISION_MAX_OUTLINE];
+  bool ok = true;
+
+  clear();
+  for (int r = 0; r < outline.num_runs; r++) {
+    const PolylineRun *run = &outline.runs[r];
+
+    if (!run->closed)
+      continue;
+    if (run->count > COLLISION_MAX_OUTLINE) {
+      ok = false;
+      continue;
+    }
+
+    for (int i = 0; i < run->count; i++) {
+      const Point &p = outline.points[run->first + i];
+      points[i] = Point(p[0] * scale, p[1] * scale);
+    }
+    if (!add_outline(points, run->count))
+      ok = false;
+  }
+
+  for (int i = 0; i < _num_pieces; i++) {
+    for (int k = 0; k < _pieces[i].num_vertices; k++) {
+      const Point &p = _pieces[i].vertices[k];
+      _radius = MAX(_radius, sqrt(p[0] * p[0] + p[1] * p[1]));
+    }
+  }
+
+  if (_num_pieces > 0)
+    build_node(0, _num_pieces);
+  return ok && _num_pieces > 0;
+}
+
+/*
+ * Transforms a box by @m and returns the box around the result.
+ */
+static void
+transform_box (const cairo_matrix_t *m, double x1, double y1, double x2, double y2,
+               double *out)
+{
+  double cx = (x1 + x2) / 2, cy = (y1 + y2) / 2;
+  double hx = (x2 - x1) / 2, hy = (y2 - y1) / 2;
+  double ex = fabs(m->xx) * hx + fabs(m->xy) * hy;
+  double ey = fabs(m->yx) * hx + fabs(m->yy) * hy;
+
+  cairo_matrix_transform_point (m, &cx, &cy);
+  out[0] = cx - ex;
+  out[1] = cy - ey;
+  out[2] = cx + ex;
+  out[3] = cy + ey;
+}
+
+static bool
+boxes_overlap (double x1, double y1, double x2, double y2, const double *box)
+{
+  return !(x2 < box[0] || box[2] < x1 || y2 < box[1] || box[3] < y1);
+}
+
+/*
+ * Whether any edge normal of @a separates the two convex polygons.
+ */
+static bool
+separated (const Point *a, int na, const Point *b, int nb)
+{
+  for (int i = 0; i < na; i++) {
+    const Point &p = a[i];
+    const Point &q = a[(i + 1) % na];
+    double nx = q[1] - p[1];
+    double ny = p[0] - q[0];
+    double amin = HUGE_VAL, amax = -HUGE_VAL;
+    double bmin = HUGE_VAL, bmax = -HUGE_VAL;
+
+    for (int k = 0; k < na; k++) {
+      double d = a[k][0] * nx + a[k][1] * ny;
+      amin = MIN(amin, d);
+      amax = MAX(amax, d);
+    }
+    for (int k = 0; k < nb; k++) {
+      double d = b[k][0] * nx + b[k][1] * ny;
+      bmin = MIN(bmin, d);
+      bmax = MAX(bmax, d);
+    }
+    if (amax < bmin || bmax < amin)
+      return true;
+  }
+  return false;
+}
+
+static bool
+pieces_overlap (const CollisionPiece *a, const CollisionPiece *b, const cairo_matrix_t *rel)
+{
+  Point moved[COLLISION_MAX_PIECE_VERTICES];
+
+  for (int k = 0; k < b->num_vertices; k++) {
+    double x = b->vertices[k][0], y = b->vertices[k][1];
+    cairo_matrix_transform_point (rel, &x, &y);
+    moved[k] = Point(x, y);
+  }
+
+  CollisionShape::piece_tests++;
+  return (!separated(a->vertices, a->num_vertices, moved, b->num_vertices) &&
+          !separated(moved, b->num_vertices, a->vertices, a->num_vertices));
+}
+
+/**
+ * Tests whether this shape, placed by @mine, touches @other placed by
+ * @theirs.  Both matrices map object coordinates to the same space.
+ */
+bool
+CollisionShape::overlaps(const cairo_matrix_t *mine,
+                         const CollisionShape &other, const cairo_matrix_t *theirs) const
+{
+  int stack[COLLISION_STACK_SIZE][2];
+  int top = 0;
+  cairo_matrix_t inverse = *mine;
+  cairo_matrix_t rel;
+  double box[4];
+
+  if (empty() || other.empty())
+    return false;
+  if (cairo_matrix_invert (&inverse) != CAIRO_STATUS_SUCCESS)
+    return false;
+
+  // Everything is done in this shape's coordinates
+  cairo_matrix_multiply (&rel, theirs, &inverse);
+
+  stack[top][0] = 0;
+  stack[top][1] = 0;
+  top++;
+
+  while (top > 0) {
+    top--;
+    int ai = stack[top][0];
+    int bi = stack[top][1];
+    const CollisionNode *a = &_nodes[ai];
+    const CollisionNode *b = &other._nodes[bi];
+
+    transform_box (&rel, b->x1, b->y1, b->x2, b->y2, box);
+    if (!boxes_overlap(a->x1, a->y1, a->x2, a->y2, box))
+      continue;
+
+    bool a_leaf = (a->left < 0);
+    bool b_leaf = (b->left < 0);
+
+    if (a_leaf && b_leaf) {
+      for (int j = b->first; j < b->first + b->count; j++) {
+        const CollisionPiece *pb = &other._pieces[j];
+        transform_box (&rel, pb->x1, pb->y1, pb->x2, pb->y2, box);
+        for (int i = a->first; i < a->first + a->count; i++) {
+          const CollisionPiece *pa = &_pieces[i];
+          if (boxes_overlap(pa->x1, pa->y1, pa->x2, pa->y2, box) &&
+              pieces_overlap(pa, pb, &rel))
+            return true;
+        }
+      }
+      continue;
+    }
+
+    // Can't happen with these sizes, but err on the side of a hit
+    if (top + 2 > COLLISION_STACK_SIZE)
+      return true;
+
+    // Descend into the larger node
+    if (b_leaf || (!a_leaf && (a->x2 - a->x1) * (a->y2 - a->y1) >=
+                   (b->x2 - b->x1) * (b->y2 - b->y1))) {
+      stack[top][0] = a->left;
+      stack[top][1] = bi;
+      stack[top + 1][0] = a->right;
+      stack[top + 1][1] = bi;
+    } else {
+      stack[top][0] = ai;
+      stack[top][1] = b->left;
+      stack[top + 1][0] = ai;
+      stack[top + 1][1] = b->right;
+    }
+    top += 2;
+  }
+  return false;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,101 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COLLISION_H__
+#define __COLLISION_H__
+
+#include <cairo.h>
+
+#include "forward.h"
+#include "path-geometry.h"
+#include "point.h"
+
+#define COLLISION_MAX_PIECES          (32)
+#define COLLISION_MAX_PIECE_VERTICES  (16)
+
+// Most points of a single outline that can be decomposed
+#define COLLISION_MAX_OUTLINE         (256)
+
+// Tolerance, in sprite units, that outlines are flattened at
+#define COLLISION_FLATTEN_TOLERANCE   (0.5)
+
+typedef struct
+{
+  int    num_vertices;
+  Point  vertices[COLLISION_MAX_PIECE_VERTICES];  /// Convex, counterclockwise
+  double x1, y1, x2, y2;                          /// Bounding box
+} CollisionPiece;
+
+typedef struct
+{
+  double x1, y1, x2, y2;
+  int    left, right;      /// Child nodes, or -1 for a leaf
+  int    first, count;     /// Leaves only: range of pieces
+} CollisionNode;
+
+/*
+ * An object's collision outline, as convex pieces under a small
+ * bounding volume hierarchy, in the object's own coordinates.
+ *
+ * Shapes are built once from flattened paths.  Testing two shapes walks
+ * both hierarchies together and only runs the separating axis test on
+ * pieces whose boxes overlap.  Callers are expected to have rejected
+ * most pairs with the bounding circle of radius() already.
+ */
+class CollisionShape {
+public:
+  CollisionShape();
+
+  bool   build(const Polyline &outline, double scale);
+  void   clear();
+
+  bool   empty() const { return _num_pieces == 0; }
+  int    num_pieces() const { return _num_pieces; }
+  const CollisionPiece &piece(int i) const { return _pieces[i]; }
+  double radius() const { return _radius; }
+
+  bool   overlaps(const cairo_matrix_t *mine,
+                  const CollisionShape &other, const cairo_matrix_t *theirs) const;
+
+  // Pieces pairs tested by the separating axis test, for statistics
+  static long piece_tests;
+
+private:
+  CollisionPiece _pieces[COLLISION_MAX_PIECES];
+  int            _num_pieces;
+  CollisionNode  _nodes[2 * COLLISION_MAX_PIECES];
+  int            _num_nodes;
+  double         _radius;     /// Furthest any point is from the origin
+
+  bool add_outline(const Point *points, int count);
+  int  build_node(int first, int count);
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
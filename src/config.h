@@ -36,7 +36,11 @@
 #define MAX_NUMBER_OF_MISSILES (60)
 #define MAX_NUMBER_OF_RINGS (12)
 #define MAX_NUMBER_OF_MINES (6)
-#define NUMBER_OF_STARS (30)
+
+// stars per STARFIELD_CHUNK_SIZE square, for each parallax layer
+#define STARFIELD_FAR_STARS  (12)
+#define STARFIELD_MID_STARS  (6)
+#define STARFIELD_NEAR_STARS (3)
 
 // a shot every 9/25 seconds = 8 ticks between shots
 #define TICKS_BETWEEN_FIRE (8)
@@ -62,12 +66,21 @@
 #define DAMAGE_PER_SHIP_BOUNCE_DIVISOR (3)
 
 #define MISSILE_RADIUS (4 * FIXED_POINT_SCALE_FACTOR)
+
+// How far flares and explosions reach past the physics radius, for culling
+#define SHIP_EFFECT_MARGIN    (12)
+#define MISSILE_EFFECT_MARGIN (16)
 #define MISSILE_SPEED (8)
 #define MISSILE_TICKS_TO_LIVE (60)
 #define MISSILE_EXPLOSION_TICKS_TO_LIVE (6)
 
 #define SEGMENTS_PER_RING (8)
 
+// Where the sprite art is looked for unless --assets says otherwise
+#ifndef SPRITE_DIR
+#define SPRITE_DIR "data/sprites"
+#endif
+
 #endif
 
 /*
@@ -0,0 +1,204 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COUNTED_CAIRO_H__
+#define __COUNTED_CAIRO_H__
+
+/*
+ * Included by drawing code after <cairo.h>.  Built with
+ * COUNT_CAIRO_CALLS, the cairo calls render-counters.h keeps track of
+ * are replaced by wrappers that count them against the calling function,
+ * named by G_STRFUNC.  Otherwise they stay direct calls into cairo.
+ */
+
+#include <cairo.h>
+#include <glib.h>
+
+#include "render-counters.h"
+
+#ifdef COUNT_CAIRO_CALLS
+
+inline void
+counted_save(cairo_t *cr, const char *caller)
+{
+  render_count(caller, RENDER_SAVE);
+  cairo_save(cr);
+}
+
+inline void
+counted_restore(cairo_t *cr, const char *caller)
+{
+  render_count(caller, RENDER_RESTORE);
+  cairo_restore(cr);
+}
+
+inline void
+counted_translate(cairo_t *cr, double tx, double ty, const char *caller)
+{
+  render_count(caller, RENDER_TRANSFORM);
+  cairo_translate(cr, tx, ty);
+}
+
+inline void
+counted_scale(cairo_t *cr, double sx, double sy, const char *caller)
+{
+  render_count(caller, RENDER_TRANSFORM);
+  cairo_scale(cr, sx, sy);
+}
+
+inline void
+counted_rotate(cairo_t *cr, double angle, const char *caller)
+{
+  render_count(caller, RENDER_TRANSFORM);
+  cairo_rotate(cr, angle);
+}
+
+inline void
+counted_set_matrix(cairo_t *cr, const cairo_matrix_t *matrix, const char *caller)
+{
+  render_count(caller, RENDER_TRANSFORM);
+  cairo_set_matrix(cr, matrix);
+}
+
+inline void
+counted_set_source(cairo_t *cr, cairo_pattern_t *source, const char *caller)
+{
+  render_count(caller, RENDER_SOURCE);
+  cairo_set_source(cr, source);
+}
+
+inline void
+counted_set_source_rgb(cairo_t *cr, double r, double g, double b, const char *caller)
+{
+  render_count(caller, RENDER_SOURCE);
+  cairo_set_source_rgb(cr, r, g, b);
+}
+
+inline void
+counted_set_source_rgba(cairo_t *cr, double r, double g, double b, double a,
+                        const char *caller)
+{
+  render_count(caller, RENDER_SOURCE);
+  cairo_set_source_rgba(cr, r, g, b, a);
+}
+
+inline void
+counted_set_source_surface(cairo_t *cr, cairo_surface_t *surface, double x, double y,
+                           const char *caller)
+{
+  render_count(caller, RENDER_SOURCE);
+  cairo_set_source_surface(cr, surface, x, y);
+}
+
+inline cairo_pattern_t *
+counted_pattern_create_linear(double x0, double y0, double x1, double y1, const char *caller)
+{
+  render_count(caller, RENDER_PATTERN);
+  return cairo_pattern_create_linear(x0, y0, x1, y1);
+}
+
+inline cairo_pattern_t *
+counted_pattern_create_radial(double cx0, double cy0, double r0,
+                              double cx1, double cy1, double r1, const char *caller)
+{
+  render_count(caller, RENDER_PATTERN);
+  return cairo_pattern_create_radial(cx0, cy0, r0, cx1, cy1, r1);
+}
+
+inline void
+counted_fill(cairo_t *cr, const char *caller)
+{
+  render_count_area(cr, caller, RENDER_FILL);
+  cairo_fill(cr);
+}
+
+inline void
+counted_fill_preserve(cairo_t *cr, const char *caller)
+{
+  render_count_area(cr, caller, RENDER_FILL);
+  cairo_fill_preserve(cr);
+}
+
+inline void
+counted_stroke(cairo_t *cr, const char *caller)
+{
+  render_count_area(cr, caller, RENDER_STROKE);
+  cairo_stroke(cr);
+}
+
+inline void
+counted_stroke_preserve(cairo_t *cr, const char *caller)
+{
+  render_count_area(cr, caller, RENDER_STROKE);
+  cairo_stroke_preserve(cr);
+}
+
+inline void
+counted_paint(cairo_t *cr, const char *caller)
+{
+  render_count_area(cr, caller, RENDER_PAINT);
+  cairo_paint(cr);
+}
+
+inline void
+counted_show_text(cairo_t *cr, const char *utf8, const char *caller)
+{
+  render_count(caller, RENDER_TEXT);
+  cairo_show_text(cr, utf8);
+}
+
+// Function-like, so a cairo function can still have its address taken
+#define cairo_save(cr)              counted_save(cr, G_STRFUNC)
+#define cairo_restore(cr)           counted_restore(cr, G_STRFUNC)
+#define cairo_translate(cr, x, y)   counted_translate(cr, x, y, G_STRFUNC)
+#define cairo_scale(cr, x, y)       counted_scale(cr, x, y, G_STRFUNC)
+#define cairo_rotate(cr, a)         counted_rotate(cr, a, G_STRFUNC)
+#define cairo_set_matrix(cr, m)     counted_set_matrix(cr, m, G_STRFUNC)
+#define cairo_set_source(cr, p)     counted_set_source(cr, p, G_STRFUNC)
+#define cairo_set_source_rgb(cr, r, g, b) \
+  counted_set_source_rgb(cr, r, g, b, G_STRFUNC)
+#define cairo_set_source_rgba(cr, r, g, b, a) \
+  counted_set_source_rgba(cr, r, g, b, a, G_STRFUNC)
+#define cairo_set_source_surface(cr, s, x, y) \
+  counted_set_source_surface(cr, s, x, y, G_STRFUNC)
+#define cairo_pattern_create_linear(x0, y0, x1, y1) \
+  counted_pattern_create_linear(x0, y0, x1, y1, G_STRFUNC)
+#define cairo_pattern_create_radial(cx0, cy0, r0, cx1, cy1, r1) \
+  counted_pattern_create_radial(cx0, cy0, r0, cx1, cy1, r1, G_STRFUNC)
+#define cairo_fill(cr)              counted_fill(cr, G_STRFUNC)
+#define cairo_fill_preserve(cr)     counted_fill_preserve(cr, G_STRFUNC)
+#define cairo_stroke(cr)            counted_stroke(cr, G_STRFUNC)
+#define cairo_stroke_preserve(cr)   counted_stroke_preserve(cr, G_STRFUNC)
+#define cairo_paint(cr)             counted_paint(cr, G_STRFUNC)
+#define cairo_show_text(cr, s)      counted_show_text(cr, s, G_STRFUNC)
+
+#endif
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
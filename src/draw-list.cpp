@@ -0,0 +1,342 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "counted-cairo.h"
+#include "draw-list.h"
+#include "drawing.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  PATTERN_MISSILE_BODY,
+  PATTERN_MISSILE_HEAD,
+  PATTERN_EXPLOSION
+};
+
+int
+alpha_level (double alpha)
+{
+  int level = (int) (alpha * (ALPHA_LEVELS - 1) + 0.5);
+  return MAX(0, MIN(level, ALPHA_LEVELS - 1));
+}
+
+static double
+alpha_value (int level)
+{
+  return level / (double) (ALPHA_LEVELS - 1);
+}
+
+DrawList::DrawList()
+  : _num_commands(0), _num_paints(0), _device_scale(1.0)
+{
+  memset(_patterns, 0, sizeof(_patterns));
+  memset(&_stats, 0, sizeof(_stats));
+
+  // Until told otherwise, everything is visible
+  _clip[0] = _clip[1] = -DBL_MAX;
+  _clip[2] = _clip[3] = DBL_MAX;
+}
+
+DrawList::~DrawList()
+{
+  for (int i = 0; i < _num_paints; i++)
+    for (int a = 0; a < ALPHA_LEVELS; a++)
+      for (int k = 0; k < 3; k++)
+        if (_patterns[i][a][k])
+          cairo_pattern_destroy (_patterns[i][a][k]);
+}
+
+void
+DrawList::clear()
+{
+  _num_commands = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+/**
+ * Takes the current clip, in device space, as the area objects must
+ * touch to be drawn.  The current matrix should be the playfield
+ * transform, which is assumed not to rotate.
+ */
+void
+DrawList::set_viewport(cairo_t *cr)
+{
+  double x1, y1, x2, y2;
+  double dx = 1.0, dy = 0.0;
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  cairo_user_to_device (cr, &x1, &y1);
+  cairo_user_to_device (cr, &x2, &y2);
+  _clip[0] = MIN(x1, x2);
+  _clip[1] = MIN(y1, y2);
+  _clip[2] = MAX(x1, x2);
+  _clip[3] = MAX(y1, y2);
+
+  cairo_user_to_device_distance (cr, &dx, &dy);
+  _device_scale = sqrt(dx*dx + dy*dy);
+}
+
+/**
+ * Returns whether a circle of the given playfield radius around the
+ * origin of an object's transform touches the viewport.  Counts the
+ * object as culled if not.
+ */
+bool
+DrawList::visible(const cairo_matrix_t *transform, double radius)
+{
+  double r = radius * _device_scale;
+  double x = transform->x0;
+  double y = transform->y0;
+
+  if (x + r < _clip[0] || x - r > _clip[2] ||
+      y + r < _clip[1] || y - r > _clip[3]) {
+    _stats.culled++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Returns the paint id for a color theme, registering it if it's new.
+ * Returns -1 if the paint table is full.
+ */
+int
+DrawList::paint(RGB_t primary, RGB_t secondary)
+{
+  for (int i = 0; i < _num_paints; i++) {
+    if (memcmp(&_paints[i][0], &primary, sizeof(RGB_t)) == 0 &&
+        memcmp(&_paints[i][1], &secondary, sizeof(RGB_t)) == 0)
+      return i;
+  }
+
+  if (_num_paints >= MAX_PAINTS)
+    return -1;
+
+  _paints[_num_paints][0] = primary;
+  _paints[_num_paints][1] = secondary;
+  return _num_paints++;
+}
+
+/**
+ * Appends a command with the given transform.  The caller fills in
+ * the paint and geometry specific fields.  Returns NULL if the list is
+ * full, in which case the object simply isn't drawn this frame.
+ */
+DrawCommand *
+DrawList::add(DrawLayer layer, GeometryId geometry, const cairo_matrix_t *transform)
+{
+  if (_num_commands >= MAX_DRAW_COMMANDS)
+    return NULL;
+
+  DrawCommand *c = &_commands[_num_commands];
+  memset(c, 0, sizeof(*c));
+  c->transform = *transform;
+  c->layer = layer;
+  c->geometry = geometry;
+  c->paint = -1;
+  c->alpha = ALPHA_LEVELS - 1;
+  c->order = _num_commands++;
+  return c;
+}
+
+cairo_pattern_t *
+DrawList::pattern(int paint, int alpha, int kind)
+{
+  cairo_pattern_t **pat = &_patterns[paint][alpha][kind];
+  RGB_t primary = _paints[paint][0];
+  RGB_t secondary = _paints[paint][1];
+
+  if (*pat)
+    return *pat;
+
+  switch (kind) {
+    case PATTERN_MISSILE_BODY:
+      *pat = create_missile_body_pattern (primary, secondary, alpha_value(alpha));
+      break;
+    case PATTERN_MISSILE_HEAD:
+      *pat = create_missile_head_pattern (primary, secondary, alpha_value(alpha));
+      break;
+    case PATTERN_EXPLOSION:
+      *pat = create_explosion_pattern (primary, secondary, alpha_value(alpha));
+      break;
+  }
+  return *pat;
+}
+
+static int
+compare_commands (const void *a, const void *b)
+{
+  const DrawCommand *c1 = (const DrawCommand *) a;
+  const DrawCommand *c2 = (const DrawCommand *) b;
+
+  if (c1->layer != c2->layer)
+    return c1->layer - c2->layer;
+  if (c1->gradient != c2->gradient)
+    return c1->gradient - c2->gradient;
+  if (c1->paint != c2->paint)
+    return c1->paint - c2->paint;
+  if (c1->geometry != c2->geometry)
+    return c1->geometry - c2->geometry;
+  if (c1->alpha != c2->alpha)
+    return c1->alpha - c2->alpha;
+  if (c1->line_width != c2->line_width)
+    return (c1->line_width < c2->line_width) ? -1 : 1;
+  return c1->order - c2->order;
+}
+
+static bool
+same_batch (const DrawCommand *c1, const DrawCommand *c2)
+{
+  return (c1->layer == c2->layer &&
+          !c2->gradient &&
+          c1->geometry == c2->geometry &&
+          c1->paint == c2->paint &&
+          c1->alpha == c2->alpha &&
+          c1->line_width == c2->line_width);
+}
+
+void
+DrawList::path_command(cairo_t *cr, const DrawCommand *c)
+{
+  switch (c->geometry) {
+    case GEOMETRY_RING_SEGMENT:
+      path_ring_segment (cr, c->radius, c->segment);
+      break;
+    case GEOMETRY_MISSILE:
+      path_missile_body (cr, true);
+      break;
+    case GEOMETRY_EXPLOSION:
+      path_explosion (cr, true);
+      break;
+    case GEOMETRY_CUSTOM:
+      break;
+  }
+}
+
+/*
+ * Paths commands [first, last) under their own transforms, then fills
+ * or strokes them all at once back in playfield space.  Line widths are
+ * unaffected since the object transforms don't scale.
+ */
+void
+DrawList::draw_batch(cairo_t *cr, const cairo_matrix_t *base, int first, int last)
+{
+  const DrawCommand *c = &_commands[first];
+
+  cairo_new_path (cr);
+  for (int i = first; i < last; i++) {
+    cairo_set_matrix (cr, &_commands[i].transform);
+    path_command (cr, &_commands[i]);
+  }
+  cairo_set_matrix (cr, base);
+
+  RGB_t color = _paints[c->paint][(c->geometry == GEOMETRY_EXPLOSION) ? 1 : 0];
+  set_source_color (cr, color, alpha_value(c->alpha));
+
+  if (c->geometry == GEOMETRY_RING_SEGMENT) {
+    cairo_set_line_width (cr, c->line_width);
+    cairo_stroke (cr);
+    _stats.strokes++;
+  } else {
+    cairo_fill (cr);
+    _stats.fills++;
+  }
+  _stats.unbatched_calls += last - first;
+}
+
+void
+DrawList::draw_gradient(cairo_t *cr, const DrawCommand *c)
+{
+  cairo_set_matrix (cr, &c->transform);
+
+  switch (c->geometry) {
+    case GEOMETRY_MISSILE:
+      path_missile_body (cr, false);
+      cairo_set_source (cr, pattern(c->paint, c->alpha, PATTERN_MISSILE_BODY));
+      cairo_fill (cr);
+
+      path_missile_head (cr);
+      cairo_set_source (cr, pattern(c->paint, c->alpha, PATTERN_MISSILE_HEAD));
+      cairo_fill (cr);
+      _stats.fills += 2;
+      _stats.unbatched_calls += 2;
+      break;
+    case GEOMETRY_EXPLOSION:
+      path_explosion (cr, false);
+      cairo_set_source (cr, pattern(c->paint, c->alpha, PATTERN_EXPLOSION));
+      cairo_fill (cr);
+      _stats.fills++;
+      _stats.unbatched_calls++;
+      break;
+    default:
+      break;
+  }
+}
+
+void
+DrawList::execute(cairo_t *cr)
+{
+  cairo_matrix_t base;
+  int i, j;
+
+  _stats.commands = _num_commands;
+  _stats.unbatched_calls = 0;
+  _stats.fills = 0;
+  _stats.strokes = 0;
+
+  qsort(_commands, _num_commands, sizeof(DrawCommand), compare_commands);
+
+  cairo_save (cr);
+  cairo_get_matrix (cr, &base);
+
+  for (i = 0; i < _num_commands; i = j) {
+    const DrawCommand *c = &_commands[i];
+    j = i + 1;
+
+    if (c->geometry == GEOMETRY_CUSTOM) {
+      cairo_set_matrix (cr, &c->transform);
+      (*c->func) (cr, c->object);
+      cairo_set_matrix (cr, &base);
+    } else if (c->gradient) {
+      draw_gradient (cr, c);
+    } else {
+      while (j < _num_commands && same_batch(c, &_commands[j]))
+        j++;
+      draw_batch (cr, &base, i, j);
+    }
+  }
+
+  cairo_restore (cr);
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,131 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DRAW_LIST_H__
+#define __DRAW_LIST_H__
+
+#include <cairo.h>
+
+#include "forward.h"
+#include "canvas.h"
+
+#define MAX_DRAW_COMMANDS (1024)
+#define MAX_PAINTS        (32)
+
+// Alpha is quantized to tenths so that fading objects can share a batch
+#define ALPHA_LEVELS      (11)
+
+typedef void (* draw_command_func) (cairo_t * cr, GameObject * object);
+
+// Layers are drawn in order; commands are only reordered within a layer
+typedef enum {
+  DRAW_LAYER_SHIPS,
+  DRAW_LAYER_MISSILES,
+  DRAW_LAYER_RINGS,
+  DRAW_LAYER_COUNT
+} DrawLayer;
+
+typedef enum {
+  GEOMETRY_RING_SEGMENT,  /// Arc of a shield ring, stroked
+  GEOMETRY_MISSILE,       /// Missile body and head, filled
+  GEOMETRY_EXPLOSION,     /// Exploded missile, filled
+  GEOMETRY_CUSTOM         /// Drawn by a callback; never batched
+} GeometryId;
+
+typedef struct
+{
+  cairo_matrix_t     transform;   /// Object space to device space
+  DrawLayer          layer;
+  GeometryId         geometry;
+  int                paint;       /// Index into the paint table
+  int                alpha;       /// Quantized, 0 .. ALPHA_LEVELS-1
+  bool               gradient;    /// Per-object pattern, can't be batched
+  double             line_width;  /// Strokes only
+  double             radius;      /// GEOMETRY_RING_SEGMENT only
+  int                segment;     /// GEOMETRY_RING_SEGMENT only
+  draw_command_func  func;        /// GEOMETRY_CUSTOM only
+  GameObject        *object;      /// GEOMETRY_CUSTOM only
+  int                order;       /// Emission order, keeps the sort stable
+} DrawCommand;
+
+typedef struct
+{
+  int commands;          /// Commands executed
+  int unbatched_calls;   /// Fills and strokes if drawn one by one
+  int fills;             /// Fills actually issued
+  int strokes;           /// Strokes actually issued
+  int culled;            /// Objects skipped for being outside the clip
+} DrawStats;
+
+/*
+ * A frame's worth of drawing, collected in object order and then
+ * sorted by paint and geometry before being handed to cairo.  Runs of
+ * flat-colored commands with the same paint, geometry, alpha and line
+ * width are pathed together and cost a single fill or stroke.
+ *
+ * Paints and the gradient patterns made from them are kept across
+ * frames, so steady-state drawing doesn't create any cairo patterns.
+ *
+ * Callers should check visible() before adding an object so that
+ * anything outside the clip never reaches cairo at all.
+ */
+class DrawList {
+public:
+  DrawList();
+  ~DrawList();
+
+  void clear();
+  void set_viewport(cairo_t *cr);
+  bool visible(const cairo_matrix_t *transform, double radius);
+  int  paint(RGB_t primary, RGB_t secondary);
+  DrawCommand *add(DrawLayer layer, GeometryId geometry, const cairo_matrix_t *transform);
+  void execute(cairo_t *cr);
+
+  const DrawStats &stats() const { return _stats; }
+
+private:
+  DrawCommand      _commands[MAX_DRAW_COMMANDS];
+  int              _num_commands;
+  RGB_t            _paints[MAX_PAINTS][2];
+  int              _num_paints;
+  cairo_pattern_t *_patterns[MAX_PAINTS][ALPHA_LEVELS][3];
+  DrawStats        _stats;
+  double           _clip[4];       /// Device space x1, y1, x2, y2
+  double           _device_scale;  /// Device units per playfield unit
+
+  cairo_pattern_t *pattern(int paint, int alpha, int kind);
+  void path_command(cairo_t *cr, const DrawCommand *c);
+  void draw_batch(cairo_t *cr, const cairo_matrix_t *base, int first, int last);
+  void draw_gradient(cairo_t *cr, const DrawCommand *c);
+};
+
+int alpha_level(double alpha);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -27,15 +27,99 @@
 
 #include "drawing.h"
 
+#include "counted-cairo.h"
 #include "game-math.h"
 #include "game-object.h"
+#include "quality.h"
 #include "score.h"
 
 #include <cairo.h>
 #include <stdio.h>
+#include <string.h>
 
 #define ENERGY_BAR_LENGTH (200)
 
+// Gradients kept at once; the game only ever uses a few colours
+#define MAX_GRADIENTS     (16)
+
+typedef enum {
+  GRADIENT_ENERGY_BAR,
+  GRADIENT_SHIP,
+  GRADIENT_FLARE,
+  GRADIENT_TURNING_FLARE
+} GradientKind;
+
+typedef struct
+{
+  GradientKind     kind;
+  RGB_t            primary;
+  RGB_t            secondary;
+  cairo_pattern_t *pattern;
+} Gradient;
+
+static Gradient gradients[MAX_GRADIENTS];
+static int      num_gradients = 0;
+
+static cairo_pattern_t *
+create_gradient (GradientKind kind, RGB_t primary, RGB_t secondary)
+{
+  RGB_t color_white = {1,1,1};
+  cairo_pattern_t *pat = NULL;
+
+  switch (kind) {
+    case GRADIENT_ENERGY_BAR:
+      pat = cairo_pattern_create_linear (0, 0, ENERGY_BAR_LENGTH, 0);
+      add_color_stop (pat, 0, secondary, 0.6);
+      add_color_stop (pat, 1, primary, 0.6);
+      break;
+    case GRADIENT_SHIP:
+      pat = cairo_pattern_create_linear (-30.0, -30.0, 30.0, 30.0);
+      add_color_stop (pat, 0, primary, 1);
+      add_color_stop (pat, 1, secondary, 1);
+      break;
+    case GRADIENT_FLARE:
+      pat = cairo_pattern_create_radial (0, 0, 2, 0, 5, 12);
+      add_color_stop (pat, 0.0, primary, 1);
+      add_color_stop (pat, 0.3, color_white, 1);
+      add_color_stop (pat, 1.0, primary, 0);
+      break;
+    case GRADIENT_TURNING_FLARE:
+      pat = cairo_pattern_create_radial (0, 0, 1, 0, 0, 7);
+      add_color_stop (pat, 0.0, color_white, 1);
+      add_color_stop (pat, 1.0, primary, 0);
+      break;
+  }
+  return pat;
+}
+
+/*
+ * Returns the gradient for these colours, creating it the first time,
+ * so that steady-state drawing doesn't create cairo patterns.  The
+ * pattern stays owned by the cache.
+ */
+static cairo_pattern_t *
+gradient (GradientKind kind, RGB_t primary, RGB_t secondary)
+{
+  Gradient *g;
+
+  for (int i = 0; i < MIN(num_gradients, MAX_GRADIENTS); i++) {
+    g = &gradients[i];
+    if (g->kind == kind && memcmp (&g->primary, &primary, sizeof (RGB_t)) == 0
+        && memcmp (&g->secondary, &secondary, sizeof (RGB_t)) == 0)
+      return g->pattern;
+  }
+
+  // Once full, the oldest goes; cairo keeps its own reference while in use
+  g = &gradients[num_gradients++ % MAX_GRADIENTS];
+  if (g->pattern)
+    cairo_pattern_destroy (g->pattern);
+  g->kind = kind;
+  g->primary = primary;
+  g->secondary = secondary;
+  g->pattern = create_gradient (kind, primary, secondary);
+  return g->pattern;
+}
+
 void
 draw_text_centered (cairo_t * cr, int font_size, int cx, int cy, int dy, const char *message, double alpha)
 {
@@ -64,19 +148,12 @@ void
 draw_energy_bar (cairo_t * cr, int x, int y, int energy_percent,
                  RGB_t primary_color, RGB_t secondary_color)
 {
-  cairo_pattern_t *pat;
-  double alpha = 0.6;
   int width = int( ENERGY_BAR_LENGTH * (energy_percent / 100.0) );
 
   cairo_rectangle (cr, x, y, width, 15);
 
-  pat = cairo_pattern_create_linear (0, 0, ENERGY_BAR_LENGTH, 0);
-  add_color_stop (pat, 0, secondary_color, alpha);
-  add_color_stop (pat, 1, primary_color, alpha);
-
-  cairo_set_source (cr, pat);
+  cairo_set_source (cr, gradient (GRADIENT_ENERGY_BAR, primary_color, secondary_color));
   cairo_fill_preserve (cr);
-  cairo_pattern_destroy (pat);
 
   cairo_set_source_rgb (cr, 0, 0, 0);
   cairo_stroke (cr);
@@ -98,8 +175,6 @@ draw_score_centered (cairo_t * cr, double cx, double cy, const Score *score)
 void
 draw_ship_body (cairo_t * cr, GameObject * p)
 {
-  cairo_pattern_t *pat;
-
   if (p->is_hit)
   {
     cairo_set_source_rgba (cr, p->primary_color.r, p->primary_color.g,
@@ -123,28 +198,51 @@ draw_ship_body (cairo_t * cr, GameObject * p)
       draw_turning_flare (cr, p->primary_color, 1);
   }
 
-  cairo_move_to (cr, 0, -33);
-  cairo_curve_to (cr, 2, -33, 3, -34, 4, -35);
-  cairo_curve_to (cr, 8, -10, 6, 15, 15, 15);
-  cairo_line_to (cr, 20, 15);
-  cairo_line_to (cr, 20, 7);
-  cairo_curve_to (cr, 25, 10, 28, 22, 25, 28);
-  cairo_curve_to (cr, 20, 26, 8, 24, 0, 24);
-  // half way point
-  cairo_curve_to (cr, -8, 24, -20, 26, -25, 28);
-  cairo_curve_to (cr, -28, 22, -25, 10, -20, 7);
-  cairo_line_to (cr, -20, 15);
-  cairo_line_to (cr, -15, 15);
-  cairo_curve_to (cr, -6, 15, -8, -10, -4, -35);
-  cairo_curve_to (cr, -3, -34, -2, -33, 0, -33);
-
-  pat = cairo_pattern_create_linear (-30.0, -30.0, 30.0, 30.0);
-  add_color_stop (pat, 0, p->primary_color, 1);
-  add_color_stop (pat, 1, p->secondary_color, 1);
-
-  cairo_set_source (cr, pat);
+  if (render_simple_outlines)
+  {
+    // Just the curve end points; indistinguishable when this small
+    cairo_move_to (cr, 0, -33);
+    cairo_line_to (cr, 4, -35);
+    cairo_line_to (cr, 15, 15);
+    cairo_line_to (cr, 20, 15);
+    cairo_line_to (cr, 20, 7);
+    cairo_line_to (cr, 25, 28);
+    cairo_line_to (cr, 0, 24);
+    cairo_line_to (cr, -25, 28);
+    cairo_line_to (cr, -20, 7);
+    cairo_line_to (cr, -20, 15);
+    cairo_line_to (cr, -15, 15);
+    cairo_line_to (cr, -4, -35);
+    cairo_close_path (cr);
+  }
+  else
+  {
+    cairo_move_to (cr, 0, -33);
+    cairo_curve_to (cr, 2, -33, 3, -34, 4, -35);
+    cairo_curve_to (cr, 8, -10, 6, 15, 15, 15);
+    cairo_line_to (cr, 20, 15);
+    cairo_line_to (cr, 20, 7);
+    cairo_curve_to (cr, 25, 10, 28, 22, 25, 28);
+    cairo_curve_to (cr, 20, 26, 8, 24, 0, 24);
+    // half way point
+    cairo_curve_to (cr, -8, 24, -20, 26, -25, 28);
+    cairo_curve_to (cr, -28, 22, -25, 10, -20, 7);
+    cairo_line_to (cr, -20, 15);
+    cairo_line_to (cr, -15, 15);
+    cairo_curve_to (cr, -6, 15, -8, -10, -4, -35);
+    cairo_curve_to (cr, -3, -34, -2, -33, 0, -33);
+  }
+
+  if (render_quality == QUALITY_LOW)
+  {
+    set_source_color (cr, p->primary_color, 1);
+    cairo_fill (cr);
+    cairo_restore (cr);
+    return;
+  }
+
+  cairo_set_source (cr, gradient (GRADIENT_SHIP, p->primary_color, p->secondary_color));
   cairo_fill_preserve (cr);
-  cairo_pattern_destroy (pat);
 
   cairo_set_source_rgb (cr, 0, 0, 0);
   cairo_stroke (cr);
@@ -154,8 +252,6 @@ draw_ship_body (cairo_t * cr, GameObject * p)
 void
 draw_cannon (cairo_t * cr, GameObject * p)
 {
-  cairo_pattern_t *pat;
-
   if (p->is_hit)
   {
     cairo_set_source_rgba (cr, p->primary_color.r, p->primary_color.g,
@@ -188,13 +284,16 @@ draw_cannon (cairo_t * cr, GameObject * p)
   cairo_line_to (cr, -6, -45);
   cairo_line_to (cr, -6, -28);
 
-  pat = cairo_pattern_create_linear (-30.0, -30.0, 30.0, 30.0);
-  add_color_stop (pat, 0, p->primary_color, 1);
-  add_color_stop (pat, 1, p->secondary_color, 1);
+  if (render_quality == QUALITY_LOW)
+  {
+    set_source_color (cr, p->primary_color, 1);
+    cairo_fill (cr);
+    cairo_restore (cr);
+    return;
+  }
 
-  cairo_set_source (cr, pat);
+  cairo_set_source (cr, gradient (GRADIENT_SHIP, p->primary_color, p->secondary_color));
   cairo_fill_preserve (cr);
-  cairo_pattern_destroy (pat);
 
   cairo_set_source_rgb (cr, 0, 0, 0);
   cairo_stroke (cr);
@@ -207,22 +306,25 @@ draw_cannon (cairo_t * cr, GameObject * p)
 void
 draw_flare (cairo_t * cr, RGB_t color)
 {
-  cairo_pattern_t *pat;
-
   RGB_t color_white = {1,1,1};
 
   cairo_save (cr);
 
   cairo_translate (cr, 0, 22);
-  pat = cairo_pattern_create_radial (0, 0, 2, 0, 5, 12);
-  add_color_stop (pat, 0.0, color, 1);
-  add_color_stop (pat, 0.3, color_white, 1);
-  add_color_stop (pat, 1.0, color, 0);
-  cairo_set_source (cr, pat);
+
+  if (render_quality == QUALITY_LOW)
+  {
+    set_source_color (cr, color_white, 0.7);
+    cairo_arc (cr, 0, 0, 8, 0, TWO_PI);
+    cairo_fill (cr);
+    cairo_restore (cr);
+    return;
+  }
+
+  cairo_set_source (cr, gradient (GRADIENT_FLARE, color, color));
   cairo_arc (cr, 0, 0, 20, 0, TWO_PI);
 
   cairo_fill (cr);
-  cairo_pattern_destroy (pat);
   cairo_restore (cr);
 }
 
@@ -231,143 +333,154 @@ draw_flare (cairo_t * cr, RGB_t color)
 void
 draw_turning_flare (cairo_t * cr, RGB_t color, int right_hand_side)
 {
-  cairo_pattern_t *pat;
-
   RGB_t color_white = {1,1,1};
 
   cairo_save (cr);
 
   cairo_translate (cr, -23 * right_hand_side, 28);
-  pat = cairo_pattern_create_radial (0, 0, 1, 0, 0, 7);
-  add_color_stop (pat, 0.0, color_white, 1);
-  add_color_stop (pat, 1.0, color, 0);
-  cairo_set_source (cr, pat);
+
+  if (render_quality == QUALITY_LOW)
+  {
+    set_source_color (cr, color_white, 0.7);
+    cairo_arc (cr, 0, 0, 4, 0, TWO_PI);
+    cairo_fill (cr);
+    cairo_restore (cr);
+    return;
+  }
+
+  cairo_set_source (cr, gradient (GRADIENT_TURNING_FLARE, color, color));
   cairo_arc (cr, 0, 0, 7, 0, TWO_PI);
   cairo_fill (cr);
-  cairo_pattern_destroy (pat);
+
+  // The second, forward layer is only drawn at full quality
+  if (render_quality < QUALITY_HIGH)
+  {
+    cairo_restore (cr);
+    return;
+  }
 
   cairo_translate (cr, 42 * right_hand_side, -22);
-  pat = cairo_pattern_create_radial (0, 0, 1, 0, 0, 7);
-  add_color_stop (pat, 0.0, color_white, 1);
-  add_color_stop (pat, 1.0, color, 0);
-  cairo_set_source (cr, pat);
+  cairo_set_source (cr, gradient (GRADIENT_TURNING_FLARE, color, color));
   cairo_arc (cr, 0, 0, 5, 0, TWO_PI);
 
   cairo_fill (cr);
-  cairo_pattern_destroy (pat);
   cairo_restore (cr);
 }
 
 //------------------------------------------------------------------------------
 
-void
-draw_ring (cairo_t * cr, GameObject * r) {
-  for (int i=0; i<SEGMENTS_PER_RING; i++) {
-    if (r->component_energy[i] <= 0)
-      continue;
-
-    cairo_save (cr);
-    cairo_set_line_width (cr, r->component_energy[i]*4);
-    cairo_arc (cr, 0, 0, r->p.radius/FIXED_POINT_SCALE_FACTOR,
-               i * TWO_PI/SEGMENTS_PER_RING,
-               (i+1) * TWO_PI/SEGMENTS_PER_RING - TWO_PI/180.0);
-    cairo_stroke (cr);
+// Geometry and paints for the draw list.  The path_* routines only
+// append to the current path, in object space, so that several objects
+// sharing a paint can be filled or stroked with a single call.
 
-    cairo_restore (cr);
-  }
+void
+path_ring_segment (cairo_t * cr, double radius, int segment)
+{
+  // Start a fresh subpath, otherwise arcs get joined up by lines
+  cairo_new_sub_path (cr);
+  cairo_arc (cr, 0, 0, radius,
+             segment * TWO_PI/SEGMENTS_PER_RING,
+             (segment+1) * TWO_PI/SEGMENTS_PER_RING - TWO_PI/180.0);
 }
 
 //------------------------------------------------------------------------------
 
-void
-draw_missile (cairo_t * cr, GameObject * m)
+double
+missile_alpha (GameObject * m)
 {
-  cairo_save (cr);
-  cairo_scale (cr, GLOBAL_SHIP_SCALE_FACTOR, GLOBAL_SHIP_SCALE_FACTOR);
+  double alpha;
 
   if (m->has_exploded)
-  {
-    draw_exploded_missile (cr, m);
-  }
+    alpha = ((double) m->energy) / MISSILE_EXPLOSION_TICKS_TO_LIVE;
   else
-  {
-    cairo_pattern_t *pat;
+    alpha = ((double) m->energy) / MISSILE_TICKS_TO_LIVE;
 
-    double alpha = ((double) m->energy) / MISSILE_TICKS_TO_LIVE;
-    // non-linear scaling so things don't fade out too fast
-    alpha = 1.0 - (1.0 - alpha) * (1.0 - alpha);
+  // non-linear scaling so things don't fade out too fast
+  return 1.0 - (1.0 - alpha) * (1.0 - alpha);
+}
 
-    cairo_save (cr);
+void
+path_missile_body (cairo_t * cr, bool simple)
+{
+  if (simple)
+  {
+    // Body and head in one polygon, for a single flat fill
     cairo_move_to (cr, 0, -4);
-    cairo_curve_to (cr, 3, -4, 4, -2, 4, 0);
-    cairo_curve_to (cr, 4, 4, 2, 10, 0, 18);
-    // half way point
-    cairo_curve_to (cr, -2, 10, -4, 4, -4, 0);
-    cairo_curve_to (cr, -4, -2, -3, -4, 0, -4);
-
-    pat = cairo_pattern_create_linear (0.0, -5.0, 0.0, 5.0);
-    add_color_stop (pat, 0, m->primary_color, alpha);
-    add_color_stop (pat, 1, m->secondary_color, alpha);
-
-    cairo_set_source (cr, pat);
-    cairo_fill (cr);
-    cairo_pattern_destroy (pat);
-    cairo_restore (cr);
+    cairo_line_to (cr, 4, 0);
+    cairo_line_to (cr, 0, 18);
+    cairo_line_to (cr, -4, 0);
+    cairo_close_path (cr);
+    return;
+  }
 
-    cairo_save (cr);
-    cairo_arc (cr, 0, 0, 3, 0, TWO_PI);
+  cairo_move_to (cr, 0, -4);
+  cairo_curve_to (cr, 3, -4, 4, -2, 4, 0);
+  cairo_curve_to (cr, 4, 4, 2, 10, 0, 18);
+  // half way point
+  cairo_curve_to (cr, -2, 10, -4, 4, -4, 0);
+  cairo_curve_to (cr, -4, -2, -3, -4, 0, -4);
+  cairo_close_path (cr);
+}
 
-    pat = cairo_pattern_create_linear (0, 3, 0, -3);
-    add_color_stop (pat, 0, m->primary_color, alpha);
-    add_color_stop (pat, 1, m->secondary_color, alpha);
+void
+path_missile_head (cairo_t * cr)
+{
+  cairo_new_sub_path (cr);
+  cairo_arc (cr, 0, 0, 3, 0, TWO_PI);
+}
 
-    cairo_set_source (cr, pat);
-    cairo_fill (cr);
-    cairo_pattern_destroy (pat);
-    cairo_restore (cr);
-  }
+cairo_pattern_t *
+create_missile_body_pattern (RGB_t primary, RGB_t secondary, double alpha)
+{
+  cairo_pattern_t *pat = cairo_pattern_create_linear (0.0, -5.0, 0.0, 5.0);
+  add_color_stop (pat, 0, primary, alpha);
+  add_color_stop (pat, 1, secondary, alpha);
+  return pat;
+}
 
-  cairo_restore (cr);
+cairo_pattern_t *
+create_missile_head_pattern (RGB_t primary, RGB_t secondary, double alpha)
+{
+  cairo_pattern_t *pat = cairo_pattern_create_linear (0, 3, 0, -3);
+  add_color_stop (pat, 0, primary, alpha);
+  add_color_stop (pat, 1, secondary, alpha);
+  return pat;
 }
 
 //------------------------------------------------------------------------------
 
 void
-draw_exploded_missile (cairo_t * cr, GameObject * m)
+path_explosion (cairo_t * cr, bool simple)
 {
-  double alpha;
-  cairo_pattern_t *pat;
-
-  RGB_t color_black = {0,0,0};
-
-  cairo_save (cr);
-  cairo_scale (cr, GLOBAL_SHIP_SCALE_FACTOR, GLOBAL_SHIP_SCALE_FACTOR);
+  cairo_new_sub_path (cr);
 
-  alpha = ((double) m->energy) / MISSILE_EXPLOSION_TICKS_TO_LIVE;
-  alpha = 1.0 - (1.0 - alpha) * (1.0 - alpha);
+  // Roughly where the gradient is still bright
+  if (simple)
+    cairo_arc (cr, 0, 0, 18, 0, TWO_PI);
+  else
+    cairo_arc (cr, 0, 0, 30, 0, TWO_PI);
+}
 
-  cairo_arc (cr, 0, 0, 30, 0, TWO_PI);
+cairo_pattern_t *
+create_explosion_pattern (RGB_t primary, RGB_t secondary, double alpha)
+{
+  RGB_t color_black = {0,0,0};
 
-  pat = cairo_pattern_create_radial (0, 0, 0, 0, 0, 30);
-  add_color_stop (pat, 0,   m->primary_color, alpha);
-  add_color_stop (pat, 0.5, m->secondary_color, alpha * 0.75);
+  cairo_pattern_t *pat = cairo_pattern_create_radial (0, 0, 0, 0, 0, 30);
+  add_color_stop (pat, 0,   primary, alpha);
+  add_color_stop (pat, 0.5, secondary, alpha * 0.75);
   add_color_stop (pat, 1,   color_black, 0);
-
-  cairo_set_source (cr, pat);
-  cairo_fill (cr);
-  cairo_pattern_destroy (pat);
-  cairo_restore (cr);
+  return pat;
 }
 
 //------------------------------------------------------------------------------
 
 void
-draw_star (cairo_t * cr, CanvasItem *)
+path_star (cairo_t * cr)
 {
   int a = NUMBER_OF_ROTATION_ANGLES / 10;
   float r1 = 5.0;
   float r2 = 2.0;
-  float c;
   int i;
 
   cairo_save (cr);
@@ -384,10 +497,6 @@ draw_star (cairo_t * cr, CanvasItem *)
 
   cairo_close_path (cr);
   cairo_restore (cr);
-
-  c = 0.5;
-  cairo_set_source_rgb (cr, c, c, c);
-  cairo_fill (cr);
 }
 
 //------------------------------------------------------------------------------
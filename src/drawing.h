@@ -26,15 +26,22 @@ void draw_energy_bar (cairo_t *, int x, int y, int energy_percent,
                       RGB_t primary_color, RGB_t secondary_color);
 void draw_score_centered (cairo_t * cr, double x, double y, const Score *score);
 void draw_flare (cairo_t *, RGB_t);
-void draw_ring (cairo_t *, GameObject *ring);
-void draw_missile (cairo_t *, GameObject *missile);
-void draw_exploded_missile (cairo_t *, GameObject *missile);
 void draw_ship_body (cairo_t *, GameObject *player);
 void draw_cannon (cairo_t *, GameObject *player);
-void draw_star (cairo_t * cr, CanvasItem * item);
+void path_star (cairo_t * cr);
 void draw_turning_flare (cairo_t *, RGB_t, int);
 void draw_text_centered (cairo_t *, int font_size, int cx, int cy, int dy, const char *message, double alpha);
 
+// Geometry and paints used by the draw list
+void path_ring_segment (cairo_t *, double radius, int segment);
+double missile_alpha (GameObject *missile);
+void path_missile_body (cairo_t *, bool simple);
+void path_missile_head (cairo_t *);
+void path_explosion (cairo_t *, bool simple);
+cairo_pattern_t *create_missile_body_pattern (RGB_t primary, RGB_t secondary, double alpha);
+cairo_pattern_t *create_missile_head_pattern (RGB_t primary, RGB_t secondary, double alpha);
+cairo_pattern_t *create_explosion_pattern (RGB_t primary, RGB_t secondary, double alpha);
+
 #endif
 
 /*
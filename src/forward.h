@@ -8,6 +8,7 @@ class Score;
 struct _RGB;
 struct _cairo;
 struct _cairo_pattern;
+struct _cairo_surface;
 struct _GtkWidget;
 struct _GdkEventKey;
 struct _GdkEventExpose;
@@ -15,6 +16,7 @@ struct _GdkEventExpose;
 typedef struct _RGB            RGB_t;
 typedef struct _cairo          cairo_t;
 typedef struct _cairo_pattern  cairo_pattern_t;
+typedef struct _cairo_surface  cairo_surface_t;
 typedef struct _GtkWidget      GtkWidget;
 typedef struct _GdkEventKey    GdkEventKey;
 typedef struct _GdkEventExpose GdkEventExpose;
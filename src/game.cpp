@@ -22,6 +22,8 @@
 #include "game.h"
 #include "game-object.h"
 #include "drawing.h"
+#include "draw-list.h"
+#include "trace.h"
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
@@ -32,7 +34,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/timeb.h>
 
 // TODO:  Need to find best place for this...
 void init_trigonometric_tables (void);
@@ -47,16 +48,39 @@ static RGB_t color_darkblue  = {0.1, 0.1, 0.3};
 // Forward declarations
 gint on_timeout (gpointer);
 
-Game::Game(gint argc, gchar ** argv)
+Game::Game(gint argc, gchar ** argv, gboolean headless)
   : num_objects(0),
+    headless(headless),
+    show_fps(FALSE),
+    show_hud(FALSE),
+    show_profile(FALSE),
+    render_width(WIDTH),
+    render_height(HEIGHT),
+    quality(MILLIS_PER_FRAME),
+    hud(MILLIS_PER_FRAME),
+    input_time(0),
+    sprite_dir(SPRITE_DIR),
+    trace_filename(NULL),
     number_of_rings(3),
     next_missile_index(0)
 {
-  gtk_init (&argc, &argv);
+  alloc_period_init(&allocations[0], "per tick");
+  alloc_period_init(&allocations[1], "per frame");
+
+  if (!headless)
+    gtk_init (&argc, &argv);
   process_options(argc, argv);
   init_trigonometric_tables ();
 
+  gchar *cache_file = asset_cache_filename();
+  if (!assets.load(sprite_dir, cache_file))
+    warnx("Could not load sprites from %s", sprite_dir);
+  g_free (cache_file);
+  init_collision_shapes ();
+  init_high_scores ();
+
   canvas = new Canvas(WIDTH, HEIGHT);
+  canvas->set_render_size(render_width, render_height);
 
   cannon = new GameObject;
   cannon->set_theme(color_red, color_darkred);
@@ -69,9 +93,8 @@ Game::Game(gint argc, gchar ** argv)
 
 Game::~Game()
 {
-  GameObject *o;
-  for (; (o = objects[--num_objects]); )
-    delete o;
+  while (num_objects > 0)
+    delete objects[--num_objects];
   delete cannon;
   delete player;
 
@@ -81,19 +104,32 @@ Game::~Game()
 void Game::init() {
   srand ((unsigned int) time (NULL));
 
-  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
-  g_signal_connect (G_OBJECT (window), "delete-event",
-                    G_CALLBACK (gtk_main_quit), NULL);
+  window = NULL;
+  if (!headless) {
+    window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    g_signal_connect (G_OBJECT (window), "delete-event",
+                      G_CALLBACK (gtk_main_quit), NULL);
 
-  gtk_window_set_default_size (GTK_WINDOW (window), WIDTH, HEIGHT);
+    gtk_window_set_default_size (GTK_WINDOW (window), WIDTH, HEIGHT);
 
-  g_signal_connect (G_OBJECT (window), "expose_event",
-                    G_CALLBACK (on_expose_event), NULL);
-  g_signal_connect (G_OBJECT (window), "key_press_event",
-                    G_CALLBACK (on_key_press), NULL);
-  g_signal_connect (G_OBJECT (window), "key_release_event",
-                    G_CALLBACK (on_key_release), NULL);
-  g_timeout_add (MILLIS_PER_FRAME, (GSourceFunc) on_timeout, window);
+    // Frames presented from our own image mustn't go through GTK's backing store
+    if (presenter.mode() != PRESENT_GDK) {
+      gtk_widget_set_double_buffered (window, FALSE);
+      gtk_widget_set_app_paintable (window, TRUE);
+    }
+
+    g_signal_connect (G_OBJECT (window), "expose_event",
+                      G_CALLBACK (on_expose_event), NULL);
+    g_signal_connect (G_OBJECT (window), "key_press_event",
+                      G_CALLBACK (on_key_press), NULL);
+    g_signal_connect (G_OBJECT (window), "key_release_event",
+                      G_CALLBACK (on_key_release), NULL);
+    g_signal_connect (G_OBJECT (window), "focus_out_event",
+                      G_CALLBACK (on_focus_out), NULL);
+    // Just below key events, so keys already waiting make the tick that's due
+    g_timeout_add_full (G_PRIORITY_DEFAULT + 1, MILLIS_PER_FRAME,
+                        (GSourceFunc) on_timeout, window, NULL);
+  }
 
   level = 0;
   num_player_lives = 3;
@@ -103,6 +139,15 @@ void Game::init() {
   cannon->p.radius = CANNON_RADIUS;
   cannon->max_rotation_speed = 1;
 
+  // The cannon and its shield rings move as one
+  scene.add_child(&castle);
+  castle.add_child(cannon);
+  for (int i = 0; i < MAX_NUMBER_OF_RINGS; i++)
+    castle.add_child(&rings[i]);
+  for (int i = 0; i < MAX_NUMBER_OF_MISSILES; i++)
+    scene.add_child(&missiles[i]);
+  scene.add_child(player);
+
   reset();
 }
 
@@ -110,14 +155,56 @@ int Game::run() {
   gtk_widget_show_all (window);
   gtk_main ();
 
+  // Let the last score finish saving
+  score_writer.stop();
+
+  if (show_profile)
+    dump_profile();
+  write_trace();
   return 0;
 }
 
+/* Prints the frame times, and where allocations came from if they're counted */
+void Game::dump_profile() {
+  profiler.dump(stderr);
+  if (alloc_tracker_enabled())
+    alloc_tracker_dump(stderr, allocations, 2);
+  if (render_counters_enabled())
+    render_counters_dump(stderr);
+}
+
+/* Writes the trace recorded so far, if there is one */
+void Game::write_trace() {
+  if (trace_filename && !trace_write(trace_filename))
+    warn("Could not write trace to %s", trace_filename);
+}
+
 void Game::process_options(int argc, gchar ** argv) {
   int rc;
   poptContext pc;
+  char *quality_name = NULL;
+  char *present_name = NULL;
+  char *resolution_name = NULL;
+  char *assets_name = NULL;
+  char *trace_name = NULL;
   struct poptOption po[] = {
     /* TODO: Add game options here */
+    {"quality", 'q', POPT_ARG_STRING, &quality_name, 0,
+     "Render quality: low, medium, high or auto", "TIER"},
+    {"present", 'p', POPT_ARG_STRING, &present_name, 0,
+     "Frame presentation: gdk, shm or image", "MODE"},
+    {"resolution", 'r', POPT_ARG_STRING, &resolution_name, 0,
+     "Internal render resolution, or 'native' for the window's own", "WIDTHxHEIGHT"},
+    {"assets", 'a', POPT_ARG_STRING, &assets_name, 0,
+     "Directory of sprite SVG files", "DIR"},
+    {"show-fps", 0, POPT_ARG_NONE, &show_fps, 0,
+     "Print the frame rate and draw statistics every 100 frames", NULL},
+    {"hud", 0, POPT_ARG_NONE, &show_hud, 0,
+     "Show the performance overlay; F3 toggles it", NULL},
+    {"profile", 0, POPT_ARG_NONE, &show_profile, 0,
+     "Print tick and frame time percentiles on exit", NULL},
+    {"trace", 0, POPT_ARG_STRING, &trace_name, 0,
+     "Record a Chrome trace, written to FILE on exit and by F12", "FILE"},
     POPT_AUTOHELP
     {NULL}
   };
@@ -142,11 +229,67 @@ void Game::process_options(int argc, gchar ** argv) {
     }
   }
   //const char **remainder = poptGetArgs(pc);
+
+  if (quality_name) {
+    RenderQuality q;
+    if (!quality_from_string(quality_name, &q))
+      errx(1, "Quality must be low, medium, high or auto\n");
+    quality.set_mode(q);
+  }
+  if (present_name) {
+    PresentMode mode;
+    if (!present_mode_from_string(present_name, &mode))
+      errx(1, "Present mode must be gdk, shm or image\n");
+    presenter.set_mode(mode);
+  }
+  if (resolution_name) {
+    int w, h;
+    if (strcmp(resolution_name, "native") == 0)
+      render_width = render_height = 0;
+    else if (sscanf(resolution_name, "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+      render_width = w;
+      render_height = h;
+    } else
+      errx(1, "Resolution must be WIDTHxHEIGHT or 'native'\n");
+  }
+  if (assets_name)
+    sprite_dir = assets_name;
+  if (trace_name) {
+    trace_filename = trace_name;
+    trace_start();
+    trace_set_thread_name("main");
+  }
+}
+
+/*
+ * Steers the ship by the keys held at the start of a tick.  Turning
+ * builds up by the same step every tick a key is held, however fast the
+ * keyboard repeats.
+ */
+void Game::apply_input(const KeyboardSample &input) {
+  bool left = key_held(input, KEY_TURN_LEFT);
+  bool right = key_held(input, KEY_TURN_RIGHT);
+
+  if (left && player->p.rotation_accel > -100)
+    player->p.rotation_accel -= 10;
+  if (right && player->p.rotation_accel < 100)
+    player->p.rotation_accel += 10;
+  if (!left && !right)
+    player->p.rotation_accel = 0;
+
+  player->is_thrusting = key_held(input, KEY_THRUST);
+  player->is_firing = key_held(input, KEY_FIRE);
+
+  if (input.input_time && !input_time)
+    input_time = input.input_time;
 }
 
 void Game::tick() {
+  TRACE_ZONE("Game::tick");
   int i, j;
 
+  apply_input(keyboard.sample());
+
   cannon->is_hit = FALSE;
   player->is_hit = FALSE;
   for (j=0; j< MAX_NUMBER_OF_RINGS; j++) {
@@ -157,6 +300,10 @@ void Game::tick() {
   apply_physics_to_player (cannon);
   apply_physics_to_player (player);
 
+  world.follow (player->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
+                player->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
+
+  TRACE_BEGIN("ship collisions");
   if (check_for_collision (&(rings[0].p), &(player->p)))
   {
     int p1vx, p1vy, p2vx, p2vy;
@@ -180,7 +327,9 @@ void Game::tick() {
     player->p.vel[0] = (p1vx * +5 / 8) + (p2vx * -2 / 8);
     player->p.vel[1] = (p1vy * +5 / 8) + (p2vy * -2 / 8);
   }
+  TRACE_END("ship collisions");
 
+  TRACE_BEGIN("missile collisions");
   for (i = 0; i < MAX_NUMBER_OF_MISSILES; i++)
   {
     if (missiles[i].is_alive())
@@ -205,19 +354,22 @@ void Game::tick() {
                                            segment);
           }
         }
-        if (check_for_collision (&(missiles[i].p), &(cannon->p))) {
+        if (check_for_shape_collision (&(missiles[i]), &missile_shape,
+                                       cannon, &cannon_shape)) {
           score += 10;
           printf("score: %d\n", score.amount());
           handle_collision (cannon, &(missiles[i]));
         }
 
-        if (check_for_collision (&(missiles[i].p), &(player->p)))
+        if (check_for_shape_collision (&(missiles[i]), &missile_shape,
+                                       player, &ship_shape))
           handle_collision (player, &(missiles[i]));
       }
 
       missiles[i].energy--;
     }
   }
+  TRACE_END("missile collisions");
 
   for (i = 0; i < number_of_rings; i++)
   {
@@ -345,7 +497,6 @@ void Game::reset() {
   }
 
   init_rings_array ();
-  init_stars_array ();
   init_missiles_array ();
 }
 
@@ -374,14 +525,39 @@ Game::check_conditions() {
 
 void
 Game::redraw(cairo_t *cr) {
+  TRACE_ZONE("Game::redraw");
+  gint64 t = profile_now_ns();
+
   world.draw(cr);
+  t = profiler.lap(PROFILE_WORLD_DRAW, t);
+
+  // Collect the game elements, then draw them sorted by paint
+  t = queue_frame(cr, t);
+  draw_list.execute(cr);
+  t = profiler.lap(PROFILE_DRAW_LIST, t);
 
-  // Draw game elements
-  _draw_ship(cr);
-  _draw_missiles(cr);
-  _draw_rings(cr);
-  _draw_mines(cr);
   draw_ui(cr);
+  profiler.lap(PROFILE_DRAW_UI, t);
+}
+
+/*
+ * Brings the scene up to date and fills the draw list, without drawing
+ * anything yet.  Takes and returns the profiler's lap time.
+ */
+gint64
+Game::queue_frame(cairo_t *cr, gint64 t) {
+  update_scene(cr);
+  draw_list.clear();
+  draw_list.set_viewport(cr);
+  t = profiler.lap(PROFILE_UPDATE_SCENE, t);
+  _draw_ship();
+  t = profiler.lap(PROFILE_DRAW_SHIP, t);
+  _draw_missiles();
+  t = profiler.lap(PROFILE_DRAW_MISSILES, t);
+  _draw_rings();
+  t = profiler.lap(PROFILE_DRAW_RINGS, t);
+  _draw_mines();
+  return profiler.lap(PROFILE_DRAW_MINES, t);
 }
 
 void Game::draw_ui(cairo_t *cr) {
@@ -412,66 +588,167 @@ void Game::draw_ui(cairo_t *cr) {
       message_timeout--;
   }
 
+  if (show_hud)
+    hud.draw (cr, WIDTH - HUD_WIDTH - 10, 40);
 }
 
-void Game::_draw_ship(cairo_t *cr) {
-  cairo_save (cr);
-  cairo_translate (cr, cannon->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
-                   cannon->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
-  cairo_rotate (cr, cannon->p.rotation * RADIANS_PER_ROTATION_ANGLE);
-  this->_draw_cannon (cr, cannon);
-  cairo_restore (cr);
-
-  cairo_save (cr);
-  cairo_translate (cr, player->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
-                   player->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
-  cairo_rotate (cr, player->p.rotation * RADIANS_PER_ROTATION_ANGLE);
-  draw_ship_body (cr, player);
-  cairo_restore (cr);
+/* Feeds the overlay this frame's counters; done whether or not it's shown */
+void Game::update_hud(gint64 now, gint64 frame_nanos) {
+  const Starfield &stars = world.stars();
+  int live = 0;
+
+  for (int i = 0; i < MAX_NUMBER_OF_MISSILES; i++)
+    if (missiles[i].is_alive())
+      live++;
+
+  hud.sample_cache(HUD_CACHE_STARFIELD, stars.cache_hits(), stars.cache_misses());
+  hud.sample_cache(HUD_CACHE_MATRIX, SceneNode::matrix_reuses, SceneNode::matrix_updates);
+  hud.frame_finished(now, frame_nanos, draw_list.stats(), live);
+  hud.render_finished(render_counters_frame());
 }
 
-void Game::_draw_cannon(cairo_t *cr, GameObject *player) {
-  draw_cannon (cr, player);
+/*
+ * Called once a frame is on screen.  Records how long the earliest input
+ * it shows took to get there, and returns that, or zero if it shows none.
+ */
+gint64 Game::input_displayed(gint64 now) {
+  gint64 latency;
+
+  if (!input_time)
+    return 0;
+  latency = now - input_time;
+  input_time = 0;
+  profiler.record(PROFILE_INPUT_LATENCY, latency);
+  hud.input_displayed(latency);
+  return latency;
 }
 
-void Game::_draw_rings(cairo_t *cr) {
+/*
+ * Brings the scene graph up to date with the physics state.  Nodes only
+ * get re-transformed when something actually moved.
+ */
+void Game::update_scene(cairo_t *cr) {
+  cairo_matrix_t base;
+
+  cairo_get_matrix (cr, &base);
+  scene.set_matrix (&base);
+
+  castle.set_position (cannon->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
+                       cannon->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
+  cannon->set_rotation (cannon->p.rotation * RADIANS_PER_ROTATION_ANGLE);
+
   for (int i = 0; i < number_of_rings; i++) {
-    if (rings[i].is_alive())
-    {
-      cairo_save (cr);
-      cairo_translate (cr,
-                       rings[i].p.pos[0] / FIXED_POINT_SCALE_FACTOR,
-                       rings[i].p.pos[1] / FIXED_POINT_SCALE_FACTOR);
-      cairo_rotate (cr,
-                    -1 * rings[i].p.rotation * RADIANS_PER_ROTATION_ANGLE
-                    - PI/2.0);
-
-      cairo_set_source_rgba (cr, 2-i, i? 1.0/i : 0, 0, 0.6);
-
-      draw_ring (cr, &(rings[i]));
-      cairo_restore (cr);
+    rings[i].set_position ((rings[i].p.pos[0] - cannon->p.pos[0]) / FIXED_POINT_SCALE_FACTOR,
+                           (rings[i].p.pos[1] - cannon->p.pos[1]) / FIXED_POINT_SCALE_FACTOR);
+    rings[i].set_rotation (-1 * rings[i].p.rotation * RADIANS_PER_ROTATION_ANGLE - PI/2.0);
+  }
+
+  player->set_position (player->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
+                        player->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
+  player->set_rotation (player->p.rotation * RADIANS_PER_ROTATION_ANGLE);
+
+  for (int i = 0; i < MAX_NUMBER_OF_MISSILES; i++) {
+    GameObject *missile = &(missiles[i]);
+    if (!missile->is_alive())
+      continue;
+
+    missile->set_position (missile->p.pos[0] / FIXED_POINT_SCALE_FACTOR,
+                           missile->p.pos[1] / FIXED_POINT_SCALE_FACTOR);
+    missile->set_rotation (missile->p.rotation * RADIANS_PER_ROTATION_ANGLE);
+
+    // Explosions have always been drawn at double the ship scale
+    if (missile->has_exploded)
+      missile->set_scale (GLOBAL_SHIP_SCALE_FACTOR * GLOBAL_SHIP_SCALE_FACTOR);
+    else
+      missile->set_scale (GLOBAL_SHIP_SCALE_FACTOR);
+  }
+}
+
+void Game::_draw_ship() {
+  GameObject *ships[] = { cannon, player };
+  draw_command_func funcs[] = { draw_cannon, draw_ship_body };
+  DrawCommand *c;
+
+  for (int i = 0; i < 2; i++) {
+    const cairo_matrix_t *m = &ships[i]->world_matrix();
+    double radius = ships[i]->p.radius / FIXED_POINT_SCALE_FACTOR + SHIP_EFFECT_MARGIN;
+
+    if (!draw_list.visible(m, radius))
+      continue;
+    if ((c = draw_list.add(DRAW_LAYER_SHIPS, GEOMETRY_CUSTOM, m))) {
+      c->func = funcs[i];
+      c->object = ships[i];
+    }
+  }
+}
+
+void Game::_draw_rings() {
+  DrawCommand *c;
+
+  for (int i = 0; i < number_of_rings; i++) {
+    if (!rings[i].is_alive())
+      continue;
+
+    // Half the widest stroke a segment can have
+    double radius = rings[i].p.radius / FIXED_POINT_SCALE_FACTOR + energy_per_segment * 2;
+    if (!draw_list.visible(&rings[i].world_matrix(), radius))
+      continue;
+
+    RGB_t color = { 2.0-i, i? 1.0/i : 0, 0 };
+    int paint = draw_list.paint(color, color);
+    if (paint < 0)
+      continue;
+
+    for (int j = 0; j < SEGMENTS_PER_RING; j++) {
+      if (rings[i].component_energy[j] <= 0)
+        continue;
+      if (!(c = draw_list.add(DRAW_LAYER_RINGS, GEOMETRY_RING_SEGMENT, &rings[i].world_matrix())))
+        return;
+      c->paint = paint;
+      c->alpha = alpha_level(0.6);
+      c->line_width = rings[i].component_energy[j] * 4;
+      c->radius = rings[i].p.radius / FIXED_POINT_SCALE_FACTOR;
+      c->segment = j;
     }
-    // else ring is dead; skip it
   }
 }
 
-void Game::_draw_missiles(cairo_t *cr) {
+void Game::_draw_missiles() {
+  DrawCommand *c;
+  bool gradient = (render_quality != QUALITY_LOW);
+
   for (int i = 0; i < MAX_NUMBER_OF_MISSILES; i++)
   {
-    if (missiles[i].is_alive())
-    {
-      cairo_save (cr);
-      cairo_translate (cr, missiles[i].p.pos[0] / FIXED_POINT_SCALE_FACTOR,
-                       missiles[i].p.pos[1] / FIXED_POINT_SCALE_FACTOR);
-      cairo_rotate (cr,
-                    missiles[i].p.rotation * RADIANS_PER_ROTATION_ANGLE);
-      draw_missile (cr, &(missiles[i]));
-      cairo_restore (cr);
+    GameObject *missile = &(missiles[i]);
+    if (!missile->is_alive())
+      continue;
+
+    double radius = missile->p.radius / FIXED_POINT_SCALE_FACTOR + MISSILE_EFFECT_MARGIN;
+    if (!draw_list.visible(&missile->world_matrix(), radius))
+      continue;
+
+    double alpha = missile_alpha (missile);
+    GeometryId geometry = GEOMETRY_MISSILE;
+
+    if (missile->has_exploded) {
+      geometry = GEOMETRY_EXPLOSION;
+      if (!gradient)
+        alpha *= 0.6;
     }
+
+    int paint = draw_list.paint(missile->primary_color, missile->secondary_color);
+    if (paint < 0 || alpha_level(alpha) == 0)
+      continue;
+
+    if (!(c = draw_list.add(DRAW_LAYER_MISSILES, geometry, &missile->world_matrix())))
+      return;
+    c->paint = paint;
+    c->alpha = alpha_level(alpha);
+    c->gradient = gradient;
   }
 }
 
-void Game::_draw_mines(cairo_t *cr) {
+void Game::_draw_mines() {
   // TODO
 }
 
@@ -494,10 +771,28 @@ Game::handle_key_event (GtkWidget * widget, GdkEventKey * event, gboolean key_is
       {
         level = 0;
         score = Score();
+        awaiting_high_score = FALSE;
         reset();
       }
       break;
 
+    case GDK_F3:
+      if (key_is_on)
+        show_hud = !show_hud;
+      break;
+
+    case GDK_F12:
+      if (key_is_on) {
+        dump_profile();
+        profiler.reset();
+        alloc_period_init(&allocations[0], "per tick");
+        alloc_period_init(&allocations[1], "per frame");
+        alloc_tracker_reset_zones();
+        render_counters_reset();
+        write_trace();
+      }
+      break;
+
     case GDK_bracketleft:
       if (key_is_on)
       {
@@ -513,23 +808,18 @@ Game::handle_key_event (GtkWidget * widget, GdkEventKey * event, gboolean key_is
       }
       break;
 
+    // The ship's controls wait in the keyboard table for the next tick
     case GDK_Left:
     case GDK_KP_Left:
-      if (!key_is_on)
-        player->p.rotation_accel = 0;
-      else if (player->p.rotation_accel > -100)
-        player->p.rotation_accel -= 10;
+      keyboard.key(KEY_TURN_LEFT, key_is_on, event->time, profile_now_ns());
       break;
     case GDK_Right:
     case GDK_KP_Right:
-      if (!key_is_on)
-        player->p.rotation_accel = 0;
-      else if (player->p.rotation_accel < 100)
-        player->p.rotation_accel += 10;
+      keyboard.key(KEY_TURN_RIGHT, key_is_on, event->time, profile_now_ns());
       break;
     case GDK_Up:
     case GDK_KP_Up:
-      player->is_thrusting = key_is_on;
+      keyboard.key(KEY_THRUST, key_is_on, event->time, profile_now_ns());
       break;
     case GDK_Down:
     case GDK_KP_Down:
@@ -539,7 +829,7 @@ Game::handle_key_event (GtkWidget * widget, GdkEventKey * event, gboolean key_is
     case GDK_Control_R:
     case GDK_Control_L:
     case GDK_KP_Insert:
-      player->is_firing = key_is_on;
+      keyboard.key(KEY_FIRE, key_is_on, event->time, profile_now_ns());
       break;
   }
   return TRUE;
@@ -556,17 +846,63 @@ Game::init_missiles_array ()
   }
 }
 
+/*
+ * Builds the collision outlines from the body path of each sprite,
+ * at the scale the objects are drawn.
+ */
+void
+Game::init_collision_shapes ()
+{
+  const char *names[] = { "ship", "cannon", "missile" };
+  CollisionShape *shapes[] = { &ship_shape, &cannon_shape, &missile_shape };
+  Polyline outline;
+
+  for (int i = 0; i < 3; i++) {
+    const Sprite *sprite = assets.find(names[i]);
+    const SpritePath *body = sprite ? assets.path(sprite, 0) : NULL;
+
+    // Without the art, collisions fall back to the bounding circles
+    if (!body)
+      continue;
+
+    path_flatten (assets.segments(body), body->num_segments,
+                  COLLISION_FLATTEN_TOLERANCE, &outline);
+    if (!shapes[i]->build(outline, GLOBAL_SHIP_SCALE_FACTOR))
+      warnx("Collision outline of %s is too complex", names[i]);
+  }
+}
+
+/*
+ * Starts the high score writer.  Scores from the old text file are
+ * brought over the first time a score is saved.
+ */
+void
+Game::init_high_scores ()
+{
+  gchar *filename, *legacy;
+
+  awaiting_high_score = FALSE;
+  if (headless)
+    return;
+
+  filename = score_store_filename();
+  legacy = g_build_filename (g_get_user_config_dir (), "games", "spacecastle",
+                             "scores.txt", NULL);
+  if (!score_writer.start(filename, legacy))
+    warnx("Could not start saving high scores");
+
+  g_free (legacy);
+  g_free (filename);
+}
+
 void
 Game::init_rings_array ()
 {
   int rot = 1;
   for (int i=0; i < number_of_rings; i++)
   {
-    rings[i].pos[0] = WIDTH / 2;
-    rings[i].pos[1] = HEIGHT / 2;
     rings[i].p.pos[0] = WIDTH / 2 * FIXED_POINT_SCALE_FACTOR;
     rings[i].p.pos[1] = HEIGHT / 2 * FIXED_POINT_SCALE_FACTOR;
-    rings[i].scale = i;
     rings[i].energy = SEGMENTS_PER_RING;
     rings[i].max_rotation_speed = rot;
     rings[i].p.rotation_speed = rot;
@@ -587,21 +923,6 @@ Game::init_rings_array ()
   rings[2].p.radius = SHIELD_INNER_RADIUS;
 }
 
-void
-Game::init_stars_array ()
-{
-  int i;
-
-  for (i = 0; i < NUMBER_OF_STARS; i++)
-  {
-    stars[i].pos[0] = random () % WIDTH;
-    stars[i].pos[1] = random () % HEIGHT;
-    stars[i].rotation = drand48 () * TWO_PI;
-    stars[i].scale = 0.5 + (drand48 ());
-    stars[i].draw_func = draw_star;
-  }
-}
-
 static const char*
 suffix(int d) {
   // TODO: Return st, nd, rd, or th
@@ -618,36 +939,49 @@ suffix(int d) {
 //------------------------------------------------------------------------------
 // TODO: Move strings into headers as constants
 //       Maybe turn the messages + data into objects
+static void
+on_score_saved (const Score *score, int place, int rank, int games, gpointer data)
+{
+  ((Game *) data)->high_score_saved(place, rank, games);
+}
+
+/*
+ * The game over screen goes up straight away; the score is saved in
+ * the background and high_score_saved() updates the message after.
+ */
 void
 Game::game_over()
 {
   printf("Game Over.  Score was %d.\n", score.amount());
+  score.record(score.amount(), level, g_get_user_name ());
 
-  // TODO: Look up / make configurable
-  // TODO: Use XDG directories
-  const char high_score_filename[] = "/home/bryce/.config/games/spacecastle/scores.txt";
+  snprintf(main_message, sizeof(main_message), "Game Over");
+  snprintf(second_message, sizeof(main_message), "Press [ENTER] for new game");
+  // TODO: What does the message timeout imply?
+  message_timeout = -1;
 
-  // Load high scores if present
-  HighScores high_scores;
-  high_scores.load(high_score_filename);
-  Score min_score = high_scores.get(HighScores::MAX_SCORES);
+  awaiting_high_score = TRUE;
+  TRACE_BEGIN("save score");
+  score_writer.save(score, on_score_saved, this);
+  TRACE_END("save score");
+}
 
-  printf("Need score of %d to make high score list\n", min_score.amount());
+void
+Game::high_score_saved(int place, int rank, int games)
+{
+  // A new game may have started while the score was being saved
+  if (!awaiting_high_score)
+    return;
+  awaiting_high_score = FALSE;
 
-  // Check for new high score
-  if (score.amount() > min_score.amount()) {
-    int dist = high_scores.insert(score);
-    high_scores.save(high_score_filename);
+  if (place >= 0) {
     snprintf(main_message, sizeof(main_message), "New High Score!  %d%s Place!",
-      dist, suffix(dist));
+      place + 1, suffix(place + 1));
     // TODO: Offer to display list of high scores
     snprintf(second_message, sizeof(main_message), "Press [ENTER] for new game");
-    // TODO: What does the message timeout imply?
-    message_timeout = -1;
-  } else {
-    snprintf(main_message, sizeof(main_message), "Game Over");
-    snprintf(second_message, sizeof(main_message), "Press [ENTER] for new game");
-    message_timeout = -1;
+  } else if (rank >= 0) {
+    snprintf(main_message, sizeof(main_message), "Game Over.  %d%s of %d games",
+      rank + 1, suffix(rank + 1), games);
   }
 }
 
@@ -687,6 +1021,7 @@ ring_segment_by_rotation (GameObject *ring, int rot)
 void
 Game::operate_cannon ()
 {
+  TRACE_ZONE("Game::operate_cannon");
   int direction;
 
   GameObject *ring = &(rings[number_of_rings-1]);
@@ -852,6 +1187,10 @@ Game::apply_physics_to_player (GameObject * player)
   apply_physics (p);
 }
 
+// Collision tests ever made: pairs whose bounding circles were compared,
+// and outline comparisons for the pairs that were close
+static long pair_collision_tests = 0;
+static long precise_collision_tests = 0;
 
 gboolean
 Game::check_for_collision (physics_t * p1, physics_t * p2)
@@ -860,9 +1199,47 @@ Game::check_for_collision (physics_t * p1, physics_t * p2)
   int dy = (p1->pos[1] - p2->pos[1]) / FIXED_POINT_HALF_SCALE_FACTOR;
   int r = (p1->radius + p2->radius) / FIXED_POINT_HALF_SCALE_FACTOR;
   int d2 = (dx * dx) + (dy * dy);
+  pair_collision_tests++;
   return (d2 < (r * r)) ? TRUE : FALSE;
 }
 
+static void
+physics_matrix (const physics_t *p, cairo_matrix_t *m)
+{
+  cairo_matrix_init_translate (m, p->pos[0] / (double) FIXED_POINT_SCALE_FACTOR,
+                               p->pos[1] / (double) FIXED_POINT_SCALE_FACTOR);
+  cairo_matrix_rotate (m, p->rotation * RADIANS_PER_ROTATION_ANGLE);
+}
+
+/*
+ * Tests two objects against each other's outlines.  The bounding
+ * circles are checked first, so the outlines are only compared for the
+ * few pairs that are actually close.
+ */
+gboolean
+Game::check_for_shape_collision (GameObject *a, const CollisionShape *sa,
+                                 GameObject *b, const CollisionShape *sb)
+{
+  physics_t pa = a->p;
+  physics_t pb = b->p;
+  cairo_matrix_t ma, mb;
+
+  // Outlines can reach past the physics radius, like the cannon's barrel
+  if (!sa->empty())
+    pa.radius = MAX(pa.radius, (int) ceil(sa->radius() * FIXED_POINT_SCALE_FACTOR));
+  if (!sb->empty())
+    pb.radius = MAX(pb.radius, (int) ceil(sb->radius() * FIXED_POINT_SCALE_FACTOR));
+
+  if (!check_for_collision (&pa, &pb))
+    return FALSE;
+  if (sa->empty() || sb->empty())
+    return TRUE;
+
+  precise_collision_tests++;
+  physics_matrix (&a->p, &ma);
+  physics_matrix (&b->p, &mb);
+  return sa->overlaps(&ma, *sb, &mb) ? TRUE : FALSE;
+}
 
 gboolean
 Game::check_for_ring_collision (physics_t * ring, physics_t * p1)
@@ -873,6 +1250,7 @@ Game::check_for_ring_collision (physics_t * ring, physics_t * p1)
   int rr = (ring->radius * 0.8) / FIXED_POINT_HALF_SCALE_FACTOR;
   int d2 = (dx * dx) + (dy * dy);
 
+  pair_collision_tests++;
   return (d2 < (r * r) && (d2 > (rr * rr)))? TRUE : FALSE;
 }
 
@@ -953,52 +1331,109 @@ Game::handle_ring_segment_collision (GameObject * ring, GameObject * m, int segm
 //------------------------------------------------------------------------------
 static int number_of_frames = 0;
 static long millis_taken_for_frames = 0;
+static long draw_calls_unbatched = 0;
+static long draw_calls_batched = 0;
+static long objects_culled = 0;
+
+// The shared counters as they were at the last print; the HUD reads them too
+static long printed_pair_tests = 0;
+static long printed_precise_tests = 0;
+static long printed_piece_tests = 0;
+static long printed_matrix_updates = 0;
+static long printed_matrix_reuses = 0;
 
 static long
 get_time_millis (void)
 {
-  struct timeb tp;
-  ftime (&tp);
-  return (long) ((tp.time * 1000) + tp.millitm);
+  return (long) (profile_now_ns () / 1000000);
 }
 
 static void
 print_frame_stats (long start_time)
 {
+  const DrawStats &stats = game->draw_list.stats();
+
   number_of_frames++;
   millis_taken_for_frames += get_time_millis () - start_time;
+  draw_calls_unbatched += stats.unbatched_calls;
+  draw_calls_batched += stats.fills + stats.strokes;
+  objects_culled += stats.culled;
   if (number_of_frames >= 100)
   {
     double fps =
       1000.0 * ((double) number_of_frames) /
       ((double) millis_taken_for_frames);
-    dbg ("%d frames in %ldms (%.3ffps)\n", number_of_frames,
-         millis_taken_for_frames, fps);
+    dbg ("%d frames in %ldms (%.3ffps), quality %s at %.0f%% resolution\n",
+         number_of_frames, millis_taken_for_frames, fps,
+         quality_to_string(game->quality.tier()), game->quality.resolution() * 100);
+    dbg ("  fill/stroke calls per frame: %.1f batched, %.1f unbatched\n",
+         draw_calls_batched / (double) number_of_frames,
+         draw_calls_unbatched / (double) number_of_frames);
+    dbg ("  objects culled per frame: %.1f\n",
+         objects_culled / (double) number_of_frames);
+    dbg ("  scene matrices: %ld recomputed, %ld reused\n",
+         SceneNode::matrix_updates - printed_matrix_updates,
+         SceneNode::matrix_reuses - printed_matrix_reuses);
+    dbg ("  collision tests: %ld pairs, %ld precise, %ld convex pieces\n",
+         pair_collision_tests - printed_pair_tests,
+         precise_collision_tests - printed_precise_tests,
+         CollisionShape::piece_tests - printed_piece_tests);
+    printed_pair_tests = pair_collision_tests;
+    printed_precise_tests = precise_collision_tests;
+    printed_piece_tests = CollisionShape::piece_tests;
+    printed_matrix_updates = SceneNode::matrix_updates;
+    printed_matrix_reuses = SceneNode::matrix_reuses;
     number_of_frames = 0;
     millis_taken_for_frames = 0L;
+    draw_calls_unbatched = 0L;
+    draw_calls_batched = 0L;
+    objects_culled = 0L;
   }
 }
 
 gint
 on_expose_event (GtkWidget * widget, GdkEventExpose * event)
 {
-  cairo_t *cr = gdk_cairo_create (widget->window);
+  cairo_t *window_cr = game->presenter.begin(widget);
   int width = widget->allocation.width;
   int height = widget->allocation.height;
-  long start_time = 0;
-
-  if (game->show_fps)
-    start_time = get_time_millis ();
-
-  game->canvas->scale_for_aspect_ratio(cr, width, height);
+  TRACE_ZONE("on_expose_event");
+  long start_time = get_time_millis ();
+  gint64 frame_start = profile_now_ns ();
+  alloc_period_begin(&game->allocations[1]);
+
+  cairo_t *cr = game->canvas->begin_frame(window_cr, width, height,
+                                          game->quality.resolution());
+  game->quality.apply(cr, game->canvas->debug_scale_factor);
+  gint64 t = profile_now_ns ();
   game->check_conditions();
+  game->profiler.lap(PROFILE_CHECK_CONDITIONS, t);
   game->redraw(cr);
-  cairo_restore (cr);
+  game->canvas->end_frame(cr, window_cr);
+  game->presenter.present(window_cr);
+
+  game->quality.frame_finished(get_time_millis () - start_time);
+  gint64 frame_end = game->profiler.lap(PROFILE_FRAME, frame_start);
+  AllocCount allocated = alloc_period_end(&game->allocations[1]);
+  render_counters_end_frame();
+
+  game->update_hud(frame_end, frame_end - frame_start);
+  gint64 latency = game->input_displayed(frame_end);
+
+  const DrawStats &stats = game->draw_list.stats();
+  TRACE_COUNTER("draw calls", stats.fills + stats.strokes + stats.unbatched_calls);
+  TRACE_COUNTER("objects culled", stats.culled);
+  if (alloc_tracker_enabled())
+    TRACE_COUNTER("allocations", allocated.count);
+  if (render_counters_enabled())
+    TRACE_COUNTER("cairo calls", render_counters_total(render_counters_frame()));
+  if (latency)
+    TRACE_COUNTER("input latency (ms)", latency / 1e6);
 
   if (game->show_fps)
     print_frame_stats(start_time);
 
-  cairo_destroy (cr);
+  cairo_destroy (window_cr);
 
   return TRUE;
 }
@@ -1015,10 +1450,28 @@ on_key_release (GtkWidget * widget, GdkEventKey * event)
   return game->handle_key_event(widget, event, FALSE);
 }
 
+/* Keys let go of elsewhere never send us their release */
+gint
+on_focus_out (GtkWidget * widget, GdkEventFocus * event)
+{
+  game->keyboard.reset();
+  return FALSE;
+}
+
 gint
 on_timeout (gpointer data)
 {
+  TRACE_ZONE("on_timeout");
+  gint64 t = profile_now_ns ();
+  long pairs = pair_collision_tests;
+  long tests = precise_collision_tests;
+
+  alloc_period_begin(&game->allocations[0]);
   game->tick();
+  alloc_period_end(&game->allocations[0]);
+  gint64 now = game->profiler.lap(PROFILE_TICK, t);
+  game->hud.tick_finished(now - t, pair_collision_tests - pairs,
+                         precise_collision_tests - tests);
   gtk_widget_queue_draw ((GtkWidget *) data);
   return TRUE;
 }
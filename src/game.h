@@ -22,10 +22,20 @@
 #include <glib.h>
 
 #include "forward.h"
+#include "alloc-tracker.h"
+#include "assets.h"
+#include "collision.h"
 #include "debug.h"
 #include "config.h"
+#include "draw-list.h"
 #include "game-object.h"
+#include "hud.h"
+#include "keyboard.h"
+#include "presenter.h"
+#include "profiler.h"
+#include "quality.h"
 #include "score.h"
+#include "score-writer.h"
 #include "world.h"
 
 // Forward definitions of handler functions
@@ -33,6 +43,7 @@ gint on_expose_event (GtkWidget *, GdkEventExpose *);
 gint on_key_event (GtkWidget *, GdkEventKey *, gboolean);
 gint on_key_press (GtkWidget *, GdkEventKey *);
 gint on_key_release (GtkWidget *, GdkEventKey *);
+gint on_focus_out (GtkWidget *, GdkEventFocus *);
 gint on_timeout (gpointer);
 
 class Game {
@@ -60,11 +71,38 @@ private:
   int          cannon_max_energy;
 
   Score        score;
+  ScoreWriter  score_writer;
+  gboolean     awaiting_high_score;  /// Game over, score still being saved
   World        world;
 
 public:
   double       debug_scale_factor;
-  gboolean     show_fps;
+  gboolean     headless;         /// No window, timer or saved scores; for benchmarks
+  gboolean     show_fps;         /// Print frame statistics every 100 frames
+  gboolean     show_hud;         /// Performance overlay, toggled by F3
+  gboolean     show_profile;     /// Dump the profiler on exit
+  int          render_width;     /// Internal resolution; zero for the window's
+  int          render_height;
+  QualityController quality;
+  Profiler     profiler;         /// Dumped by F12
+  AllocPeriod  allocations[2];   /// Per tick and per frame, with TRACK_ALLOCATIONS
+  PerfHud      hud;
+  Keyboard     keyboard;         /// Sampled once at the start of each tick
+  gint64       input_time;       /// Earliest input taken in by ticks no frame has shown yet
+  DrawList     draw_list;
+  Presenter    presenter;
+  AssetSet     assets;
+  const char  *sprite_dir;
+  const char  *trace_filename;   /// NULL unless --trace was given
+
+  // Precise outlines, tested once the bounding circles overlap
+  CollisionShape ship_shape;
+  CollisionShape cannon_shape;
+  CollisionShape missile_shape;
+
+  // Root of the scene graph; its matrix is the canvas transform
+  SceneNode    scene;
+  SceneNode    castle;
 
   // TODO:  Move these into objects[]
   GameObject  *cannon;
@@ -76,18 +114,19 @@ public:
   GameObject   rings[MAX_NUMBER_OF_RINGS];
   int          next_ring_index;
 
-  // TODO:  Move these into a background object structure
   Canvas      *canvas;
-  CanvasItem   stars[NUMBER_OF_STARS];
 
-  Game(gint argc, gchar ** argv);
+  Game(gint argc, gchar ** argv, gboolean headless = FALSE);
   ~Game();
 
   void init();
   void init_missiles_array ();
-  void init_stars_array ();
   void init_rings_array ();
+  void init_collision_shapes ();
+  void init_high_scores ();
   void process_options(int argc, gchar **argv);
+  void write_trace();
+  void dump_profile();
 
   int  add_object(GameObject *o);
   void check_conditions();
@@ -97,14 +136,20 @@ public:
   void handle_ring_segment_collision(GameObject * ring, GameObject *m, int segment);
   int  ring_segment_hit(GameObject *ring, GameObject *m);
 
+  void update_scene(cairo_t *cr);
   void redraw(cairo_t *cr);
+  gint64 queue_frame(cairo_t *cr, gint64 t);
   void draw_world(cairo_t *cr);
   void draw_ui(cairo_t *cr);
+  void update_hud(gint64 now, gint64 frame_nanos);
+  gint64 input_displayed(gint64 now);
   void draw_text_message(cairo_t *cr, int x, int y, const char*msg);
 
   void tick();
+  void apply_input(const KeyboardSample &input);
   void reset();
   void game_over();
+  void high_score_saved(int place, int rank, int games);
   void try_again();
   void advance_level();
   int  run();
@@ -114,14 +159,16 @@ public:
   void apply_physics(physics_t *p);
   gboolean check_for_collision(physics_t *p1, physics_t *p2);
   gboolean check_for_ring_collision(physics_t * ring, physics_t * p1);
+  gboolean check_for_shape_collision(GameObject *a, const CollisionShape *sa,
+                                     GameObject *b, const CollisionShape *sb);
   void enforce_minimum_distance(physics_t *ring, physics_t *p);
 
 protected:
-  void _draw_ship(cairo_t *cr);
-  void _draw_cannon(cairo_t *, GameObject *player);
-  void _draw_missiles(cairo_t *cr);
-  void _draw_rings(cairo_t *cr);
-  void _draw_mines(cairo_t *cr);
+  // These queue commands on draw_list rather than drawing directly
+  void _draw_ship();
+  void _draw_missiles();
+  void _draw_rings();
+  void _draw_mines();
 };
 
 extern Game* game;
@@ -0,0 +1,267 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cairo.h>
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hud.h"
+
+#define GRAPH_HEIGHT  (60)
+#define LINE_HEIGHT   (14)
+#define MARGIN        (6)
+
+PerfHud::PerfHud(double budget_millis)
+  : _budget(budget_millis),
+    _frames(0),
+    _ticks(0),
+    _missiles(0),
+    _input_ms(-1)
+{
+  memset(_frame_ms, 0, sizeof(_frame_ms));
+  memset(_tick_ms, 0, sizeof(_tick_ms));
+  memset(_tick_pairs, 0, sizeof(_tick_pairs));
+  memset(_tick_tests, 0, sizeof(_tick_tests));
+  memset(_frame_times, 0, sizeof(_frame_times));
+  memset(&_stats, 0, sizeof(_stats));
+  memset(&_render, 0, sizeof(_render));
+  memset(_last, 0, sizeof(_last));
+  memset(_window, 0, sizeof(_window));
+  for (int i = 0; i < HUD_CACHES; i++)
+    _rates[i] = -1;
+}
+
+void
+PerfHud::tick_finished(gint64 nanos, long pair_tests, long precise_tests)
+{
+  int i = _ticks % HUD_HISTORY;
+
+  _tick_ms[i] = nanos / 1e6;
+  _tick_pairs[i] = pair_tests;
+  _tick_tests[i] = precise_tests;
+  _ticks++;
+}
+
+void
+PerfHud::frame_finished(gint64 now, gint64 nanos, const DrawStats &stats, int missiles)
+{
+  int i = _frames % HUD_HISTORY;
+
+  _frame_ms[i] = nanos / 1e6;
+  _frame_times[i] = now;
+  _stats = stats;
+  _missiles = missiles;
+  _frames++;
+
+  if (_frames % HUD_RATE_FRAMES == 0) {
+    for (int c = 0; c < HUD_CACHES; c++) {
+      long total = _window[c].hits + _window[c].misses;
+      if (total > 0)
+        _rates[c] = _window[c].hits / (double) total;
+      _window[c].hits = _window[c].misses = 0;
+    }
+  }
+}
+
+/*
+ * Takes the running totals of a cache's hits and misses.  Totals that
+ * went down were reset by someone else, and count from zero.
+ */
+void
+PerfHud::sample_cache(HudCache cache, long hits, long misses)
+{
+  HudCacheCount *last = &_last[cache];
+
+  if (hits < last->hits || misses < last->misses)
+    last->hits = last->misses = 0;
+  _window[cache].hits += hits - last->hits;
+  _window[cache].misses += misses - last->misses;
+  last->hits = hits;
+  last->misses = misses;
+}
+
+void
+PerfHud::render_finished(const RenderCounts &counts)
+{
+  _render = counts;
+}
+
+void
+PerfHud::input_displayed(gint64 nanos)
+{
+  _input_ms = nanos / 1e6;
+}
+
+double
+PerfHud::fps() const
+{
+  int n = MIN(_frames, HUD_HISTORY);
+  gint64 newest, oldest;
+
+  if (n < 2)
+    return 0;
+  newest = _frame_times[(_frames - 1) % HUD_HISTORY];
+  oldest = _frame_times[(_frames - n) % HUD_HISTORY];
+  return newest > oldest ? (n - 1) * 1e9 / (newest - oldest) : 0;
+}
+
+/* Average of the ticks in a ring */
+static double
+tick_average(const long *ring, int ticks)
+{
+  int n = MIN(ticks, HUD_HISTORY);
+  long total = 0;
+
+  for (int i = 0; i < n; i++)
+    total += ring[i];
+  return n ? total / (double) n : 0;
+}
+
+double
+PerfHud::pair_tests_per_tick() const
+{
+  return tick_average(_tick_pairs, _ticks);
+}
+
+double
+PerfHud::precise_tests_per_tick() const
+{
+  return tick_average(_tick_tests, _ticks);
+}
+
+/* One series of the graph, oldest on the left, as a single path */
+static void
+graph_path(cairo_t *cr, const float *ms, int count, double x, double y, double max_ms)
+{
+  int n = MIN(count, HUD_HISTORY);
+  double step = (HUD_WIDTH - 2 * MARGIN) / (double) (HUD_HISTORY - 1);
+
+  for (int i = 0; i < n; i++) {
+    double v = MIN(ms[(count - n + i) % HUD_HISTORY], max_ms);
+    double px = x + (HUD_HISTORY - n + i) * step;
+    double py = y + GRAPH_HEIGHT * (1 - v / max_ms);
+    if (i == 0)
+      cairo_move_to (cr, px, py);
+    else
+      cairo_line_to (cr, px, py);
+  }
+}
+
+static void
+format_rate(char *buf, size_t size, double rate)
+{
+  if (rate < 0)
+    snprintf(buf, size, "--");
+  else
+    snprintf(buf, size, "%.0f%%", rate * 100);
+}
+
+/*
+ * Draws the overlay with its top left corner at x, y.  Frame times use
+ * the top of the graph up to twice the budget, which is marked.
+ */
+void
+PerfHud::draw(cairo_t *cr, double x, double y) const
+{
+  double max_ms = 2 * _budget;
+  double gx = x + MARGIN;
+  double gy = y + MARGIN;
+  double ty = gy + GRAPH_HEIGHT + LINE_HEIGHT;
+  char line[96], stars[8], matrices[8], input[16];
+  int last_frame = (_frames + HUD_HISTORY - 1) % HUD_HISTORY;
+  int last_tick = (_ticks + HUD_HISTORY - 1) % HUD_HISTORY;
+
+  cairo_save (cr);
+
+  cairo_rectangle (cr, x, y, HUD_WIDTH, HUD_HEIGHT);
+  cairo_set_source_rgba (cr, 0, 0, 0, 0.6);
+  cairo_fill (cr);
+
+  cairo_set_line_width (cr, 1);
+  cairo_move_to (cr, gx, gy + GRAPH_HEIGHT / 2);
+  cairo_rel_line_to (cr, HUD_WIDTH - 2 * MARGIN, 0);
+  cairo_set_source_rgba (cr, 1, 1, 1, 0.3);
+  cairo_stroke (cr);
+
+  graph_path (cr, _frame_ms, _frames, gx, gy, max_ms);
+  cairo_set_source_rgb (cr, 0.3, 0.9, 0.3);
+  cairo_stroke (cr);
+
+  graph_path (cr, _tick_ms, _ticks, gx, gy, max_ms);
+  cairo_set_source_rgb (cr, 0.9, 0.6, 0.2);
+  cairo_stroke (cr);
+
+  cairo_select_font_face (cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_set_font_size (cr, 10);
+  cairo_set_source_rgb (cr, 1, 1, 1);
+
+  snprintf(line, sizeof(line), "%.0f fps   frame %.1f ms   tick %.2f ms", fps(),
+           _frames ? _frame_ms[last_frame] : 0.0, _ticks ? _tick_ms[last_tick] : 0.0);
+  cairo_move_to (cr, gx, ty);
+  cairo_show_text (cr, line);
+
+  if (_input_ms < 0)
+    snprintf(input, sizeof(input), "--");
+  else
+    snprintf(input, sizeof(input), "%.0f ms", _input_ms);
+  snprintf(line, sizeof(line), "missiles %d   input %s", _missiles, input);
+  cairo_move_to (cr, gx, ty += LINE_HEIGHT);
+  cairo_show_text (cr, line);
+
+  snprintf(line, sizeof(line), "tests/tick %.1f pairs, %.1f precise",
+           pair_tests_per_tick(), precise_tests_per_tick());
+  cairo_move_to (cr, gx, ty += LINE_HEIGHT);
+  cairo_show_text (cr, line);
+
+  snprintf(line, sizeof(line), "fills %d   strokes %d   (%d unbatched)",
+           _stats.fills, _stats.strokes, _stats.unbatched_calls);
+  cairo_move_to (cr, gx, ty += LINE_HEIGHT);
+  cairo_show_text (cr, line);
+
+  format_rate(stars, sizeof(stars), _rates[HUD_CACHE_STARFIELD]);
+  format_rate(matrices, sizeof(matrices), _rates[HUD_CACHE_MATRIX]);
+  snprintf(line, sizeof(line), "cache hits: stars %s   matrices %s", stars, matrices);
+  cairo_move_to (cr, gx, ty += LINE_HEIGHT);
+  cairo_show_text (cr, line);
+
+  if (render_counters_enabled()) {
+    const long *calls = _render.calls;
+    snprintf(line, sizeof(line), "cairo calls %ld   state %ld   %.2f Mpx",
+             render_counters_total(_render),
+             calls[RENDER_SAVE] + calls[RENDER_RESTORE] + calls[RENDER_TRANSFORM] +
+             calls[RENDER_SOURCE], _render.pixels / 1e6);
+    cairo_move_to (cr, gx, ty += LINE_HEIGHT);
+    cairo_show_text (cr, line);
+  }
+
+  cairo_restore (cr);
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,104 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HUD_H__
+#define __HUD_H__
+
+#include <glib.h>
+
+#include "forward.h"
+#include "draw-list.h"
+#include "render-counters.h"
+
+// Frames and ticks shown in the graph
+#define HUD_HISTORY        (120)
+
+// Cache hit rates are worked out over this many frames
+#define HUD_RATE_FRAMES    (30)
+
+#define HUD_WIDTH          (240)
+#define HUD_HEIGHT         (164)
+
+typedef enum {
+  HUD_CACHE_STARFIELD,    /// Starfield chunks
+  HUD_CACHE_MATRIX,       /// Scene node matrices
+  HUD_CACHES
+} HudCache;
+
+typedef struct
+{
+  long  hits;
+  long  misses;
+} HudCacheCount;
+
+/*
+ * The performance overlay: a rolling graph of frame and tick times
+ * against the frame budget, and a few lines of engine counters.
+ *
+ * Samples go into fixed rings every frame whether or not the overlay is
+ * showing, so it's full the moment it's turned on.  Drawing it is a
+ * background fill, three strokes and a handful of text runs.  It isn't
+ * counted in the cairo calls it shows.
+ */
+class PerfHud {
+public:
+  PerfHud(double budget_millis);
+
+  void   tick_finished(gint64 nanos, long pair_tests, long precise_tests);
+  void   frame_finished(gint64 now, gint64 nanos, const DrawStats &stats, int missiles);
+  void   sample_cache(HudCache cache, long hits, long misses);
+  void   render_finished(const RenderCounts &counts);
+  void   input_displayed(gint64 nanos);
+  void   draw(cairo_t *cr, double x, double y) const;
+
+  double fps() const;
+  double pair_tests_per_tick() const;
+  double precise_tests_per_tick() const;
+  double hit_rate(HudCache cache) const { return _rates[cache]; }
+
+private:
+  double        _budget;
+  float         _frame_ms[HUD_HISTORY];
+  float         _tick_ms[HUD_HISTORY];
+  long          _tick_pairs[HUD_HISTORY];   /// Bounding circle tests
+  long          _tick_tests[HUD_HISTORY];   /// Outline tests, of the close pairs
+  gint64        _frame_times[HUD_HISTORY];  /// When each frame finished, for fps
+  int           _frames;                    /// Ever recorded
+  int           _ticks;
+  DrawStats     _stats;
+  int           _missiles;
+  RenderCounts  _render;                    /// Last frame's cairo calls, if counted
+  double        _input_ms;                  /// Latest input latency; negative until known
+  HudCacheCount _last[HUD_CACHES];          /// Counters at the last sample
+  HudCacheCount _window[HUD_CACHES];        /// Counted since the last rate
+  double        _rates[HUD_CACHES];         /// Negative until known
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
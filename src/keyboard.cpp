@@ -0,0 +1,108 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <string.h>
+
+#include "keyboard.h"
+
+Keyboard::Keyboard()
+  : _repeats(0)
+{
+  reset();
+}
+
+/* Lets go of everything, and forgets what hasn't been sampled */
+void
+Keyboard::reset()
+{
+  _down = 0;
+  _pressed = 0;
+  _released = 0;
+  _input_time = 0;
+  memset(_release_time, 0, sizeof(_release_time));
+  memset(_input_before_release, 0, sizeof(_input_before_release));
+}
+
+/*
+ * Takes a key event.  @event_time is the event's own timestamp, in ms,
+ * which is what tells a repeat's release and press apart from real
+ * ones; @now is when it arrived, for the latency.
+ */
+void
+Keyboard::key(KeyAction action, bool down, guint32 event_time, gint64 now)
+{
+  guint32 bit = 1u << action;
+
+  if (down) {
+    if (_down & bit) {
+      _repeats++;
+      return;
+    }
+    if ((_released & bit) && _release_time[action] == event_time) {
+      // The release was a repeat's; as far as a tick can tell, it never happened
+      _down |= bit;
+      _released &= ~bit;
+      _input_time = _input_before_release[action];
+      _repeats++;
+      return;
+    }
+    _down |= bit;
+    _pressed |= bit;
+    _released &= ~bit;
+  } else {
+    if (!(_down & bit))
+      return;
+    _down &= ~bit;
+    _released |= bit;
+    _release_time[action] = event_time;
+    _input_before_release[action] = _input_time;
+  }
+
+  if (!_input_time)
+    _input_time = now;
+}
+
+/* What the coming tick should act on; called once at its start */
+KeyboardSample
+Keyboard::sample()
+{
+  KeyboardSample s;
+
+  s.held = _down | _pressed;
+  s.pressed = _pressed;
+  s.input_time = _input_time;
+
+  _pressed = 0;
+  _input_time = 0;
+  memset(_input_before_release, 0, sizeof(_input_before_release));
+  return s;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,92 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KEYBOARD_H__
+#define __KEYBOARD_H__
+
+#include <glib.h>
+
+// The keys the simulation reads; the rest act when they arrive
+typedef enum {
+  KEY_TURN_LEFT,
+  KEY_TURN_RIGHT,
+  KEY_THRUST,
+  KEY_FIRE,
+  KEY_ACTIONS
+} KeyAction;
+
+/*
+ * All a tick sees of the keyboard.  It's a few bits, so a run can be
+ * replayed by keeping one per tick.
+ */
+typedef struct
+{
+  guint32  held;          /// Bit per action: down now, or pressed since the last sample
+  guint32  pressed;       /// Bit per action: went down since the last sample
+  gint64   input_time;    /// When the first event taken in arrived, ns; zero if none
+} KeyboardSample;
+
+inline bool
+key_held(const KeyboardSample &sample, KeyAction action)
+{
+  return sample.held & (1u << action);
+}
+
+/*
+ * Collects key events as they come and hands them to the simulation
+ * once a tick, so how a key acts no longer depends on when its events
+ * arrive or how fast they repeat.
+ *
+ * Auto-repeat is filtered out in either form X sends it: presses of a
+ * key already down, or a release and press with the same timestamp.  A
+ * key pressed and let go between two samples still counts as held for
+ * one of them.
+ */
+class Keyboard {
+public:
+  Keyboard();
+
+  void           key(KeyAction action, bool down, guint32 event_time, gint64 now);
+  KeyboardSample sample();
+  void           reset();
+
+  long           repeats() const { return _repeats; }
+
+private:
+  guint32  _down;
+  guint32  _pressed;
+  guint32  _released;                       /// Up, but maybe only for a repeat
+  guint32  _release_time[KEY_ACTIONS];      /// Event time of the last release
+  gint64   _input_time;
+  gint64   _input_before_release[KEY_ACTIONS];
+  long     _repeats;                        /// Filtered out, ever
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
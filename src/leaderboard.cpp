@@ -0,0 +1,373 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include "leaderboard.h"
+
+// Each block starts with a pointer to the one before it
+#define BLOCK_HEADER_SIZE  (sizeof(char *))
+
+static size_t
+node_size (int height)
+{
+  size_t size = offsetof(LeaderboardNode, links) + height * sizeof(LeaderboardLink);
+  return (size + 7) & ~(size_t) 7;
+}
+
+/* ----------------------------------------------------------------------
+ * ScoreList
+ * ---------------------------------------------------------------------- */
+ScoreList::ScoreList()
+  : _head(NULL),
+    _height(1),
+    _count(0),
+    _rng(0x9e3779b9),
+    _block(NULL),
+    _block_used(0),
+    _num_blocks(0)
+{
+}
+
+ScoreList::~ScoreList()
+{
+  clear();
+}
+
+void
+ScoreList::clear()
+{
+  while (_block) {
+    char *previous = *(char **) _block;
+    g_free (_block);
+    _block = previous;
+  }
+
+  _head = NULL;
+  _height = 1;
+  _count = 0;
+  _block_used = 0;
+  _num_blocks = 0;
+}
+
+LeaderboardNode *
+ScoreList::new_node(int height)
+{
+  size_t size = node_size(height);
+  LeaderboardNode *node;
+
+  if (!_block || _block_used + size > LEADERBOARD_BLOCK_SIZE) {
+    char *block = (char *) g_malloc (LEADERBOARD_BLOCK_SIZE);
+    *(char **) block = _block;
+    _block = block;
+    _block_used = BLOCK_HEADER_SIZE;
+    _num_blocks++;
+  }
+
+  node = (LeaderboardNode *) (_block + _block_used);
+  _block_used += size;
+  node->height = height;
+  return node;
+}
+
+/* One more level for every two zero bits, xorshift32 for the bits */
+int
+ScoreList::random_height()
+{
+  guint32 bits;
+  int height = 1;
+
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+
+  for (bits = _rng; (bits & 3) == 0 && height < LEADERBOARD_MAX_HEIGHT; bits >>= 2)
+    height++;
+  return height;
+}
+
+/**
+ * Adds a record after any with an equal amount.
+ *
+ * Returns its rank, counting from 0 for the highest.
+ */
+int
+ScoreList::insert(const ScoreRecord *rec)
+{
+  LeaderboardNode *update[LEADERBOARD_MAX_HEIGHT];
+  guint32 position[LEADERBOARD_MAX_HEIGHT];
+  LeaderboardNode *node;
+  guint32 pos = 0;
+  int height, i;
+
+  if (!_head) {
+    _head = new_node(LEADERBOARD_MAX_HEIGHT);
+    memset(_head->links, 0, LEADERBOARD_MAX_HEIGHT * sizeof(LeaderboardLink));
+  }
+
+  node = _head;
+  for (i = _height - 1; i >= 0; i--) {
+    while (node->links[i].next && node->links[i].next->record.amount >= rec->amount) {
+      pos += node->links[i].width;
+      node = node->links[i].next;
+    }
+    update[i] = node;
+    position[i] = pos;
+  }
+
+  height = random_height();
+  for (i = _height; i < height; i++) {
+    update[i] = _head;
+    position[i] = 0;
+    _head->links[i].next = NULL;
+    _head->links[i].width = _count + 1;
+  }
+  if (height > _height)
+    _height = height;
+
+  // pos counts the nodes before the new one; its own position is pos + 1
+  node = new_node(height);
+  node->record = *rec;
+  for (i = 0; i < height; i++) {
+    node->links[i].next = update[i]->links[i].next;
+    node->links[i].width = update[i]->links[i].width - (pos - position[i]);
+    update[i]->links[i].next = node;
+    update[i]->links[i].width = pos + 1 - position[i];
+  }
+  for (; i < _height; i++)
+    update[i]->links[i].width++;
+
+  _count++;
+  return pos;
+}
+
+/* Rank a new score of this amount would get */
+int
+ScoreList::rank_of(int amount) const
+{
+  const LeaderboardNode *node = _head;
+  guint32 pos = 0;
+
+  if (!_head)
+    return 0;
+
+  for (int i = _height - 1; i >= 0; i--) {
+    while (node->links[i].next && node->links[i].next->record.amount >= amount) {
+      pos += node->links[i].width;
+      node = node->links[i].next;
+    }
+  }
+  return pos;
+}
+
+const LeaderboardNode *
+ScoreList::node_at(int rank) const
+{
+  const LeaderboardNode *node = _head;
+  guint32 pos = 0;
+  guint32 target = rank + 1;
+
+  if (rank < 0 || rank >= _count)
+    return NULL;
+
+  for (int i = _height - 1; i >= 0; i--) {
+    while (node->links[i].next && pos + node->links[i].width <= target) {
+      pos += node->links[i].width;
+      node = node->links[i].next;
+    }
+  }
+  return node;
+}
+
+const ScoreRecord *
+ScoreList::at(int rank) const
+{
+  const LeaderboardNode *node = node_at(rank);
+  return node ? &node->record : NULL;
+}
+
+/* Copies up to max records starting at a rank; returns how many */
+int
+ScoreList::copy(int first, int max, ScoreRecord *out) const
+{
+  const LeaderboardNode *node = node_at(first);
+  int n = 0;
+
+  for (; node && n < max; node = node->links[0].next)
+    out[n++] = node->record;
+  return n;
+}
+
+/*
+ * Copies up to max records with amounts from high down to low,
+ * inclusive; returns how many.
+ */
+int
+ScoreList::range(int high, int low, ScoreRecord *out, int max) const
+{
+  const LeaderboardNode *node = _head;
+  int n = 0;
+
+  if (!_head)
+    return 0;
+
+  for (int i = _height - 1; i >= 0; i--) {
+    while (node->links[i].next && node->links[i].next->record.amount > high)
+      node = node->links[i].next;
+  }
+
+  for (node = node->links[0].next; node && n < max; node = node->links[0].next) {
+    if (node->record.amount < low)
+      break;
+    out[n++] = node->record;
+  }
+  return n;
+}
+
+/* ----------------------------------------------------------------------
+ * Leaderboard
+ * ---------------------------------------------------------------------- */
+Leaderboard::Leaderboard()
+  : _levels(NULL),
+    _num_levels(0)
+{
+}
+
+Leaderboard::~Leaderboard()
+{
+  clear();
+}
+
+void
+Leaderboard::clear()
+{
+  for (int i = 0; i < _num_levels; i++)
+    delete _levels[i];
+  g_free (_levels);
+
+  _all.clear();
+  _levels = NULL;
+  _num_levels = 0;
+}
+
+/*
+ * Returns the record's overall rank, or -1 if its level is negative or
+ * past LEADERBOARD_MAX_LEVEL, as only a damaged file would have it.
+ */
+int
+Leaderboard::insert(const ScoreRecord *rec)
+{
+  int level = rec->level;
+
+  if (level < 0 || level > LEADERBOARD_MAX_LEVEL)
+    return -1;
+
+  if (level >= _num_levels) {
+    int n = MIN(MAX(level + 1, _num_levels * 2), LEADERBOARD_MAX_LEVEL + 1);
+    _levels = g_renew (ScoreList *, _levels, n);
+    memset(_levels + _num_levels, 0, (n - _num_levels) * sizeof(ScoreList *));
+    _num_levels = n;
+  }
+  if (!_levels[level])
+    _levels[level] = new ScoreList;
+
+  _levels[level]->insert(rec);
+  return _all.insert(rec);
+}
+
+int
+Leaderboard::insert(const Score &score)
+{
+  ScoreRecord rec;
+
+  score.to_record(&rec);
+  return insert(&rec);
+}
+
+const ScoreList *
+Leaderboard::level_list(int level) const
+{
+  if (level < 0 || level >= _num_levels)
+    return NULL;
+  return _levels[level];
+}
+
+int
+Leaderboard::count(int level) const
+{
+  const ScoreList *list = level_list(level);
+  return list ? list->count() : 0;
+}
+
+int
+Leaderboard::rank_of(int amount, int level) const
+{
+  const ScoreList *list = level_list(level);
+  return list ? list->rank_of(amount) : 0;
+}
+
+bool
+Leaderboard::get(int rank, ScoreRecord *out) const
+{
+  const ScoreRecord *rec = _all.at(rank);
+
+  if (!rec)
+    return false;
+  *out = *rec;
+  return true;
+}
+
+int
+Leaderboard::top(int k, int level, ScoreRecord *out) const
+{
+  const ScoreList *list = level_list(level);
+  return list ? list->copy(0, k, out) : 0;
+}
+
+int
+Leaderboard::range(int high, int low, ScoreRecord *out, int max) const
+{
+  return _all.range(high, low, out, max);
+}
+
+size_t
+Leaderboard::memory_used() const
+{
+  size_t used = _all.memory_used() + _num_levels * sizeof(ScoreList *);
+
+  for (int i = 0; i < _num_levels; i++) {
+    if (_levels[i])
+      used += sizeof(ScoreList) + _levels[i]->memory_used();
+  }
+  return used;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,141 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LEADERBOARD_H__
+#define __LEADERBOARD_H__
+
+#include <glib.h>
+
+#include <stddef.h>
+
+#include "score.h"
+
+// Tallest skiplist node; a quarter of the nodes reach each next level,
+// so this is plenty for billions of scores
+#define LEADERBOARD_MAX_HEIGHT  (16)
+
+// Nodes are carved out of blocks of this size
+#define LEADERBOARD_BLOCK_SIZE  (65536)
+
+// Highest level ranked; records from past it are refused, not stored
+#define LEADERBOARD_MAX_LEVEL   (9999)
+
+typedef struct _LeaderboardNode LeaderboardNode;
+
+typedef struct
+{
+  LeaderboardNode *next;
+  guint32          width;     /// Positions from this node to next
+} LeaderboardLink;
+
+struct _LeaderboardNode
+{
+  ScoreRecord      record;
+  guint32          height;
+  LeaderboardLink  links[1];  /// height of them
+};
+
+/*
+ * Score records, highest first, in an indexable skiplist.  Each link
+ * knows how many positions it skips, so finding a score's rank or the
+ * score at a rank are O(log n) like insertion is.  Equal scores keep
+ * the order they were added in.  Nodes are never freed singly; they
+ * come out of large blocks that go all at once in clear().
+ */
+class ScoreList {
+public:
+  ScoreList();
+  ~ScoreList();
+
+  int    insert(const ScoreRecord *rec);
+  void   clear();
+
+  int    count() const { return _count; }
+  int    rank_of(int amount) const;
+  const ScoreRecord *at(int rank) const;
+  int    copy(int first, int max, ScoreRecord *out) const;
+  int    range(int high, int low, ScoreRecord *out, int max) const;
+  size_t memory_used() const { return _num_blocks * (size_t) LEADERBOARD_BLOCK_SIZE; }
+
+private:
+  LeaderboardNode *_head;
+  int              _height;
+  int              _count;
+  guint32          _rng;
+  char            *_block;      /// Block nodes are being carved from
+  size_t           _block_used;
+  int              _num_blocks;
+
+  LeaderboardNode *new_node(int height);
+  int              random_height();
+  const LeaderboardNode *node_at(int rank) const;
+
+public:
+  ScoreList(const ScoreList &) = delete;
+  ScoreList &operator=(const ScoreList &) = delete;
+};
+
+/*
+ * Every score from every cabinet, ranked overall and within the level
+ * each was reached on.  Any number of scores can be held; the limit is
+ * memory, at about 50 bytes a score for each of the two rankings.
+ */
+class Leaderboard {
+public:
+  Leaderboard();
+  ~Leaderboard();
+
+  int  insert(const ScoreRecord *rec);
+  int  insert(const Score &score);
+  void clear();
+
+  int  count() const { return _all.count(); }
+  int  count(int level) const;
+  int  rank_of(int amount) const { return _all.rank_of(amount); }
+  int  rank_of(int amount, int level) const;
+  bool get(int rank, ScoreRecord *out) const;
+  int  top(int k, ScoreRecord *out) const { return _all.copy(0, k, out); }
+  int  top(int k, int level, ScoreRecord *out) const;
+  int  range(int high, int low, ScoreRecord *out, int max) const;
+  size_t memory_used() const;
+
+private:
+  ScoreList   _all;
+  ScoreList **_levels;         /// By level, NULL until a score is added
+  int         _num_levels;
+
+  const ScoreList *level_list(int level) const;
+
+public:
+  Leaderboard(const Leaderboard &) = delete;
+  Leaderboard &operator=(const Leaderboard &) = delete;
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,605 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "path-geometry.h"
+
+#include <math.h>
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * The kernels treat a Point as two packed doubles, x then y, so that
+ * SSE2 can work on both coordinates at once.  Points are only 8 byte
+ * aligned inside a PathSegment, so all loads and stores are unaligned.
+ */
+static inline const double *
+coords (const Point &p)
+{
+  return (const double *) &p;
+}
+
+Polyline::Polyline()
+  : points(NULL), num_points(0), runs(NULL), num_runs(0),
+    _point_capacity(0), _run_capacity(0)
+{
+}
+
+Polyline::~Polyline()
+{
+  free(points);
+  free(runs);
+}
+
+/**
+ * Starts a new run of points.  Returns false if memory ran out.
+ */
+bool
+Polyline::begin_run()
+{
+  if (num_runs >= _run_capacity) {
+    int capacity = _run_capacity ? 2 * _run_capacity : 4;
+    PolylineRun *buffer = (PolylineRun *) realloc(runs, capacity * sizeof(PolylineRun));
+    if (!buffer)
+      return false;
+    runs = buffer;
+    _run_capacity = capacity;
+  }
+
+  runs[num_runs].first = num_points;
+  runs[num_runs].count = 0;
+  runs[num_runs].closed = false;
+  num_runs++;
+  return true;
+}
+
+/**
+ * Makes room for at least @count points.  Returns false if memory ran
+ * out, leaving the points as they were.
+ */
+bool
+Polyline::reserve(int count)
+{
+  int capacity = _point_capacity ? _point_capacity : 32;
+
+  if (count <= _point_capacity)
+    return true;
+
+  while (capacity < count)
+    capacity *= 2;
+
+  Point *buffer = (Point *) malloc(capacity * sizeof(Point));
+  if (!buffer)
+    return false;
+  for (int i = 0; i < num_points; i++)
+    new (&buffer[i]) Point(points[i]);
+  free(points);
+  points = buffer;
+  _point_capacity = capacity;
+  return true;
+}
+
+bool
+Polyline::add_point(double x, double y)
+{
+  if (num_runs == 0 && !begin_run())
+    return false;
+  if (num_points >= _point_capacity && !reserve(num_points + 1))
+    return false;
+
+  new (&points[num_points++]) Point(x, y);
+  runs[num_runs - 1].count++;
+  return true;
+}
+
+void
+Polyline::close_run()
+{
+  if (num_runs > 0)
+    runs[num_runs - 1].closed = true;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Transform                                                               */
+/* ---------------------------------------------------------------------- */
+
+/**
+ * Applies @m to every point of @count segments from @src, writing them
+ * to @dst.  @src and @dst may be the same array.
+ */
+void
+path_transform(const PathSegment *src, PathSegment *dst, int count, const cairo_matrix_t *m)
+{
+#ifdef __SSE2__
+  const __m128d cx = _mm_set_pd (m->yx, m->xx);
+  const __m128d cy = _mm_set_pd (m->yy, m->xy);
+  const __m128d t  = _mm_set_pd (m->y0, m->x0);
+
+  for (int i = 0; i < count; i++) {
+    const double *s = coords(src[i].c1);
+    double *d = &dst[i].c1[0];
+
+    dst[i].code = src[i].code;
+
+    // c1, c2 and pt are six consecutive doubles
+    for (int k = 0; k < 6; k += 2) {
+      __m128d p = _mm_loadu_pd (s + k);
+      __m128d x = _mm_unpacklo_pd (p, p);
+      __m128d y = _mm_unpackhi_pd (p, p);
+      _mm_storeu_pd (d + k, _mm_add_pd (_mm_add_pd (_mm_mul_pd (x, cx), _mm_mul_pd (y, cy)), t));
+    }
+  }
+#else
+  for (int i = 0; i < count; i++) {
+    const Point *s[3] = { &src[i].c1, &src[i].c2, &src[i].pt };
+    Point *d[3] = { &dst[i].c1, &dst[i].c2, &dst[i].pt };
+
+    dst[i].code = src[i].code;
+    for (int k = 0; k < 3; k++) {
+      double x = (*s[k])[0], y = (*s[k])[1];
+      (*d[k])[0] = m->xx * x + m->xy * y + m->x0;
+      (*d[k])[1] = m->yx * x + m->yy * y + m->y0;
+    }
+  }
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+/* Bounds                                                                  */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Widens [*lo, *hi] to take in the extrema of one coordinate of a cubic
+ * Bezier, found where its derivative is zero.
+ */
+static void
+curve_extrema (double p0, double p1, double p2, double p3, double *lo, double *hi)
+{
+  // Derivative over three: a t^2 + b t + c
+  double a = -p0 + 3 * p1 - 3 * p2 + p3;
+  double b = 2 * (p0 - 2 * p1 + p2);
+  double c = p1 - p0;
+  double roots[2];
+  int n = 0;
+
+  if (fabs(a) < 1e-12) {
+    if (fabs(b) > 1e-12)
+      roots[n++] = -c / b;
+  } else {
+    double disc = b * b - 4 * a * c;
+    if (disc >= 0) {
+      double s = sqrt(disc);
+      roots[n++] = (-b + s) / (2 * a);
+      roots[n++] = (-b - s) / (2 * a);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    double t = roots[i], mt = 1 - t;
+    if (t <= 0 || t >= 1)
+      continue;
+    double v = mt * mt * mt * p0 + 3 * mt * mt * t * p1 + 3 * mt * t * t * p2 + t * t * t * p3;
+    *lo = MIN(*lo, v);
+    *hi = MAX(*hi, v);
+  }
+}
+
+/**
+ * Computes the tight bounding box of the path, including the true
+ * extent of curves rather than their control points.  Returns false,
+ * leaving @bounds alone, if the path has no points.
+ */
+bool
+path_bounds(const PathSegment *segments, int count, PathBounds *bounds)
+{
+  double lo[2] = { HUGE_VAL, HUGE_VAL };
+  double hi[2] = { -HUGE_VAL, -HUGE_VAL };
+  double cur[2] = { 0.0, 0.0 };
+  double start[2] = { 0.0, 0.0 };
+  bool any = false;
+
+#ifdef __SSE2__
+  __m128d vlo = _mm_set1_pd (HUGE_VAL);
+  __m128d vhi = _mm_set1_pd (-HUGE_VAL);
+#endif
+
+  for (int i = 0; i < count; i++) {
+    const PathSegment *s = &segments[i];
+
+    // End records carry no point; the next segment starts where the subpath did
+    if (s->code == PATH_END) {
+      cur[0] = start[0];
+      cur[1] = start[1];
+      continue;
+    }
+    if (s->code == PATH_MOVETO || s->code == PATH_MOVETO_OPEN) {
+      start[0] = s->pt[0];
+      start[1] = s->pt[1];
+    }
+
+#ifdef __SSE2__
+    __m128d pt = _mm_loadu_pd (coords(s->pt));
+    vlo = _mm_min_pd (vlo, pt);
+    vhi = _mm_max_pd (vhi, pt);
+
+    if (s->code == PATH_CURVETO && any) {
+      // Only a control point outside the ends' box can stretch it
+      __m128d p0 = _mm_loadu_pd (cur);
+      __m128d elo = _mm_min_pd (p0, pt);
+      __m128d ehi = _mm_max_pd (p0, pt);
+      __m128d c1 = _mm_loadu_pd (coords(s->c1));
+      __m128d c2 = _mm_loadu_pd (coords(s->c2));
+      __m128d out = _mm_or_pd (_mm_or_pd (_mm_cmplt_pd (c1, elo), _mm_cmpgt_pd (c1, ehi)),
+                               _mm_or_pd (_mm_cmplt_pd (c2, elo), _mm_cmpgt_pd (c2, ehi)));
+      int mask = _mm_movemask_pd (out);
+
+      if (mask) {
+        _mm_storeu_pd (lo, vlo);
+        _mm_storeu_pd (hi, vhi);
+        for (int k = 0; k < 2; k++) {
+          if (mask & (1 << k))
+            curve_extrema (cur[k], s->c1[k], s->c2[k], s->pt[k], &lo[k], &hi[k]);
+        }
+        vlo = _mm_loadu_pd (lo);
+        vhi = _mm_loadu_pd (hi);
+      }
+    }
+#else
+    for (int k = 0; k < 2; k++) {
+      lo[k] = MIN(lo[k], s->pt[k]);
+      hi[k] = MAX(hi[k], s->pt[k]);
+      if (s->code == PATH_CURVETO && any)
+        curve_extrema (cur[k], s->c1[k], s->c2[k], s->pt[k], &lo[k], &hi[k]);
+    }
+#endif
+
+    cur[0] = s->pt[0];
+    cur[1] = s->pt[1];
+    any = true;
+  }
+
+  if (!any)
+    return false;
+
+#ifdef __SSE2__
+  _mm_storeu_pd (lo, vlo);
+  _mm_storeu_pd (hi, vhi);
+#endif
+  bounds->x1 = lo[0];
+  bounds->y1 = lo[1];
+  bounds->x2 = hi[0];
+  bounds->y2 = hi[1];
+  return true;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Flattening                                                              */
+/* ---------------------------------------------------------------------- */
+
+/**
+ * Returns how many line segments a cubic must be split into to stay
+ * within @tolerance of the true curve, by Wang's formula.
+ */
+int
+path_flatten_steps(const Point &p0, const Point &p1, const Point &p2, const Point &p3,
+                   double tolerance)
+{
+  double ddx = MAX(fabs(p0[0] - 2 * p1[0] + p2[0]), fabs(p1[0] - 2 * p2[0] + p3[0]));
+  double ddy = MAX(fabs(p0[1] - 2 * p1[1] + p2[1]), fabs(p1[1] - 2 * p2[1] + p3[1]));
+  double n = ceil(sqrt(0.75 * sqrt(ddx * ddx + ddy * ddy) / tolerance));
+
+  if (!(n >= 1))
+    return 1;
+  return (int) MIN(n, PATH_FLATTEN_MAX_STEPS);
+}
+
+/*
+ * Appends the points of a cubic after p0, stepping through it by
+ * forward differences.  The last point is p3 exactly.
+ */
+static bool
+flatten_curve (Polyline *out, const Point &p0, const Point &p1, const Point &p2, const Point &p3,
+               int steps)
+{
+  double h = 1.0 / steps;
+  Point *dst;
+
+  // Written straight into the points; the run is counted at the end
+  if (out->num_runs == 0 && !out->begin_run())
+    return false;
+  if (!out->reserve(out->num_points + steps))
+    return false;
+  dst = &out->points[out->num_points];
+
+#ifdef __SSE2__
+  __m128d v0 = _mm_loadu_pd (coords(p0));
+  __m128d v1 = _mm_loadu_pd (coords(p1));
+  __m128d v2 = _mm_loadu_pd (coords(p2));
+  __m128d v3 = _mm_loadu_pd (coords(p3));
+  __m128d three = _mm_set1_pd (3.0);
+
+  // B(t) = a t^3 + b t^2 + c t + p0
+  __m128d c = _mm_mul_pd (three, _mm_sub_pd (v1, v0));
+  __m128d b = _mm_sub_pd (_mm_mul_pd (three, _mm_sub_pd (v2, v1)), c);
+  __m128d a = _mm_sub_pd (_mm_sub_pd (_mm_sub_pd (v3, v0), c), b);
+
+  __m128d h1 = _mm_set1_pd (h);
+  __m128d h2 = _mm_set1_pd (h * h);
+  __m128d h3 = _mm_set1_pd (h * h * h);
+  __m128d ah3 = _mm_mul_pd (a, h3);
+  __m128d bh2 = _mm_mul_pd (b, h2);
+
+  __m128d d1 = _mm_add_pd (_mm_add_pd (ah3, bh2), _mm_mul_pd (c, h1));
+  __m128d d3 = _mm_mul_pd (_mm_set1_pd (6.0), ah3);
+  __m128d d2 = _mm_add_pd (d3, _mm_add_pd (bh2, bh2));
+  __m128d p = v0;
+
+  for (int i = 1; i < steps; i++) {
+    p = _mm_add_pd (p, d1);
+    d1 = _mm_add_pd (d1, d2);
+    d2 = _mm_add_pd (d2, d3);
+    _mm_storeu_pd ((double *) &dst[i - 1], p);
+  }
+#else
+  double c[2], b[2], a[2], d1[2], d2[2], d3[2], p[2];
+
+  for (int k = 0; k < 2; k++) {
+    c[k] = 3 * (p1[k] - p0[k]);
+    b[k] = 3 * (p2[k] - p1[k]) - c[k];
+    a[k] = p3[k] - p0[k] - c[k] - b[k];
+    d1[k] = a[k] * h * h * h + b[k] * h * h + c[k] * h;
+    d3[k] = 6 * a[k] * h * h * h;
+    d2[k] = d3[k] + 2 * b[k] * h * h;
+    p[k] = p0[k];
+  }
+
+  for (int i = 1; i < steps; i++) {
+    for (int k = 0; k < 2; k++) {
+      p[k] += d1[k];
+      d1[k] += d2[k];
+      d2[k] += d3[k];
+      dst[i - 1][k] = p[k];
+    }
+  }
+#endif
+
+  dst[steps - 1] = p3;
+  out->num_points += steps;
+  out->runs[out->num_runs - 1].count += steps;
+  return true;
+}
+
+/**
+ * Flattens the path into @out, which is cleared first.  Curves are
+ * split adaptively so no point of the true curve is further than
+ * @tolerance from the lines.  Returns false if memory ran out.
+ */
+bool
+path_flatten(const PathSegment *segments, int count, double tolerance, Polyline *out)
+{
+  Point cur(0.0, 0.0);
+  Point start(0.0, 0.0);
+  bool closed = false;
+
+  out->clear();
+  for (int i = 0; i < count; i++) {
+    const PathSegment *s = &segments[i];
+
+    // Drawing on after a close starts a new run from where it closed
+    if (closed && (s->code == PATH_LINETO || s->code == PATH_CURVETO)) {
+      if (!out->begin_run() || !out->add_point(start[0], start[1]))
+        return false;
+      closed = false;
+    }
+
+    switch (s->code) {
+      case PATH_MOVETO:
+      case PATH_MOVETO_OPEN:
+        if (!out->begin_run() || !out->add_point(s->pt[0], s->pt[1]))
+          return false;
+        start = s->pt;
+        closed = false;
+        break;
+      case PATH_LINETO:
+        if (!out->add_point(s->pt[0], s->pt[1]))
+          return false;
+        break;
+      case PATH_CURVETO:
+        if (!flatten_curve (out, cur, s->c1, s->c2, s->pt,
+                            path_flatten_steps (cur, s->c1, s->c2, s->pt, tolerance)))
+          return false;
+        break;
+      case PATH_END:
+        // The end record's point means nothing; closing goes back to the start
+        out->close_run();
+        cur = start;
+        closed = true;
+        continue;
+      default:
+        continue;
+    }
+    cur = s->pt;
+  }
+  return true;
+}
+
+/* ---------------------------------------------------------------------- */
+/* FlattenCache                                                            */
+/* ---------------------------------------------------------------------- */
+
+FlattenCache::FlattenCache()
+  : _clock(0), _hits(0), _misses(0)
+{
+  for (int i = 0; i < FLATTEN_CACHE_SIZE; i++) {
+    _entries[i].hash = 0;
+    _entries[i].segments = NULL;
+    _entries[i].count = 0;
+    _entries[i].capacity = 0;
+    _entries[i].tolerance = 0.0;
+    _entries[i].last_used = 0;
+  }
+}
+
+FlattenCache::~FlattenCache()
+{
+  for (int i = 0; i < FLATTEN_CACHE_SIZE; i++)
+    free(_entries[i].segments);
+}
+
+static inline uint64_t
+hash_word (uint64_t h, uint64_t w)
+{
+  h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t
+hash_point (uint64_t h, const Point &p)
+{
+  uint64_t bits[2];
+
+  // Each step is a bijection, so changing any one word changes the hash
+  memcpy(bits, coords(p), sizeof(bits));
+  h = (h ^ bits[0]) * 0x9e3779b97f4a7c15ULL;
+  return (h ^ bits[1]) * 0xc2b2ae3d27d4eb4fULL;
+}
+
+/*
+ * Hashes everything a flattening depends on: each segment's code and
+ * points.  The fields are read one by one so padding never gets in, and
+ * the three points go into separate lanes that can be worked on at the
+ * same time; this runs on every get(), hit or not.
+ */
+static uint64_t
+hash_segments (const PathSegment *segments, int count)
+{
+  uint64_t h[3] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL, (uint64_t) count };
+
+  for (int i = 0; i < count; i++) {
+    h[0] = hash_point (h[0] ^ (uint64_t) segments[i].code, segments[i].c1);
+    h[1] = hash_point (h[1], segments[i].c2);
+    h[2] = hash_point (h[2], segments[i].pt);
+  }
+  return hash_word (hash_word (hash_word (0, h[0]), h[1]), h[2]);
+}
+
+/*
+ * Whether two arrays hold the same segments.  A copy is the same byte
+ * for byte; otherwise the fields are compared one by one, the way
+ * hash_segments() reads them, so padding doesn't count.
+ */
+static bool
+same_segments (const PathSegment *a, const PathSegment *b, int count)
+{
+  if (memcmp(a, b, count * sizeof(PathSegment)) == 0)
+    return true;
+
+  for (int i = 0; i < count; i++) {
+    if (a[i].code != b[i].code ||
+        memcmp(coords(a[i].c1), coords(b[i].c1), 2 * sizeof(double)) ||
+        memcmp(coords(a[i].c2), coords(b[i].c2), 2 * sizeof(double)) ||
+        memcmp(coords(a[i].pt), coords(b[i].pt), 2 * sizeof(double)))
+      return false;
+  }
+  return true;
+}
+
+static unsigned int
+flatten_cache_set (uint64_t hash, double tolerance)
+{
+  uint64_t bits;
+
+  memcpy(&bits, &tolerance, sizeof(bits));
+  return (unsigned int) (hash_word (hash, bits) % (FLATTEN_CACHE_SIZE / FLATTEN_CACHE_WAYS));
+}
+
+/**
+ * Returns @segments flattened at @tolerance, flattening them only if
+ * the same segments aren't cached already.  The result stays valid
+ * until the entry is evicted by a later get(), so use it before asking
+ * for more.  Returns NULL if memory ran out.
+ */
+const Polyline *
+FlattenCache::get(const PathSegment *segments, int count, double tolerance)
+{
+  uint64_t hash = hash_segments(segments, count);
+  Entry *set = &_entries[flatten_cache_set(hash, tolerance) * FLATTEN_CACHE_WAYS];
+  Entry *victim = set;
+
+  _clock++;
+  for (int i = 0; i < FLATTEN_CACHE_WAYS; i++) {
+    Entry *e = &set[i];
+    if (e->count && e->hash == hash && e->count == count && e->tolerance == tolerance &&
+        same_segments(e->segments, segments, count)) {
+      e->last_used = _clock;
+      _hits++;
+      return &e->flat;
+    }
+    if (e->last_used < victim->last_used)
+      victim = e;
+  }
+
+  _misses++;
+  victim->count = 0;
+  if (count > victim->capacity) {
+    PathSegment *buffer = (PathSegment *) malloc(count * sizeof(PathSegment));
+    if (!buffer)
+      return NULL;
+    free(victim->segments);
+    victim->segments = buffer;
+    victim->capacity = count;
+  }
+  if (!path_flatten(segments, count, tolerance, &victim->flat))
+    return NULL;
+
+  // Padding and all, so that same_segments() matches it with one memcmp
+  memcpy((void *) victim->segments, segments, count * sizeof(PathSegment));
+  victim->hash = hash;
+  victim->count = count;
+  victim->tolerance = tolerance;
+  victim->last_used = _clock;
+  return &victim->flat;
+}
+
+void
+FlattenCache::clear()
+{
+  for (int i = 0; i < FLATTEN_CACHE_SIZE; i++) {
+    _entries[i].count = 0;
+    _entries[i].last_used = 0;
+  }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
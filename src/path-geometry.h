@@ -0,0 +1,138 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PATH_GEOMETRY_H__
+#define __PATH_GEOMETRY_H__
+
+#include <cairo.h>
+#include <stdint.h>
+
+#include "forward.h"
+#include "path.h"
+#include "point.h"
+
+// Most line segments a single curve is flattened into
+#define PATH_FLATTEN_MAX_STEPS (256)
+
+// Flattened paths kept by a FlattenCache, in sets of FLATTEN_CACHE_WAYS
+#define FLATTEN_CACHE_SIZE     (256)
+#define FLATTEN_CACHE_WAYS     (4)
+
+typedef struct
+{
+  double x1, y1;    /// Top left
+  double x2, y2;    /// Bottom right
+} PathBounds;
+
+typedef struct
+{
+  int  first;       /// Index of the subpath's first point
+  int  count;
+  bool closed;      /// Ended by 'z'
+} PolylineRun;
+
+/*
+ * A path flattened into straight lines, as runs of points.  Storage
+ * grows as needed and is kept across clear() for reuse.
+ */
+class Polyline {
+public:
+  Point        *points;
+  int           num_points;
+  PolylineRun  *runs;
+  int           num_runs;
+
+  Polyline();
+  ~Polyline();
+
+  void clear() { num_points = 0; num_runs = 0; }
+  bool reserve(int count);
+  bool begin_run();
+  bool add_point(double x, double y);
+  void close_run();
+
+private:
+  int _point_capacity;
+  int _run_capacity;
+
+public:
+  Polyline(const Polyline &) = delete;
+  Polyline &operator=(const Polyline &) = delete;
+};
+
+/*
+ * Flattened paths by content and tolerance, so geometry that doesn't
+ * change (sprites, cached paths) is only flattened once per level of
+ * detail.  Paths are matched by their segments rather than their
+ * address, so an array that is edited in place, or freed and its
+ * memory reused, is never taken for what was there before: a hash picks
+ * the candidates, and a copy of the segments kept with each entry
+ * settles it.  Set-associative with LRU replacement within a set.
+ */
+class FlattenCache {
+public:
+  FlattenCache();
+  ~FlattenCache();
+
+  const Polyline *get(const PathSegment *segments, int count, double tolerance);
+  void clear();
+
+  long hits() const { return _hits; }
+  long misses() const { return _misses; }
+
+private:
+  typedef struct
+  {
+    uint64_t           hash;        /// Of the segments; see hash_segments()
+    PathSegment       *segments;    /// What was flattened, to check a hit against
+    int                count;       /// Zero for an unused entry
+    int                capacity;
+    double             tolerance;
+    unsigned int       last_used;
+    Polyline           flat;
+  } Entry;
+
+  Entry        _entries[FLATTEN_CACHE_SIZE];
+  unsigned int _clock;
+  long         _hits;
+  long         _misses;
+
+public:
+  FlattenCache(const FlattenCache &) = delete;
+  FlattenCache &operator=(const FlattenCache &) = delete;
+};
+
+void path_transform(const PathSegment *src, PathSegment *dst, int count, const cairo_matrix_t *m);
+bool path_bounds(const PathSegment *segments, int count, PathBounds *bounds);
+bool path_flatten(const PathSegment *segments, int count, double tolerance, Polyline *out);
+int  path_flatten_steps(const Point &p0, const Point &p1, const Point &p2, const Point &p3,
+                        double tolerance);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
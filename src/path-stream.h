@@ -0,0 +1,727 @@
+/*
+  Streaming SVG path data parser.
+  The command handling is rsvg_parse_path_data and friends from
+  path-parser.cpp (derived from svg-path.c from Sodipodi), made into a
+  template over where the segments go.
+
+  Copyright (C) 2000 Eazel, Inc.
+  Copyright (C) 2000 Lauris Kaplinski
+  Copyright (C) 2001 Ximian, Inc.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public
+  License along with this program; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+  Boston, MA 02111-1307, USA.
+
+  Authors:
+  Raph Levien <raph@artofcode.com>
+  Lauris Kaplinski <lauris@ximian.com>
+*/
+
+#ifndef PATH_STREAM_H
+#define PATH_STREAM_H
+
+#include <cairo.h>
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "path.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif  /*  M_PI  */
+
+/* Longest number that may be split across two chunks */
+#define PATH_STREAM_MAX_TOKEN (128)
+
+const char *svg_scan_number(const char *s, double *val);
+
+/**
+ * PathStreamParser: Parse SVG path data without building a Path.
+ *
+ * Segments are handed to a sink as they are completed.  A sink is any
+ * class with these members, which are called directly and so inline:
+ *
+ *   void move_to(double x, double y);
+ *   void line_to(double x, double y);
+ *   void curve_to(double x1, double y1, double x2, double y2,
+ *                 double x3, double y3);
+ *   void close_path();
+ *
+ * Data may arrive in chunks of any size, split anywhere; only a number
+ * cut in two by a chunk boundary is copied.  Call finish() after the
+ * last chunk.  feed() and finish() return false once the data has an
+ * error, after which the sink has seen everything up to the last
+ * complete segment before it and further data is ignored.
+ **/
+template <class Sink>
+class PathStreamParser {
+public:
+    PathStreamParser(Sink &sink);
+
+    bool feed(const char *data, size_t length);
+    bool finish();
+    bool parse(const char *str);
+
+    Sink &sink() { return _sink; }
+
+private:
+    Sink  &_sink;
+    double cpx, cpy;  /* current point */
+    double rpx, rpy;  /* reflection point (for 's' and 't' commands) */
+    double spx, spy;  /* beginning of current subpath point */
+    char   cmd;       /* current command (lowercase) */
+    int    param;     /* parameter number */
+    bool   rel;       /* true if relative coords */
+    double params[7]; /* parameters that have been parsed */
+
+    bool   _failed;
+    char   _carry[PATH_STREAM_MAX_TOKEN + 1];  /* number split by a chunk */
+    size_t _carry_length;
+
+    const char *parse_data(const char *s, const char *end);
+    bool carry(const char *data, size_t length);
+    void do_cmd(bool final);
+    void default_xy(int n_params);
+    void arc(double rx, double ry, double x_axis_rotation,
+             int large_arc_flag, int sweep_flag, double x, double y);
+    void arc_segment(double xc, double yc, double th0, double th1,
+                     double rx, double ry, double x_axis_rotation);
+
+public:
+    PathStreamParser(const PathStreamParser &) = delete;
+    PathStreamParser &operator=(const PathStreamParser &) = delete;
+};
+
+/* Appends segments to a Path */
+class PathBuilderSink {
+public:
+    PathBuilderSink(Path *path) : _path(path) {}
+
+    void move_to(double x, double y)
+    {
+        _path->addSegment(PathSegment(PATH_MOVETO, x, y));
+    }
+    void line_to(double x, double y)
+    {
+        _path->addSegment(PathSegment(PATH_LINETO, x, y));
+    }
+    void curve_to(double x1, double y1, double x2, double y2, double x3, double y3)
+    {
+        _path->addSegment(PathSegment(PATH_CURVETO, x1, y1, x2, y2, x3, y3));
+    }
+    void close_path() { _path->end(); }
+
+private:
+    Path *_path;
+};
+
+/* Adds segments to cairo's current path */
+class CairoPathSink {
+public:
+    CairoPathSink(cairo_t *cr) : _cr(cr) {}
+
+    void move_to(double x, double y) { cairo_move_to (_cr, x, y); }
+    void line_to(double x, double y) { cairo_line_to (_cr, x, y); }
+    void curve_to(double x1, double y1, double x2, double y2, double x3, double y3)
+    {
+        cairo_curve_to (_cr, x1, y1, x2, y2, x3, y3);
+    }
+    void close_path() { cairo_close_path (_cr); }
+
+private:
+    cairo_t *_cr;
+};
+
+/**
+ * svg_parse_path: Parse a whole d attribute into a sink.
+ *
+ * Returns: false if the data has an error.
+ **/
+template <class Sink>
+inline bool svg_parse_path(const char *str, Sink &sink)
+{
+    PathStreamParser<Sink> parser(sink);
+    return parser.parse(str);
+}
+
+
+/* A chunk may be cut just before @c if @prev ends a token */
+static inline bool path_stream_ends_token(char prev)
+{
+    return prev == ' ' || prev == ',' || prev == '\t' || prev == '\n' || prev == '\r' ||
+        prev == '\f' ||
+        (prev >= 'A' && prev <= 'Z' && prev != 'E') ||
+        (prev >= 'a' && prev <= 'z' && prev != 'e');
+}
+
+static inline bool path_stream_can_split(char prev, char c)
+{
+    return path_stream_ends_token(prev) ||
+        ((c == '+' || c == '-') && prev != 'e' && prev != 'E');
+}
+
+template <class Sink>
+PathStreamParser<Sink>::PathStreamParser(Sink &sink)
+    : _sink(sink),
+      cpx(0.0), cpy(0.0), rpx(0.0), rpy(0.0), spx(0.0), spy(0.0),
+      cmd(0), param(0), rel(false),
+      _failed(false), _carry_length(0)
+{
+}
+
+template <class Sink>
+void PathStreamParser<Sink>::arc_segment(double xc, double yc,
+                                         double th0, double th1,
+                                         double rx, double ry, double x_axis_rotation)
+{
+    double sin_th, cos_th;
+    double a00, a01, a10, a11;
+    double x1, y1, x2, y2, x3, y3;
+    double t;
+    double th_half;
+
+    sin_th = sin (x_axis_rotation * (M_PI / 180.0));
+    cos_th = cos (x_axis_rotation * (M_PI / 180.0));
+    /* inverse transform compared with arc() */
+    a00 = cos_th * rx;
+    a01 = -sin_th * ry;
+    a10 = sin_th * rx;
+    a11 = cos_th * ry;
+
+    th_half = 0.5 * (th1 - th0);
+    t = (8.0 / 3.0) * sin(th_half * 0.5) * sin(th_half * 0.5) / sin(th_half);
+    x1 = xc + cos (th0) - t * sin (th0);
+    y1 = yc + sin (th0) + t * cos (th0);
+    x3 = xc + cos (th1);
+    y3 = yc + sin (th1);
+    x2 = x3 + t * sin (th1);
+    y2 = y3 - t * cos (th1);
+
+    _sink.curve_to(a00 * x1 + a01 * y1, a10 * x1 + a11 * y1,
+                   a00 * x2 + a01 * y2, a10 * x2 + a11 * y2,
+                   a00 * x3 + a01 * y3, a10 * x3 + a11 * y3);
+}
+
+/**
+ * arc: Add an RSVG arc to the path.
+ * @rx: Radius in x direction (before rotation).
+ * @ry: Radius in y direction (before rotation).
+ * @x_axis_rotation: Rotation angle for axes.
+ * @large_arc_flag: 0 for arc length <= 180, 1 for arc >= 180.
+ * @sweep: 0 for "negative angle", 1 for "positive angle".
+ * @x: New x coordinate.
+ * @y: New y coordinate.
+ *
+ **/
+template <class Sink>
+void PathStreamParser<Sink>::arc(double rx, double ry, double x_axis_rotation,
+                                 int large_arc_flag, int sweep_flag,
+                                 double x, double y)
+{
+    double sin_th, cos_th;
+    double a00, a01, a10, a11;
+    double x0, y0, x1, y1, xc, yc;
+    double d, sfactor, sfactor_sq;
+    double th0, th1, th_arc;
+    double px, py, pl;
+    int i, n_segs;
+
+    sin_th = sin (x_axis_rotation * (M_PI / 180.0));
+    cos_th = cos (x_axis_rotation * (M_PI / 180.0));
+
+    /*
+      Correction of out-of-range radii as described in Appendix F.6.6:
+
+      1. Ensure radii are non-zero (Done?).
+      2. Ensure that radii are positive.
+      3. Ensure that radii are large enough.
+    */
+
+    if(rx < 0.0) rx = -rx;
+    if(ry < 0.0) ry = -ry;
+
+    px = cos_th * (cpx - x) * 0.5 + sin_th * (cpy - y) * 0.5;
+    py = cos_th * (cpy - y) * 0.5 - sin_th * (cpx - x) * 0.5;
+    pl = (px * px) / (rx * rx) + (py * py) / (ry * ry);
+
+    if(pl > 1.0)
+    {
+        pl  = sqrt(pl);
+        rx *= pl;
+        ry *= pl;
+    }
+
+    /* Proceed with computations as described in Appendix F.6.5 */
+
+    a00 = cos_th / rx;
+    a01 = sin_th / rx;
+    a10 = -sin_th / ry;
+    a11 = cos_th / ry;
+    x0 = a00 * cpx + a01 * cpy;
+    y0 = a10 * cpx + a11 * cpy;
+    x1 = a00 * x + a01 * y;
+    y1 = a10 * x + a11 * y;
+    /* (x0, y0) is current point in transformed coordinate space.
+       (x1, y1) is new point in transformed coordinate space.
+
+       The arc fits a unit-radius circle in this space.
+    */
+    d = (x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0);
+    sfactor_sq = 1.0 / d - 0.25;
+    if (sfactor_sq < 0) sfactor_sq = 0;
+    sfactor = sqrt (sfactor_sq);
+    if (sweep_flag == large_arc_flag) sfactor = -sfactor;
+    xc = 0.5 * (x0 + x1) - sfactor * (y1 - y0);
+    yc = 0.5 * (y0 + y1) + sfactor * (x1 - x0);
+    /* (xc, yc) is center of the circle. */
+
+    th0 = atan2 (y0 - yc, x0 - xc);
+    th1 = atan2 (y1 - yc, x1 - xc);
+
+    th_arc = th1 - th0;
+    if (th_arc < 0 && sweep_flag)
+        th_arc += 2 * M_PI;
+    else if (th_arc > 0 && !sweep_flag)
+        th_arc -= 2 * M_PI;
+
+    n_segs = (int) ceil (fabs (th_arc / (M_PI * 0.5 + 0.001)));
+
+    for (i = 0; i < n_segs; i++) {
+        arc_segment(xc, yc,
+                    th0 + i * th_arc / n_segs,
+                    th0 + (i + 1) * th_arc / n_segs,
+                    rx, ry, x_axis_rotation);
+    }
+
+    cpx = x;
+    cpy = y;
+}
+
+/* supply defaults for missing parameters, assuming relative coordinates
+   are to be interpreted as x,y */
+template <class Sink>
+void PathStreamParser<Sink>::default_xy(int n_params)
+{
+    int i;
+
+    if (rel) {
+        for (i = param; i < n_params; i++) {
+            if (i > 2)
+                params[i] = params[i - 2];
+            else if (i == 1)
+                params[i] = cpy;
+            else if (i == 0)
+                /* we shouldn't get here (usually param > 0 as
+                   precondition) */
+                params[i] = cpx;
+        }
+    } else {
+        for (i = param; i < n_params; i++) {
+            params[i] = 0.0;
+        }
+    }
+}
+
+template <class Sink>
+void PathStreamParser<Sink>::do_cmd(bool final)
+{
+    double x1, y1, x2, y2, x3, y3;
+
+    switch (cmd) {
+        case 'm':
+            /* moveto */
+            if (param == 2 || final)
+            {
+                default_xy (2);
+                _sink.move_to(params[0], params[1]);
+                cpx = rpx = spx = params[0];
+                cpy = rpy = spy = params[1];
+                param = 0;
+                cmd = 'l';
+            }
+            break;
+        case 'l':
+            /* lineto */
+            if (param == 2 || final)
+            {
+                default_xy (2);
+                _sink.line_to(params[0], params[1]);
+                cpx = rpx = params[0];
+                cpy = rpy = params[1];
+                param = 0;
+            }
+            break;
+        case 'c':
+            /* curveto */
+            if (param == 6 || final )
+            {
+                default_xy (6);
+                x1 = params[0];
+                y1 = params[1];
+                x2 = params[2];
+                y2 = params[3];
+                x3 = params[4];
+                y3 = params[5];
+                _sink.curve_to(x1, y1, x2, y2, x3, y3);
+                rpx = x2;
+                rpy = y2;
+                cpx = x3;
+                cpy = y3;
+                param = 0;
+            }
+            break;
+        case 's':
+            /* smooth curveto */
+            if (param == 4 || final)
+            {
+                default_xy (4);
+                x1 = 2 * cpx - rpx;
+                y1 = 2 * cpy - rpy;
+                x2 = params[0];
+                y2 = params[1];
+                x3 = params[2];
+                y3 = params[3];
+                _sink.curve_to(x1, y1, x2, y2, x3, y3);
+                rpx = x2;
+                rpy = y2;
+                cpx = x3;
+                cpy = y3;
+                param = 0;
+            }
+            break;
+        case 'h':
+            /* horizontal lineto */
+            if (param == 1) {
+                _sink.line_to(params[0], cpy);
+                cpx = rpx = params[0];
+                param = 0;
+            }
+            break;
+        case 'v':
+            /* vertical lineto */
+            if (param == 1) {
+                _sink.line_to(cpx, params[0]);
+                cpy = rpy = params[0];
+                param = 0;
+            }
+            break;
+        case 'q':
+            /* quadratic bezier curveto */
+
+            /* non-normative reference:
+               http://www.icce.rug.nl/erikjan/bluefuzz/beziers/beziers/beziers.html
+            */
+            if (param == 4 || final)
+            {
+                default_xy (4);
+                /* raise quadratic bezier to cubic */
+                x1 = (cpx + 2 * params[0]) * (1.0 / 3.0);
+                y1 = (cpy + 2 * params[1]) * (1.0 / 3.0);
+                x3 = params[2];
+                y3 = params[3];
+                x2 = (x3 + 2 * params[0]) * (1.0 / 3.0);
+                y2 = (y3 + 2 * params[1]) * (1.0 / 3.0);
+                _sink.curve_to(x1, y1, x2, y2, x3, y3);
+                rpx = params[0];
+                rpy = params[1];
+                cpx = x3;
+                cpy = y3;
+                param = 0;
+            }
+            break;
+        case 't':
+            /* Truetype quadratic bezier curveto */
+            if (param == 2 || final) {
+                double xc, yc; /* quadratic control point */
+
+                xc = 2 * cpx - rpx;
+                yc = 2 * cpy - rpy;
+                /* generate a quadratic bezier with control point = xc, yc */
+                x1 = (cpx + 2 * xc) * (1.0 / 3.0);
+                y1 = (cpy + 2 * yc) * (1.0 / 3.0);
+                x3 = params[0];
+                y3 = params[1];
+                x2 = (x3 + 2 * xc) * (1.0 / 3.0);
+                y2 = (y3 + 2 * yc) * (1.0 / 3.0);
+                _sink.curve_to(x1, y1, x2, y2, x3, y3);
+                rpx = xc;
+                rpy = yc;
+                cpx = x3;
+                cpy = y3;
+                param = 0;
+            } else if (final) {
+                if (param > 2) {
+                    default_xy(4);
+                    /* raise quadratic bezier to cubic */
+                    x1 = (cpx + 2 * params[0]) * (1.0 / 3.0);
+                    y1 = (cpy + 2 * params[1]) * (1.0 / 3.0);
+                    x3 = params[2];
+                    y3 = params[3];
+                    x2 = (x3 + 2 * params[0]) * (1.0 / 3.0);
+                    y2 = (y3 + 2 * params[1]) * (1.0 / 3.0);
+                    _sink.curve_to(x1, y1, x2, y2, x3, y3);
+                    rpx = x2;
+                    rpy = y2;
+                    cpx = x3;
+                    cpy = y3;
+                } else {
+                    default_xy(2);
+                    _sink.line_to(params[0], params[1]);
+                    cpx = rpx = params[0];
+                    cpy = rpy = params[1];
+                }
+                param = 0;
+            }
+            break;
+        case 'a':
+            if (param == 7 || final)
+            {
+                arc(params[0], params[1], params[2],
+                    (int) params[3], (int) params[4],
+                    params[5], params[6]);
+                param = 0;
+            }
+            break;
+        default:
+            param = 0;
+    }
+}
+
+/*
+ * Parses from @s up to @end, or up to a NUL if @end is NULL.  Numbers
+ * are scanned in place, so the data must not stop partway through one
+ * unless it is NUL terminated.
+ *
+ * Returns: Where parsing stopped, or %NULL on an error.
+ */
+template <class Sink>
+const char *PathStreamParser<Sink>::parse_data(const char *s, const char *end)
+{
+    double val;
+    char c;
+
+    /* fixme: At some point we'll need to do all of
+     * http://www.w3.org/TR/SVG11/implnote.html#ErrorProcessing.
+     */
+    while (s != end)
+    {
+        c = *s;
+        if ((c >= '0' && c <= '9') || c == '.' || c == '+' || c == '-')
+        {
+            s = svg_scan_number (s, &val);
+            if (!s) {
+                param = 0;
+                return NULL;
+            }
+
+            if (rel)
+            {
+                /* Handle relative coordinates. This switch statement attempts
+                   to determine _what_ the coords are relative to. This is
+                   underspecified in the 12 Apr working draft. */
+                switch (cmd)
+                {
+                    case 'l':
+                    case 'm':
+                    case 'c':
+                    case 's':
+                    case 'q':
+                    case 't':
+                        if ( param & 1 ) {
+                            val += cpy; /* odd param, y */
+                        } else {
+                            val += cpx; /* even param, x */
+                        }
+                        break;
+                    case 'a':
+                        /* rule: sixth and seventh are x and y, rest are not
+                           relative */
+                        if (param == 5)
+                            val += cpx;
+                        else if (param == 6)
+                            val += cpy;
+                        break;
+                    case 'h':
+                        /* rule: x-relative */
+                        val += cpx;
+                        break;
+                    case 'v':
+                        /* rule: y-relative */
+                        val += cpy;
+                        break;
+                }
+            }
+            params[param++] = val;
+            do_cmd (false);
+            continue;
+        }
+
+        if (c == '\0')
+            break;
+        else if (c == 'z' || c == 'Z')
+        {
+            if (param)
+                do_cmd (true);
+            _sink.close_path();
+
+            cmd = 'm';
+            params[0] = cpx = rpx = spx;
+            params[1] = cpy = rpy = spy;
+            param = 2;
+        }
+        else if (c >= 'A' && c <= 'Z' && c != 'E')
+        {
+            if (param)
+                do_cmd (true);
+            cmd = c + 'a' - 'A';
+            rel = false;
+        }
+        else if (c >= 'a' && c <= 'z' && c != 'e')
+        {
+            if (param)
+                do_cmd (true);
+            cmd = c;
+            rel = true;
+        }
+        /* else c _should_ be whitespace or , */
+        s++;
+    }
+
+    return s;
+}
+
+/* Adds to the token held over from the last chunk */
+template <class Sink>
+bool PathStreamParser<Sink>::carry(const char *data, size_t length)
+{
+    if (_carry_length + length > PATH_STREAM_MAX_TOKEN) {
+        _failed = true;
+        return false;
+    }
+    memcpy(_carry + _carry_length, data, length);
+    _carry_length += length;
+    _carry[_carry_length] = '\0';
+    return true;
+}
+
+/**
+ * feed: Parse the next chunk of path data.
+ *
+ * Everything up to the last point in @data where a new token may begin
+ * is parsed straight out of @data; the rest is held back until the
+ * following chunk says where it ends.
+ **/
+template <class Sink>
+bool PathStreamParser<Sink>::feed(const char *data, size_t length)
+{
+    const char *s = data;
+    const char *end = data + length;
+    const char *split;
+
+    if (_failed)
+        return false;
+
+    if (_carry_length) {
+        /* Finish the token split by the last chunk first */
+        split = s;
+        if (!path_stream_can_split(_carry[_carry_length - 1], *split)) {
+            for (split++; split < end; split++) {
+                if (path_stream_can_split(split[-1], *split))
+                    break;
+            }
+        }
+        if (!carry(s, split - s))
+            return false;
+        if (split == end)
+            return true;
+        if (!parse_data(_carry, NULL)) {
+            _failed = true;
+            return false;
+        }
+        _carry_length = 0;
+        s = split;
+    }
+
+    if (s == end)
+        return true;
+
+    for (split = end; split > s; split--) {
+        if (path_stream_ends_token(split[-1]) ||
+            (split < end && path_stream_can_split(split[-1], *split)))
+            break;
+    }
+
+    if (split > s && !parse_data(s, split)) {
+        _failed = true;
+        return false;
+    }
+    return carry(split, end - split);
+}
+
+/**
+ * finish: Parse what is left after the last chunk.
+ *
+ * Returns: false if the data had an error.
+ **/
+template <class Sink>
+bool PathStreamParser<Sink>::finish()
+{
+    if (_failed)
+        return false;
+
+    if (_carry_length) {
+        if (!parse_data(_carry, NULL)) {
+            _failed = true;
+            return false;
+        }
+        _carry_length = 0;
+    }
+
+    if (param && cmd != 'm')
+        do_cmd (true);
+    param = 0;
+
+    return true;
+}
+
+/**
+ * parse: Parse a whole NUL terminated d attribute, then finish().
+ **/
+template <class Sink>
+bool PathStreamParser<Sink>::parse(const char *str)
+{
+    if (_failed || _carry_length)
+        return feed(str, strlen(str)) && finish();
+
+    if (!parse_data(str, NULL)) {
+        _failed = true;
+        return false;
+    }
+    return finish();
+}
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:encoding=utf-8:textwidth=99 :
@@ -21,17 +21,181 @@
 #include "path.h"
 
 #include <cairo.h>
+#include <new>
+#include <stdlib.h>
+
+PathArena::PathArena(size_t block_size)
+  : _blocks(NULL), _block_size(block_size), _allocated(0)
+{
+}
+
+PathArena::~PathArena()
+{
+  clear();
+}
+
+// Keeps allocations aligned for anything a path holds
+static inline size_t
+arena_round (size_t size)
+{
+  return (size + 15) & ~(size_t) 15;
+}
+
+/**
+ * Returns @size bytes from the arena, or NULL if out of memory.  Sizes
+ * bigger than a block get a block of their own.
+ */
+void *
+PathArena::alloc(size_t size)
+{
+  size_t header = arena_round(sizeof(Block));
+  Block *block = _blocks;
+
+  size = arena_round(size);
+  if (!block || block->used + size > block->size) {
+    size_t block_size = MAX(_block_size, size);
+
+    block = (Block *) malloc(header + block_size);
+    if (!block)
+      return NULL;
+    block->size = block_size;
+    block->used = 0;
+
+    // Keep filling the current block if the new one is just for this
+    if (_blocks && block_size > _block_size) {
+      block->next = _blocks->next;
+      _blocks->next = block;
+    } else {
+      block->next = _blocks;
+      _blocks = block;
+    }
+  }
+
+  void *p = (char *) block + header + block->used;
+  block->used += size;
+  _allocated += size;
+  return p;
+}
+
+void
+PathArena::clear()
+{
+  while (_blocks) {
+    Block *next = _blocks->next;
+    free(_blocks);
+    _blocks = next;
+  }
+  _allocated = 0;
+}
+
+Path::Path(PathArena *arena)
+  : segments(_inline), segment_count(0),
+    _capacity(PATH_INLINE_SEGMENTS), _arena(arena)
+{
+}
+
+Path::Path(Path &&other)
+  : segments(_inline), segment_count(0),
+    _capacity(PATH_INLINE_SEGMENTS), _arena(other._arena)
+{
+  take(other);
+}
 
 Path::~Path()
 {
-  /*
-    for (; --segment_count;)
-    g_free( segments[segment_count] );
-  */
+  if (is_heap())
+    free(segments);
 }
 
+Path &
+Path::operator=(Path &&other)
+{
+  if (this != &other) {
+    if (is_heap())
+      free(segments);
+    segments = _inline;
+    segment_count = 0;
+    _capacity = PATH_INLINE_SEGMENTS;
+    _arena = other._arena;
+    take(other);
+  }
+  return *this;
+}
+
+/*
+ * Moves other's segments into this empty path, stealing its buffer
+ * unless it's inline.  Leaves other empty.
+ */
 void
-Path::draw(cairo_t * cr)
+Path::take(Path &other)
+{
+  if (other.segments == other._inline) {
+    for (int i = 0; i < other.segment_count; i++)
+      _inline[i] = other._inline[i];
+  } else {
+    segments = other.segments;
+    _capacity = other._capacity;
+  }
+  segment_count = other.segment_count;
+
+  other.segments = other._inline;
+  other.segment_count = 0;
+  other._capacity = PATH_INLINE_SEGMENTS;
+}
+
+/**
+ * Makes room for at least @count segments.  Returns false if memory
+ * ran out, leaving the path as it was.
+ */
+bool
+Path::reserve(int count)
+{
+  PathSegment *buffer;
+
+  if (count <= _capacity)
+    return true;
+
+  if (_arena)
+    buffer = (PathSegment *) _arena->alloc(count * sizeof(PathSegment));
+  else
+    buffer = (PathSegment *) malloc(count * sizeof(PathSegment));
+  if (!buffer)
+    return false;
+
+  for (int i = 0; i < segment_count; i++)
+    new (&buffer[i]) PathSegment(segments[i]);
+
+  // Arena memory is only given back with the rest of the arena
+  if (is_heap())
+    free(segments);
+
+  segments = buffer;
+  _capacity = count;
+  return true;
+}
+
+/**
+ * Replaces this path's segments with a copy of @other's, allocating
+ * exactly as much as they need.
+ */
+bool
+Path::assign(const Path &other)
+{
+  if (&other == this)
+    return true;
+
+  segment_count = 0;
+  if (!reserve(other.segment_count))
+    return false;
+
+  for (int i = 0; i < other.segment_count; i++)
+    segments[i] = other.segments[i];
+  segment_count = other.segment_count;
+  return true;
+}
+
+void
+path_draw_segments(cairo_t * cr, const PathSegment *segments, int segment_count)
 {
   for (int i=0; i<segment_count; i++) {
     switch (segments[i].code) {
@@ -50,6 +214,8 @@ Path::draw(cairo_t * cr)
         cairo_line_to (cr, segments[i].pt[0], segments[i].pt[1]);
         break;
       case PATH_END:
+        // Written for 'z', so the subpath it ends is closed
+        cairo_close_path (cr);
         break;
       default:
         break;
@@ -57,19 +223,24 @@ Path::draw(cairo_t * cr)
   }
 }
 
+void
+Path::draw(cairo_t * cr)
+{
+  path_draw_segments (cr, segments, segment_count);
+}
+
 int
-Path::addSegment(PathSegment* p) {
-  if (segment_count >= MAX_SEGMENTS)
+Path::addSegment(const PathSegment &p) {
+  if (segment_count >= _capacity && !reserve(2 * _capacity))
     return 1;
 
-  segments[segment_count++] = *p;
+  segments[segment_count++] = p;
   return 0;
 }
 
 int
 Path::end() {
-  PathSegment *p = new PathSegment(PATH_END, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
-  return addSegment(p);
+  return addSegment(PathSegment(PATH_END, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0));
 }
 
 /*
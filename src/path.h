@@ -19,6 +19,8 @@
 #ifndef PATH_H
 #define PATH_H
 
+#include <stddef.h>
+
 #include "forward.h"
 #include "point.h"
 
@@ -45,34 +47,95 @@ public:
                 Coord x1, Coord y1,
                 Coord x2, Coord y2,
                 Coord x3, Coord y3)
-        : c1(x1, y1), c2(x2, y2), pt(x3, y3)
+        : code(c), c1(x1, y1), c2(x2, y2), pt(x3, y3)
 	{}
 
     PathSegment(Pathcode c, Coord x, Coord y)
-        : c1(0.0, 0.0), c2(0.0, 0.0), pt(x, y)
+        : code(c), c1(0.0, 0.0), c2(0.0, 0.0), pt(x, y)
 	{}
 
 };
 
 
-#define MAX_SEGMENTS (256)
+// Segments held in the Path itself before anything is allocated
+#define PATH_INLINE_SEGMENTS  (4)
+
+// Arena memory is handed out of blocks of this size
+#define PATH_ARENA_BLOCK_SIZE (16384)
+
+/*
+ * Bump allocator for path storage.  Everything allocated from an arena
+ * is packed together and freed at once when the arena is cleared or
+ * destroyed, so a whole asset set's paths cost one free.
+ */
+class PathArena {
+public:
+    PathArena(size_t block_size = PATH_ARENA_BLOCK_SIZE);
+    ~PathArena();
+
+    void  *alloc(size_t size);
+    void   clear();
+    size_t bytes_allocated() const { return _allocated; }
+
+private:
+    struct Block {
+        Block  *next;
+        size_t  size;
+        size_t  used;
+    };
+
+    Block  *_blocks;
+    size_t  _block_size;
+    size_t  _allocated;
+
+public:
+    PathArena(const PathArena &) = delete;
+    PathArena &operator=(const PathArena &) = delete;
+};
 
 /*
  * Analog to SPCurve in Inkscape
+ *
+ * Segments live in a small inline buffer until they outgrow it, then in
+ * heap memory, or in the path's arena if it was given one.  Paths can
+ * be moved but not copied; use assign() to copy segments explicitly.
  */
 class Path {
 public:
-    PathSegment   segments[MAX_SEGMENTS]; /// Array of path segments
+    PathSegment  *segments;               /// Array of path segments
     int           segment_count;          /// Number of segments
 
-    Path() {}
+    Path(PathArena *arena = NULL);
+    Path(Path &&other);
     ~Path();
 
+    Path &operator=(Path &&other);
+
+    int  capacity() const { return _capacity; }
+    bool reserve(int count);
+    bool assign(const Path &other);
+    void clear() { segment_count = 0; }
+
     void draw(cairo_t * cr);
-    int addSegment(PathSegment* p);
+    int addSegment(const PathSegment &p);
     int end();
+
+private:
+    int           _capacity;
+    PathArena    *_arena;
+    PathSegment   _inline[PATH_INLINE_SEGMENTS];
+
+    bool is_heap() const { return segments != _inline && !_arena; }
+    void take(Path &other);
+
+public:
+    Path(const Path &) = delete;
+    Path &operator=(const Path &) = delete;
 };
 
+void  path_draw_segments(cairo_t * cr, const PathSegment *segments, int segment_count);
+Path *sp_svg_read_path(char const *str, PathArena *arena = NULL);
+
 
 #endif
 
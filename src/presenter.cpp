@@ -0,0 +1,358 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "presenter.h"
+#include "debug.h"
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+struct PresenterImage
+{
+  Display          *display;
+  Window            window;
+  GC                gc;
+  XImage           *ximage;
+  XShmSegmentInfo   shm;
+  bool              use_shm;
+  cairo_surface_t  *surface;
+  int               width;
+  int               height;
+};
+
+static const char *present_mode_names[] = { "gdk", "shm", "image" };
+
+/* Returns false, leaving @mode alone, if @name isn't a mode */
+bool
+present_mode_from_string(const char *name, PresentMode *mode)
+{
+  for (int i = PRESENT_GDK; i <= PRESENT_IMAGE; i++) {
+    if (strcmp(name, present_mode_names[i]) == 0) {
+      *mode = (PresentMode) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *
+present_mode_to_string(PresentMode mode)
+{
+  return present_mode_names[mode];
+}
+
+/*
+ * Picks the mode that can actually be used when @wanted was asked for:
+ * the image modes need an image cairo can draw into, and without
+ * shared memory PRESENT_SHM becomes PRESENT_IMAGE.
+ */
+PresentMode
+present_mode_fallback(PresentMode wanted, const PresentSupport &support)
+{
+  if (wanted == PRESENT_GDK)
+    return PRESENT_GDK;
+  if (!support.image || !support.visual_matches)
+    return PRESENT_GDK;
+  if (wanted == PRESENT_SHM && !support.shm)
+    return PRESENT_IMAGE;
+  return wanted;
+}
+
+static bool shm_attach_failed = false;
+
+static int
+catch_shm_error (Display *, XErrorEvent *)
+{
+  shm_attach_failed = true;
+  return 0;
+}
+
+/*
+ * Cairo's RGB24 is a native endian 32 bit word with the top byte
+ * unused, so the image can only be handed to cairo if the server
+ * wants exactly that.
+ */
+static bool
+image_matches_cairo (XImage *ximage, Visual *visual)
+{
+  int one = 1;
+  int native_order = (*(char *) &one) ? LSBFirst : MSBFirst;
+
+  return (ximage->bits_per_pixel == 32 &&
+          ximage->byte_order == native_order &&
+          visual->red_mask == 0xff0000 &&
+          visual->green_mask == 0x00ff00 &&
+          visual->blue_mask == 0x0000ff);
+}
+
+static bool
+create_shm_image (PresenterImage *img, Visual *visual, int depth)
+{
+  Display *display = img->display;
+  XErrorHandler old_handler;
+
+  if (!XShmQueryExtension (display))
+    return false;
+
+  img->ximage = XShmCreateImage (display, visual, depth, ZPixmap, NULL, &img->shm,
+                                 img->width, img->height);
+  if (!img->ximage)
+    return false;
+
+  img->shm.shmid = shmget (IPC_PRIVATE, img->ximage->bytes_per_line * img->height,
+                           IPC_CREAT | 0600);
+  if (img->shm.shmid < 0) {
+    XDestroyImage (img->ximage);
+    img->ximage = NULL;
+    return false;
+  }
+
+  img->shm.shmaddr = img->ximage->data = (char *) shmat (img->shm.shmid, NULL, 0);
+  img->shm.readOnly = False;
+  if (img->shm.shmaddr == (char *) -1) {
+    shmctl (img->shm.shmid, IPC_RMID, NULL);
+    img->ximage->data = NULL;
+    XDestroyImage (img->ximage);
+    img->ximage = NULL;
+    return false;
+  }
+
+  // Remote displays refuse the attach with an X error, not a status
+  XSync (display, False);
+  shm_attach_failed = false;
+  old_handler = XSetErrorHandler (catch_shm_error);
+  XShmAttach (display, &img->shm);
+  XSync (display, False);
+  XSetErrorHandler (old_handler);
+
+  // Marked for removal now, so the segment goes away however we exit
+  shmctl (img->shm.shmid, IPC_RMID, NULL);
+
+  if (shm_attach_failed) {
+    shmdt (img->shm.shmaddr);
+    img->ximage->data = NULL;
+    XDestroyImage (img->ximage);
+    img->ximage = NULL;
+    return false;
+  }
+
+  img->use_shm = true;
+  return true;
+}
+
+static bool
+create_plain_image (PresenterImage *img, Visual *visual, int depth)
+{
+  img->ximage = XCreateImage (img->display, visual, depth, ZPixmap, 0, NULL,
+                              img->width, img->height, 32, 0);
+  if (!img->ximage)
+    return false;
+
+  // Freed along with the image by XDestroyImage
+  img->ximage->data = (char *) malloc (img->ximage->bytes_per_line * img->height);
+  if (!img->ximage->data) {
+    XDestroyImage (img->ximage);
+    img->ximage = NULL;
+    return false;
+  }
+
+  img->use_shm = false;
+  return true;
+}
+
+Presenter::Presenter()
+  : _mode(PRESENT_GDK), _image(NULL), _widget(NULL), _put_pending(false)
+{
+}
+
+Presenter::~Presenter()
+{
+  destroy_image();
+}
+
+void
+Presenter::set_mode(PresentMode mode)
+{
+  if (mode == _mode)
+    return;
+  destroy_image();
+  _mode = mode;
+}
+
+/*
+ * Sets up a client side image the size of the widget, trying shared
+ * memory first if the mode allows.  Downgrades _mode to whatever
+ * actually worked.
+ */
+bool
+Presenter::create_image(GtkWidget *widget, int width, int height)
+{
+  XWindowAttributes attrs;
+  PresentSupport support;
+  PresenterImage *img;
+  PresentMode mode;
+
+  if (width <= 0 || height <= 0)
+    return false;
+
+  img = new PresenterImage;
+  memset(img, 0, sizeof(*img));
+  img->display = GDK_WINDOW_XDISPLAY (widget->window);
+  img->window = GDK_WINDOW_XID (widget->window);
+  img->width = width;
+  img->height = height;
+
+  if (!XGetWindowAttributes (img->display, img->window, &attrs)) {
+    delete img;
+    return false;
+  }
+
+  support.shm = (_mode == PRESENT_SHM && create_shm_image (img, attrs.visual, attrs.depth));
+  support.image = support.shm || create_plain_image (img, attrs.visual, attrs.depth);
+  support.visual_matches = support.image && image_matches_cairo (img->ximage, attrs.visual);
+
+  mode = present_mode_fallback (_mode, support);
+  if (mode == PRESENT_GDK) {
+    if (support.image)
+      dbg ("%s: %d bit visual doesn't match cairo's image format\n", __func__, attrs.depth);
+    _image = img;
+    destroy_image();
+    return false;
+  }
+  if (mode != _mode)
+    dbg ("%s: MIT-SHM unavailable, using XPutImage\n", __func__);
+  _mode = mode;
+
+  // Anything outside the playfield is never drawn; keep it black
+  memset (img->ximage->data, 0, img->ximage->bytes_per_line * height);
+
+  img->gc = XCreateGC (img->display, img->window, 0, NULL);
+  img->surface = cairo_image_surface_create_for_data ((unsigned char *) img->ximage->data,
+                                                      CAIRO_FORMAT_RGB24, width, height,
+                                                      img->ximage->bytes_per_line);
+  _image = img;
+  _widget = widget;
+  return true;
+}
+
+void
+Presenter::destroy_image()
+{
+  PresenterImage *img = _image;
+
+  if (!img)
+    return;
+
+  if (img->surface)
+    cairo_surface_destroy (img->surface);
+  if (img->gc)
+    XFreeGC (img->display, img->gc);
+  if (img->ximage) {
+    if (img->use_shm) {
+      XShmDetach (img->display, &img->shm);
+      XSync (img->display, False);
+      shmdt (img->shm.shmaddr);
+      img->ximage->data = NULL;
+    }
+    XDestroyImage (img->ximage);
+  }
+
+  delete img;
+  _image = NULL;
+  _widget = NULL;
+  _put_pending = false;
+}
+
+/**
+ * Returns a cairo context to draw the next frame with.  Pass it to
+ * present() once the frame is complete, then destroy it.
+ */
+cairo_t *
+Presenter::begin(GtkWidget *widget)
+{
+  int width = widget->allocation.width;
+  int height = widget->allocation.height;
+
+  if (_mode == PRESENT_GDK)
+    return gdk_cairo_create (widget->window);
+
+  if (!_image || _widget != widget ||
+      _image->width != width || _image->height != height) {
+    destroy_image();
+    if (!create_image(widget, width, height)) {
+      dbg ("%s: falling back to drawing through GDK\n", __func__);
+      _mode = PRESENT_GDK;
+      gtk_widget_set_double_buffered (widget, TRUE);
+      return gdk_cairo_create (widget->window);
+    }
+  }
+
+  // About to draw over the segment the last frame was put from
+  if (_put_pending) {
+    XSync (_image->display, False);
+    _put_pending = false;
+  }
+
+  return cairo_create (_image->surface);
+}
+
+/**
+ * Puts a frame drawn with the context from begin() on the screen.  The
+ * caller still owns the context.
+ */
+void
+Presenter::present(cairo_t *cr)
+{
+  PresenterImage *img = _image;
+
+  if (img && cairo_get_target (cr) == img->surface) {
+    cairo_surface_flush (img->surface);
+
+    if (img->use_shm) {
+      XShmPutImage (img->display, img->window, img->gc, img->ximage,
+                    0, 0, 0, 0, img->width, img->height, False);
+      // The server reads the pixels in place; begin() waits for it
+      // before the next frame draws over them
+      _put_pending = true;
+    } else {
+      XPutImage (img->display, img->window, img->gc, img->ximage,
+                 0, 0, 0, 0, img->width, img->height);
+    }
+    XFlush (img->display);
+  }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,94 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PRESENTER_H__
+#define __PRESENTER_H__
+
+#include <gtk/gtk.h>
+
+#include "forward.h"
+
+typedef enum {
+  PRESENT_GDK,      /// Draw straight to the window through GDK
+  PRESENT_SHM,      /// Client side image in shared memory, else PRESENT_IMAGE
+  PRESENT_IMAGE     /// Client side image sent with a plain XPutImage
+} PresentMode;
+
+bool        present_mode_from_string(const char *name, PresentMode *mode);
+const char *present_mode_to_string(PresentMode mode);
+
+// What the display turned out to allow, once an image has been tried
+typedef struct
+{
+  bool shm;             /// A shared memory image could be attached
+  bool image;           /// Some client side image could be created
+  bool visual_matches;  /// The window's pixel format is cairo's RGB24
+} PresentSupport;
+
+PresentMode present_mode_fallback(PresentMode wanted, const PresentSupport &support);
+
+struct PresenterImage;
+
+/*
+ * Gets frames onto the screen.
+ *
+ * In the image modes each frame is rendered by cairo's image backend
+ * into client memory and sent to the window in a single request,
+ * instead of every fill becoming its own round of X protocol.  With
+ * MIT-SHM the server reads the pixels straight out of a shared segment.
+ * Anything that keeps the image path from working (no X11 window, an
+ * unusual visual, a remote display) silently drops back to the next
+ * mode down.
+ *
+ * The widget must not be double buffered by GTK when an image mode is
+ * in use, or GTK's backing store would paint over the presented frame.
+ */
+class Presenter {
+public:
+  Presenter();
+  ~Presenter();
+
+  void        set_mode(PresentMode mode);
+  PresentMode mode() const { return _mode; }
+
+  cairo_t    *begin(GtkWidget *widget);
+  void        present(cairo_t *cr);
+
+private:
+  PresentMode     _mode;
+  PresenterImage *_image;
+  GtkWidget      *_widget;
+  bool            _put_pending;   /// The server may still be reading the segment
+
+  bool create_image(GtkWidget *widget, int width, int height);
+  void destroy_image();
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
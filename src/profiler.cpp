@@ -0,0 +1,179 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "profiler.h"
+
+static const char *section_names[PROFILE_SECTIONS] = {
+  "tick",
+  "check_conditions",
+  "World::draw",
+  "update_scene",
+  "_draw_ship",
+  "_draw_missiles",
+  "_draw_rings",
+  "_draw_mines",
+  "DrawList::execute",
+  "draw_ui",
+  "frame",
+  "input latency",
+};
+
+const char *
+profile_section_name (ProfileSection section)
+{
+  return section_names[section];
+}
+
+gint64
+profile_now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * The first PROFILE_SUB_BUCKETS buckets hold single nanoseconds; after
+ * that each power of two gets PROFILE_SUB_BUCKETS of its own.
+ */
+int
+profile_bucket (guint64 nanos)
+{
+  int msb, shift;
+
+  if (nanos < PROFILE_SUB_BUCKETS)
+    return (int) nanos;
+
+  msb = 63 - __builtin_clzll (nanos);
+  if (msb >= PROFILE_MAX_BITS)
+    return PROFILE_BUCKETS - 1;
+
+  shift = msb - PROFILE_SUB_BITS;
+  return (shift + 1) * PROFILE_SUB_BUCKETS + (int) ((nanos >> shift) - PROFILE_SUB_BUCKETS);
+}
+
+/* Largest time that falls in a bucket */
+guint64
+profile_bucket_limit (int bucket)
+{
+  int shift, sub;
+
+  if (bucket < PROFILE_SUB_BUCKETS)
+    return bucket;
+
+  shift = bucket / PROFILE_SUB_BUCKETS - 1;
+  sub = bucket % PROFILE_SUB_BUCKETS;
+  return ((guint64) (PROFILE_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+Profiler::Profiler()
+{
+  reset();
+}
+
+void
+Profiler::reset()
+{
+  memset(_sections, 0, sizeof(_sections));
+}
+
+void
+Profiler::record(ProfileSection section, gint64 nanos)
+{
+  ProfileHistogram *h = &_sections[section];
+  guint64 n = nanos > 0 ? nanos : 0;
+
+  h->counts[profile_bucket(n)]++;
+  h->count++;
+  h->total += n;
+  if (n > h->max)
+    h->max = n;
+}
+
+/* Records the time since start and returns now, to start the next lap */
+gint64
+Profiler::lap(ProfileSection section, gint64 start)
+{
+  gint64 now = profile_now_ns();
+
+  record(section, now - start);
+  return now;
+}
+
+/* The time below which the given fraction of the samples fall, in ns */
+guint64
+Profiler::percentile(ProfileSection section, double fraction) const
+{
+  const ProfileHistogram *h = &_sections[section];
+  guint64 target, seen = 0;
+
+  if (h->count == 0)
+    return 0;
+
+  target = (guint64) ceil(fraction * h->count);
+  if (target < 1)
+    target = 1;
+
+  for (int i = 0; i < PROFILE_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= target)
+      return MIN(profile_bucket_limit(i), h->max);
+  }
+  return h->max;
+}
+
+void
+Profiler::dump(FILE *fp) const
+{
+  fprintf(fp, "%-18s %8s %9s %9s %9s %9s %9s  (microseconds)\n",
+          "section", "count", "mean", "p50", "p95", "p99", "max");
+
+  for (int i = 0; i < PROFILE_SECTIONS; i++) {
+    const ProfileHistogram *h = &_sections[i];
+    ProfileSection section = (ProfileSection) i;
+
+    if (h->count == 0)
+      continue;
+    fprintf(fp, "%-18s %8llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+            section_names[i], (unsigned long long) h->count,
+            h->total / 1000.0 / h->count,
+            percentile(section, 0.50) / 1000.0,
+            percentile(section, 0.95) / 1000.0,
+            percentile(section, 0.99) / 1000.0,
+            h->max / 1000.0);
+  }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
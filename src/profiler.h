@@ -0,0 +1,102 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <glib.h>
+
+#include <stdio.h>
+
+typedef enum {
+  PROFILE_TICK,
+  PROFILE_CHECK_CONDITIONS,
+  PROFILE_WORLD_DRAW,
+  PROFILE_UPDATE_SCENE,
+  PROFILE_DRAW_SHIP,
+  PROFILE_DRAW_MISSILES,
+  PROFILE_DRAW_RINGS,
+  PROFILE_DRAW_MINES,
+  PROFILE_DRAW_LIST,
+  PROFILE_DRAW_UI,
+  PROFILE_FRAME,            /// The whole expose handler
+  PROFILE_INPUT_LATENCY,    /// From a key event to the frame showing its tick
+  PROFILE_SECTIONS
+} ProfileSection;
+
+// Each power of two is split into this many buckets, so a bucket is
+// at most an eighth wider than its lower edge
+#define PROFILE_SUB_BITS     (3)
+#define PROFILE_SUB_BUCKETS  (1 << PROFILE_SUB_BITS)
+
+// Times up to 2^PROFILE_MAX_BITS ns, about a minute; longer ones land
+// in the last bucket
+#define PROFILE_MAX_BITS     (36)
+#define PROFILE_BUCKETS      ((PROFILE_MAX_BITS - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+typedef struct
+{
+  guint64  counts[PROFILE_BUCKETS];
+  guint64  count;
+  guint64  total;           /// ns
+  guint64  max;             /// ns
+} ProfileHistogram;
+
+gint64 profile_now_ns(void);
+
+int     profile_bucket(guint64 nanos);
+guint64 profile_bucket_limit(int bucket);
+
+/*
+ * Log-scale histograms of how long each part of a tick or frame takes,
+ * and how long input takes to show, timed with CLOCK_MONOTONIC.
+ * Recording is a few adds into a fixed table, cheap enough to leave on
+ * all the time.  Percentiles come out as the top of the bucket they
+ * fall in, capped at the largest time seen.
+ */
+class Profiler {
+public:
+  Profiler();
+
+  void    record(ProfileSection section, gint64 nanos);
+  gint64  lap(ProfileSection section, gint64 start);
+  void    reset();
+
+  const ProfileHistogram &histogram(ProfileSection section) const { return _sections[section]; }
+  guint64 percentile(ProfileSection section, double fraction) const;
+  void    dump(FILE *fp) const;
+
+private:
+  ProfileHistogram _sections[PROFILE_SECTIONS];
+};
+
+const char *profile_section_name(ProfileSection section);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
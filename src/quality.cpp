@@ -0,0 +1,164 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quality.h"
+#include "game-math.h"
+
+#include <cairo.h>
+#include <string.h>
+
+// Drop a tier once smoothed frame time exceeds this share of the budget
+#define QUALITY_DOWNGRADE_LOAD (0.8)
+// Consider a tier upgrade only while below this share of the budget
+#define QUALITY_UPGRADE_LOAD   (0.4)
+
+#define QUALITY_DOWNGRADE_FRAMES      (5)
+#define QUALITY_MIN_UPGRADE_FRAMES    (50)
+#define QUALITY_MAX_UPGRADE_FRAMES    (1600)
+
+RenderQuality render_quality = QUALITY_HIGH;
+bool          render_simple_outlines = false;
+
+static const char *quality_names[] = { "low", "medium", "high", "auto" };
+
+// Auto mode steps through these, best first
+static const struct {
+  RenderQuality tier;
+  double        resolution;
+} quality_ladder[] = {
+  { QUALITY_HIGH,   1.0  },
+  { QUALITY_MEDIUM, 1.0  },
+  { QUALITY_MEDIUM, 0.75 },
+  { QUALITY_LOW,    0.75 },
+  { QUALITY_LOW,    0.5  },
+};
+#define QUALITY_LADDER_STEPS ((int) (sizeof(quality_ladder) / sizeof(quality_ladder[0])))
+
+/* Returns false, leaving @q alone, if @name isn't a tier */
+bool
+quality_from_string(const char *name, RenderQuality *q)
+{
+  for (int i = QUALITY_LOW; i <= QUALITY_AUTO; i++) {
+    if (strcmp(name, quality_names[i]) == 0) {
+      *q = (RenderQuality) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *
+quality_to_string(RenderQuality q)
+{
+  return quality_names[q];
+}
+
+QualityController::QualityController(double budget_millis)
+  : _budget(budget_millis),
+    _average(0.0),
+    _mode(QUALITY_AUTO),
+    _tier(QUALITY_HIGH),
+    _resolution(1.0),
+    _step(0),
+    _frames_over(0),
+    _frames_under(0),
+    _frames_since_upgrade(0),
+    _upgrade_wait(QUALITY_MIN_UPGRADE_FRAMES),
+    _upgraded(false)
+{
+}
+
+void
+QualityController::set_mode(RenderQuality q)
+{
+  _mode = q;
+  _tier = (q == QUALITY_AUTO) ? QUALITY_HIGH : q;
+  _resolution = 1.0;
+  _step = 0;
+  _frames_over = 0;
+  _frames_under = 0;
+  _upgraded = false;
+}
+
+void
+QualityController::frame_finished(double millis)
+{
+  // Exponential moving average, weighted 1/8 towards the newest frame
+  _average += (millis - _average) / 8.0;
+  _frames_since_upgrade++;
+
+  if (_mode != QUALITY_AUTO)
+    return;
+
+  if (_average > _budget * QUALITY_DOWNGRADE_LOAD) {
+    _frames_under = 0;
+    if (++_frames_over < QUALITY_DOWNGRADE_FRAMES || _step == QUALITY_LADDER_STEPS - 1)
+      return;
+
+    // Backing off right after an upgrade means we were too eager; a
+    // run of downgrades, as at startup, doesn't
+    if (_upgraded && _frames_since_upgrade < _upgrade_wait)
+      _upgrade_wait = MIN(_upgrade_wait * 2, QUALITY_MAX_UPGRADE_FRAMES);
+
+    _step++;
+    _frames_over = 0;
+    _upgraded = false;
+  } else if (_average < _budget * QUALITY_UPGRADE_LOAD) {
+    _frames_over = 0;
+    if (++_frames_under < _upgrade_wait || _step == 0)
+      return;
+
+    _step--;
+    _frames_under = 0;
+    _frames_since_upgrade = 0;
+    _upgraded = true;
+  } else {
+    _frames_over = 0;
+    _frames_under = 0;
+    return;
+  }
+
+  _tier = quality_ladder[_step].tier;
+  _resolution = quality_ladder[_step].resolution;
+}
+
+/*
+ * Publishes the current tier to the drawing code and sets up the
+ * cairo context for it.  Must be called at the start of each frame.
+ */
+void
+QualityController::apply(cairo_t *cr, double zoom)
+{
+  render_quality = _tier;
+  render_simple_outlines = (_tier == QUALITY_LOW) || (zoom < SIMPLE_OUTLINE_ZOOM);
+
+  cairo_set_antialias (cr, (_tier == QUALITY_LOW) ?
+                       CAIRO_ANTIALIAS_FAST : CAIRO_ANTIALIAS_DEFAULT);
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,92 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __QUALITY_H__
+#define __QUALITY_H__
+
+#include "forward.h"
+
+typedef enum {
+  QUALITY_LOW,      /// Flat fills, fast antialiasing, simplified outlines
+  QUALITY_MEDIUM,   /// Gradients, but only one turning flare layer
+  QUALITY_HIGH,     /// Everything at full quality
+  QUALITY_AUTO      /// Pick one of the above from measured frame time
+} RenderQuality;
+
+// Below this debug zoom, ship outlines are drawn as plain polygons
+#define SIMPLE_OUTLINE_ZOOM (0.6)
+
+// Render state consulted by the draw_* routines for the current frame
+extern RenderQuality render_quality;
+extern bool          render_simple_outlines;
+
+bool          quality_from_string(const char *name, RenderQuality *q);
+const char   *quality_to_string(RenderQuality q);
+
+/*
+ * Picks a render quality tier and internal resolution from the time
+ * taken to draw recent frames.
+ *
+ * In auto mode the controller walks a ladder of tier and resolution
+ * pairs.  Frame times are smoothed; it steps down quickly once the
+ * smoothed time eats most of the frame budget, and climbs back slowly
+ * when there is plenty of headroom.  An upgrade that immediately has to
+ * be undone doubles the wait before the next attempt, so a machine
+ * sitting right at a step boundary doesn't flicker between the two.
+ * A fixed tier always renders at full resolution.
+ */
+class QualityController {
+public:
+  QualityController(double budget_millis);
+
+  void          set_mode(RenderQuality q);
+  RenderQuality mode() const { return _mode; }
+  RenderQuality tier() const { return _tier; }
+  double        resolution() const { return _resolution; }
+  double        average_millis() const { return _average; }
+
+  void          frame_finished(double millis);
+  void          apply(cairo_t *cr, double zoom);
+
+private:
+  double        _budget;
+  double        _average;
+  RenderQuality _mode;
+  RenderQuality _tier;
+  double        _resolution;
+  int           _step;
+  int           _frames_over;
+  int           _frames_under;
+  int           _frames_since_upgrade;
+  int           _upgrade_wait;
+  bool          _upgraded;            /// The last step was up, not down
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,251 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cairo.h>
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "render-counters.h"
+
+typedef struct
+{
+  const char   *name;
+  RenderCounts  counts;         /// Since the last reset
+} RenderCaller;
+
+static RenderCaller callers[MAX_RENDER_CALLERS];
+static int          num_callers = 0;
+static RenderCaller other_callers = { "(other callers)", {} };
+
+static RenderCounts this_frame;
+static RenderCounts last_frame;
+static long         frames = 0;   /// Since the last reset
+
+/*
+ * Callers are told apart by the address of their name, which is
+ * G_STRFUNC.  Calls come in runs from the same function, so the last
+ * one found is tried first.
+ */
+static RenderCaller *
+find_caller (const char *name)
+{
+  static RenderCaller *last = NULL;
+
+  if (last && last->name == name)
+    return last;
+  for (int i = 0; i < num_callers; i++)
+    if (callers[i].name == name)
+      return last = &callers[i];
+  if (num_callers >= MAX_RENDER_CALLERS)
+    return &other_callers;
+
+  last = &callers[num_callers++];
+  last->name = name;
+  return last;
+}
+
+static void
+add (const char *caller, RenderCall call, double pixels)
+{
+  RenderCaller *c = find_caller (caller);
+
+  c->counts.calls[call]++;
+  c->counts.pixels += pixels;
+  this_frame.calls[call]++;
+  this_frame.pixels += pixels;
+}
+
+/* The device space bounding box of a user space rectangle, within the clip */
+static double
+device_area (cairo_t *cr, double x1, double y1, double x2, double y2)
+{
+  double cx1, cy1, cx2, cy2;
+  double xs[4], ys[4];
+
+  cairo_clip_extents (cr, &cx1, &cy1, &cx2, &cy2);
+  x1 = MAX(x1, cx1);
+  y1 = MAX(y1, cy1);
+  x2 = MIN(x2, cx2);
+  y2 = MIN(y2, cy2);
+  if (x2 <= x1 || y2 <= y1)
+    return 0;
+
+  xs[0] = xs[3] = x1;  ys[0] = ys[1] = y1;
+  xs[1] = xs[2] = x2;  ys[2] = ys[3] = y2;
+  for (int i = 0; i < 4; i++)
+    cairo_user_to_device (cr, &xs[i], &ys[i]);
+
+  return (*std::max_element (xs, xs + 4) - *std::min_element (xs, xs + 4)) *
+    (*std::max_element (ys, ys + 4) - *std::min_element (ys, ys + 4));
+}
+
+bool
+render_counters_enabled (void)
+{
+#ifdef COUNT_CAIRO_CALLS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+render_count (const char *caller, RenderCall call)
+{
+  add (caller, call, 0);
+}
+
+/* Counts a fill, stroke or paint, about to be made with the current path */
+void
+render_count_area (cairo_t *cr, const char *caller, RenderCall call)
+{
+  double x1, y1, x2, y2;
+
+  if (call == RENDER_FILL)
+    cairo_fill_extents (cr, &x1, &y1, &x2, &y2);
+  else if (call == RENDER_STROKE)
+    cairo_stroke_extents (cr, &x1, &y1, &x2, &y2);
+  else
+    cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  add (caller, call, device_area (cr, x1, y1, x2, y2));
+}
+
+/* Makes the counts so far the last frame's, and starts the next one */
+void
+render_counters_end_frame (void)
+{
+  last_frame = this_frame;
+  memset (&this_frame, 0, sizeof (this_frame));
+  frames++;
+}
+
+const RenderCounts &
+render_counters_frame (void)
+{
+  return last_frame;
+}
+
+long
+render_counters_total (const RenderCounts &counts)
+{
+  long total = 0;
+
+  for (int i = 0; i < RENDER_CALLS; i++)
+    total += counts.calls[i];
+  return total;
+}
+
+/* Fills in the callers seen since the last reset, most pixels first */
+int
+render_counters_callers (const char **names, RenderCounts *counts, int max)
+{
+  RenderCaller *sorted[MAX_RENDER_CALLERS + 1];
+  int n = 0;
+
+  for (int i = 0; i < num_callers; i++)
+    if (render_counters_total (callers[i].counts))
+      sorted[n++] = &callers[i];
+  if (render_counters_total (other_callers.counts))
+    sorted[n++] = &other_callers;
+
+  std::sort (sorted, sorted + n, [] (const RenderCaller *a, const RenderCaller *b) {
+      if (a->counts.pixels != b->counts.pixels)
+        return a->counts.pixels > b->counts.pixels;
+      return render_counters_total (a->counts) > render_counters_total (b->counts);
+    });
+
+  n = std::min (n, max);
+  for (int i = 0; i < n; i++) {
+    names[i] = sorted[i]->name;
+    counts[i] = sorted[i]->counts;
+  }
+  return n;
+}
+
+void
+render_counters_reset (void)
+{
+  for (int i = 0; i < num_callers; i++)
+    memset (&callers[i].counts, 0, sizeof (RenderCounts));
+  memset (&other_callers.counts, 0, sizeof (RenderCounts));
+  frames = 0;
+}
+
+/* Just the function's name out of G_STRFUNC's signature */
+static void
+short_name (char *buf, size_t size, const char *name)
+{
+  const char *end = strchr (name, '(');
+  const char *start;
+
+  if (!end)
+    end = name + strlen (name);
+  for (start = end; start > name && start[-1] != ' ' && start[-1] != '*'; start--)
+    ;
+  snprintf (buf, size, "%.*s", (int) (end - start), start);
+}
+
+/* Prints each caller's counts per frame, averaged since the last reset */
+void
+render_counters_dump (FILE *fp)
+{
+  static const char *headings[RENDER_CALLS] = {
+    "save", "restore", "xform", "source", "pattern", "fill", "stroke", "paint", "text"
+  };
+  const char *names[MAX_RENDER_CALLERS + 1];
+  RenderCounts counts[MAX_RENDER_CALLERS + 1];
+  double divisor = frames ? frames : 1;
+  int n;
+
+  if (!render_counters_enabled ()) {
+    fprintf (fp, "Cairo calls aren't counted in this build\n");
+    return;
+  }
+
+  n = render_counters_callers (names, counts, MAX_RENDER_CALLERS + 1);
+  fprintf (fp, "cairo calls per frame, over %ld frames\n", frames);
+  fprintf (fp, "%-28s", "caller");
+  for (int c = 0; c < RENDER_CALLS; c++)
+    fprintf (fp, " %8s", headings[c]);
+  fprintf (fp, " %12s\n", "pixels");
+
+  for (int i = 0; i < n; i++) {
+    char name[64];
+    short_name (name, sizeof (name), names[i]);
+    fprintf (fp, "%-28s", name);
+    for (int c = 0; c < RENDER_CALLS; c++)
+      fprintf (fp, " %8.1f", counts[i].calls[c] / divisor);
+    fprintf (fp, " %12.0f\n", counts[i].pixels / divisor);
+  }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,80 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RENDER_COUNTERS_H__
+#define __RENDER_COUNTERS_H__
+
+#include <cairo.h>
+
+#include <stdio.h>
+
+// Distinct drawing functions counted; any more are lumped together
+#define MAX_RENDER_CALLERS  (64)
+
+typedef enum {
+  RENDER_SAVE,            /// cairo_save
+  RENDER_RESTORE,         /// cairo_restore
+  RENDER_TRANSFORM,       /// Changes to the current matrix
+  RENDER_SOURCE,          /// Changes to the source
+  RENDER_PATTERN,         /// Gradients created
+  RENDER_FILL,
+  RENDER_STROKE,
+  RENDER_PAINT,
+  RENDER_TEXT,            /// cairo_show_text
+  RENDER_CALLS
+} RenderCall;
+
+typedef struct
+{
+  long    calls[RENDER_CALLS];
+  double  pixels;         /// Device pixels under fills, strokes and paints
+} RenderCounts;
+
+/*
+ * Counts the cairo calls made by each drawing function, and how many
+ * pixels its fills, strokes and paints cover.  Areas are the device
+ * space bounding boxes of the operations, clipped, so they overestimate
+ * anything round or diagonal.
+ *
+ * The drawing code is counted by including "counted-cairo.h".  Without
+ * COUNT_CAIRO_CALLS nothing is counted, and every count stays at zero.
+ * Drawing happens on the main thread only.
+ */
+bool   render_counters_enabled(void);
+void   render_count(const char *caller, RenderCall call);
+void   render_count_area(cairo_t *cr, const char *caller, RenderCall call);
+void   render_counters_end_frame(void);
+const RenderCounts &render_counters_frame(void);
+long   render_counters_total(const RenderCounts &counts);
+int    render_counters_callers(const char **names, RenderCounts *counts, int max);
+void   render_counters_reset(void);
+void   render_counters_dump(FILE *fp);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,170 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scene-node.h"
+
+#include <string.h>
+
+long SceneNode::matrix_updates = 0;
+long SceneNode::matrix_reuses = 0;
+
+SceneNode::SceneNode()
+  : _pos(0, 0), _rotation(0.0), _scale(1.0),
+    _explicit(false), _dirty(true),
+    _parent(NULL), _first_child(NULL), _next_sibling(NULL),
+    _version(1), _parent_version(0)
+{
+  cairo_matrix_init_identity (&_local);
+  cairo_matrix_init_identity (&_world);
+}
+
+SceneNode::~SceneNode()
+{
+  if (_parent)
+    _parent->remove_child(this);
+
+  // Orphan the children; they belong to someone else
+  while (_first_child)
+    remove_child(_first_child);
+}
+
+void
+SceneNode::set_position(double x, double y)
+{
+  if (!_explicit && x == _pos[0] && y == _pos[1])
+    return;
+  _pos[0] = x;
+  _pos[1] = y;
+  _explicit = false;
+  _dirty = true;
+}
+
+void
+SceneNode::set_rotation(double radians)
+{
+  if (!_explicit && radians == _rotation)
+    return;
+  _rotation = radians;
+  _explicit = false;
+  _dirty = true;
+}
+
+void
+SceneNode::set_scale(double scale)
+{
+  if (!_explicit && scale == _scale)
+    return;
+  _scale = scale;
+  _explicit = false;
+  _dirty = true;
+}
+
+/*
+ * Sets the local matrix directly, e.g. the canvas transform on the
+ * root node.  Position, rotation and scale are ignored until one of
+ * them is set again.
+ */
+void
+SceneNode::set_matrix(const cairo_matrix_t *m)
+{
+  if (_explicit && memcmp(m, &_local, sizeof(cairo_matrix_t)) == 0)
+    return;
+  _local = *m;
+  _explicit = true;
+  _dirty = true;
+}
+
+void
+SceneNode::add_child(SceneNode *child)
+{
+  if (child->_parent)
+    child->_parent->remove_child(child);
+
+  child->_parent = this;
+  child->_next_sibling = _first_child;
+  child->_parent_version = 0;
+  _first_child = child;
+}
+
+void
+SceneNode::remove_child(SceneNode *child)
+{
+  SceneNode **link = &_first_child;
+
+  while (*link && *link != child)
+    link = &(*link)->_next_sibling;
+
+  if (!*link)
+    return;
+
+  *link = child->_next_sibling;
+  child->_parent = NULL;
+  child->_next_sibling = NULL;
+  child->_dirty = true;
+}
+
+/**
+ * Returns the node's local to device space matrix, recomputing it only
+ * if the node or one of its ancestors has changed.
+ */
+const cairo_matrix_t &
+SceneNode::world_matrix()
+{
+  bool changed = false;
+
+  if (_dirty) {
+    if (!_explicit) {
+      cairo_matrix_init_translate (&_local, _pos[0], _pos[1]);
+      cairo_matrix_rotate (&_local, _rotation);
+      cairo_matrix_scale (&_local, _scale, _scale);
+    }
+    _dirty = false;
+    changed = true;
+  }
+
+  if (_parent) {
+    const cairo_matrix_t &parent_world = _parent->world_matrix();
+    if (changed || _parent_version != _parent->_version) {
+      cairo_matrix_multiply (&_world, &_local, &parent_world);
+      _parent_version = _parent->_version;
+      changed = true;
+    }
+  } else if (changed) {
+    _world = _local;
+  }
+
+  if (changed) {
+    _version++;
+    matrix_updates++;
+  } else {
+    matrix_reuses++;
+  }
+  return _world;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,95 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCENE_NODE_H__
+#define __SCENE_NODE_H__
+
+#include <cairo.h>
+
+#include "forward.h"
+#include "point.h"
+
+/*
+ * A node in the retained scene graph.
+ *
+ * Each node has a position, rotation and scale relative to its parent,
+ * and caches both its local matrix and its world (device space) matrix.
+ * The setters only mark the node dirty when a value actually changes,
+ * and a node only recomputes its world matrix when it is dirty or its
+ * parent's world matrix has changed since the last time, so items that
+ * don't move cost nothing to re-transform.
+ *
+ * Children are kept in an intrusive list; adding and removing nodes
+ * never allocates.  The graph does not own its nodes.
+ */
+class SceneNode {
+public:
+  SceneNode();
+  virtual ~SceneNode();
+
+  void set_position(double x, double y);
+  void set_rotation(double radians);
+  void set_scale(double scale);
+  void set_matrix(const cairo_matrix_t *m);
+
+  const Point &position() const { return _pos; }
+  double       rotation() const { return _rotation; }
+  double       scale() const { return _scale; }
+
+  void add_child(SceneNode *child);
+  void remove_child(SceneNode *child);
+  SceneNode *parent() const { return _parent; }
+  SceneNode *first_child() const { return _first_child; }
+  SceneNode *next_sibling() const { return _next_sibling; }
+
+  const cairo_matrix_t &world_matrix();
+
+  // Number of world matrices recomputed and reused, for statistics
+  static long matrix_updates;
+  static long matrix_reuses;
+
+private:
+  Point           _pos;
+  double          _rotation;
+  double          _scale;
+  bool            _explicit;       /// Local matrix was given by set_matrix()
+  bool            _dirty;          /// Local matrix needs recomputing
+
+  SceneNode      *_parent;
+  SceneNode      *_first_child;
+  SceneNode      *_next_sibling;
+
+  cairo_matrix_t  _local;
+  cairo_matrix_t  _world;
+  unsigned int    _version;        /// Bumped whenever _world changes
+  unsigned int    _parent_version; /// Parent's _version that _world used
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
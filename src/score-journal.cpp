@@ -0,0 +1,265 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "debug.h"
+#include "score-journal.h"
+
+/* FNV-1a, enough to spot an entry torn by a crash */
+static guint32
+record_checksum(const ScoreRecord *rec)
+{
+  const unsigned char *p = (const unsigned char *) rec;
+  guint32 hash = 2166136261u;
+
+  for (size_t i = 0; i < sizeof(*rec); i++) {
+    hash ^= p[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* Whether fd is still the file at filename, and not one moved aside */
+static bool
+is_file(int fd, const char *filename)
+{
+  struct stat fd_st, st;
+
+  return fstat(fd, &fd_st) == 0 && stat(filename, &st) == 0 &&
+    fd_st.st_dev == st.st_dev && fd_st.st_ino == st.st_ino;
+}
+
+ScoreJournal::ScoreJournal()
+  : _filename(NULL),
+    _aside_filename(NULL),
+    _fd(-1)
+{
+}
+
+ScoreJournal::~ScoreJournal()
+{
+  close();
+}
+
+bool
+ScoreJournal::open(const char *filename)
+{
+  close();
+
+  _fd = ::open(filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (_fd < 0)
+    return false;
+  _filename = g_strdup (filename);
+  _aside_filename = g_strdup_printf ("%s.folding", filename);
+  return true;
+}
+
+void
+ScoreJournal::close()
+{
+  if (_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+  g_free (_filename);
+  g_free (_aside_filename);
+  _filename = NULL;
+  _aside_filename = NULL;
+}
+
+/* Carries on in the journal that replaces one drain() moved aside */
+bool
+ScoreJournal::reopen()
+{
+  ::close(_fd);
+  _fd = ::open(_filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  return _fd >= 0;
+}
+
+/*
+ * Adds a finished game to the end of the journal.  Fails, rather than
+ * wait, while drain() is moving the journal aside.
+ */
+bool
+ScoreJournal::append(const Score &score)
+{
+  ScoreJournalEntry entry;
+  ssize_t written;
+
+  if (_fd < 0)
+    return false;
+
+  memset(&entry, 0, sizeof(entry));
+  entry.magic = SCORE_JOURNAL_MAGIC;
+  score.to_record(&entry.record);
+  entry.checksum = record_checksum(&entry.record);
+
+  // The lock only keeps the entry out of a journal that was moved aside
+  for (int tries = 0; ; tries++) {
+    if (flock(_fd, LOCK_SH | LOCK_NB) < 0)
+      return false;
+    if (is_file(_fd, _filename))
+      break;
+    flock(_fd, LOCK_UN);
+    if (tries > 0 || !reopen())
+      return false;
+  }
+
+  do {
+    written = write(_fd, &entry, sizeof(entry));
+  } while (written < 0 && errno == EINTR);
+  flock(_fd, LOCK_UN);
+
+  return written == (ssize_t) sizeof(entry);
+}
+
+/*
+ * Renames the journal aside, once no append is under way, unless a
+ * batch is aside already.  Returns 1 if it did, 0 if there was nothing
+ * to move, or -1 on error.
+ */
+int
+ScoreJournal::move_aside()
+{
+  struct stat st;
+  int fd, moved = 0;
+
+  fd = ::open(_filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return errno == ENOENT ? 0 : -1;
+
+  if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+    moved = -1;
+  } else if (st.st_size > 0 && is_file(fd, _filename) &&
+             access(_aside_filename, F_OK) < 0) {
+    moved = rename(_filename, _aside_filename) < 0 ? -1 : 1;
+  }
+
+  flock(fd, LOCK_UN);
+  ::close(fd);
+  return moved;
+}
+
+/*
+ * Hands every intact record moved aside to func, and deletes them if
+ * func returns true.  Returns the number handed over, or -1 on error.
+ */
+int
+ScoreJournal::fold_aside(ScoreJournalFunc func, gpointer user_data)
+{
+  ScoreJournalEntry *entries = NULL;
+  ScoreRecord *records = NULL;
+  struct stat st;
+  int fd, n, count = 0;
+  ssize_t got = 0;
+
+  fd = ::open(_aside_filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return errno == ENOENT ? 0 : -1;
+
+  // Only another drain() waits here, and then finds the batch gone
+  if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  if (!is_file(fd, _aside_filename)) {
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return 0;
+  }
+
+  // A torn entry at the end is dropped along with the rest
+  n = st.st_size / sizeof(ScoreJournalEntry);
+  if (n > 0) {
+    entries = g_new (ScoreJournalEntry, n);
+    records = g_new (ScoreRecord, n);
+    got = pread(fd, entries, n * sizeof(ScoreJournalEntry), 0);
+  }
+
+  if (got < 0) {
+    count = -1;
+  } else {
+    n = got / sizeof(ScoreJournalEntry);
+    for (int i = 0; i < n; i++) {
+      if (entries[i].magic == SCORE_JOURNAL_MAGIC &&
+          entries[i].checksum == record_checksum(&entries[i].record))
+        records[count++] = entries[i].record;
+      else
+        dbg("Dropping damaged journal entry %d of %s\n", i, _aside_filename);
+    }
+
+    if ((st.st_size == 0 || func(records, count, user_data)) &&
+        unlink(_aside_filename) < 0)
+      perror(_aside_filename);
+  }
+
+  flock(fd, LOCK_UN);
+  ::close(fd);
+  g_free (records);
+  g_free (entries);
+  return count;
+}
+
+/**
+ * Hands every intact record in the journal to func, and deletes those
+ * it takes.  A batch left aside by a crash, or not taken last time,
+ * goes first.  Then the journal is moved aside and folded in, while
+ * appends carry on in a new one.
+ *
+ * Returns the number of records handed over, or -1 on error.
+ */
+int
+ScoreJournal::drain(ScoreJournalFunc func, gpointer user_data)
+{
+  int left, moved, count;
+
+  if (!_filename)
+    return -1;
+
+  left = fold_aside(func, user_data);
+  if (left < 0)
+    return -1;
+
+  moved = move_aside();
+  if (moved <= 0)
+    return moved < 0 ? -1 : left;
+
+  count = fold_aside(func, user_data);
+  return count < 0 ? -1 : left + count;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
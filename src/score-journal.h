@@ -0,0 +1,91 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCORE_JOURNAL_H__
+#define __SCORE_JOURNAL_H__
+
+#include <glib.h>
+
+#include "score.h"
+
+// Starts every journal entry; bump if the entry layout changes
+#define SCORE_JOURNAL_MAGIC  (0x314a4353)     /// "SCJ1" read little endian
+
+typedef struct
+{
+  guint32      magic;
+  guint32      checksum;              /// Of the record
+  ScoreRecord  record;
+} ScoreJournalEntry;
+
+/*
+ * Called with every intact record in a batch of the journal, oldest
+ * first.  The batch is deleted if it returns true; if not, or after a
+ * crash, it is handed over again, so folding the same batch twice has
+ * to be harmless.
+ */
+typedef bool (*ScoreJournalFunc)(const ScoreRecord *records, int count, gpointer user_data);
+
+/*
+ * A write-ahead log of finished games, one fixed size entry each.
+ *
+ * Appending is a single write() to a file opened O_APPEND, so it takes
+ * the same time however long the journal is, and never waits: drain()
+ * renames the journal aside, to fold it in without holding up appends,
+ * and an append that finds it being moved fails rather than wait.  An
+ * entry torn by a crash fails its checksum and is dropped.
+ */
+class ScoreJournal {
+public:
+  ScoreJournal();
+  ~ScoreJournal();
+
+  bool open(const char *filename);
+  void close();
+  bool is_open() const { return _fd >= 0; }
+
+  bool append(const Score &score);
+  int  drain(ScoreJournalFunc func, gpointer user_data);
+
+private:
+  gchar *_filename;
+  gchar *_aside_filename;             /// The batch being folded in
+  int    _fd;
+
+  bool reopen();
+  int  move_aside();
+  int  fold_aside(ScoreJournalFunc func, gpointer user_data);
+
+public:
+  ScoreJournal(const ScoreJournal &) = delete;
+  ScoreJournal &operator=(const ScoreJournal &) = delete;
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
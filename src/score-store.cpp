@@ -0,0 +1,518 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "debug.h"
+#include "score-store.h"
+
+#define SCORE_STORE_MAGIC       "SCHS"
+#define SCORE_STORE_BYTE_ORDER  (0x01020304)
+
+static void
+table_init(ScoreTable *table)
+{
+  memset(table, 0, sizeof(*table));
+  memcpy(table->header.magic, SCORE_STORE_MAGIC, 4);
+  table->header.version = SCORE_STORE_VERSION;
+  table->header.byte_order = SCORE_STORE_BYTE_ORDER;
+  table->header.record_size = sizeof(ScoreRecord);
+  table->header.capacity = SCORE_STORE_CAPACITY;
+  table->header.count = 0;
+}
+
+static bool
+table_valid(const ScoreTable *table)
+{
+  return memcmp(table->header.magic, SCORE_STORE_MAGIC, 4) == 0 &&
+    table->header.version == SCORE_STORE_VERSION &&
+    table->header.byte_order == SCORE_STORE_BYTE_ORDER &&
+    table->header.record_size == sizeof(ScoreRecord) &&
+    table->header.capacity == SCORE_STORE_CAPACITY;
+}
+
+/* Records in use, trusting the header no further than the table's size */
+static int
+table_used(const ScoreTable *table)
+{
+  return MIN(table->header.count, (guint32) SCORE_STORE_CAPACITY);
+}
+
+/*
+ * Adds a record below any with an equal amount, dropping the lowest if
+ * the table is full.  Returns its position, or -1 if it doesn't fit.
+ */
+static int
+table_insert(ScoreTable *table, const ScoreRecord *rec)
+{
+  int lo, hi, mid, n;
+
+  n = table_used(table);
+  lo = 0;
+  hi = n;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (table->records[mid].amount >= rec->amount)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo >= SCORE_STORE_CAPACITY)
+    return -1;
+
+  if (n == SCORE_STORE_CAPACITY)
+    n--;
+  memmove(&table->records[lo + 1], &table->records[lo], (n - lo) * sizeof(ScoreRecord));
+  table->records[lo] = *rec;
+  table->header.count = n + 1;
+  return lo;
+}
+
+ScoreStore::ScoreStore()
+  : _filename(NULL),
+    _lock_fd(-1),
+    _fd(-1),
+    _table(NULL)
+{
+}
+
+ScoreStore::~ScoreStore()
+{
+  close();
+}
+
+/*
+ * Opens the score file, creating it if it doesn't exist.  A file that
+ * isn't a score file of this version is left alone and not opened.
+ */
+bool
+ScoreStore::open(const char *filename)
+{
+  gchar *lock_filename;
+  ScoreTable empty;
+  bool mapped;
+
+  close();
+
+  _filename = g_strdup (filename);
+  lock_filename = g_strdup_printf ("%s.lock", filename);
+  _lock_fd = ::open(lock_filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  g_free (lock_filename);
+
+  // Held exclusively so two processes don't both create the file
+  if (_lock_fd < 0 || !lock(LOCK_EX)) {
+    close();
+    return false;
+  }
+
+  if (!g_file_test (_filename, G_FILE_TEST_EXISTS)) {
+    table_init(&empty);
+    write_file(&empty);
+  }
+  mapped = map_file();
+  unlock();
+
+  if (!mapped)
+    close();
+  return mapped;
+}
+
+void
+ScoreStore::close()
+{
+  unmap_file();
+  if (_lock_fd >= 0)
+    ::close(_lock_fd);
+  g_free (_filename);
+
+  _lock_fd = -1;
+  _filename = NULL;
+}
+
+bool
+ScoreStore::map_file()
+{
+  struct stat st;
+  void *image;
+  int fd;
+
+  fd = ::open(_filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  if (fstat(fd, &st) < 0 || st.st_size != (off_t) sizeof(ScoreTable)) {
+    dbg("%s is not a score file\n", _filename);
+    ::close(fd);
+    return false;
+  }
+
+  image = mmap(NULL, sizeof(ScoreTable), PROT_READ, MAP_SHARED, fd, 0);
+  if (image == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+
+  if (!table_valid((const ScoreTable *) image)) {
+    dbg("%s is not a version %d score file\n", _filename, SCORE_STORE_VERSION);
+    munmap(image, sizeof(ScoreTable));
+    ::close(fd);
+    return false;
+  }
+
+  unmap_file();
+  _fd = fd;
+  _table = (const ScoreTable *) image;
+  return true;
+}
+
+void
+ScoreStore::unmap_file()
+{
+  if (_table)
+    munmap((void *) _table, sizeof(ScoreTable));
+  if (_fd >= 0)
+    ::close(_fd);
+
+  _table = NULL;
+  _fd = -1;
+}
+
+/* Maps the file again if another process has replaced it */
+bool
+ScoreStore::refresh()
+{
+  struct stat current, mapped;
+
+  if (_table && stat(_filename, &current) == 0 && fstat(_fd, &mapped) == 0 &&
+      current.st_ino == mapped.st_ino && current.st_dev == mapped.st_dev)
+    return true;
+
+  return map_file();
+}
+
+/*
+ * Replaces the file with a new table: writes a temporary file next to
+ * it, syncs that, renames it into place and syncs the directory.
+ */
+bool
+ScoreStore::write_file(const ScoreTable *table)
+{
+  gchar *temp_filename = g_strdup_printf ("%s.XXXXXX", _filename);
+  const char *data = (const char *) table;
+  size_t left = sizeof(*table);
+  ssize_t n;
+  bool ok;
+  int fd;
+
+  fd = g_mkstemp (temp_filename);
+  ok = (fd >= 0 && fchmod(fd, 0644) == 0);
+  while (ok && left > 0) {
+    n = write(fd, data, left);
+    if (n < 0 && errno == EINTR)
+      continue;
+    ok = (n > 0);
+    data += n;
+    left -= n;
+  }
+  ok = ok && fsync(fd) == 0;
+  if (fd >= 0)
+    ok = (::close(fd) == 0) && ok;
+  ok = ok && rename(temp_filename, _filename) == 0;
+
+  if (ok) {
+    gchar *dir = g_path_get_dirname (_filename);
+    int dir_fd = ::open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+      fsync(dir_fd);
+      ::close(dir_fd);
+    }
+    g_free (dir);
+  } else if (fd >= 0) {
+    unlink(temp_filename);
+  }
+
+  g_free (temp_filename);
+  return ok;
+}
+
+bool
+ScoreStore::lock(int operation)
+{
+  while (flock(_lock_fd, operation) < 0) {
+    if (errno != EINTR)
+      return false;
+  }
+  return true;
+}
+
+void
+ScoreStore::unlock()
+{
+  flock(_lock_fd, LOCK_UN);
+}
+
+int
+ScoreStore::count()
+{
+  int n = 0;
+
+  if (!_table || !lock(LOCK_SH))
+    return 0;
+  if (refresh())
+    n = table_used(_table);
+  unlock();
+  return n;
+}
+
+bool
+ScoreStore::get(int pos, Score *score)
+{
+  bool found = false;
+
+  if (!_table || pos < 0 || !lock(LOCK_SH))
+    return false;
+  if (refresh() && pos < table_used(_table)) {
+    score->from_record(&_table->records[pos]);
+    found = true;
+  }
+  unlock();
+  return found;
+}
+
+/* Scores must be higher than this to make the table */
+int
+ScoreStore::min_amount()
+{
+  int amount = 0;
+
+  if (!_table || !lock(LOCK_SH))
+    return 0;
+  if (refresh() && table_used(_table) == SCORE_STORE_CAPACITY)
+    amount = _table->records[SCORE_STORE_CAPACITY - 1].amount;
+  unlock();
+  return amount;
+}
+
+/**
+ * Adds a score below any equal to it, dropping the lowest score if the
+ * table is full.
+ *
+ * Returns its position from the top, or -1 if it didn't make the table
+ * or couldn't be saved.
+ */
+int
+ScoreStore::insert(const Score &score)
+{
+  ScoreTable table;
+  ScoreRecord rec;
+  int pos = -1;
+
+  if (!_table || score.amount() <= 0)
+    return -1;
+
+  score.to_record(&rec);
+  if (!lock(LOCK_EX))
+    return -1;
+
+  if (refresh()) {
+    table = *_table;
+    pos = table_insert(&table, &rec);
+    if (pos >= 0) {
+      if (write_file(&table))
+        map_file();
+      else
+        pos = -1;
+    }
+  }
+
+  unlock();
+  return pos;
+}
+
+/* True if the table already holds exactly this record */
+static bool
+table_contains(const ScoreTable *table, const ScoreRecord *rec)
+{
+  for (int i = 0; i < table_used(table); i++) {
+    if (memcmp(&table->records[i], rec, sizeof(ScoreRecord)) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Inserts a batch of records, replacing the score file once.  Records
+ * already in the table are skipped, so replaying a batch that was
+ * partly saved before does no harm.
+ *
+ * Returns how many made the table, or -1 if they couldn't be saved.
+ */
+int
+ScoreStore::insert_records(const ScoreRecord *records, int count)
+{
+  ScoreTable table;
+  int inserted = 0;
+
+  if (!_table || !lock(LOCK_EX))
+    return -1;
+
+  if (refresh()) {
+    table = *_table;
+    for (int i = 0; i < count; i++) {
+      if (records[i].amount <= 0 || table_contains(&table, &records[i]))
+        continue;
+      if (table_insert(&table, &records[i]) >= 0)
+        inserted++;
+    }
+    if (inserted > 0) {
+      if (write_file(&table))
+        map_file();
+      else
+        inserted = -1;
+    }
+  } else {
+    inserted = -1;
+  }
+
+  unlock();
+  return inserted;
+}
+
+/* Position of the record identical to rec, or -1 if it isn't there */
+int
+ScoreStore::find(const ScoreRecord *rec)
+{
+  int pos = -1;
+
+  if (!_table || !lock(LOCK_SH))
+    return -1;
+  if (refresh()) {
+    for (int i = 0; i < table_used(_table) && pos < 0; i++) {
+      if (memcmp(&_table->records[i], rec, sizeof(ScoreRecord)) == 0)
+        pos = i;
+    }
+  }
+  unlock();
+  return pos;
+}
+
+/**
+ * Inserts every score of a file in the text format, replacing the
+ * score file once at the end.
+ *
+ * Returns the number of scores that made the table, or -1 if the file
+ * couldn't be read.
+ */
+int
+ScoreStore::import_text(const char *filename)
+{
+  ScoreTable table;
+  ScoreRecord rec;
+  Score score;
+  int imported = 0;
+  FILE *fp;
+
+  if (!_table || !(fp = fopen(filename, "r")))
+    return -1;
+
+  if (!lock(LOCK_EX)) {
+    fclose(fp);
+    return -1;
+  }
+
+  if (refresh()) {
+    table = *_table;
+    while (!feof(fp) && !ferror(fp)) {
+      if (!score.read(fp) || score.amount() <= 0)
+        continue;
+      score.to_record(&rec);
+      if (table_insert(&table, &rec) >= 0)
+        imported++;
+    }
+    // A file that couldn't be read to the end isn't half imported
+    if (ferror(fp)) {
+      imported = -1;
+    } else if (imported > 0) {
+      if (write_file(&table))
+        map_file();
+      else
+        imported = -1;
+    }
+  }
+
+  unlock();
+  fclose(fp);
+  return imported;
+}
+
+/* Writes the table out in the text format */
+bool
+ScoreStore::export_text(const char *filename)
+{
+  ScoreTable table;
+  Score score;
+  FILE *fp;
+  bool copied = false;
+
+  if (!_table || !lock(LOCK_SH))
+    return false;
+  if (refresh()) {
+    table = *_table;
+    copied = true;
+  }
+  unlock();
+
+  if (!copied || !(fp = fopen(filename, "w")))
+    return false;
+
+  for (int i = 0; i < table_used(&table); i++) {
+    score.from_record(&table.records[i]);
+    score.write(fp);
+  }
+  return fclose(fp) == 0;
+}
+
+gchar *
+score_store_filename(void)
+{
+  return g_build_filename (g_get_user_data_dir (), "spacecastle", "scores.dat", NULL);
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
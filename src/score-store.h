@@ -0,0 +1,117 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCORE_STORE_H__
+#define __SCORE_STORE_H__
+
+#include <glib.h>
+
+#include <stddef.h>
+
+#include "score.h"
+
+// Bump whenever the layout of the score file changes
+#define SCORE_STORE_VERSION   (1)
+
+// Scores kept in the file; lower ones fall off the end
+#define SCORE_STORE_CAPACITY  (HighScores::MAX_SCORES)
+
+/*
+ * The score file's layout: a header followed by SCORE_STORE_CAPACITY
+ * records, the first count of which are in use, highest first.
+ */
+typedef struct
+{
+  char     magic[4];
+  guint32  version;
+  guint32  byte_order;                /// Reads as SCORE_STORE_BYTE_ORDER if native
+  guint32  record_size;               /// sizeof(ScoreRecord) when created
+  guint32  capacity;
+  guint32  count;
+  guint32  reserved[2];
+} ScoreStoreHeader;
+
+typedef struct
+{
+  ScoreStoreHeader header;
+  ScoreRecord      records[SCORE_STORE_CAPACITY];
+} ScoreTable;
+
+/*
+ * The high score table, kept in a binary file of fixed size records.
+ *
+ * The file is mapped shared and read in place.  Changes are made to a
+ * copy of the table, which is written to a temporary file, synced and
+ * renamed over the old one, so a crash leaves either the old table or
+ * the new one.  Every process that has the file open notices when it
+ * is replaced and maps the new one.  Access is serialized across
+ * processes by a flock() on a lock file beside it, shared for reading
+ * and exclusive for changes.
+ */
+class ScoreStore {
+public:
+  ScoreStore();
+  ~ScoreStore();
+
+  bool open(const char *filename);
+  void close();
+  bool is_open() const { return _table != NULL; }
+
+  int  count();
+  bool get(int pos, Score *score);
+  int  min_amount();
+  int  insert(const Score &score);
+  int  insert_records(const ScoreRecord *records, int count);
+  int  find(const ScoreRecord *rec);
+
+  int  import_text(const char *filename);
+  bool export_text(const char *filename);
+
+private:
+  gchar            *_filename;
+  int               _lock_fd;
+  int               _fd;
+  const ScoreTable *_table;           /// Mapped read only
+
+  bool lock(int operation);
+  void unlock();
+  bool refresh();
+  bool map_file();
+  void unmap_file();
+  bool write_file(const ScoreTable *table);
+
+public:
+  ScoreStore(const ScoreStore &) = delete;
+  ScoreStore &operator=(const ScoreStore &) = delete;
+};
+
+gchar *score_store_filename(void);
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,306 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "score-writer.h"
+#include "trace.h"
+
+typedef struct
+{
+  Score          score;
+  int            place;
+  int            rank;
+  int            games;
+  bool           journaled;           /// Or else saved straight to the table
+  ScoreSavedFunc done;
+  gpointer       user_data;
+} ScoreSaveRequest;
+
+ScoreWriter::ScoreWriter()
+  : _pool(NULL),
+    _filename(NULL),
+    _legacy_filename(NULL),
+    _history_filename(NULL),
+    _open_failed(false)
+{
+}
+
+ScoreWriter::~ScoreWriter()
+{
+  stop();
+}
+
+/*
+ * Opens the journal and starts the worker thread, which first folds in
+ * whatever a previous run left in the journal.
+ */
+bool
+ScoreWriter::start(const char *filename, const char *legacy_filename)
+{
+  gchar *dir, *journal_filename;
+
+  stop();
+
+  _filename = g_strdup (filename);
+  _legacy_filename = g_strdup (legacy_filename);
+  _open_failed = false;
+
+  dir = g_path_get_dirname (_filename);
+  g_mkdir_with_parents (dir, 0755);
+  _history_filename = g_build_filename (dir, "history.rec", NULL);
+  g_free (dir);
+
+  journal_filename = g_strdup_printf ("%s.journal", _filename);
+  if (!_journal.open(journal_filename))
+    dbg("Could not open score journal %s\n", journal_filename);
+  g_free (journal_filename);
+
+  _pool = g_thread_pool_new (run, this, 1, TRUE, NULL);
+  if (!_pool)
+    return false;
+
+  // Replays the journal; there's no score to save
+  ScoreSaveRequest *request = new ScoreSaveRequest;
+  request->place = -1;
+  request->rank = -1;
+  request->games = 0;
+  request->journaled = true;
+  request->done = NULL;
+  request->user_data = NULL;
+  g_thread_pool_push (_pool, request, NULL);
+  return true;
+}
+
+/* Waits for every score already handed over to be saved */
+void
+ScoreWriter::stop()
+{
+  if (_pool)
+    g_thread_pool_free (_pool, FALSE, TRUE);
+  _pool = NULL;
+
+  _journal.close();
+  _store.close();
+  _history.clear();
+  g_free (_filename);
+  g_free (_legacy_filename);
+  g_free (_history_filename);
+  _filename = NULL;
+  _legacy_filename = NULL;
+  _history_filename = NULL;
+}
+
+/*
+ * Appends the score to the journal, which is all the calling thread
+ * waits for, and has the worker fold it into the table.
+ */
+void
+ScoreWriter::save(const Score &score, ScoreSavedFunc done, gpointer user_data)
+{
+  ScoreSaveRequest *request;
+
+  if (!_pool)
+    return;
+
+  request = new ScoreSaveRequest;
+  request->score = score;
+  request->place = -1;
+  request->rank = -1;
+  request->games = 0;
+  request->journaled = _journal.append(score);
+  request->done = done;
+  request->user_data = user_data;
+  g_thread_pool_push (_pool, request, NULL);
+}
+
+/* Worker thread only */
+void
+ScoreWriter::open_store()
+{
+  if (!_store.open(_filename)) {
+    fprintf(stderr, "Could not open high scores in %s\n", _filename);
+    _open_failed = true;
+    return;
+  }
+
+  if (_legacy_filename && _store.count() == 0 &&
+      g_file_test (_legacy_filename, G_FILE_TEST_EXISTS)) {
+    int imported = _store.import_text(_legacy_filename);
+    dbg("Imported %d scores from %s\n", imported, _legacy_filename);
+  }
+
+  load_history();
+}
+
+/* Worker thread.  Ranks every game already in the history file. */
+void
+ScoreWriter::load_history()
+{
+  ScoreRecord records[256];
+  size_t n;
+  FILE *fp;
+
+  _history.clear();
+  fp = fopen(_history_filename, "rb");
+  if (!fp)
+    return;
+
+  while ((n = fread(records, sizeof(ScoreRecord), G_N_ELEMENTS(records), fp)) > 0) {
+    for (size_t i = 0; i < n; i++)
+      _history.insert(&records[i]);
+  }
+  fclose(fp);
+  dbg("Ranked %d games from %s\n", _history.count(), _history_filename);
+}
+
+/*
+ * Worker thread.  How many of records, from the first, already end the
+ * history file, as they do when a crash came after a batch was written
+ * there but before the journal let go of it.  Cuts off a record torn
+ * by a crash first, so the next ones line up.
+ */
+static int
+history_written(int fd, const ScoreRecord *records, int count)
+{
+  ScoreRecord *tail;
+  struct stat st;
+  off_t whole;
+  int n, written = 0;
+
+  if (fstat(fd, &st) < 0)
+    return 0;
+  whole = st.st_size - st.st_size % sizeof(ScoreRecord);
+  if (whole != st.st_size && ftruncate(fd, whole) < 0)
+    return 0;
+
+  n = MIN(count, (int) (whole / sizeof(ScoreRecord)));
+  if (n == 0)
+    return 0;
+  tail = g_new (ScoreRecord, n);
+  if (pread(fd, tail, n * sizeof(ScoreRecord), whole - n * sizeof(ScoreRecord)) ==
+      (ssize_t) (n * sizeof(ScoreRecord))) {
+    for (int k = n; k > 0 && !written; k--) {
+      if (memcmp(tail + n - k, records, k * sizeof(ScoreRecord)) == 0)
+        written = k;
+    }
+  }
+  g_free (tail);
+  return written;
+}
+
+/*
+ * Worker thread.  Keeps every game in the history file, which the
+ * spacecastle-scores tool can read, and the best in the table.  A
+ * batch folded twice is only kept once.
+ */
+bool
+ScoreWriter::fold(const ScoreRecord *records, int count, gpointer user_data)
+{
+  ScoreWriter *writer = (ScoreWriter *) user_data;
+  size_t size;
+  int fd, written = 0;
+
+  if (writer->_store.insert_records(records, count) < 0)
+    return false;
+
+  fd = open(writer->_history_filename, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd >= 0)
+    written = history_written(fd, records, count);
+  size = (count - written) * sizeof(ScoreRecord);
+  if (fd < 0 || write(fd, records + written, size) != (ssize_t) size)
+    perror(writer->_history_filename);
+  if (fd >= 0)
+    close(fd);
+
+  // What was written before is ranked already, by load_history()
+  for (int i = written; i < count; i++)
+    writer->_history.insert(&records[i]);
+  return true;
+}
+
+void
+ScoreWriter::run(gpointer data, gpointer user_data)
+{
+  ScoreSaveRequest *request = (ScoreSaveRequest *) data;
+  ScoreWriter *writer = (ScoreWriter *) user_data;
+  ScoreRecord rec;
+
+  trace_set_thread_name("score writer");
+  TRACE_ZONE("ScoreWriter::run");
+
+  if (!writer->_store.is_open() && !writer->_open_failed)
+    writer->open_store();
+
+  if (writer->_store.is_open()) {
+    // Earlier requests may have folded this one's entry in already
+    TRACE_BEGIN("fold journal");
+    writer->_journal.drain(fold, writer);
+    TRACE_END("fold journal");
+
+    if (request->score.amount() > 0) {
+      request->score.to_record(&rec);
+      // Without the journal it goes through the same steps, now
+      if (!request->journaled)
+        fold(&rec, 1, writer);
+      request->place = writer->_store.find(&rec);
+
+      // Equal scores rank in the order they came, so this one is last of them
+      if (writer->_history.count() > 0) {
+        request->rank = writer->_history.rank_of(rec.amount) - 1;
+        request->games = writer->_history.count();
+      }
+    }
+  }
+
+  if (request->done)
+    g_idle_add (report, request);
+  else
+    delete request;
+}
+
+/* Main loop */
+gboolean
+ScoreWriter::report(gpointer data)
+{
+  ScoreSaveRequest *request = (ScoreSaveRequest *) data;
+
+  request->done(&request->score, request->place, request->rank, request->games,
+                request->user_data);
+  delete request;
+  return FALSE;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
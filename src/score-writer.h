@@ -0,0 +1,94 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCORE_WRITER_H__
+#define __SCORE_WRITER_H__
+
+#include <glib.h>
+
+#include "leaderboard.h"
+#include "score.h"
+#include "score-journal.h"
+#include "score-store.h"
+
+/*
+ * Called on the main loop once a score has been saved, with its place
+ * in the table from the top, or -1 if it didn't make the table, and
+ * its rank from the top among all @games in the history, or -1.
+ */
+typedef void (*ScoreSavedFunc)(const Score *score, int place, int rank, int games,
+                               gpointer user_data);
+
+/*
+ * Saves scores without holding up a frame.  The calling thread only
+ * appends each game to a journal beside the score file; a background
+ * thread folds the journal into the ScoreStore and the history file,
+ * then empties it.  Every game in the history is ranked in a
+ * Leaderboard, so a score that misses the table still learns where it
+ * stands.
+ *
+ * Requests are handled one at a time, in order, by a single worker
+ * thread, which is the only thread that touches the ScoreStore.  Its
+ * first job is replaying anything left in the journal by a run that
+ * didn't finish, bringing over scores from the old text file if the
+ * store is new.  Results are posted back to the main loop with
+ * g_idle_add().
+ */
+class ScoreWriter {
+public:
+  ScoreWriter();
+  ~ScoreWriter();
+
+  bool start(const char *filename, const char *legacy_filename);
+  void save(const Score &score, ScoreSavedFunc done, gpointer user_data);
+  void stop();
+
+private:
+  GThreadPool *_pool;
+  ScoreJournal _journal;
+  ScoreStore   _store;
+  gchar       *_filename;
+  gchar       *_legacy_filename;
+  gchar       *_history_filename;     /// Every game ever saved, as ScoreRecords
+  Leaderboard  _history;              /// Ranks the history file
+  bool         _open_failed;
+
+  void open_store();
+  void load_history();
+  static bool fold(const ScoreRecord *records, int count, gpointer user_data);
+  static void run(gpointer data, gpointer user_data);
+  static gboolean report(gpointer data);
+
+public:
+  ScoreWriter(const ScoreWriter &) = delete;
+  ScoreWriter &operator=(const ScoreWriter &) = delete;
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -9,30 +9,30 @@
 #include <errno.h>
 #include <time.h>
 
+#include <charconv>
+#include <type_traits>
+
 /* ----------------------------------------------------------------------
  * Score
  * ---------------------------------------------------------------------- */
+static_assert(std::is_trivially_copyable<Score>::value, "Score must stay a plain value");
+
 Score::Score(void)
 {
     _amount = 0;
     _level = 0;
+    memset(&_timestamp, 0, sizeof(_timestamp));
     _initials[0] = '\0';
-    _str_rep = NULL;
-}
-
-Score::~Score(void)
-{
-    printf("~Score()\n");
-    if (_str_rep)
-        delete _str_rep;
+    _text[0] = '\0';
 }
 
+/* A score can only be recorded once */
 bool
 Score::record(int amt, int lvl, const char *who) {
-    if (amt < 0 || lvl < 0)
+    if (amt < 0 || lvl < 0 || is_recorded())
         return false;
     int j = 0;
-    for (int i=0; i < strlen(who); i++) {
+    for (int i=0; who[i] != '\0'; i++) {
         char c = who[i];
         /* Ignore non-printable characters */
         if (c == ' ')
@@ -47,6 +47,7 @@ Score::record(int amt, int lvl, const char *who) {
     time_t now = time(NULL);
     if (!localtime_r(&now, &_timestamp)) {
         perror("localtime_r");
+        memset(&_timestamp, 0, sizeof(_timestamp));
         return false;
     }
     _amount = amt;
@@ -55,84 +56,231 @@ Score::record(int amt, int lvl, const char *who) {
     return true;
 }
 
+/* Writes value with at least width digits, zero padded */
+static char *
+put_number(char *first, char *last, int value, int width)
+{
+    char digits[16];
+    std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), value);
+    int len = r.ptr - digits;
+    int pad = (value >= 0 && len < width) ? width - len : 0;
+
+    if (last - first < pad + len)
+        return NULL;
+    memset(first, '0', pad);
+    memcpy(first + pad, digits, len);
+    return first + pad + len;
+}
+
+static char *
+put_char(char *first, char *last, char c)
+{
+    if (!first || first == last)
+        return NULL;
+    *first = c;
+    return first + 1;
+}
+
+/**
+ * Writes the score's text form, newline included but not terminated,
+ * into [first, last).
+ *
+ * Returns the end of what was written, or NULL if the score is blank or
+ * doesn't fit.
+ */
+char *
+Score::to_chars(char *first, char *last) const {
+    const struct tm *t = &_timestamp;
+    char *p = first;
+    size_t initials_len = strlen(_initials);
+
+    if (_amount == 0)
+        return NULL;
+
+    p = put_number(p, last, t->tm_year + 1900, 4);
+    p = put_char(p, last, '-');
+    if (p) p = put_number(p, last, t->tm_mon + 1, 2);
+    p = put_char(p, last, '-');
+    if (p) p = put_number(p, last, t->tm_mday, 2);
+    p = put_char(p, last, '.');
+    if (p) p = put_number(p, last, t->tm_hour, 2);
+    p = put_char(p, last, ':');
+    if (p) p = put_number(p, last, t->tm_min, 2);
+    p = put_char(p, last, ':');
+    if (p) p = put_number(p, last, t->tm_sec, 2);
+    p = put_char(p, last, ' ');
+    if (!p || (size_t) (last - p) < initials_len)
+        return NULL;
+    memcpy(p, _initials, initials_len);
+    p = put_char(p + initials_len, last, ' ');
+    if (p) p = put_number(p, last, _level, 1);
+    p = put_char(p, last, ' ');
+    if (p) p = put_number(p, last, _amount, 1);
+    return put_char(p, last, '\n');
+}
+
+/* The text form, kept in the score itself; NULL if the score is blank */
 const char*
 Score::to_string(void) {
-    // TODO: Better name?
-    char date_str[80];
+    char *end = to_chars(_text, _text + sizeof(_text) - 1);
 
-    if (_amount == 0) {
+    if (!end)
         return NULL;
-    } else if (_str_rep == NULL) {
-        _str_rep = (char *)malloc(256);
-        if (strftime(date_str, sizeof(date_str), "%F.%T", &_timestamp) == 0) {
-            fprintf(stderr, "strftime could not format time\n");
-            return NULL;
-        }
-        snprintf(_str_rep, 256, "%s %s %d %d\n", date_str, _initials, _level, _amount);
+    *end = '\0';
+    return _text;
+}
+
+static const char *
+skip_blanks(const char *p, const char *last)
+{
+    while (p < last && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+/* Reads one to max_digits digits into a value between min and max */
+static const char *
+get_field(const char *p, const char *last, int max_digits, int min, int max, int *value)
+{
+    int v = 0, n = 0;
+
+    while (p < last && n < max_digits && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        n++;
     }
-    return _str_rep;
+    if (n == 0 || v < min || v > max)
+        return NULL;
+    *value = v;
+    return p;
+}
+
+static const char *
+get_char(const char *p, const char *last, char c)
+{
+    return (p && p < last && *p == c) ? p + 1 : NULL;
+}
+
+static const char *
+get_int(const char *p, const char *last, int *value)
+{
+    if (!p)
+        return NULL;
+    p = skip_blanks(p, last);
+    if (p < last && *p == '+')
+        p++;
+    std::from_chars_result r = std::from_chars(p, last, *value);
+    return r.ec == std::errc() ? r.ptr : NULL;
+}
+
+/**
+ * Reads a score in the text form from the start of [first, last).  The
+ * score is left alone unless the whole of it can be read.
+ *
+ * Returns the end of what was read, or NULL.
+ */
+const char *
+Score::from_chars(const char *first, const char *last) {
+    struct tm t;
+    int level, amount;
+    const char *p, *initials;
+    size_t initials_len;
+
+    memset(&t, 0, sizeof(t));
+    p = skip_blanks(first, last);
+    p = get_field(p, last, 4, 0, 9999, &t.tm_year);
+    p = get_char(p, last, '-');
+    if (p) p = get_field(p, last, 2, 1, 12, &t.tm_mon);
+    p = get_char(p, last, '-');
+    if (p) p = get_field(p, last, 2, 1, 31, &t.tm_mday);
+    p = get_char(p, last, '.');
+    if (p) p = get_field(p, last, 2, 0, 23, &t.tm_hour);
+    p = get_char(p, last, ':');
+    if (p) p = get_field(p, last, 2, 0, 59, &t.tm_min);
+    p = get_char(p, last, ':');
+    if (p) p = get_field(p, last, 2, 0, 61, &t.tm_sec);
+    if (!p || p == last || (*p != ' ' && *p != '\t'))
+        return NULL;
+
+    initials = p = skip_blanks(p, last);
+    while (p < last && *p > ' ')
+        p++;
+    if (p == initials)
+        return NULL;
+    initials_len = p - initials;
+    if (initials_len > MAX_INITIALS_STR - 1)
+        initials_len = MAX_INITIALS_STR - 1;
+
+    p = get_int(p, last, &level);
+    p = get_int(p, last, &amount);
+    if (!p)
+        return NULL;
+
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    _timestamp = t;
+    _level = level;
+    _amount = amount;
+    memcpy(_initials, initials, initials_len);
+    _initials[initials_len] = '\0';
+    return p;
 }
 
 bool
 Score::from_string(const char *str) {
-    int n, i, j;
-    char *date_str;
-    char *initials_str;
-    char *amount_str;
-
-    // printf("%s\n", str);
-    n = sscanf(str, "%ms %ms %d %d", &date_str, &initials_str, &_level, &_amount);
-    if (n == 4) {
-        if ( strptime(date_str, "%F.%T", &_timestamp) == NULL) {
-	    free(date_str);
-	    return false;
-	}
-        free(date_str);
-
-	j = 0;
-        for (i=0; i<strlen(initials_str); i++) {
-	    _initials[j++] = initials_str[i];
-	    if (j+1 >= MAX_INITIALS_STR)
-		break;
-	}
-    } else if (errno != 0) {
-        perror("scanf");
-        return false;
-    } else {
-        // fprintf(stderr, "Score could not be parsed: %s\n", str);
-        return false;
-    }
-    return true;
+    return from_chars(str, str + strlen(str)) != NULL;
+}
+
+void
+Score::to_record(ScoreRecord *rec) const {
+    struct tm when = _timestamp;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->amount = _amount;
+    rec->level = _level;
+    rec->timestamp = is_recorded() ? (int64_t) mktime(&when) : 0;
+    memcpy(rec->initials, _initials, MAX_INITIALS_STR);
+    rec->initials[MAX_INITIALS_STR - 1] = '\0';
+}
+
+void
+Score::from_record(const ScoreRecord *rec) {
+    time_t when = (time_t) rec->timestamp;
+
+    _amount = rec->amount;
+    _level = rec->level;
+    if (!localtime_r(&when, &_timestamp))
+        memset(&_timestamp, 0, sizeof(_timestamp));
+    memcpy(_initials, rec->initials, MAX_INITIALS_STR);
+    _initials[MAX_INITIALS_STR - 1] = '\0';
 }
 
-// TODO: Do I even need this?
 bool
-Score::write(FILE *fp) {
-    const char *s = to_string();
-    if (!s)
+Score::write(FILE *fp) const {
+    char line[MAX_SCORE_TEXT];
+    char *end = to_chars(line, line + sizeof(line));
+
+    if (!end)
         return false;
-    fprintf(fp, "%s", to_string());
-    return true;
+    return fwrite(line, 1, end - line, fp) == (size_t) (end - line);
 }
 
+/* Returns false at the end of the file or on a line that isn't a score */
 bool
 Score::read(FILE *fp) {
-    int n;
-    char *line = NULL;
-    size_t len = 0;
+    char line[MAX_SCORE_LINE];
 
-    n = getline(&line, &len, fp);
-    if (n > 0)
-        from_string(line);
-    free(line);
+    if (!fgets(line, sizeof(line), fp))
+        return false;
 
-    return true;
+    return from_string(line);
 }
 
 /* ----------------------------------------------------------------------
  * High Scores
  * ---------------------------------------------------------------------- */
 HighScores::HighScores(void)
+    : num_scores(0)
 {
 }
 
@@ -149,44 +297,42 @@ HighScores::~HighScores()
 int
 HighScores::insert(const Score& new_score)
 {
-    int dist = -1;
-    Score a, b;
-    bool inserted = false;
-    for (int i=0; i<HighScores::MAX_SCORES; i++) {
-        if (new_score.amount() > scores[i].amount()) {
-            if (!inserted) {
-                a = scores[i];
-                scores[i] = new_score;
-                dist = i;
-                inserted = true;
-            } else {
-                b = scores[i];
-                scores[i] = a;
-                a = b;
-
-                // Check if there's no more scores and return early
-                if (b.amount() <= 0)
-                    break;
-            }
-        }
-    }
-    return dist;
+    int pos = num_scores;
+
+    if (new_score.amount() <= 0)
+        return -1;
+
+    // Equal scores keep their order, the earlier one ranking higher
+    while (pos > 0 && new_score.amount() > scores[pos-1].amount())
+        pos--;
+    if (pos >= HighScores::MAX_SCORES)
+        return -1;
+
+    if (num_scores < HighScores::MAX_SCORES)
+        num_scores++;
+    for (int i = num_scores - 1; i > pos; i--)
+        scores[i] = scores[i-1];
+    scores[pos] = new_score;
+
+    return pos;
 }
 
 bool
 HighScores::load(const char *scores_path)
 {
-    int i = 0;
-
     FILE *fp = fopen(scores_path, "r");
     if (!fp)
         return false;
 
-    while (fp && (i<HighScores::MAX_SCORES))
-        scores[i++].read(fp);
+    num_scores = 0;
+    while (num_scores < HighScores::MAX_SCORES && !feof(fp) && !ferror(fp)) {
+        if (scores[num_scores].read(fp))
+            num_scores++;
+    }
 
+    bool ok = !ferror(fp);
     fclose(fp);
-    return true;
+    return ok;
 }
 
 bool
@@ -195,16 +341,22 @@ HighScores::save(const char *scores_path)
     /* TODO: Create path if necessary */
 
     FILE *fp = fopen(scores_path, "w");
+    if (!fp)
+        return false;
+
     for (int i=0; i<num_scores; i++) {
         scores[i].write(fp);
     }
-    fclose(fp);
+    return fclose(fp) == 0;
 }
 
+/* Positions past the last score read as an empty score */
 const Score&
 HighScores::get(int pos)
 {
-    if (pos > num_scores)
-        pos = num_scores - 1;
+    static const Score empty;
+
+    if (pos < 0 || pos >= num_scores)
+        return empty;
     return scores[pos];
 }
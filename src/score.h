@@ -19,30 +19,61 @@
 #ifndef __SCORE_H__
 #define __SCORE_H__
 
+#include <stdint.h>
 #include <stdio.h>
 #include <time.h>
 
 #define MAX_INITIALS_STR 4
 
+// Longest line of the text score format, including the newline
+#define MAX_SCORE_LINE   256
+
+// Room for any score Score::to_chars() can write, plus a terminator
+#define MAX_SCORE_TEXT   64
+
+/*
+ * A score as stored on disk, in host byte order.  The timestamp is in
+ * seconds since the epoch.
+ */
+typedef struct
+{
+  int32_t  amount;
+  int32_t  level;
+  int64_t  timestamp;
+  char     initials[MAX_INITIALS_STR];
+  char     reserved[4];
+} ScoreRecord;
+
+/*
+ * A plain value: it owns no memory and can be copied with memcpy.  The
+ * text form is "YYYY-MM-DD.HH:MM:SS initials level amount", in local
+ * time, and is written and read without allocating or consulting the
+ * locale.
+ */
 class Score {
  public:
   Score();
-  ~Score();
 
   bool record(int amt, int level, const char *who);
-  bool write(FILE *fp);
+  bool is_recorded() const { return _timestamp.tm_mday != 0; }
+  bool write(FILE *fp) const;
   bool read(FILE *fp);
   int  amount() const { return _amount; }
+  int  level() const { return _level; }
   int operator += (int amount) { return _amount += amount; }
   const char *to_string();
+  char *to_chars(char *first, char *last) const;
   bool from_string(const char *str);
+  const char *from_chars(const char *first, const char *last);
+  void to_record(ScoreRecord *rec) const;
+  void from_record(const ScoreRecord *rec);
 
  private:
   int         _amount;
   int         _level;
   struct tm   _timestamp;
   char        _initials[MAX_INITIALS_STR];
-  char       *_str_rep;
+  char        _text[MAX_SCORE_TEXT];     /// Filled in by to_string()
 };
 
 class HighScores {
@@ -56,6 +87,7 @@ public:
   bool load(const char *scores_path);
   bool save(const char *scores_path);
   const Score &get(int pos);
+  int count() const { return num_scores; }
 
 private:
   int   num_scores;
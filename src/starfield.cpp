@@ -0,0 +1,252 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "starfield.h"
+#include "counted-cairo.h"
+#include "drawing.h"
+
+#include <cairo.h>
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+static unsigned int
+hash_chunk (unsigned int seed, int layer, int cx, int cy)
+{
+  unsigned int h = seed ^ ((unsigned int) layer * 0x9e3779b9u);
+
+  h ^= (unsigned int) cx * 0x85ebca6bu;
+  h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+  h ^= (unsigned int) cy * 0x27d4eb2fu;
+  h = (h ^ (h >> 16)) * 0x85ebca6bu;
+  h ^= h >> 15;
+
+  // xorshift can't leave zero
+  return h ? h : 1;
+}
+
+// xorshift32, returning a value in [0, 1)
+static double
+next_random (unsigned int *state)
+{
+  unsigned int x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x / 4294967296.0;
+}
+
+Starfield::Starfield(unsigned int seed)
+  : _seed(seed), _num_layers(0), _cache(NULL), _cache_size(0),
+    _device_scale(0.0), _frame(0), _hits(0), _misses(0)
+{
+}
+
+Starfield::~Starfield()
+{
+  flush();
+  g_free(_cache);
+}
+
+/**
+ * Adds a layer in front of the existing ones.  Returns its index, or
+ * -1 if there are already STARFIELD_MAX_LAYERS.
+ */
+int
+Starfield::add_layer(double parallax, int stars_per_chunk,
+                     double min_scale, double max_scale, double brightness)
+{
+  if (_num_layers >= STARFIELD_MAX_LAYERS)
+    return -1;
+
+  StarfieldLayer *l = &_layers[_num_layers];
+  l->parallax = parallax;
+  l->stars_per_chunk = stars_per_chunk;
+  l->min_scale = min_scale;
+  l->max_scale = max_scale;
+  l->brightness = brightness;
+
+  flush();
+  return _num_layers++;
+}
+
+void
+Starfield::flush()
+{
+  for (int i = 0; i < _cache_size; i++) {
+    if (_cache[i].surface)
+      cairo_surface_destroy (_cache[i].surface);
+    _cache[i].surface = NULL;
+    _cache[i].layer = -1;
+  }
+}
+
+/* Makes room in the cache for at least @chunks; it never shrinks */
+void
+Starfield::reserve(int chunks)
+{
+  if (chunks <= _cache_size)
+    return;
+
+  _cache = g_renew(Chunk, _cache, chunks);
+  memset(&_cache[_cache_size], 0, (chunks - _cache_size) * sizeof(Chunk));
+  for (int i = _cache_size; i < chunks; i++)
+    _cache[i].layer = -1;
+  _cache_size = chunks;
+}
+
+/*
+ * Adds the stars belonging to chunk (cx, cy) to the current path, in
+ * layer space.  Generation order is fixed, so the stars only ever
+ * depend on the seed and the chunk's identity.
+ */
+void
+Starfield::path_chunk_stars(cairo_t *cr, int layer, int cx, int cy)
+{
+  const StarfieldLayer *l = &_layers[layer];
+  unsigned int state = hash_chunk (_seed, layer, cx, cy);
+
+  for (int i = 0; i < l->stars_per_chunk; i++) {
+    double x = (cx + next_random(&state)) * STARFIELD_CHUNK_SIZE;
+    double y = (cy + next_random(&state)) * STARFIELD_CHUNK_SIZE;
+    double rotation = next_random(&state) * TWO_PI;
+    double scale = l->min_scale + next_random(&state) * (l->max_scale - l->min_scale);
+
+    cairo_save (cr);
+    cairo_translate (cr, x, y);
+    cairo_rotate (cr, rotation);
+    cairo_scale (cr, scale, scale);
+    path_star (cr);
+    cairo_restore (cr);
+  }
+}
+
+/*
+ * Returns the cached surface for a chunk, rendering it on a miss into
+ * the least recently used slot.
+ */
+cairo_surface_t *
+Starfield::chunk(cairo_t *cr, int layer, int cx, int cy)
+{
+  Chunk *victim = &_cache[0];
+
+  for (int i = 0; i < _cache_size; i++) {
+    Chunk *c = &_cache[i];
+    if (c->surface && c->layer == layer && c->cx == cx && c->cy == cy) {
+      c->last_used = _frame;
+      _hits++;
+      return c->surface;
+    }
+    if (victim->surface && (!c->surface || c->last_used < victim->last_used))
+      victim = c;
+  }
+  _misses++;
+
+  int size = (int) ceil (STARFIELD_CHUNK_SIZE * _device_scale);
+  if (!victim->surface)
+    victim->surface = cairo_surface_create_similar (cairo_get_target (cr),
+                                                    CAIRO_CONTENT_COLOR_ALPHA,
+                                                    size, size);
+  victim->layer = layer;
+  victim->cx = cx;
+  victim->cy = cy;
+  victim->last_used = _frame;
+
+  cairo_t *chunk_cr = cairo_create (victim->surface);
+  cairo_set_operator (chunk_cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (chunk_cr);
+  cairo_set_operator (chunk_cr, CAIRO_OPERATOR_OVER);
+
+  cairo_scale (chunk_cr, _device_scale, _device_scale);
+  cairo_translate (chunk_cr, -cx * STARFIELD_CHUNK_SIZE, -cy * STARFIELD_CHUNK_SIZE);
+
+  // Stars near the edge of a neighbouring chunk poke into this one
+  for (int ny = cy - 1; ny <= cy + 1; ny++)
+    for (int nx = cx - 1; nx <= cx + 1; nx++)
+      path_chunk_stars (chunk_cr, layer, nx, ny);
+
+  double c = _layers[layer].brightness;
+  cairo_set_source_rgb (chunk_cr, c, c, c);
+  cairo_fill (chunk_cr);
+  cairo_destroy (chunk_cr);
+
+  return victim->surface;
+}
+
+void
+Starfield::draw(cairo_t *cr, double camera_x, double camera_y)
+{
+  double x1, y1, x2, y2;
+  double dx = 1.0, dy = 0.0;
+
+  // Chunks are rendered at device resolution; start over if that changes
+  cairo_user_to_device_distance (cr, &dx, &dy);
+  double device_scale = sqrt (dx * dx + dy * dy);
+  if (fabs (device_scale - _device_scale) > 0.01 * device_scale) {
+    flush();
+    _device_scale = device_scale;
+  }
+  _frame++;
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+
+  // However the clip sits on the chunk grid, it can't cover more than
+  // this; one more row and column on top keeps those just scrolled off
+  int cols = (int) ceil ((x2 - x1) / STARFIELD_CHUNK_SIZE) + 2;
+  int rows = (int) ceil ((y2 - y1) / STARFIELD_CHUNK_SIZE) + 2;
+  reserve (cols * rows * _num_layers);
+
+  for (int layer = 0; layer < _num_layers; layer++) {
+    double ox = camera_x * _layers[layer].parallax;
+    double oy = camera_y * _layers[layer].parallax;
+    int cx1 = (int) floor ((x1 + ox) / STARFIELD_CHUNK_SIZE);
+    int cy1 = (int) floor ((y1 + oy) / STARFIELD_CHUNK_SIZE);
+    int cx2 = (int) floor ((x2 + ox) / STARFIELD_CHUNK_SIZE);
+    int cy2 = (int) floor ((y2 + oy) / STARFIELD_CHUNK_SIZE);
+
+    for (int cy = cy1; cy <= cy2; cy++) {
+      for (int cx = cx1; cx <= cx2; cx++) {
+        cairo_surface_t *surface = chunk (cr, layer, cx, cy);
+
+        cairo_save (cr);
+        cairo_translate (cr, cx * STARFIELD_CHUNK_SIZE - ox, cy * STARFIELD_CHUNK_SIZE - oy);
+        cairo_rectangle (cr, 0, 0, STARFIELD_CHUNK_SIZE, STARFIELD_CHUNK_SIZE);
+        cairo_scale (cr, 1.0 / _device_scale, 1.0 / _device_scale);
+        cairo_set_source_surface (cr, surface, 0, 0);
+        cairo_fill (cr);
+        cairo_restore (cr);
+      }
+    }
+  }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,97 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STARFIELD_H__
+#define __STARFIELD_H__
+
+#include "forward.h"
+
+// Side of a square chunk, in playfield units
+#define STARFIELD_CHUNK_SIZE  (256)
+#define STARFIELD_MAX_LAYERS  (4)
+
+typedef struct
+{
+  double parallax;         /// Fraction of camera movement the layer follows
+  int    stars_per_chunk;
+  double min_scale;
+  double max_scale;
+  double brightness;
+} StarfieldLayer;
+
+/*
+ * An endless, layered starfield.
+ *
+ * Stars are laid out per chunk from a hash of the seed, layer and chunk
+ * coordinates, so any chunk can be regenerated at any time and comes out
+ * the same.  Each chunk is rendered once into a surface at device
+ * resolution and kept in an LRU cache, which grows to hold every chunk
+ * the clip can cover; drawing a frame composites only the chunks that
+ * intersect the clip, so its cost depends on the window size and not
+ * on how many stars there are.
+ */
+class Starfield {
+public:
+  Starfield(unsigned int seed);
+  ~Starfield();
+
+  int  add_layer(double parallax, int stars_per_chunk,
+                 double min_scale, double max_scale, double brightness);
+  void draw(cairo_t *cr, double camera_x, double camera_y);
+  void flush();
+
+  long cache_hits() const { return _hits; }
+  long cache_misses() const { return _misses; }
+
+private:
+  typedef struct
+  {
+    int              layer;
+    int              cx, cy;
+    cairo_surface_t *surface;
+    unsigned int     last_used;
+  } Chunk;
+
+  unsigned int   _seed;
+  StarfieldLayer _layers[STARFIELD_MAX_LAYERS];
+  int            _num_layers;
+  Chunk         *_cache;
+  int            _cache_size;
+  double         _device_scale;
+  unsigned int   _frame;
+  long           _hits;
+  long           _misses;
+
+  void reserve(int chunks);
+  cairo_surface_t *chunk(cairo_t *cr, int layer, int cx, int cy);
+  void path_chunk_stars(cairo_t *cr, int layer, int cx, int cy);
+};
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
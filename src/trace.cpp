@@ -0,0 +1,210 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "profiler.h"
+#include "trace.h"
+
+/*
+ * Each thread writes only to its own ring, so recording an event is a
+ * few stores and a release of the new head; no locks.  The writer reads
+ * the rings while they may still be filling and throws away anything
+ * that was overwritten as it copied.
+ */
+typedef struct _TraceBuffer
+{
+  TraceEvent                events[TRACE_RING_SIZE];
+  std::atomic<guint64>      head;           /// Events ever recorded
+  int                       tid;
+  const char               *thread_name;
+  struct _TraceBuffer      *next;
+} TraceBuffer;
+
+std::atomic<bool> trace_enabled(false);
+
+static gint64 trace_start_time;
+
+// Every thread's ring, kept after the thread is gone so it can be written
+static GMutex       buffers_lock;
+static TraceBuffer *buffers = NULL;
+static int          next_tid = 1;
+
+static thread_local TraceBuffer *thread_buffer = NULL;
+
+#ifdef TRACK_ALLOCATIONS
+thread_local TraceZoneStack trace_zone_stack;
+#endif
+
+static TraceBuffer *
+get_thread_buffer (void)
+{
+  if (!thread_buffer) {
+    TraceBuffer *buffer = new TraceBuffer();
+
+    g_mutex_lock (&buffers_lock);
+    buffer->tid = next_tid++;
+    buffer->next = buffers;
+    buffers = buffer;
+    g_mutex_unlock (&buffers_lock);
+    thread_buffer = buffer;
+  }
+  return thread_buffer;
+}
+
+void
+trace_start (void)
+{
+  trace_start_time = profile_now_ns ();
+  trace_enabled.store (true, std::memory_order_relaxed);
+}
+
+void
+trace_stop (void)
+{
+  trace_enabled.store (false, std::memory_order_relaxed);
+}
+
+void
+trace_set_thread_name (const char *name)
+{
+  if (trace_is_enabled ())
+    get_thread_buffer ()->thread_name = name;
+}
+
+void
+trace_event (TraceEventType type, const char *name, double value)
+{
+  TraceBuffer *buffer = get_thread_buffer ();
+  guint64 head = buffer->head.load (std::memory_order_relaxed);
+  TraceEvent *event = &buffer->events[head & (TRACE_RING_SIZE - 1)];
+
+  event->time = profile_now_ns ();
+  event->name = name;
+  event->value = value;
+  event->type = type;
+  buffer->head.store (head + 1, std::memory_order_release);
+}
+
+static void
+write_string (FILE *fp, const char *str)
+{
+  fputc ('"', fp);
+  for (const char *p = str; *p; p++) {
+    if (*p == '"' || *p == '\\')
+      fputc ('\\', fp);
+    if ((unsigned char) *p >= ' ')
+      fputc (*p, fp);
+  }
+  fputc ('"', fp);
+}
+
+/* Writes one thread's events, oldest first */
+static void
+write_buffer (FILE *fp, const TraceBuffer *buffer, TraceEvent *copy, bool *first)
+{
+  guint64 head = buffer->head.load (std::memory_order_acquire);
+  guint64 start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+  guint64 oldest;
+  int depth = 0;
+
+  for (guint64 i = start; i < head; i++)
+    copy[i - start] = buffer->events[i & (TRACE_RING_SIZE - 1)];
+
+  // Anything the thread wrote over while we copied is garbage, and so
+  // is the slot it may be writing now, for the event after the last one
+  oldest = buffer->head.load (std::memory_order_acquire);
+  oldest = oldest >= TRACE_RING_SIZE ? oldest - TRACE_RING_SIZE + 1 : 0;
+
+  if (buffer->thread_name) {
+    fprintf (fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+             "\"args\":{\"name\":", *first ? "" : ",", buffer->tid);
+    write_string (fp, buffer->thread_name);
+    fprintf (fp, "}}");
+    *first = false;
+  }
+
+  for (guint64 i = MAX(start, oldest); i < head; i++) {
+    const TraceEvent *event = &copy[i - start];
+    const char *phase = "C";
+
+    // Ends whose beginnings were overwritten would confuse the viewer
+    if (event->type == TRACE_EVENT_BEGIN) {
+      phase = "B";
+      depth++;
+    } else if (event->type == TRACE_EVENT_END) {
+      if (depth == 0)
+        continue;
+      phase = "E";
+      depth--;
+    }
+
+    fprintf (fp, "%s\n{\"name\":", *first ? "" : ",");
+    write_string (fp, event->name);
+    fprintf (fp, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", phase,
+             (event->time - trace_start_time) / 1000.0, buffer->tid);
+    if (event->type == TRACE_EVENT_COUNTER)
+      fprintf (fp, ",\"args\":{\"value\":%g}", event->value);
+    fprintf (fp, "}");
+    *first = false;
+  }
+}
+
+/**
+ * Writes every thread's recent events as Chrome trace event JSON, which
+ * chrome://tracing and Perfetto open.  Tracing carries on meanwhile.
+ */
+bool
+trace_write (const char *filename)
+{
+  TraceEvent *copy;
+  bool first = true;
+  FILE *fp;
+
+  if (!(fp = fopen (filename, "w")))
+    return false;
+
+  copy = g_new (TraceEvent, TRACE_RING_SIZE);
+  fprintf (fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  g_mutex_lock (&buffers_lock);
+  for (const TraceBuffer *buffer = buffers; buffer; buffer = buffer->next)
+    write_buffer (fp, buffer, copy, &first);
+  g_mutex_unlock (&buffers_lock);
+
+  fprintf (fp, "\n]}\n");
+  g_free (copy);
+  return fclose (fp) == 0;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
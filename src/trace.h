@@ -0,0 +1,144 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <glib.h>
+
+#include <atomic>
+
+// Events each thread keeps; older ones are overwritten
+#define TRACE_RING_SIZE  (1 << 16)
+
+typedef enum {
+  TRACE_EVENT_BEGIN,
+  TRACE_EVENT_END,
+  TRACE_EVENT_COUNTER
+} TraceEventType;
+
+typedef struct
+{
+  gint64          time;             /// ns, CLOCK_MONOTONIC
+  const char     *name;             /// Must outlive the trace; use literals
+  double          value;            /// Counters only
+  TraceEventType  type;
+} TraceEvent;
+
+// Checked before anything else, so a disabled trace costs one load.
+// Only changed by trace_start() and trace_stop(), from any thread.
+extern std::atomic<bool> trace_enabled;
+
+inline bool
+trace_is_enabled(void)
+{
+  return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_start(void);
+void trace_stop(void);
+bool trace_write(const char *filename);
+void trace_set_thread_name(const char *name);
+void trace_event(TraceEventType type, const char *name, double value);
+
+#ifdef TRACK_ALLOCATIONS
+// Zones deeper than this still nest, but count as the deepest one kept
+#define TRACE_MAX_DEPTH  (32)
+
+// The zones a thread is in, whether or not tracing, so that the
+// allocation tracker can say where each allocation came from
+typedef struct
+{
+  const char *names[TRACE_MAX_DEPTH];
+  int         depth;
+} TraceZoneStack;
+
+extern thread_local TraceZoneStack trace_zone_stack;
+
+inline void
+trace_push_zone(const char *name)
+{
+  if (trace_zone_stack.depth < TRACE_MAX_DEPTH)
+    trace_zone_stack.names[trace_zone_stack.depth] = name;
+  trace_zone_stack.depth++;
+}
+
+inline void
+trace_pop_zone(void)
+{
+  if (trace_zone_stack.depth > 0)
+    trace_zone_stack.depth--;
+}
+
+/* The innermost zone, or NULL outside them all */
+inline const char *
+trace_current_zone(void)
+{
+  int depth = trace_zone_stack.depth;
+
+  if (depth == 0)
+    return NULL;
+  return trace_zone_stack.names[(depth < TRACE_MAX_DEPTH ? depth : TRACE_MAX_DEPTH) - 1];
+}
+#else
+inline void trace_push_zone(const char *) {}
+inline void trace_pop_zone(void) {}
+#endif
+
+/* Begins a zone that ends when the scope does */
+class TraceZone {
+public:
+  TraceZone(const char *name) : _name(trace_is_enabled() ? name : NULL) {
+    trace_push_zone(name);
+    if (_name)
+      trace_event(TRACE_EVENT_BEGIN, _name, 0);
+  }
+  ~TraceZone() {
+    if (_name)
+      trace_event(TRACE_EVENT_END, _name, 0);
+    trace_pop_zone();
+  }
+
+private:
+  const char *_name;
+};
+
+#define TRACE_CONCAT_(a, b)  a##b
+#define TRACE_CONCAT(a, b)   TRACE_CONCAT_(a, b)
+
+#define TRACE_ZONE(name)     TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_BEGIN(name) \
+  do { trace_push_zone(name); if (trace_is_enabled()) trace_event(TRACE_EVENT_BEGIN, name, 0); } while (0)
+#define TRACE_END(name) \
+  do { if (trace_is_enabled()) trace_event(TRACE_EVENT_END, name, 0); trace_pop_zone(); } while (0)
+#define TRACE_COUNTER(name, value) \
+  do { if (trace_is_enabled()) trace_event(TRACE_EVENT_COUNTER, name, value); } while (0)
+
+#endif
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :
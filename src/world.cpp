@@ -1,33 +1,54 @@
 #include <stdlib.h>
 #include <cairo.h>
 
-#include "canvas.h"
 #include "world.h"
+#include "counted-cairo.h"
 
-void draw_star (cairo_t * cr, CanvasItem * item);
-
-
-World::World() {
-  for (int i = 0; i < NUMBER_OF_STARS; i++)
-  {
-    stars[i].pos[0] = random() % WIDTH;
-    stars[i].pos[1] = random() % HEIGHT;
-    stars[i].rotation = drand48 () * TWO_PI;
-    stars[i].scale = 0.5 + (drand48 ());
-    stars[i].draw_func = draw_star;
-  }
+World::World()
+  : starfield(random()),
+    camera_x(WIDTH / 2),
+    camera_y(HEIGHT / 2),
+    target_x(WIDTH / 2),
+    target_y(HEIGHT / 2)
+{
+  // Far to near
+  starfield.add_layer(0.02, STARFIELD_FAR_STARS,  0.3, 0.6, 0.3);
+  starfield.add_layer(0.05, STARFIELD_MID_STARS,  0.5, 1.0, 0.4);
+  starfield.add_layer(0.10, STARFIELD_NEAR_STARS, 0.8, 1.5, 0.5);
 }
 
 World::~World() {
 }
 
+/*
+ * Moves the camera by however far (x, y) moved since the last call,
+ * taking the shorter way round the wrapped playfield.  The camera
+ * itself never wraps, so the stars don't jump when the ship does.
+ */
+void World::follow(double x, double y) {
+    double dx = x - target_x;
+    double dy = y - target_y;
+
+    if (dx > WIDTH / 2)
+        dx -= WIDTH;
+    else if (dx < -WIDTH / 2)
+        dx += WIDTH;
+    if (dy > HEIGHT / 2)
+        dy -= HEIGHT;
+    else if (dy < -HEIGHT / 2)
+        dy += HEIGHT;
+
+    camera_x += dx;
+    camera_y += dy;
+    target_x = x;
+    target_y = y;
+}
+
 void World::draw(cairo_t *cr) {
     // background
     cairo_set_source_rgb(cr, 0.1, 0.0, 0.1);
     cairo_paint(cr);
 
     // stars
-    for (int i = 0; i < NUMBER_OF_STARS; i++) {
-	stars[i].draw(cr);
-    }
+    starfield.draw(cr, camera_x, camera_y);
 }
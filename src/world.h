@@ -21,18 +21,27 @@
 
 #include "config.h"
 #include "forward.h"
+#include "starfield.h"
 
 class World {
 private:
-    CanvasItem stars[NUMBER_OF_STARS];
+    Starfield starfield;
+    double    camera_x;     // Unwrapped; keeps going past the playfield's edges
+    double    camera_y;
+    double    target_x;     // Last point followed, in the playfield
+    double    target_y;
 
 public:
     World();
     ~World();
 
+    // Moves the point the background parallax is taken relative to
+    void follow(double x, double y);
+
     // TODO: Move Game::draw_world here
     void draw(cairo_t *cr);
 
+    const Starfield &stars() const { return starfield; }
 };
 
 #endif
@@ -0,0 +1,15 @@
+#ifndef __MAKE_SCORE_H__
+#define __MAKE_SCORE_H__
+
+#include "score.h"
+
+/* A finished game, timestamped now */
+static inline Score
+make_score(int amount, int level, const char *who)
+{
+    Score score;
+    score.record(amount, level, who);
+    return score;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "alloc-tracker.h"
+#include "game.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <cairo.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Long enough for every cache and buffer to have reached its size
+#define WARMUP_TICKS  (500)
+#define STEADY_TICKS  (10000)
+
+Game *game;
+
+static guint64
+zone_count(const char *name)
+{
+    const char *names[MAX_ALLOC_ZONES + 1];
+    AllocCount counts[MAX_ALLOC_ZONES + 1];
+    int n = alloc_tracker_zones(names, counts, MAX_ALLOC_ZONES + 1);
+
+    for (int i = 0; i < n; i++)
+        if (strcmp(names[i], name) == 0)
+            return counts[i].count;
+    return 0;
+}
+
+void
+test_tracker_counts()
+{
+    AllocCount before, after;
+    AllocPeriod period;
+
+    assert( alloc_tracker_enabled() );
+
+    alloc_period_init(&period, "test");
+    alloc_period_begin(&period);
+    before = alloc_tracker_thread_total();
+    {
+        TRACE_ZONE("test zone");
+        // volatile, so the compiler can't leave the pairs out
+        void * volatile p = malloc(100);
+        free(p);
+        int * volatile q = new int[10];
+        delete[] q;
+    }
+    after = alloc_tracker_thread_total();
+    alloc_period_end(&period);
+
+    assert( after.count - before.count == 2 );
+    assert( after.bytes - before.bytes == 100 + 10 * sizeof(int) );
+    assert( zone_count("test zone") == 2 );
+    assert( period.periods == 1 && period.total.count == 2 && period.worst.count == 2 );
+
+    alloc_tracker_reset_zones();
+    assert( zone_count("test zone") == 0 );
+}
+
+/* Keeps both sides shooting, so the field never empties out */
+static void
+keep_playing()
+{
+    game->player->energy = SHIP_MAX_ENERGY;
+    game->cannon->energy = SHIP_MAX_ENERGY;
+    game->keyboard.key(KEY_FIRE, true, 0, profile_now_ns());
+    game->player->p.rotation_speed = 2;
+}
+
+/*
+ * A tick and a whole frame must not touch the heap once the game is
+ * going.  What cairo and pixman allocate while rasterizing is theirs to
+ * answer for, so that's left out; so are the font libraries cairo
+ * reaches down into for text.
+ */
+void
+test_steady_state()
+{
+    char name[] = "test_allocations";
+    char *argv[] = { name, NULL };
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cairo_t *cr = cairo_create(surface);
+    AllocPeriod ticks, frames;
+
+    assert( alloc_tracker_exclude_library("libcairo") );
+    assert( alloc_tracker_exclude_library("libpixman") );
+    alloc_tracker_exclude_library("libfreetype");
+    alloc_tracker_exclude_library("libfontconfig");
+
+    game = new Game(1, argv, TRUE);
+
+    for (int i = 0; i < WARMUP_TICKS; i++) {
+        keep_playing();
+        game->tick();
+        game->redraw(cr);
+    }
+
+    alloc_tracker_reset_zones();
+    alloc_period_init(&ticks, "per tick");
+    alloc_period_init(&frames, "per frame");
+    for (int i = 0; i < STEADY_TICKS; i++) {
+        keep_playing();
+        alloc_period_begin(&ticks);
+        game->tick();
+        alloc_period_end(&ticks);
+
+        alloc_period_begin(&frames);
+        game->redraw(cr);
+        alloc_period_end(&frames);
+    }
+
+    if (ticks.total.count || frames.total.count) {
+        AllocPeriod periods[] = { ticks, frames };
+        alloc_tracker_dump(stderr, periods, 2);
+    }
+    assert( ticks.periods == STEADY_TICKS );
+    assert( frames.periods == STEADY_TICKS );
+    assert( ticks.total.count == 0 );
+    assert( frames.total.count == 0 );
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+}
+
+int
+main()
+{
+    test_tracker_counts();
+    test_steady_state();
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "assets.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char cache_file[] = "/tmp/test_assets_XXXXXX";
+
+void
+check_sprites(const AssetSet &assets)
+{
+    const Sprite *ship = assets.find("ship");
+
+    assert( assets.count() == 5 );
+    assert( assets.find("cannon") != NULL );
+    assert( assets.find("explosion") != NULL );
+    assert( assets.find("missile") != NULL );
+    assert( assets.find("star") != NULL );
+    assert( assets.find("nonexistent") == NULL );
+
+    assert( ship != NULL );
+    assert( ship->width == 80 && ship->height == 100 );
+    assert( ship->num_paths == 4 );
+
+    // Group transforms are baked in, and the origin is the center
+    const SpritePath *body = assets.path(ship, 0);
+    const PathSegment *seg = assets.segments(body);
+    assert( body->num_segments > 2 );
+    assert( seg[0].code == PATH_MOVETO );
+    assert( fabs(seg[0].pt[0] - 0.0) < 1e-9 );
+    assert( fabs(seg[0].pt[1] + 33.0) < 1e-9 );
+    assert( seg[body->num_segments - 1].code == PATH_END );
+    assert( body->fill[3] == 1.0 && body->stroke[3] == 1.0 );
+    assert( assets.path(ship, 4) == NULL );
+}
+
+void
+test_assets_missing()
+{
+    AssetSet assets;
+    char empty_dir[] = "/tmp/test_assets_empty_XXXXXX";
+    struct stat st;
+
+    assert( mkdtemp(empty_dir) != NULL );
+
+    // Neither loads, or leaves a cache behind that would
+    assert( !assets.load("/nonexistent", cache_file) );
+    assert( !assets.load(empty_dir, cache_file) );
+    assert( assets.count() == 0 );
+    assert( stat(cache_file, &st) == 0 && st.st_size == 0 );
+
+    rmdir(empty_dir);
+}
+
+void
+test_assets_cold()
+{
+    AssetSet assets;
+
+    // A missing directory is an error, not an empty set
+    assert( !assets.load("/nonexistent", NULL) );
+    assert( assets.count() == 0 );
+
+    assert( assets.load(SPRITE_DIR, cache_file) );
+    assert( !assets.from_cache() );
+    check_sprites(assets);
+}
+
+void
+test_assets_cached()
+{
+    AssetSet assets;
+
+    assert( assets.load(SPRITE_DIR, cache_file) );
+    assert( assets.from_cache() );
+    check_sprites(assets);
+}
+
+void
+test_assets_stale()
+{
+    AssetSet assets;
+    FILE *fp = fopen(cache_file, "r+b");
+
+    // A cache from some other version is rebuilt, not used
+    assert( fp != NULL );
+    fputs("SCSC\xff\xff", fp);
+    fclose(fp);
+
+    assert( assets.load(SPRITE_DIR, cache_file) );
+    assert( !assets.from_cache() );
+    check_sprites(assets);
+
+    assert( assets.load(SPRITE_DIR, cache_file) );
+    assert( assets.from_cache() );
+}
+
+int
+main() {
+    int fd = mkstemp(cache_file);
+    assert( fd >= 0 );
+    close(fd);
+
+    test_assets_missing();
+    test_assets_cold();
+    test_assets_cached();
+    test_assets_stale();
+
+    unlink(cache_file);
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "assets.h"
+#include "collision.h"
+#include "config.h"
+#include "path.h"
+#include "path-geometry.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+static void
+shape_from_path(CollisionShape *shape, const char *data, double scale)
+{
+    Path *path = sp_svg_read_path(data);
+    Polyline outline;
+
+    assert( path_flatten(path->segments, path->segment_count, 0.5, &outline) );
+    assert( shape->build(outline, scale) );
+    delete path;
+}
+
+static void
+place(cairo_matrix_t *m, double x, double y, double angle)
+{
+    cairo_matrix_init_translate(m, x, y);
+    cairo_matrix_rotate(m, angle);
+}
+
+void
+test_decompose()
+{
+    CollisionShape square, ell;
+
+    shape_from_path(&square, "M -5,-5 L 5,-5 L 5,5 L -5,5 z", 1.0);
+    assert( square.num_pieces() == 1 );
+    assert( square.piece(0).num_vertices == 4 );
+    assert( fabs(square.radius() - sqrt(50)) < 1e-9 );
+
+    // Concave, so at least two pieces
+    shape_from_path(&ell, "M 0,0 L 20,0 L 20,5 L 5,5 L 5,20 L 0,20 z", 1.0);
+    assert( ell.num_pieces() >= 2 );
+    double area = 0;
+    for (int i = 0; i < ell.num_pieces(); i++) {
+        const CollisionPiece &p = ell.piece(i);
+        for (int k = 0; k < p.num_vertices; k++) {
+            const Point &a = p.vertices[k];
+            const Point &b = p.vertices[(k + 1) % p.num_vertices];
+            area += (a[0] * b[1] - b[0] * a[1]) / 2;
+        }
+    }
+    assert( fabs(fabs(area) - 175) < 1e-9 );
+
+    // Winding doesn't matter, and the scale is applied
+    CollisionShape reversed;
+    shape_from_path(&reversed, "M -5,5 L 5,5 L 5,-5 L -5,-5 z", 2.0);
+    assert( reversed.num_pieces() == 1 );
+    assert( fabs(reversed.radius() - sqrt(200)) < 1e-9 );
+}
+
+void
+test_overlaps()
+{
+    CollisionShape ell, dot;
+    cairo_matrix_t a, b;
+
+    shape_from_path(&ell, "M 0,0 L 20,0 L 20,5 L 5,5 L 5,20 L 0,20 z", 1.0);
+    shape_from_path(&dot, "M -1,-1 L 1,-1 L 1,1 L -1,1 z", 1.0);
+
+    place(&a, 100, 100, 0);
+
+    // In the notch: inside the bounding circle, but not touching
+    place(&b, 112, 112, 0);
+    assert( !ell.overlaps(&a, dot, &b) );
+    assert( !dot.overlaps(&b, ell, &a) );
+
+    // On each arm
+    place(&b, 115, 102, 0);
+    assert( ell.overlaps(&a, dot, &b) );
+    place(&b, 102, 115, 0);
+    assert( ell.overlaps(&a, dot, &b) );
+    assert( dot.overlaps(&b, ell, &a) );
+
+    // Turning the L a half turn around its corner moves the arms away
+    place(&a, 100, 100, M_PI);
+    place(&b, 115, 102, 0);
+    assert( !ell.overlaps(&a, dot, &b) );
+    place(&b, 85, 98, 0);
+    assert( ell.overlaps(&a, dot, &b) );
+
+    // Rotated small shape poking into the corner of a bar
+    CollisionShape bar;
+    shape_from_path(&bar, "M -10,-1 L 10,-1 L 10,1 L -10,1 z", 1.0);
+    place(&a, 0, 0, 0);
+    place(&b, 0, 0, M_PI / 4);
+    assert( bar.overlaps(&a, bar, &b) );
+    place(&b, 0, 12, M_PI / 2);
+    assert( !bar.overlaps(&a, bar, &b) );
+    place(&b, 0, 10, M_PI / 2);
+    assert( bar.overlaps(&a, bar, &b) );
+}
+
+void
+test_curves()
+{
+    CollisionShape circle, dot;
+    cairo_matrix_t a, b;
+
+    shape_from_path(&circle, "m 20,0 a 20,20 0 1 1 -40,0 20,20 0 1 1 40,0 z", 1.0);
+    shape_from_path(&dot, "M -1,-1 L 1,-1 L 1,1 L -1,1 z", 1.0);
+    assert( circle.radius() <= 20.01 );
+    assert( circle.radius() > 19.5 );
+
+    place(&a, 0, 0, 0);
+    place(&b, 15, 15, 0);
+    assert( !circle.overlaps(&a, dot, &b) );
+    place(&b, 13, 13, 0);
+    assert( circle.overlaps(&a, dot, &b) );
+}
+
+/* The cannon's outline is where draw_cannon() draws it, not its old bounding circle */
+void
+test_cannon_outline()
+{
+    AssetSet assets;
+    CollisionShape cannon, dot;
+    Polyline outline;
+    cairo_matrix_t a, b;
+    double body = CANNON_RADIUS / FIXED_POINT_SCALE_FACTOR * GLOBAL_SHIP_SCALE_FACTOR;
+    double barrel = 45 * GLOBAL_SHIP_SCALE_FACTOR;
+
+    assert( assets.load(SPRITE_DIR, NULL) );
+    const Sprite *sprite = assets.find("cannon");
+    assert( sprite );
+    const SpritePath *path = assets.path(sprite, 0);
+    assert( path );
+    assert( path_flatten(assets.segments(path), path->num_segments,
+                         COLLISION_FLATTEN_TOLERANCE, &outline) );
+    assert( cannon.build(outline, GLOBAL_SHIP_SCALE_FACTOR) );
+    shape_from_path(&dot, "M -0.5,-0.5 L 0.5,-0.5 L 0.5,0.5 L -0.5,0.5 z", 1.0);
+    place(&a, 0, 0, 0);
+
+    // Around the body, on the side away from the barrel
+    for (int i = 0; i <= 4; i++) {
+        double angle = i * M_PI / 4;
+        place(&b, (body - 1.5) * cos(angle), (body - 1.5) * sin(angle), 0);
+        assert( cannon.overlaps(&a, dot, &b) );
+        place(&b, (body + 1.5) * cos(angle), (body + 1.5) * sin(angle), 0);
+        assert( !cannon.overlaps(&a, dot, &b) );
+    }
+
+    // The barrel reaches past the body, upwards
+    place(&b, 0, -(barrel - 1.5), 0);
+    assert( cannon.overlaps(&a, dot, &b) );
+    place(&b, 0, -(barrel + 1.5), 0);
+    assert( !cannon.overlaps(&a, dot, &b) );
+    place(&b, 10, -(body + 1.5), 0);
+    assert( !cannon.overlaps(&a, dot, &b) );
+}
+
+int
+main() {
+    test_decompose();
+    test_overlaps();
+    test_curves();
+    test_cannon_outline();
+
+    return 0;
+}
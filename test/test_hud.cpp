@@ -0,0 +1,99 @@
+#include "hud.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static DrawStats
+no_stats()
+{
+    DrawStats stats;
+    memset(&stats, 0, sizeof(stats));
+    return stats;
+}
+
+void
+test_hud_fps()
+{
+    PerfHud hud(16);
+    DrawStats stats = no_stats();
+
+    assert( hud.fps() == 0 );
+
+    // A frame every 20ms
+    for (int i = 0; i < 10; i++)
+        hud.frame_finished(1000000000LL + i * 20000000LL, 5000000, stats, 0);
+    assert( fabs(hud.fps() - 50) < 0.01 );
+
+    // Only the recent frames count once the ring wraps
+    for (int i = 0; i < HUD_HISTORY; i++)
+        hud.frame_finished(2000000000LL + i * 10000000LL, 5000000, stats, 0);
+    assert( fabs(hud.fps() - 100) < 0.01 );
+}
+
+void
+test_hud_collision_tests()
+{
+    PerfHud hud(16);
+
+    assert( hud.pair_tests_per_tick() == 0 );
+    assert( hud.precise_tests_per_tick() == 0 );
+
+    hud.tick_finished(1000, 20, 4);
+    hud.tick_finished(1000, 40, 8);
+    assert( hud.pair_tests_per_tick() == 30 );
+    assert( hud.precise_tests_per_tick() == 6 );
+
+    // Old ticks fall out of the average
+    for (int i = 0; i < HUD_HISTORY; i++)
+        hud.tick_finished(1000, 10, 2);
+    assert( hud.pair_tests_per_tick() == 10 );
+    assert( hud.precise_tests_per_tick() == 2 );
+}
+
+void
+test_hud_hit_rates()
+{
+    PerfHud hud(16);
+    DrawStats stats = no_stats();
+    long hits = 0, misses = 0;
+
+    assert( hud.hit_rate(HUD_CACHE_STARFIELD) < 0 );
+
+    // Three hits to every miss
+    for (int i = 0; i < HUD_RATE_FRAMES; i++) {
+        hits += 3;
+        misses += 1;
+        hud.sample_cache(HUD_CACHE_STARFIELD, hits, misses);
+        hud.frame_finished(i, 0, stats, 0);
+    }
+    assert( fabs(hud.hit_rate(HUD_CACHE_STARFIELD) - 0.75) < 1e-9 );
+    assert( hud.hit_rate(HUD_CACHE_MATRIX) < 0 );
+
+    // Counters reset by someone else don't make for negative counts
+    hits = misses = 0;
+    for (int i = 0; i < HUD_RATE_FRAMES; i++) {
+        hits += 1;
+        hud.sample_cache(HUD_CACHE_STARFIELD, hits, misses);
+        hud.frame_finished(i, 0, stats, 0);
+    }
+    assert( hud.hit_rate(HUD_CACHE_STARFIELD) == 1.0 );
+
+    // A window with nothing in it keeps the last rate
+    for (int i = 0; i < HUD_RATE_FRAMES; i++) {
+        hud.sample_cache(HUD_CACHE_STARFIELD, hits, misses);
+        hud.frame_finished(i, 0, stats, 0);
+    }
+    assert( hud.hit_rate(HUD_CACHE_STARFIELD) == 1.0 );
+}
+
+int
+main()
+{
+    test_hud_fps();
+    test_hud_collision_tests();
+    test_hud_hit_rates();
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "keyboard.h"
+
+#include <assert.h>
+
+void
+test_hold_and_release()
+{
+    Keyboard keyboard;
+    KeyboardSample s;
+
+    s = keyboard.sample();
+    assert( s.held == 0 && s.pressed == 0 && s.input_time == 0 );
+
+    keyboard.key(KEY_THRUST, true, 100, 5000);
+    s = keyboard.sample();
+    assert( key_held(s, KEY_THRUST) && !key_held(s, KEY_FIRE) );
+    assert( s.pressed == 1u << KEY_THRUST );
+    assert( s.input_time == 5000 );
+
+    // Still held, but no longer new
+    s = keyboard.sample();
+    assert( key_held(s, KEY_THRUST) );
+    assert( s.pressed == 0 && s.input_time == 0 );
+
+    keyboard.key(KEY_THRUST, false, 300, 9000);
+    s = keyboard.sample();
+    assert( !key_held(s, KEY_THRUST) );
+    assert( s.input_time == 9000 );
+}
+
+/* A tap between two ticks is seen by one of them */
+void
+test_tap_between_samples()
+{
+    Keyboard keyboard;
+    KeyboardSample s;
+
+    keyboard.key(KEY_FIRE, true, 100, 1000);
+    keyboard.key(KEY_FIRE, false, 110, 2000);
+    s = keyboard.sample();
+    assert( key_held(s, KEY_FIRE) && (s.pressed & (1u << KEY_FIRE)) );
+    assert( s.input_time == 1000 );
+
+    s = keyboard.sample();
+    assert( !key_held(s, KEY_FIRE) );
+}
+
+void
+test_auto_repeat()
+{
+    Keyboard keyboard;
+    KeyboardSample s;
+
+    // Presses of a key already down
+    keyboard.key(KEY_TURN_LEFT, true, 100, 1000);
+    keyboard.key(KEY_TURN_LEFT, true, 130, 2000);
+    keyboard.key(KEY_TURN_LEFT, true, 160, 3000);
+    assert( keyboard.repeats() == 2 );
+    s = keyboard.sample();
+    assert( key_held(s, KEY_TURN_LEFT) && s.input_time == 1000 );
+
+    // A release and press with the same timestamp
+    keyboard.key(KEY_TURN_LEFT, false, 190, 4000);
+    keyboard.key(KEY_TURN_LEFT, true, 190, 4001);
+    assert( keyboard.repeats() == 3 );
+    s = keyboard.sample();
+    assert( key_held(s, KEY_TURN_LEFT) );
+    assert( s.pressed == 0 && s.input_time == 0 );
+
+    // A real release and press again
+    keyboard.key(KEY_TURN_LEFT, false, 220, 5000);
+    keyboard.key(KEY_TURN_LEFT, true, 260, 6000);
+    assert( keyboard.repeats() == 3 );
+    s = keyboard.sample();
+    assert( key_held(s, KEY_TURN_LEFT) && (s.pressed & (1u << KEY_TURN_LEFT)) );
+    assert( s.input_time == 5000 );
+}
+
+void
+test_reset()
+{
+    Keyboard keyboard;
+
+    keyboard.key(KEY_TURN_RIGHT, true, 100, 1000);
+    keyboard.reset();
+    KeyboardSample s = keyboard.sample();
+    assert( s.held == 0 && s.input_time == 0 );
+
+    // Releases of keys that aren't down don't count as input
+    keyboard.key(KEY_TURN_RIGHT, false, 120, 2000);
+    s = keyboard.sample();
+    assert( s.held == 0 && s.input_time == 0 );
+}
+
+int
+main()
+{
+    test_hold_and_release();
+    test_tap_between_samples();
+    test_auto_repeat();
+    test_reset();
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "leaderboard.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_RANDOM (20000)
+#define NUM_LEVELS (7)
+
+typedef struct
+{
+    ScoreRecord rec;
+    int         order;     /// When it was added
+} Reference;
+
+static int
+compare_reference(const void *a, const void *b)
+{
+    const Reference *ra = (const Reference *) a;
+    const Reference *rb = (const Reference *) b;
+
+    if (ra->rec.amount != rb->rec.amount)
+        return ra->rec.amount > rb->rec.amount ? -1 : 1;
+    return ra->order - rb->order;
+}
+
+static ScoreRecord
+make_record(int amount, int level, int id)
+{
+    ScoreRecord rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.amount = amount;
+    rec.level = level;
+    rec.timestamp = id;
+    return rec;
+}
+
+void
+test_leaderboard_empty()
+{
+    Leaderboard board;
+    ScoreRecord out[4];
+
+    assert( board.count() == 0 );
+    assert( board.count(3) == 0 );
+    assert( board.rank_of(100) == 0 );
+    assert( board.rank_of(100, 3) == 0 );
+    assert( !board.get(0, out) );
+    assert( board.top(4, out) == 0 );
+    assert( board.top(4, 3, out) == 0 );
+    assert( board.range(100, 0, out, 4) == 0 );
+}
+
+void
+test_leaderboard_ties()
+{
+    Leaderboard board;
+    ScoreRecord rec;
+
+    // Equal scores rank in the order they came in
+    assert( board.insert(&(rec = make_record(50, 1, 1))) == 0 );
+    assert( board.insert(&(rec = make_record(50, 1, 2))) == 1 );
+    assert( board.insert(&(rec = make_record(80, 1, 3))) == 0 );
+    assert( board.insert(&(rec = make_record(50, 1, 4))) == 3 );
+    assert( board.rank_of(50) == 4 );
+    assert( board.rank_of(51) == 1 );
+
+    for (int i = 0; i < 4; i++) {
+        const long expected[] = { 3, 1, 2, 4 };
+        assert( board.get(i, &rec) );
+        assert( rec.timestamp == expected[i] );
+    }
+    assert( !board.get(4, &rec) );
+    assert( !board.get(-1, &rec) );
+
+    // Scores need a level
+    assert( board.insert(&(rec = make_record(10, -1, 5))) == -1 );
+    assert( board.count() == 4 );
+}
+
+void
+test_leaderboard_random()
+{
+    static Reference reference[NUM_RANDOM];
+    static ScoreRecord out[NUM_RANDOM];
+    Leaderboard board;
+    ScoreRecord rec;
+    int n;
+
+    srand(1234);
+    for (int i = 0; i < NUM_RANDOM; i++) {
+        reference[i].rec = make_record(rand() % 5000, rand() % NUM_LEVELS, i);
+        reference[i].order = i;
+
+        // The rank it gets is the number of scores at least as high
+        int expected = 0;
+        for (int j = 0; j < i; j++)
+            expected += (reference[j].rec.amount >= reference[i].rec.amount);
+        assert( board.rank_of(reference[i].rec.amount) == expected );
+        assert( board.insert(&reference[i].rec) == expected );
+    }
+    qsort(reference, NUM_RANDOM, sizeof(Reference), compare_reference);
+
+    // Every rank holds the right score
+    assert( board.count() == NUM_RANDOM );
+    for (int i = 0; i < NUM_RANDOM; i++) {
+        assert( board.get(i, &rec) );
+        assert( rec.timestamp == reference[i].rec.timestamp );
+    }
+
+    // Top-K overall and by level
+    assert( board.top(100, out) == 100 );
+    for (int i = 0; i < 100; i++)
+        assert( out[i].timestamp == reference[i].rec.timestamp );
+
+    for (int level = 0; level < NUM_LEVELS; level++) {
+        int j = 0, above = 0;
+        n = board.top(NUM_RANDOM, level, out);
+        assert( n == board.count(level) );
+        for (int i = 0; i < NUM_RANDOM; i++) {
+            if (reference[i].rec.level == level) {
+                assert( j < n );
+                assert( out[j++].timestamp == reference[i].rec.timestamp );
+                above += (reference[i].rec.amount >= 2500);
+            }
+        }
+        assert( j == n );
+        assert( board.rank_of(2500, level) == above );
+    }
+
+    // Ranges take both ends
+    n = board.range(3000, 2000, out, NUM_RANDOM);
+    int first = board.rank_of(3000 + 1);
+    assert( n == board.rank_of(2000) - first );
+    for (int i = 0; i < n; i++)
+        assert( out[i].timestamp == reference[first + i].rec.timestamp );
+    assert( board.range(3000, 2000, out, 10) == 10 );
+
+    board.clear();
+    assert( board.count() == 0 );
+    assert( board.insert(&rec) == 0 );
+
+    // Levels no game reaches are refused rather than making room for them
+    rec.level = LEADERBOARD_MAX_LEVEL + 1;
+    assert( board.insert(&rec) == -1 );
+    rec.level = INT32_MAX;
+    assert( board.insert(&rec) == -1 );
+    rec.level = LEADERBOARD_MAX_LEVEL;
+    assert( board.insert(&rec) == 1 );
+    assert( board.count() == 2 && board.count(LEADERBOARD_MAX_LEVEL) == 1 );
+}
+
+void
+test_leaderboard_large()
+{
+    Leaderboard board;
+    ScoreRecord rec;
+
+    // A million scores, ranked twice, take about a hundred bytes apiece
+    for (int i = 0; i < 1000000; i++) {
+        rec = make_record((int) ((i * 7919L) % 1000003), i % 10, i);
+        board.insert(&rec);
+    }
+    assert( board.count() == 1000000 );
+    assert( board.memory_used() < 120 * 1000000 );
+
+    assert( board.get(0, &rec) );
+    assert( board.rank_of(rec.amount) == 1 );
+    assert( board.get(999999, &rec) );
+    assert( board.rank_of(rec.amount) == 1000000 );
+}
+
+int
+main() {
+    test_leaderboard_empty();
+    test_leaderboard_ties();
+    test_leaderboard_random();
+    test_leaderboard_large();
+
+    return 0;
+}
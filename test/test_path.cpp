@@ -0,0 +1,122 @@
+#include "path.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+
+void
+test_path_inline()
+{
+    Path path;
+
+    assert( path.segment_count == 0 );
+    for (int i = 0; i < PATH_INLINE_SEGMENTS; i++)
+        assert( path.addSegment(PathSegment(PATH_LINETO, i, i)) == 0 );
+    assert( path.capacity() == PATH_INLINE_SEGMENTS );
+    assert( path.segments[PATH_INLINE_SEGMENTS-1].pt[0] == PATH_INLINE_SEGMENTS-1 );
+}
+
+void
+test_path_growth()
+{
+    Path path;
+
+    // Well past the old fixed limit of 256
+    for (int i = 0; i < 1000; i++)
+        assert( path.addSegment(PathSegment(PATH_LINETO, i, -i)) == 0 );
+    assert( path.end() == 0 );
+
+    assert( path.segment_count == 1001 );
+    for (int i = 0; i < 1000; i++) {
+        assert( path.segments[i].code == PATH_LINETO );
+        assert( path.segments[i].pt[0] == i );
+        assert( path.segments[i].pt[1] == -i );
+    }
+    assert( path.segments[1000].code == PATH_END );
+}
+
+void
+test_path_move()
+{
+    Path small;
+    Path big;
+
+    small.addSegment(PathSegment(PATH_MOVETO, 1, 2));
+    for (int i = 0; i < 100; i++)
+        big.addSegment(PathSegment(PATH_LINETO, i, i));
+
+    Path a(std::move(small));
+    assert( a.segment_count == 1 );
+    assert( a.segments[0].pt[1] == 2 );
+    assert( small.segment_count == 0 );
+
+    PathSegment *buffer = big.segments;
+    Path b(std::move(big));
+    assert( b.segments == buffer );
+    assert( b.segment_count == 100 );
+    assert( big.segment_count == 0 );
+
+    a = std::move(b);
+    assert( a.segment_count == 100 );
+    assert( a.segments == buffer );
+}
+
+void
+test_path_assign()
+{
+    Path path;
+    Path copy;
+
+    for (int i = 0; i < 100; i++)
+        path.addSegment(PathSegment(PATH_LINETO, i, i));
+
+    assert( copy.assign(path) );
+    assert( copy.segment_count == 100 && copy.capacity() == 100 );
+    assert( copy.segments != path.segments );
+    assert( copy.segments[99].pt[0] == 99 );
+
+    // Onto itself, it's left as it was
+    PathSegment *buffer = path.segments;
+    assert( path.assign(path) );
+    assert( path.segment_count == 100 );
+    assert( path.segments == buffer );
+    assert( path.segments[99].pt[1] == 99 );
+}
+
+void
+test_path_arena()
+{
+    PathArena arena;
+    Path *paths[50];
+
+    for (int i = 0; i < 50; i++) {
+        char data[64];
+        snprintf(data, sizeof(data), "M %d 0 L 1 1 L 2 2 L 3 3 L 4 4 L 5 5 z", i);
+        paths[i] = sp_svg_read_path(data, &arena);
+        assert( paths[i]->segment_count == 7 );
+        assert( paths[i]->segments[0].pt[0] == i );
+    }
+
+    // Parsed paths are sized exactly and packed together
+    assert( paths[0]->capacity() == 7 );
+    assert( (char *) paths[1]->segments - (char *) paths[0]->segments < 7 * 64 );
+    assert( arena.bytes_allocated() >= 50 * 7 * sizeof(PathSegment) );
+
+    for (int i = 0; i < 50; i++)
+        delete paths[i];
+    arena.clear();
+    assert( arena.bytes_allocated() == 0 );
+}
+
+int
+main() {
+    test_path_inline();
+    test_path_growth();
+    test_path_move();
+    test_path_assign();
+    test_path_arena();
+
+    return 0;
+}
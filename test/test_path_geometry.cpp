@@ -0,0 +1,173 @@
+#include "path.h"
+#include "path-geometry.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+// A circle of radius 20 around (354.28571, 500.07647), as Inkscape writes it
+static const char *circle =
+    "m 374.28571,500.07647 a 20,20 0 1 1 -40,0 20,20 0 1 1 40,0 z";
+
+static bool
+near(double a, double b, double epsilon)
+{
+    return fabs(a - b) <= epsilon;
+}
+
+void
+test_transform()
+{
+    Path *path = sp_svg_read_path("M 1,2 L 3,4 C 5,6 7,8 9,10");
+    PathSegment out[4];
+    cairo_matrix_t m;
+
+    // Rotate a quarter turn, then move by (100, 200)
+    cairo_matrix_init(&m, 0, 1, -1, 0, 100, 200);
+    path_transform(path->segments, out, path->segment_count, &m);
+
+    assert( out[0].code == PATH_MOVETO );
+    assert( out[0].pt[0] == 98 && out[0].pt[1] == 201 );
+    assert( out[1].pt[0] == 96 && out[1].pt[1] == 203 );
+    assert( out[2].code == PATH_CURVETO );
+    assert( out[2].c1[0] == 94 && out[2].c1[1] == 205 );
+    assert( out[2].c2[0] == 92 && out[2].c2[1] == 207 );
+    assert( out[2].pt[0] == 90 && out[2].pt[1] == 209 );
+
+    // In place
+    path_transform(path->segments, path->segments, path->segment_count, &m);
+    assert( path->segments[2].pt[0] == 90 && path->segments[2].pt[1] == 209 );
+    delete path;
+}
+
+void
+test_bounds()
+{
+    PathBounds b;
+    Path *lines = sp_svg_read_path("M 0,0 L 10,-5 L -3,7 z");
+    Path *round = sp_svg_read_path(circle);
+    Path *empty = sp_svg_read_path("");
+
+    assert( path_bounds(lines->segments, lines->segment_count, &b) );
+    assert( b.x1 == -3 && b.y1 == -5 && b.x2 == 10 && b.y2 == 7 );
+
+    // The curves' extent, not their control points
+    assert( path_bounds(round->segments, round->segment_count, &b) );
+    assert( near(b.x1, 334.28571, 0.01) && near(b.x2, 374.28571, 0.01) );
+    assert( near(b.y1, 480.07647, 0.01) && near(b.y2, 520.07647, 0.01) );
+
+    // A single curve bulging well past its ends
+    Path *arch = sp_svg_read_path("M 0,0 C 0,40 40,40 40,0");
+    assert( path_bounds(arch->segments, arch->segment_count, &b) );
+    assert( b.x1 == 0 && b.x2 == 40 && b.y1 == 0 && near(b.y2, 30, 1e-9) );
+
+    assert( !path_bounds(empty->segments, empty->segment_count, &b) );
+
+    delete lines;
+    delete round;
+    delete arch;
+    delete empty;
+}
+
+void
+test_flatten()
+{
+    Path *round = sp_svg_read_path(circle);
+    Polyline coarse, fine;
+
+    assert( path_flatten(round->segments, round->segment_count, 0.5, &coarse) );
+    assert( path_flatten(round->segments, round->segment_count, 0.01, &fine) );
+
+    assert( coarse.num_runs == 1 && coarse.runs[0].closed );
+    assert( coarse.runs[0].count == coarse.num_points );
+    assert( fine.num_points > coarse.num_points );
+
+    // Every point lies on the circle
+    for (int i = 0; i < fine.num_points; i++) {
+        double dx = fine.points[i][0] - 354.28571;
+        double dy = fine.points[i][1] - 500.07647;
+        assert( near(sqrt(dx*dx + dy*dy), 20, 0.01) );
+    }
+
+    // A straight "curve" needs only one step
+    Point a(0, 0), b(1, 1), c(2, 2), d(3, 3);
+    assert( path_flatten_steps(a, b, c, d, 0.1) == 1 );
+
+    delete round;
+}
+
+/* Segments drawn on after a close start over from the subpath's start */
+void
+test_flatten_after_close()
+{
+    PathSegment segments[] = {
+        PathSegment(PATH_MOVETO, 10, 10),
+        PathSegment(PATH_LINETO, 20, 10),
+        PathSegment(PATH_LINETO, 20, 20),
+        PathSegment(PATH_END, 0, 0),
+        PathSegment(PATH_CURVETO, 10, 30, 10, 30, 10, 30),
+    };
+    Polyline flat;
+    PathBounds b;
+
+    assert( path_flatten(segments, 5, 0.25, &flat) );
+    assert( flat.num_runs == 2 );
+    assert( flat.runs[0].closed && flat.runs[0].count == 3 );
+    assert( !flat.runs[1].closed );
+
+    // A straight line from (10, 10), not from (20, 20) or the end record's (0, 0)
+    const Point &first = flat.points[flat.runs[1].first];
+    assert( first[0] == 10 && first[1] == 10 );
+    for (int i = 0; i < flat.runs[1].count; i++)
+        assert( flat.points[flat.runs[1].first + i][0] == 10 );
+
+    assert( path_bounds(segments, 5, &b) );
+    assert( b.x1 == 10 && b.y1 == 10 && b.x2 == 20 && b.y2 == 30 );
+}
+
+void
+test_flatten_cache()
+{
+    Path *round = sp_svg_read_path(circle);
+    FlattenCache cache;
+
+    const Polyline *p1 = cache.get(round->segments, round->segment_count, 0.25);
+    const Polyline *p2 = cache.get(round->segments, round->segment_count, 0.25);
+    assert( p1 != NULL && p1 == p2 );
+    assert( cache.hits() == 1 && cache.misses() == 1 );
+
+    const Polyline *p3 = cache.get(round->segments, round->segment_count, 0.05);
+    assert( p3 != NULL && p3->num_points > p1->num_points );
+    assert( cache.misses() == 2 );
+
+    // The same segments somewhere else are the same path
+    PathSegment copy[16];
+    assert( round->segment_count <= 16 );
+    for (int i = 0; i < round->segment_count; i++)
+        copy[i] = round->segments[i];
+    assert( cache.get(copy, round->segment_count, 0.25) == p1 );
+    assert( cache.misses() == 2 );
+
+    // Changed in place, or memory reused for another path, they aren't
+    copy[1].pt[0] += 1;
+    const Polyline *p4 = cache.get(copy, round->segment_count, 0.25);
+    assert( p4 != NULL && p4 != p1 );
+    assert( cache.misses() == 3 );
+
+    cache.clear();
+    cache.get(round->segments, round->segment_count, 0.25);
+    assert( cache.misses() == 4 );
+
+    delete round;
+}
+
+int
+main() {
+    test_transform();
+    test_bounds();
+    test_flatten();
+    test_flatten_after_close();
+    test_flatten_cache();
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "path.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    Pathcode code;
+    double   c1x, c1y, c2x, c2y, x, y;
+} ExpectedSegment;
+
+/*
+ * The old digit-by-digit scanner was off by an ulp or two on most
+ * fractions, so results are compared with a small relative tolerance.
+ */
+static bool
+close_to(double a, double b)
+{
+    return fabs(a - b) <= 1e-12 * fmax(1.0, fabs(b));
+}
+
+static void
+check_path(const char *data, const ExpectedSegment *expected, int count)
+{
+    Path *path = sp_svg_read_path(data);
+
+    assert( path->segment_count == count );
+    for (int i = 0; i < count; i++) {
+        const PathSegment &s = path->segments[i];
+        assert( s.code == expected[i].code );
+        assert( close_to(s.c1[0], expected[i].c1x) );
+        assert( close_to(s.c1[1], expected[i].c1y) );
+        assert( close_to(s.c2[0], expected[i].c2x) );
+        assert( close_to(s.c2[1], expected[i].c2y) );
+        assert( close_to(s.pt[0], expected[i].x) );
+        assert( close_to(s.pt[1], expected[i].y) );
+    }
+    delete path;
+}
+
+#define CHECK_PATH(data, expected) \
+    check_path(data, expected, sizeof(expected) / sizeof(expected[0]))
+
+// Expected values below were produced by the parser before the number
+// scanner was rewritten.
+
+void
+test_parse_lines()
+{
+    const ExpectedSegment expected[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 10, 20 },
+        { PATH_LINETO, 0, 0, 0, 0, 30, 40 },
+    };
+    CHECK_PATH("M 10 20 L 30 40", expected);
+
+    const ExpectedSegment hv[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 100, 200 },
+        { PATH_LINETO, 0, 0, 0, 0, 50, 200 },
+        { PATH_LINETO, 0, 0, 0, 0, 50, 25 },
+        { PATH_LINETO, 0, 0, 0, 0, 60, 25 },
+        { PATH_LINETO, 0, 0, 0, 0, 60, 20 },
+    };
+    CHECK_PATH("M 100,200 H 50 V 25 h 10 v -5", hv);
+}
+
+void
+test_parse_curves()
+{
+    const ExpectedSegment cubic[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 0, 0 },
+        { PATH_CURVETO, 1, 2, 3, 4, 5, 6 },
+        { PATH_CURVETO, 7, 8, 7, 8, 9, 10 },
+    };
+    CHECK_PATH("M 0 0 C 1 2 3 4 5 6 S 7 8 9 10", cubic);
+
+    const ExpectedSegment quadratic[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 0, 0 },
+        { PATH_CURVETO, 6.6666666666666661, 13.333333333333332,
+          16.666666666666664, 26.666666666666664, 30, 40 },
+        { PATH_CURVETO, 43.333333333333329, 53.333333333333329, 50, 60, 50, 60 },
+    };
+    CHECK_PATH("M 0 0 Q 10 20 30 40 T 50 60", quadratic);
+}
+
+void
+test_parse_inkscape()
+{
+    // Ship outline, as Inkscape writes relative paths
+    const ExpectedSegment ship[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 354.28571, 440.07647 },
+        { PATH_CURVETO, 356.28571, 440.07647, 357.28571, 439.07647, 358.28571, 438.07647 },
+        { PATH_CURVETO, 362.28571, 463.07647, 360.28571, 488.07647, 369.28571, 488.07647 },
+        { PATH_LINETO, 0, 0, 0, 0, 374.28571, 488.07647 },
+        { PATH_LINETO, 0, 0, 0, 0, 374.28571, 480.07647 },
+        { PATH_END, 0, 0, 0, 0, 0, 0 },
+    };
+    CHECK_PATH("m 354.28571,440.07647 c 2,0 3,-1 4,-2 4,25 2,50 11,50 l 5,0 0,-8 z", ship);
+
+    // Flare, as a sodipodi arc
+    const ExpectedSegment arc[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 374.28571, 495.07647 },
+        { PATH_CURVETO, 374.28570999999999, 506.12216499661588,
+          365.33140499661584, 515.07646999999997, 354.28570999999999, 515.07646999999997 },
+        { PATH_CURVETO, 343.24001500338409, 515.07646999999997,
+          334.28570999999999, 506.12216499661588, 334.28570999999999, 495.07646999999997 },
+        { PATH_CURVETO, 334.28570999999999, 484.03077500338412,
+          343.24001500338409, 475.07646999999997, 354.28570999999999, 475.07646999999997 },
+        { PATH_CURVETO, 365.33140499661584, 475.07646999999997,
+          374.28570999999999, 484.03077500338412, 374.28570999999999, 495.07646999999997 },
+        { PATH_END, 0, 0, 0, 0, 0, 0 },
+    };
+    CHECK_PATH("M 374.28571,495.07647 a 20,20 0 1 1 -40,0 20,20 0 1 1 40,0 z", arc);
+}
+
+void
+test_parse_number_forms()
+{
+    // Numbers run together, relying on '.' and signs as separators
+    const ExpectedSegment packed[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 0.5, 0.5 },
+        { PATH_LINETO, 0, 0, 0, 0, -0.25, -1.75 },
+    };
+    CHECK_PATH("M0.5.5L-.25-1.75", packed);
+
+    const ExpectedSegment exponents[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 100, -0.25 },
+        { PATH_LINETO, 0, 0, 0, 0, 30, 4.125 },
+    };
+    CHECK_PATH("M 1e2 -2.5E-1 L 3e+1 4.125e0", exponents);
+
+    const ExpectedSegment long_numbers[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 1.2345678901234567e+19, 1 },
+        { PATH_LINETO, 0, 0, 0, 0, 1e-06, 1e-07 },
+    };
+    CHECK_PATH("M 12345678901234567890 1 L 0.000001 1e-7", long_numbers);
+}
+
+void
+test_parse_exact()
+{
+    // Every number must come out exactly as strtod rounds it
+    const char *numbers[] = {
+        "0", "-0", "7", "9007199254740993", "0.1", "0.30000000000000004",
+        "354.28571", "-123.456e-3", "1e22", "1e23", "4.9e-324", "2.2250738585072014e-308",
+        "1.7976931348623157e308", "123456789012345678901234567890", ".000000000000000000000001",
+        "3.14159265358979323846264338327950288", "1e-22", "8.5e-23",
+    };
+
+    for (unsigned i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        char data[128];
+        snprintf(data, sizeof(data), "M %s 0", numbers[i]);
+
+        Path *path = sp_svg_read_path(data);
+        assert( path->segment_count == 1 );
+        assert( path->segments[0].pt[0] == strtod(numbers[i], NULL) );
+        delete path;
+    }
+}
+
+void
+test_parse_errors()
+{
+    // A malformed number ends the path at the last complete segment
+    const ExpectedSegment double_exponent[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 0, 0 },
+        { PATH_LINETO, 0, 0, 0, 0, 1000, 2 },
+    };
+    CHECK_PATH("M 0 0 L 1e3 2 L 1e3e4 5 L 6 7", double_exponent);
+
+    const ExpectedSegment empty_exponent[] = {
+        { PATH_MOVETO, 0, 0, 0, 0, 1, 1 },
+    };
+    CHECK_PATH("M 1 1 L 2e 3", empty_exponent);
+    CHECK_PATH("M 1 1 L 2e+ 3", empty_exponent);
+    CHECK_PATH("M 1 1 L - 3", empty_exponent);
+
+    Path *path = sp_svg_read_path("M 1e3e4 2 L 5 5");
+    assert( path->segment_count == 0 );
+    delete path;
+}
+
+int
+main() {
+    test_parse_lines();
+    test_parse_curves();
+    test_parse_inkscape();
+    test_parse_number_forms();
+    test_parse_exact();
+    test_parse_errors();
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "path.h"
+#include "path-stream.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *samples[] = {
+    "M 10,20 L 30,40 l 5-5 h 10 v -10 H 0 V 0 z",
+    "m 1e2,-2.5E-1 c 1,2 3,4 5,6 s 7,8 9,10 q 1,1 2,2 t 3,3 Z m 5 5 l 1 1",
+    "M0,0C.5.5-1-1,2e1-3e+1S1.5.25.75-.125zl10,10",
+    "M 100 100 A 50 25 30 1 0 200 150 a 10 10 0 0 1 -20 0 z",
+    "M 1 1 L 2 2 3 3 4 4 T 9 9",
+    "M 0 0 L 1e3 2 L 1e3e4 5 L 6 7",
+    "M 1 1 L 2e 3",
+    "M-1-2-3-4-5-6",
+};
+
+#define NUM_SAMPLES (int) (sizeof(samples) / sizeof(samples[0]))
+
+static void
+assert_same_path(const Path *a, const Path *b)
+{
+    assert( a->segment_count == b->segment_count );
+    for (int i = 0; i < a->segment_count; i++) {
+        const PathSegment &s = a->segments[i];
+        const PathSegment &t = b->segments[i];
+        assert( s.code == t.code );
+        assert( s.c1[0] == t.c1[0] && s.c1[1] == t.c1[1] );
+        assert( s.c2[0] == t.c2[0] && s.c2[1] == t.c2[1] );
+        assert( s.pt[0] == t.pt[0] && s.pt[1] == t.pt[1] );
+    }
+}
+
+void
+test_stream_whole()
+{
+    // Streaming into a builder gives exactly what sp_svg_read_path does
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        Path *expected = sp_svg_read_path(samples[i]);
+        Path path;
+        PathBuilderSink sink(&path);
+
+        svg_parse_path(samples[i], sink);
+        assert_same_path(&path, expected);
+        delete expected;
+    }
+}
+
+void
+test_stream_split()
+{
+    // Cutting the data in two anywhere makes no difference
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        Path *expected = sp_svg_read_path(samples[i]);
+        size_t length = strlen(samples[i]);
+
+        for (size_t cut = 0; cut <= length; cut++) {
+            Path path;
+            PathBuilderSink sink(&path);
+            PathStreamParser<PathBuilderSink> parser(sink);
+
+            parser.feed(samples[i], cut);
+            parser.feed(samples[i] + cut, length - cut);
+            parser.finish();
+            assert_same_path(&path, expected);
+        }
+        delete expected;
+    }
+}
+
+void
+test_stream_chunks()
+{
+    // Nor does feeding it in chunks of any size
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        Path *expected = sp_svg_read_path(samples[i]);
+        size_t length = strlen(samples[i]);
+
+        for (size_t chunk = 1; chunk <= length; chunk++) {
+            Path path;
+            PathBuilderSink sink(&path);
+            PathStreamParser<PathBuilderSink> parser(sink);
+
+            for (size_t at = 0; at < length; at += chunk)
+                parser.feed(samples[i] + at, at + chunk < length ? chunk : length - at);
+            parser.finish();
+            assert_same_path(&path, expected);
+        }
+        delete expected;
+    }
+}
+
+void
+test_stream_errors()
+{
+    Path path;
+    PathBuilderSink sink(&path);
+    PathStreamParser<PathBuilderSink> parser(sink);
+
+    // An error stops the stream at the last complete segment
+    assert( parser.feed("M 1 1 L 2 2 L 3e", 16) );
+    assert( !parser.feed("e 4 L 5 5", 9) );
+    assert( !parser.feed(" L 6 6", 6) );
+    assert( !parser.finish() );
+    assert( path.segment_count == 2 );
+
+    // As does a number too long to hold over between chunks
+    char digits[PATH_STREAM_MAX_TOKEN + 2];
+    memset(digits, '1', sizeof(digits));
+    Path long_path;
+    PathBuilderSink long_sink(&long_path);
+    PathStreamParser<PathBuilderSink> long_parser(long_sink);
+
+    assert( long_parser.feed("M 0 0 L ", 8) );
+    assert( !long_parser.feed(digits, sizeof(digits)) );
+    assert( long_path.segment_count == 1 );
+}
+
+class CountingSink {
+public:
+    int moves, lines, curves, closes;
+
+    CountingSink() : moves(0), lines(0), curves(0), closes(0) {}
+    void move_to(double, double) { moves++; }
+    void line_to(double, double) { lines++; }
+    void curve_to(double, double, double, double, double, double) { curves++; }
+    void close_path() { closes++; }
+};
+
+void
+test_stream_unbounded()
+{
+    // A path far bigger than anything kept in memory, made up as it goes
+    CountingSink sink;
+    PathStreamParser<CountingSink> parser(sink);
+    char chunk[64];
+    int n;
+
+    parser.feed("M 0 0", 5);
+    for (int i = 0; i < 100000; i++) {
+        n = snprintf(chunk, sizeof(chunk), " l %d.5,-%d c 1 2 3 4 5 6", i % 97, i % 13);
+        assert( parser.feed(chunk, n) );
+        if (i % 100 == 99)
+            assert( parser.feed(" z", 2) );
+    }
+    assert( parser.finish() );
+
+    assert( sink.moves == 1000 );
+    assert( sink.lines == 100000 );
+    assert( sink.curves == 100000 );
+    assert( sink.closes == 1000 );
+}
+
+int
+main() {
+    test_stream_whole();
+    test_stream_split();
+    test_stream_chunks();
+    test_stream_errors();
+    test_stream_unbounded();
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <gtk/gtk.h>
+
+#include "presenter.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+static PresentSupport
+support(bool shm, bool image, bool visual_matches)
+{
+    PresentSupport s;
+
+    s.shm = shm;
+    s.image = image;
+    s.visual_matches = visual_matches;
+    return s;
+}
+
+void
+test_fallback()
+{
+    // Everything works
+    assert( present_mode_fallback(PRESENT_SHM, support(true, true, true)) == PRESENT_SHM );
+    assert( present_mode_fallback(PRESENT_IMAGE, support(false, true, true)) == PRESENT_IMAGE );
+    assert( present_mode_fallback(PRESENT_GDK, support(true, true, true)) == PRESENT_GDK );
+
+    // No shared memory, as on a remote display
+    assert( present_mode_fallback(PRESENT_SHM, support(false, true, true)) == PRESENT_IMAGE );
+
+    // A visual cairo can't draw into
+    assert( present_mode_fallback(PRESENT_SHM, support(true, true, false)) == PRESENT_GDK );
+    assert( present_mode_fallback(PRESENT_IMAGE, support(false, true, false)) == PRESENT_GDK );
+
+    // No image at all
+    assert( present_mode_fallback(PRESENT_SHM, support(false, false, false)) == PRESENT_GDK );
+    assert( present_mode_fallback(PRESENT_IMAGE, support(false, false, false)) == PRESENT_GDK );
+}
+
+static void
+present_frames(Presenter &presenter, GtkWidget *widget, PresentMode wanted)
+{
+    presenter.set_mode(wanted);
+    for (int i = 0; i < 3; i++) {
+        cairo_t *cr = presenter.begin(widget);
+
+        cairo_set_source_rgb(cr, 0.1, 0.0, 0.1);
+        cairo_paint(cr);
+        presenter.present(cr);
+        if (presenter.mode() != PRESENT_GDK)
+            assert( cairo_surface_get_type(cairo_get_target(cr)) == CAIRO_SURFACE_TYPE_IMAGE );
+        cairo_destroy(cr);
+    }
+
+    // Only ever a step down from what was asked for
+    switch (wanted) {
+    case PRESENT_SHM:
+        break;
+    case PRESENT_IMAGE:
+        assert( presenter.mode() != PRESENT_SHM );
+        break;
+    case PRESENT_GDK:
+        assert( presenter.mode() == PRESENT_GDK );
+        break;
+    }
+}
+
+/* Runs each mode against a real window, when there's a display to open one on */
+void
+test_window(int *argc, char ***argv)
+{
+    Presenter presenter;
+
+    if (!gtk_init_check(argc, argv)) {
+        printf("No display; skipping the window test\n");
+        return;
+    }
+
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_default_size(GTK_WINDOW(window), 64, 48);
+    gtk_widget_set_double_buffered(window, FALSE);
+    gtk_widget_show(window);
+    while (gtk_events_pending())
+        gtk_main_iteration();
+
+    present_frames(presenter, window, PRESENT_SHM);
+    present_frames(presenter, window, PRESENT_IMAGE);
+    present_frames(presenter, window, PRESENT_GDK);
+
+    gtk_widget_destroy(window);
+}
+
+int
+main(int argc, char **argv)
+{
+    test_fallback();
+    test_window(&argc, &argv);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void
+test_profiler_buckets()
+{
+    // Small times get a bucket each
+    for (int i = 0; i < PROFILE_SUB_BUCKETS; i++) {
+        assert( profile_bucket(i) == i );
+        assert( profile_bucket_limit(i) == (guint64) i );
+    }
+
+    // Every time falls within its bucket, no more than an eighth off
+    for (guint64 n = 1; n < (1ull << 40); n = n * 3 / 2 + 1) {
+        int bucket = profile_bucket(n);
+        assert( bucket >= 0 && bucket < PROFILE_BUCKETS );
+        if (bucket == PROFILE_BUCKETS - 1)
+            continue;
+        assert( n <= profile_bucket_limit(bucket) );
+        assert( bucket == 0 || n > profile_bucket_limit(bucket - 1) );
+        assert( profile_bucket_limit(bucket) - n <= n / PROFILE_SUB_BUCKETS );
+    }
+
+    // Buckets are in order
+    for (int i = 1; i < PROFILE_BUCKETS; i++)
+        assert( profile_bucket_limit(i) > profile_bucket_limit(i - 1) );
+}
+
+void
+test_profiler_percentiles()
+{
+    Profiler profiler;
+
+    assert( profiler.percentile(PROFILE_FRAME, 0.5) == 0 );
+
+    // 990 quick frames and 10 hitches
+    for (int i = 0; i < 990; i++)
+        profiler.record(PROFILE_FRAME, 1000000);
+    for (int i = 0; i < 10; i++)
+        profiler.record(PROFILE_FRAME, 50000000);
+
+    const ProfileHistogram &h = profiler.histogram(PROFILE_FRAME);
+    assert( h.count == 1000 );
+    assert( h.max == 50000000 );
+
+    guint64 p50 = profiler.percentile(PROFILE_FRAME, 0.50);
+    assert( p50 >= 1000000 && p50 <= 1000000 * 9 / 8 );
+    assert( profiler.percentile(PROFILE_FRAME, 0.99) == p50 );
+    assert( profiler.percentile(PROFILE_FRAME, 0.995) == 50000000 );
+    assert( profiler.percentile(PROFILE_FRAME, 1.0) == 50000000 );
+
+    // Negative times from a clock that went backwards count as zero
+    profiler.record(PROFILE_TICK, -5);
+    assert( profiler.histogram(PROFILE_TICK).max == 0 );
+
+    profiler.reset();
+    assert( profiler.histogram(PROFILE_FRAME).count == 0 );
+}
+
+void
+test_profiler_lap()
+{
+    Profiler profiler;
+    gint64 start = profile_now_ns();
+    gint64 t = profiler.lap(PROFILE_TICK, start);
+
+    assert( t >= start );
+    assert( profiler.histogram(PROFILE_TICK).count == 1 );
+    assert( profiler.histogram(PROFILE_TICK).max == (guint64) (t - start) );
+
+    FILE *fp = tmpfile();
+    char line[256];
+    profiler.dump(fp);
+    rewind(fp);
+    assert( fgets(line, sizeof(line), fp) );
+    assert( fgets(line, sizeof(line), fp) );
+    assert( strncmp(line, "tick ", 5) == 0 );
+    assert( !fgets(line, sizeof(line), fp) );
+    fclose(fp);
+}
+
+int
+main() {
+    test_profiler_buckets();
+    test_profiler_percentiles();
+    test_profiler_lap();
+
+    return 0;
+}
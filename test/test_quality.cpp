@@ -0,0 +1,60 @@
+#include "quality.h"
+
+#include <assert.h>
+
+/* Frames of the given time until the resolution or tier changes */
+static int
+frames_until_step(QualityController &quality, double millis)
+{
+    RenderQuality tier = quality.tier();
+    double resolution = quality.resolution();
+
+    for (int frames = 1; frames < 10000; frames++) {
+        quality.frame_finished(millis);
+        if (quality.tier() != tier || quality.resolution() != resolution)
+            return frames;
+    }
+    return -1;
+}
+
+void
+test_quality_fixed()
+{
+    QualityController quality(16);
+
+    quality.set_mode(QUALITY_MEDIUM);
+    for (int i = 0; i < 100; i++)
+        quality.frame_finished(40);
+    assert( quality.tier() == QUALITY_MEDIUM && quality.resolution() == 1.0 );
+}
+
+void
+test_quality_recovers()
+{
+    QualityController quality(16);
+
+    // A slow start steps down several tiers in a row
+    for (int i = 0; i < 3; i++)
+        assert( frames_until_step(quality, 14) > 0 );
+    assert( quality.tier() == QUALITY_LOW && quality.resolution() == 0.75 );
+
+    // None of those undid an upgrade, so the first one back up comes
+    // after the shortest wait, plus the average settling
+    int frames = frames_until_step(quality, 1);
+    assert( frames > 50 && frames < 100 );
+    assert( quality.tier() == QUALITY_MEDIUM && quality.resolution() == 0.75 );
+
+    // An upgrade that has to be undone straight away doubles the wait
+    assert( frames_until_step(quality, 14) > 0 );
+    frames = frames_until_step(quality, 1);
+    assert( frames > 100 && frames < 150 );
+}
+
+int
+main()
+{
+    test_quality_fixed();
+    test_quality_recovers();
+
+    return 0;
+}
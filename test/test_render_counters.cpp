@@ -0,0 +1,114 @@
+#include <cairo.h>
+
+#include "counted-cairo.h"
+#include "render-counters.h"
+
+#include <assert.h>
+#include <string.h>
+
+static void
+draw_square(cairo_t *cr, double scale)
+{
+    cairo_save(cr);
+    cairo_translate(cr, 10, 10);
+    cairo_scale(cr, scale, scale);
+    cairo_rectangle(cr, 0, 0, 20, 10);
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_fill(cr);
+    cairo_restore(cr);
+}
+
+static void
+draw_offscreen(cairo_t *cr)
+{
+    cairo_rectangle(cr, -100, -100, 10, 10);
+    cairo_fill(cr);
+}
+
+static void
+draw_background(cairo_t *cr)
+{
+    cairo_save(cr);
+    cairo_rectangle(cr, 0, 0, 30, 30);
+    cairo_clip(cr);
+    cairo_paint(cr);
+    cairo_restore(cr);
+}
+
+static const RenderCounts *
+find_caller(const char *name, const char **names, const RenderCounts *counts, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (strstr(names[i], name))
+            return &counts[i];
+    return NULL;
+}
+
+void
+test_frame_counts(cairo_t *cr)
+{
+    render_counters_reset();
+    draw_square(cr, 1);
+    draw_square(cr, 2);
+    draw_offscreen(cr);
+    draw_background(cr);
+    render_counters_end_frame();
+
+    const RenderCounts &frame = render_counters_frame();
+    assert( frame.calls[RENDER_SAVE] == 3 && frame.calls[RENDER_RESTORE] == 3 );
+    assert( frame.calls[RENDER_TRANSFORM] == 4 );
+    assert( frame.calls[RENDER_SOURCE] == 2 );
+    assert( frame.calls[RENDER_FILL] == 3 );
+    assert( frame.calls[RENDER_PAINT] == 1 );
+    assert( render_counters_total(frame) == 16 );
+    // 20x10, the same scaled by two, nothing off the surface and the 30x30 clip
+    assert( frame.pixels == 200 + 800 + 0 + 900 );
+
+    // The next frame starts from nothing
+    render_counters_end_frame();
+    assert( render_counters_total(render_counters_frame()) == 0 );
+}
+
+void
+test_callers(cairo_t *cr)
+{
+    const char *names[MAX_RENDER_CALLERS + 1];
+    RenderCounts counts[MAX_RENDER_CALLERS + 1];
+    const RenderCounts *square, *background;
+    int n;
+
+    render_counters_reset();
+    draw_square(cr, 1);
+    draw_background(cr);
+    draw_square(cr, 1);
+    render_counters_end_frame();
+
+    n = render_counters_callers(names, counts, MAX_RENDER_CALLERS + 1);
+    assert( n == 2 );
+    // Most pixels first
+    assert( strstr(names[0], "draw_background") );
+    square = find_caller("draw_square", names, counts, n);
+    background = find_caller("draw_background", names, counts, n);
+    assert( square && background );
+    assert( square->calls[RENDER_FILL] == 2 && square->pixels == 400 );
+    assert( background->calls[RENDER_PAINT] == 1 && background->pixels == 900 );
+    assert( find_caller("draw_offscreen", names, counts, n) == NULL );
+
+    render_counters_reset();
+    assert( render_counters_callers(names, counts, MAX_RENDER_CALLERS + 1) == 0 );
+}
+
+int
+main()
+{
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 100, 100);
+    cairo_t *cr = cairo_create(surface);
+
+    assert( render_counters_enabled() );
+    test_frame_counts(cr);
+    test_callers(cr);
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return 0;
+}
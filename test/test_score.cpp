@@ -1,7 +1,9 @@
 #include "score.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 void
 test_score_init()
@@ -124,6 +126,132 @@ test_highscore_init()
     assert( score.amount() == 0.0 );
 }
 
+void
+test_score_copy()
+{
+    Score score;
+    score.record(500, 3, "cpy");
+    assert( score.to_string() != NULL );
+
+    // Copies don't share the string form
+    Score copy(score);
+    Score assigned;
+    assigned = score;
+    assert( copy.amount() == 500 );
+    assert( assigned.amount() == 500 );
+    assert( copy.to_string() != score.to_string() );
+    assert( strcmp(copy.to_string(), score.to_string()) == 0 );
+    assert( strcmp(assigned.to_string(), score.to_string()) == 0 );
+
+    assigned = assigned;
+    assert( strcmp(assigned.to_string(), score.to_string()) == 0 );
+}
+
+void
+test_score_record_conversion()
+{
+    Score score, back;
+    ScoreRecord rec;
+
+    score.record(1234, 5, "rec");
+    score.to_record(&rec);
+    assert( rec.amount == 1234 );
+    assert( rec.level == 5 );
+    assert( strcmp(rec.initials, "rec") == 0 );
+
+    back.from_record(&rec);
+    assert( strcmp(back.to_string(), score.to_string()) == 0 );
+}
+
+void
+test_score_chars()
+{
+    Score score, back;
+    char buf[MAX_SCORE_TEXT];
+    char *end;
+    const char *line = "2015-04-22.20:47:35 abc 7 4200\nnext";
+
+    // Reads exactly one score and stops
+    assert( score.from_chars(line, line + strlen(line)) == line + 30 );
+    assert( score.is_recorded() );
+    assert( score.level() == 7 );
+    assert( score.amount() == 4200 );
+
+    // And writes it back the same, newline included
+    end = score.to_chars(buf, buf + sizeof(buf));
+    assert( end == buf + 31 );
+    assert( memcmp(buf, line, 31) == 0 );
+
+    // Too small a buffer is refused rather than overrun
+    assert( score.to_chars(buf, buf + 30) == NULL );
+    assert( back.to_chars(buf, buf + sizeof(buf)) == NULL );
+
+    // A failed parse leaves the score alone
+    assert( !score.from_string("2015-04-22.20:47:35 abc 7") );
+    assert( !score.from_string("2015-04-22.20:47:35 abc 7 99999999999") );
+    assert( !score.from_string("2015-04-22 abc 7 10") );
+    assert( score.amount() == 4200 );
+
+    // Short fields, tabs and long initials are taken as sscanf would
+    assert( score.from_string("2015-4-2.3:04:05\tlonger +8  9\n") );
+    assert( strcmp(score.to_string(), "2015-04-02.03:04:05 lon 8 9\n") == 0 );
+
+    // Copies are plain memory
+    memcpy((void *) &back, (const void *) &score, sizeof(Score));
+    assert( strcmp(back.to_string(), score.to_string()) == 0 );
+}
+
+void
+test_score_record_once()
+{
+    Score score;
+
+    assert( !score.is_recorded() );
+    assert( score.record(10, 1, "one") );
+    assert( !score.record(20, 2, "two") );
+    assert( score.amount() == 10 );
+    assert( score.level() == 1 );
+
+    score = Score();
+    assert( score.record(20, 2, "two") );
+}
+
+void
+test_highscore_insert()
+{
+    HighScores high_scores;
+    Score score;
+
+    score.record(10, 1, "a");
+    assert( high_scores.insert(score) == 0 );
+    score = Score();
+    score.record(30, 1, "b");
+    assert( high_scores.insert(score) == 0 );
+    score = Score();
+    score.record(20, 1, "c");
+    assert( high_scores.insert(score) == 1 );
+    assert( high_scores.insert(Score()) == -1 );
+
+    assert( high_scores.count() == 3 );
+    assert( high_scores.get(0).amount() == 30 );
+    assert( high_scores.get(1).amount() == 20 );
+    assert( high_scores.get(2).amount() == 10 );
+}
+
+/* A read error ends the load rather than being retried forever */
+void
+test_highscore_load_error()
+{
+    HighScores high_scores;
+    char dir[] = "/tmp/test_score_XXXXXX";
+
+    assert( mkdtemp(dir) );
+    // Opening a directory works, but reading it fails with EISDIR
+    assert( !high_scores.load(dir) );
+    assert( high_scores.count() == 0 );
+    assert( rmdir(dir) == 0 );
+}
+
 int
 main() {
     test_score_init();
@@ -135,6 +263,12 @@ main() {
     test_string_conversion_truncate();
     test_parse_valid_strings();
     test_parse_invalid_strings();
+    test_score_copy();
+    test_score_record_conversion();
+    test_highscore_insert();
+    test_highscore_load_error();
+    test_score_chars();
+    test_score_record_once();
 
     return 0;
 }
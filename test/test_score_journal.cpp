@@ -0,0 +1,136 @@
+#include "score-journal.h"
+#include "make-score.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+static int drained[8];
+static int num_drained = 0;
+static bool accept_drain = true;
+
+static bool
+on_drain(const ScoreRecord *records, int count, gpointer user_data)
+{
+    assert( user_data == &num_drained );
+    for (int i = 0; i < count && num_drained < 8; i++)
+        drained[num_drained++] = records[i].amount;
+    return accept_drain;
+}
+
+static off_t
+file_size(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    off_t size = lseek(fd, 0, SEEK_END);
+    close(fd);
+    return size;
+}
+
+void
+test_journal_append_drain()
+{
+    char path[] = "/tmp/test_score_journal_XXXXXX";
+    ScoreJournal journal;
+
+    close(mkstemp(path));
+    gchar *aside = g_strdup_printf ("%s.folding", path);
+    assert( journal.open(path) );
+    assert( journal.append(make_score(10, 1, "j")) );
+    assert( journal.append(make_score(0, 1, "j")) );
+    assert( journal.append(make_score(30, 1, "j")) );
+    assert( file_size(path) == 3 * sizeof(ScoreJournalEntry) );
+
+    // Records come out oldest first, and stay aside if they aren't taken
+    accept_drain = false;
+    assert( journal.drain(on_drain, &num_drained) == 3 );
+    assert( num_drained == 3 );
+    assert( drained[0] == 10 && drained[1] == 0 && drained[2] == 30 );
+    assert( file_size(path) == -1 );
+    assert( file_size(aside) == 3 * sizeof(ScoreJournalEntry) );
+
+    // Appends carry on in a new journal, which waits for the batch aside
+    assert( journal.append(make_score(40, 1, "j")) );
+    assert( file_size(path) == sizeof(ScoreJournalEntry) );
+    num_drained = 0;
+    accept_drain = true;
+    assert( journal.drain(on_drain, &num_drained) == 4 );
+    assert( num_drained == 4 );
+    assert( drained[0] == 10 && drained[3] == 40 );
+    assert( file_size(path) == -1 && file_size(aside) == -1 );
+
+    assert( journal.append(make_score(50, 1, "j")) );
+    num_drained = 0;
+    assert( journal.drain(on_drain, &num_drained) == 1 );
+    assert( drained[0] == 50 );
+
+    journal.close();
+    assert( !journal.append(make_score(60, 1, "j")) );
+    assert( journal.drain(on_drain, &num_drained) == -1 );
+    unlink(path);
+    g_free (aside);
+}
+
+/* An append never waits for a drain moving the journal aside */
+void
+test_journal_busy()
+{
+    char path[] = "/tmp/test_score_journal_XXXXXX";
+    ScoreJournal journal;
+    int fd;
+
+    close(mkstemp(path));
+    assert( journal.open(path) );
+    assert( journal.append(make_score(10, 1, "j")) );
+
+    fd = open(path, O_RDONLY);
+    assert( flock(fd, LOCK_EX) == 0 );
+    assert( !journal.append(make_score(20, 1, "j")) );
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    assert( journal.append(make_score(30, 1, "j")) );
+    num_drained = 0;
+    assert( journal.drain(on_drain, &num_drained) == 2 );
+    assert( drained[0] == 10 && drained[1] == 30 );
+    unlink(path);
+}
+
+void
+test_journal_damaged()
+{
+    char path[] = "/tmp/test_score_journal_XXXXXX";
+    ScoreJournal journal;
+    int fd;
+
+    close(mkstemp(path));
+    assert( journal.open(path) );
+    assert( journal.append(make_score(10, 1, "j")) );
+    assert( journal.append(make_score(20, 1, "j")) );
+    assert( journal.append(make_score(30, 1, "j")) );
+
+    // Scribble over the middle entry and tear off the end of the last
+    fd = open(path, O_RDWR);
+    assert( pwrite(fd, "xx", 2, sizeof(ScoreJournalEntry) + 12) == 2 );
+    assert( ftruncate(fd, 3 * sizeof(ScoreJournalEntry) - 4) == 0 );
+    close(fd);
+
+    num_drained = 0;
+    assert( journal.drain(on_drain, &num_drained) == 1 );
+    assert( drained[0] == 10 );
+    assert( file_size(path) == -1 );
+}
+
+int
+main() {
+    test_journal_append_drain();
+    test_journal_busy();
+    test_journal_damaged();
+
+    return 0;
+}
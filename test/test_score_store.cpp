@@ -0,0 +1,216 @@
+#include "score-store.h"
+#include "make-score.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char store_path[] = "/tmp/test_score_store_XXXXXX";
+static char text_path[] = "/tmp/test_score_text_XXXXXX";
+
+static void
+fresh_file(char *path)
+{
+    int fd = mkstemp(path);
+    assert( fd >= 0 );
+    close(fd);
+    unlink(path);
+}
+
+static void
+remove_store(const char *path)
+{
+    char lock_path[64];
+
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    unlink(lock_path);
+    unlink(path);
+}
+
+void
+test_store_create()
+{
+    ScoreStore store;
+
+    fresh_file(store_path);
+    assert( store.open(store_path) );
+    assert( store.is_open() );
+    assert( store.count() == 0 );
+    assert( store.min_amount() == 0 );
+
+    // Empty scores don't make the table
+    assert( store.insert(Score()) == -1 );
+    assert( store.count() == 0 );
+}
+
+void
+test_store_order()
+{
+    ScoreStore store;
+    Score score;
+
+    assert( store.open(store_path) );
+    assert( store.insert(make_score(50, 1, "b")) == 0 );
+    assert( store.insert(make_score(100, 1, "a")) == 0 );
+    assert( store.insert(make_score(10, 1, "d")) == 2 );
+
+    // Ties go below the scores already there
+    assert( store.insert(make_score(50, 1, "c")) == 2 );
+    assert( store.count() == 4 );
+
+    const int amounts[] = { 100, 50, 50, 10 };
+    const char *initials[] = { "a", "b", "c", "d" };
+    for (int i = 0; i < 4; i++) {
+        assert( store.get(i, &score) );
+        assert( score.amount() == amounts[i] );
+        assert( strstr(score.to_string(), initials[i]) != NULL );
+    }
+    assert( !store.get(4, &score) );
+    assert( !store.get(-1, &score) );
+}
+
+void
+test_store_persists()
+{
+    ScoreStore store;
+    Score score;
+
+    // Reopening sees what was written before
+    assert( store.open(store_path) );
+    assert( store.count() == 4 );
+    assert( store.get(0, &score) );
+    assert( score.amount() == 100 );
+    assert( score.level() == 1 );
+}
+
+void
+test_store_shared()
+{
+    ScoreStore a, b;
+    Score score;
+
+    // Two opens of one file share the table, even once one of them has
+    // replaced the file
+    assert( a.open(store_path) );
+    assert( b.open(store_path) );
+    assert( a.insert(make_score(75, 1, "e")) == 1 );
+    assert( b.count() == 5 );
+    assert( b.get(1, &score) );
+    assert( score.amount() == 75 );
+}
+
+void
+test_store_full()
+{
+    ScoreStore store;
+    Score score;
+
+    assert( store.open(store_path) );
+    for (int i = store.count(); i < SCORE_STORE_CAPACITY; i++)
+        assert( store.insert(make_score(20, 1, "f")) >= 0 );
+    assert( store.count() == SCORE_STORE_CAPACITY );
+    assert( store.min_amount() == 10 );
+
+    // The lowest score falls off the end, and ties with it don't get in
+    assert( store.insert(make_score(15, 1, "g")) == SCORE_STORE_CAPACITY - 1 );
+    assert( store.min_amount() == 15 );
+    assert( store.insert(make_score(15, 1, "h")) == -1 );
+    assert( store.insert(make_score(5, 1, "i")) == -1 );
+    assert( store.count() == SCORE_STORE_CAPACITY );
+
+    assert( store.insert(make_score(1000, 1, "j")) == 0 );
+    assert( store.get(SCORE_STORE_CAPACITY - 1, &score) );
+    assert( score.amount() == 20 );
+}
+
+void
+test_store_text()
+{
+    ScoreStore store, copy;
+    Score a, b;
+    char copy_path[] = "/tmp/test_score_copy_XXXXXX";
+
+    // Export to the text format and import it into a new file
+    fresh_file(text_path);
+    fresh_file(copy_path);
+    assert( store.open(store_path) );
+    assert( store.export_text(text_path) );
+    assert( copy.open(copy_path) );
+    assert( copy.import_text(text_path) == SCORE_STORE_CAPACITY );
+    assert( copy.count() == SCORE_STORE_CAPACITY );
+    for (int i = 0; i < SCORE_STORE_CAPACITY; i++) {
+        assert( store.get(i, &a) );
+        assert( copy.get(i, &b) );
+        assert( strcmp(a.to_string(), b.to_string()) == 0 );
+    }
+
+    assert( copy.import_text("/nonexistent/scores.txt") == -1 );
+
+    // Opening a directory works, but reading it doesn't
+    char dir[] = "/tmp/test_score_dir_XXXXXX";
+    assert( mkdtemp(dir) );
+    assert( copy.import_text(dir) == -1 );
+    assert( copy.count() == SCORE_STORE_CAPACITY );
+    assert( rmdir(dir) == 0 );
+    remove_store(copy_path);
+}
+
+void
+test_store_batch()
+{
+    char batch_path[] = "/tmp/test_score_batch_XXXXXX";
+    ScoreStore store;
+    ScoreRecord recs[3];
+    Score score;
+
+    fresh_file(batch_path);
+    assert( store.open(batch_path) );
+    make_score(20, 1, "a").to_record(&recs[0]);
+    make_score(50, 1, "b").to_record(&recs[1]);
+    make_score(0, 1, "c").to_record(&recs[2]);
+
+    // Blank scores are skipped, and so is a batch seen before
+    assert( store.insert_records(recs, 3) == 2 );
+    assert( store.insert_records(recs, 3) == 0 );
+    assert( store.count() == 2 );
+    assert( store.find(&recs[1]) == 0 );
+    assert( store.find(&recs[0]) == 1 );
+    assert( store.find(&recs[2]) == -1 );
+
+    remove_store(batch_path);
+}
+
+void
+test_store_reject()
+{
+    ScoreStore store;
+    FILE *fp;
+
+    // Anything that isn't a score file is left alone
+    fp = fopen(text_path, "r");
+    assert( fp );
+    fclose(fp);
+    assert( !store.open(text_path) );
+    assert( !store.is_open() );
+    assert( store.count() == 0 );
+    assert( store.insert(make_score(10, 1, "k")) == -1 );
+
+    remove_store(text_path);
+    remove_store(store_path);
+}
+
+int
+main() {
+    test_store_create();
+    test_store_order();
+    test_store_persists();
+    test_store_shared();
+    test_store_full();
+    test_store_text();
+    test_store_batch();
+    test_store_reject();
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "score-writer.h"
+#include "make-score.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int saved_places[8];
+static int saved_ranks[8];
+static int saved_games[8];
+static int num_saved = 0;
+
+static void
+on_saved(const Score *score, int place, int rank, int games, gpointer user_data)
+{
+    assert( user_data == &num_saved );
+    assert( score->amount() > 0 );
+    saved_places[num_saved] = place;
+    saved_ranks[num_saved] = rank;
+    saved_games[num_saved] = games;
+    num_saved++;
+}
+
+void
+test_writer_saves()
+{
+    char dir[] = "/tmp/test_score_writer_XXXXXX";
+    ScoreWriter writer;
+    ScoreStore store;
+    Score score;
+    FILE *fp;
+
+    assert( mkdtemp(dir) );
+    gchar *filename = g_build_filename (dir, "nested", "scores.dat", NULL);
+    gchar *legacy = g_build_filename (dir, "scores.txt", NULL);
+    gchar *lock = g_strdup_printf ("%s.lock", filename);
+    gchar *nested = g_path_get_dirname (filename);
+    gchar *journal = g_strdup_printf ("%s.journal", filename);
+    gchar *history = g_build_filename (nested, "history.rec", NULL);
+    gchar *contents;
+    gsize length;
+
+    // Scores from the old text file are brought over
+    fp = fopen(legacy, "w");
+    assert( fp );
+    fprintf(fp, "2015-04-22.20:47:35 old 3 300\n");
+    fclose(fp);
+
+    assert( writer.start(filename, legacy) );
+    writer.save(make_score(100, 2, "w"), on_saved, &num_saved);
+    writer.save(make_score(500, 2, "w"), on_saved, &num_saved);
+    writer.save(make_score(200, 2, "w"), NULL, NULL);
+    writer.stop();
+
+    // Results come back through the main loop, in order
+    assert( num_saved == 0 );
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+    // The 100 ranks below 300, and below 500 and 200 as well if they
+    // were folded in along with it
+    assert( num_saved == 2 );
+    assert( saved_places[0] == 1 || saved_places[0] == 3 );
+    assert( saved_places[1] == 0 );
+
+    // Ranked among the games in the history, which the old file's aren't
+    assert( saved_games[0] >= 1 && saved_ranks[0] == saved_games[0] - 1 );
+    assert( saved_games[1] >= 2 && saved_ranks[1] == 0 );
+
+    assert( store.open(filename) );
+    assert( store.count() == 4 );
+    assert( store.get(1, &score) );
+    assert( score.amount() == 300 );
+    assert( store.get(2, &score) );
+    assert( score.amount() == 200 );
+    store.close();
+
+    // Every game is kept in the history, and the journal is folded away
+    assert( !g_file_test (journal, G_FILE_TEST_EXISTS) );
+    assert( g_file_get_contents (history, &contents, &length, NULL) );
+    assert( length == 3 * sizeof(ScoreRecord) );
+
+    // A crash before the journal let go of a batch folds it in again,
+    // but doesn't count its games twice
+    ScoreJournal replay;
+    const ScoreRecord *records = (const ScoreRecord *) contents;
+    assert( replay.open(journal) );
+    for (int i = 1; i < 3; i++) {
+        score.from_record(&records[i]);
+        assert( replay.append(score) );
+    }
+    replay.close();
+    g_free (contents);
+
+    // A new run ranks against the history it finds, beyond the table
+    num_saved = 0;
+    assert( writer.start(filename, NULL) );
+    writer.save(make_score(150, 2, "w"), on_saved, &num_saved);
+    writer.stop();
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+    assert( num_saved == 1 );
+    assert( saved_ranks[0] == 2 && saved_games[0] == 4 );
+    assert( g_file_get_contents (history, &contents, &length, NULL) );
+    assert( length == 4 * sizeof(ScoreRecord) );
+    g_free (contents);
+
+    // No temporary files are left behind
+    assert( unlink(filename) == 0 );
+    assert( unlink(lock) == 0 );
+    assert( !g_file_test (journal, G_FILE_TEST_EXISTS) );
+    assert( unlink(history) == 0 );
+    assert( rmdir(nested) == 0 );
+    assert( unlink(legacy) == 0 );
+    assert( rmdir(dir) == 0 );
+
+    g_free (history);
+    g_free (journal);
+    g_free (nested);
+    g_free (lock);
+    g_free (legacy);
+    g_free (filename);
+}
+
+void
+test_writer_unwritable()
+{
+    ScoreWriter writer;
+
+    // A score that can't be saved is reported as not placing
+    num_saved = 0;
+    assert( writer.start("/proc/nonexistent/scores.dat", NULL) );
+    writer.save(make_score(100, 2, "w"), on_saved, &num_saved);
+    writer.stop();
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+    assert( num_saved == 1 );
+    assert( saved_places[0] == -1 );
+    assert( saved_ranks[0] == -1 );
+
+    // Nor does saving after stopping do anything
+    writer.save(make_score(100, 2, "w"), on_saved, &num_saved);
+    assert( !g_main_context_iteration (NULL, FALSE) );
+}
+
+int
+main() {
+    test_writer_saves();
+    test_writer_unwritable();
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <glib.h>
+
+#include "score.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SCORES_DIR
+#define SCORES_DIR "test/data"
+#endif
+
+static const char *tool;
+static char dir[] = "/tmp/test_scores_tool_XXXXXX";
+
+/*
+ * Runs the tool with the given arguments, up to a NULL, with its
+ * standard output in @out.  Returns its exit status.
+ */
+static int
+run(const char *out, ...)
+{
+    const char *argv[16];
+    int argc = 0;
+    int status;
+    va_list ap;
+
+    argv[argc++] = tool;
+    va_start(ap, out);
+    while ((argv[argc++] = va_arg(ap, const char *)) != NULL)
+        assert( argc < 16 );
+    va_end(ap);
+
+    pid_t pid = fork();
+    assert( pid >= 0 );
+    if (pid == 0) {
+        int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || dup2(fd, 1) < 0)
+            _exit(126);
+        execv(tool, (char **) argv);
+        _exit(127);
+    }
+    assert( waitpid(pid, &status, 0) == pid );
+    assert( WIFEXITED(status) );
+    return WEXITSTATUS(status);
+}
+
+static gchar *
+contents_of(const char *filename, gsize *length)
+{
+    gchar *contents;
+
+    assert( g_file_get_contents(filename, &contents, length, NULL) );
+    return contents;
+}
+
+static bool
+file_contains(const char *filename, const char *text)
+{
+    gchar *contents = contents_of(filename, NULL);
+    bool found = strstr(contents, text) != NULL;
+
+    g_free(contents);
+    return found;
+}
+
+void
+test_validate(const char *out)
+{
+    assert( run(out, "validate", SCORES_DIR "/scores-a.txt", SCORES_DIR "/scores-b.txt",
+                NULL) == 0 );
+    assert( file_contains(out, "scores-a.txt: 3 scores, 0 bad\n") );
+    assert( file_contains(out, "scores-b.txt: 2 scores, 0 bad\n") );
+
+    // A bad line, a negative level and a zero score
+    assert( run(out, "validate", SCORES_DIR "/scores-bad.txt", NULL) == 1 );
+    assert( file_contains(out, "scores-bad.txt: 2 scores, 3 bad\n") );
+
+    assert( run(out, "validate", SCORES_DIR "/nonexistent.txt", NULL) == 1 );
+}
+
+void
+test_convert(const char *out, const char *rec, const char *text)
+{
+    gchar *original, *converted;
+    gsize length;
+
+    // Text to records and back again comes out the same
+    assert( run(out, "convert", SCORES_DIR "/scores-a.txt", rec, NULL) == 0 );
+    g_free(contents_of(rec, &length));
+    assert( length == 3 * sizeof(ScoreRecord) );
+
+    assert( run(out, "convert", rec, text, NULL) == 0 );
+    original = contents_of(SCORES_DIR "/scores-a.txt", NULL);
+    converted = contents_of(text, NULL);
+    assert( strcmp(original, converted) == 0 );
+    g_free(original);
+    g_free(converted);
+
+    // Bad scores are left out, but the good ones still go through
+    assert( run(out, "convert", SCORES_DIR "/scores-bad.txt", text, NULL) == 0 );
+    converted = contents_of(text, NULL);
+    assert( strcmp(converted, "2014-05-01.10:00:00 joe 2 700\n"
+                              "2014-05-04.10:00:00 sue 1 650\n") == 0 );
+    g_free(converted);
+
+    assert( run(out, "convert", SCORES_DIR "/nonexistent.txt", text, NULL) == 1 );
+
+    // Converting a file onto itself leaves it as it was
+    gsize again_length;
+    original = contents_of(rec, &length);
+    assert( run(out, "convert", rec, rec, NULL) == 0 );
+    converted = contents_of(rec, &again_length);
+    assert( again_length == length && memcmp(original, converted, length) == 0 );
+    g_free(original);
+    g_free(converted);
+}
+
+void
+test_merge(const char *out, const char *rec, const char *text)
+{
+    gchar *merged;
+
+    // Highest first across text and records; equal scores in input order
+    assert( run(out, "convert", SCORES_DIR "/scores-b.txt", rec, NULL) == 0 );
+    assert( run(out, "merge", text, SCORES_DIR "/scores-a.txt", rec, NULL) == 0 );
+    merged = contents_of(text, NULL);
+    assert( strcmp(merged, "2014-03-02.21:00:05 ann 5 4500\n"
+                           "2014-04-01.12:00:00 kim 4 3000\n"
+                           "2014-03-01.20:15:00 bry 3 1200\n"
+                           "2014-03-03.09:30:10 bry 2 800\n"
+                           "2014-04-02.12:00:00 ann 1 800\n") == 0 );
+
+    // The output can be one of the inputs
+    assert( run(out, "merge", text, text, NULL) == 0 );
+    gchar *again = contents_of(text, NULL);
+    assert( strcmp(again, merged) == 0 );
+    g_free(again);
+    g_free(merged);
+
+    assert( run(out, "merge", "-n", "2", "-", SCORES_DIR "/scores-a.txt", rec, NULL) == 0 );
+    merged = contents_of(out, NULL);
+    assert( strcmp(merged, "2014-03-02.21:00:05 ann 5 4500\n"
+                           "2014-04-01.12:00:00 kim 4 3000\n") == 0 );
+    g_free(merged);
+
+    assert( run(out, "merge", "-n", "0", text, SCORES_DIR "/scores-a.txt", NULL) == 0 );
+    merged = contents_of(text, NULL);
+    assert( merged[0] == '\0' );
+    g_free(merged);
+
+    // Anything but a plain count is refused before a file is read
+    const char *bad_counts[] = { "", "ten", "10x", "-1", "99999999999999999999" };
+    for (size_t i = 0; i < G_N_ELEMENTS(bad_counts); i++)
+        assert( run(out, "merge", "-n", bad_counts[i], text, SCORES_DIR "/scores-a.txt",
+                    NULL) == 2 );
+
+    assert( run(out, "merge", text, SCORES_DIR "/nonexistent.txt", NULL) == 1 );
+}
+
+void
+test_usage(const char *out)
+{
+    assert( run(out, NULL) == 2 );
+    assert( run(out, "convert", SCORES_DIR "/scores-a.txt", NULL) == 2 );
+    assert( run(out, "merge", "-n", "3", NULL) == 2 );
+}
+
+int
+main(int argc, char **argv)
+{
+    assert( argc == 2 );
+    tool = argv[1];
+
+    // The text form is in local time
+    setenv("TZ", "UTC", 1);
+
+    assert( mkdtemp(dir) );
+    gchar *out = g_build_filename(dir, "stdout", NULL);
+    gchar *rec = g_build_filename(dir, "scores.rec", NULL);
+    gchar *text = g_build_filename(dir, "scores.txt", NULL);
+
+    test_validate(out);
+    test_convert(out, rec, text);
+    test_merge(out, rec, text);
+    test_usage(out);
+
+    unlink(out);
+    unlink(rec);
+    unlink(text);
+    assert( rmdir(dir) == 0 );
+    g_free(out);
+    g_free(rec);
+    g_free(text);
+    return 0;
+}
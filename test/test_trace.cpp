@@ -0,0 +1,128 @@
+#include "trace.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char *
+read_trace(const char *path)
+{
+    gchar *contents;
+
+    assert( g_file_get_contents(path, &contents, NULL, NULL) );
+    return contents;
+}
+
+static int
+count(const char *haystack, const char *needle)
+{
+    int n = 0;
+
+    for (const char *p = haystack; (p = strstr(p, needle)); p++)
+        n++;
+    return n;
+}
+
+static void *
+worker(void *)
+{
+    trace_set_thread_name("worker");
+    TRACE_ZONE("work");
+    TRACE_COUNTER("items", 42);
+    return NULL;
+}
+
+void
+test_trace_disabled()
+{
+    char path[] = "/tmp/test_trace_XXXXXX";
+    char *json;
+
+    close(mkstemp(path));
+
+    // Nothing is recorded until tracing starts
+    {
+        TRACE_ZONE("ignored");
+        TRACE_COUNTER("ignored", 1);
+    }
+    assert( trace_write(path) );
+    json = read_trace(path);
+    assert( strstr(json, "\"traceEvents\":[") );
+    assert( !strstr(json, "ignored") );
+    g_free(json);
+    unlink(path);
+}
+
+void
+test_trace_threads()
+{
+    char path[] = "/tmp/test_trace_XXXXXX";
+    pthread_t thread;
+    char *json;
+
+    close(mkstemp(path));
+    trace_start();
+    trace_set_thread_name("main");
+    {
+        TRACE_ZONE("outer");
+        TRACE_BEGIN("inner \"quoted\"");
+        TRACE_END("inner \"quoted\"");
+    }
+    assert( pthread_create(&thread, NULL, worker, NULL) == 0 );
+    pthread_join(thread, NULL);
+    trace_stop();
+
+    assert( trace_write(path) );
+    json = read_trace(path);
+    assert( count(json, "\"name\":\"thread_name\"") == 2 );
+    assert( strstr(json, "\"args\":{\"name\":\"worker\"}") );
+    assert( count(json, "\"name\":\"outer\",\"ph\":\"B\"") == 1 );
+    assert( count(json, "\"name\":\"outer\",\"ph\":\"E\"") == 1 );
+    assert( strstr(json, "\"name\":\"inner \\\"quoted\\\"\"") );
+    assert( strstr(json, "\"name\":\"items\",\"ph\":\"C\"") );
+    assert( strstr(json, "\"args\":{\"value\":42}") );
+    assert( strstr(json, "\n]}\n") );
+    g_free(json);
+    unlink(path);
+}
+
+void
+test_trace_wraps()
+{
+    char path[] = "/tmp/test_trace_XXXXXX";
+    char *json;
+
+    // The ring keeps the newest events, and drops ends it lost the
+    // beginnings of
+    close(mkstemp(path));
+    trace_start();
+    TRACE_BEGIN("long");
+    for (int i = 0; i < TRACE_RING_SIZE; i++)
+        TRACE_COUNTER("tick", i);
+    TRACE_END("long");
+    trace_stop();
+
+    assert( trace_write(path) );
+    json = read_trace(path);
+    assert( !strstr(json, "\"name\":\"long\"") );
+    assert( strstr(json, "\"value\":65535}") );
+    assert( !strstr(json, "\"value\":0}") );
+
+    // Nor the slot the thread could be writing the next event into
+    assert( !strstr(json, "\"value\":1}") );
+    assert( strstr(json, "\"value\":2}") );
+    g_free(json);
+    unlink(path);
+}
+
+int
+main() {
+    test_trace_disabled();
+    test_trace_threads();
+    test_trace_wraps();
+
+    return 0;
+}
@@ -0,0 +1,497 @@
+/* spacecastle - A vector graphics space shooter game
+ *
+ * Copyright © 2014 Bryce Harrington
+ *
+ * Spacecastle is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Spacecastle is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spacecastle.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks, converts and merges dumps of scores.
+ *
+ *   spacecastle-scores validate FILE...
+ *   spacecastle-scores convert IN OUT
+ *   spacecastle-scores merge [-n COUNT] OUT IN...
+ *
+ * Files ending in .rec hold raw ScoreRecords; anything else is the text
+ * format, one score a line.  OUT may be - for standard output; a file
+ * is written beside itself and renamed into place, so it can be one of
+ * the inputs.  Inputs are mapped rather than read, and merging sorts small keys pointing
+ * back into them, so dumps of millions of scores go through at about
+ * the speed of the disk.
+ */
+
+#include <glib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "score.h"
+
+#include <algorithm>
+
+// Output is gathered into blocks of this size before being written
+#define OUTPUT_BUFFER_SIZE  (1 << 20)
+
+// Bad lines reported by name before validate just counts them
+#define MAX_REPORTED_ERRORS (10)
+
+typedef enum {
+  FORMAT_TEXT,
+  FORMAT_RECORDS
+} ScoreFormat;
+
+typedef struct
+{
+  const char  *filename;
+  ScoreFormat  format;
+  const char  *data;
+  size_t       size;
+} ScoreFile;
+
+/* Where a score is in the inputs, for sorting without copying it */
+typedef struct
+{
+  gint32   amount;
+  guint32  file;
+  guint64  offset;
+} ScoreKey;
+
+typedef struct
+{
+  FILE        *fp;
+  gchar       *temp_filename;       /// Renamed over the output once written
+  ScoreFormat  format;
+  char        *buffer;
+  size_t       used;
+  bool         failed;
+} ScoreOutput;
+
+// Called for each score; offset is where it starts in the file
+typedef void (*ScoreFunc)(const Score *score, guint64 offset, gpointer data);
+
+static ScoreFormat
+format_of (const char *filename)
+{
+  return g_str_has_suffix (filename, ".rec") ? FORMAT_RECORDS : FORMAT_TEXT;
+}
+
+static bool
+open_input (ScoreFile *file, const char *filename)
+{
+  struct stat st;
+  int fd;
+
+  file->filename = filename;
+  file->format = format_of (filename);
+  file->data = NULL;
+  file->size = 0;
+
+  if ((fd = open (filename, O_RDONLY)) < 0 || fstat (fd, &st) < 0) {
+    perror (filename);
+    if (fd >= 0)
+      close (fd);
+    return false;
+  }
+
+  if (st.st_size > 0) {
+    void *data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      perror (filename);
+      close (fd);
+      return false;
+    }
+    madvise (data, st.st_size, MADV_SEQUENTIAL);
+    file->data = (const char *) data;
+    file->size = st.st_size;
+  }
+  close (fd);
+  return true;
+}
+
+static void
+close_input (ScoreFile *file)
+{
+  if (file->data)
+    munmap ((void *) file->data, file->size);
+  file->data = NULL;
+}
+
+static bool
+score_valid (const Score *score)
+{
+  return score->amount() > 0 && score->level() >= 0;
+}
+
+/* Reads a text score from [first, last), which must hold nothing else */
+static bool
+parse_line (Score *score, const char *first, const char *last)
+{
+  const char *p = score->from_chars (first, last);
+
+  if (!p)
+    return false;
+  while (p < last && g_ascii_isspace (*p))
+    p++;
+  return p == last && score_valid (score);
+}
+
+/**
+ * Calls func for each good score in a file, in order, and reports the
+ * bad lines or records unless quiet.
+ *
+ * Returns how many were bad.
+ */
+static long
+read_scores (const ScoreFile *file, ScoreFunc func, gpointer data, bool quiet)
+{
+  const char *p = file->data;
+  const char *end = file->data + file->size;
+  long line = 0, bad = 0;
+  Score score;
+
+  if (file->format == FORMAT_RECORDS) {
+    size_t n = file->size / sizeof(ScoreRecord);
+    ScoreRecord rec;
+
+    for (size_t i = 0; i < n; i++) {
+      memcpy (&rec, p + i * sizeof(ScoreRecord), sizeof(rec));
+      score.from_record (&rec);
+      if (score_valid (&score)) {
+        func (&score, i * sizeof(ScoreRecord), data);
+      } else if (bad++ < MAX_REPORTED_ERRORS && !quiet) {
+        fprintf (stderr, "%s: record %zu is not a score\n", file->filename, i);
+      }
+    }
+    if (file->size % sizeof(ScoreRecord)) {
+      if (!quiet)
+        fprintf (stderr, "%s: ends with a partial record\n", file->filename);
+      bad++;
+    }
+    return bad;
+  }
+
+  while (p < end) {
+    const char *eol = (const char *) memchr (p, '\n', end - p);
+    const char *next;
+
+    if (!eol)
+      eol = end;
+    next = eol + (eol < end);
+    line++;
+
+    if (eol > p && eol[-1] == '\r')
+      eol--;
+    if (eol == p) {
+      // Blank lines are allowed
+    } else if (parse_line (&score, p, eol)) {
+      func (&score, p - file->data, data);
+    } else if (bad++ < MAX_REPORTED_ERRORS && !quiet) {
+      fprintf (stderr, "%s:%ld: not a score: %.*s\n", file->filename, line,
+               (int) MIN(eol - p, 80), p);
+    }
+    p = next;
+  }
+  return bad;
+}
+
+/* Reads back the score a key points at, which is known to be good */
+static void
+score_at (const ScoreFile *file, guint64 offset, Score *score)
+{
+  if (file->format == FORMAT_RECORDS) {
+    ScoreRecord rec;
+    memcpy (&rec, file->data + offset, sizeof(rec));
+    score->from_record (&rec);
+  } else {
+    score->from_chars (file->data + offset, file->data + file->size);
+  }
+}
+
+static bool
+open_output (ScoreOutput *out, const char *filename)
+{
+  out->fp = stdout;
+  out->temp_filename = NULL;
+  if (strcmp (filename, "-") != 0) {
+    int fd;
+
+    out->temp_filename = g_strdup_printf ("%s.XXXXXX", filename);
+    fd = g_mkstemp (out->temp_filename);
+    if (fd < 0 || fchmod (fd, 0644) < 0 || !(out->fp = fdopen (fd, "wb"))) {
+      perror (filename);
+      if (fd >= 0) {
+        close (fd);
+        unlink (out->temp_filename);
+      }
+      g_free (out->temp_filename);
+      return false;
+    }
+  }
+  out->format = format_of (filename);
+  out->buffer = (char *) g_malloc (OUTPUT_BUFFER_SIZE);
+  out->used = 0;
+  out->failed = false;
+  return true;
+}
+
+static void
+flush_output (ScoreOutput *out)
+{
+  if (out->used && fwrite (out->buffer, 1, out->used, out->fp) != out->used)
+    out->failed = true;
+  out->used = 0;
+}
+
+static void
+write_score (ScoreOutput *out, const Score *score)
+{
+  char *first = out->buffer + out->used;
+  char *last = out->buffer + OUTPUT_BUFFER_SIZE;
+
+  if (out->format == FORMAT_RECORDS) {
+    if ((size_t) (last - first) < sizeof(ScoreRecord)) {
+      flush_output (out);
+      first = out->buffer;
+    }
+    score->to_record ((ScoreRecord *) first);
+    out->used += sizeof(ScoreRecord);
+    return;
+  }
+
+  char *end = score->to_chars (first, last);
+  if (!end) {
+    flush_output (out);
+    end = score->to_chars (out->buffer, last);
+    first = out->buffer;
+  }
+  if (end)
+    out->used += end - first;
+}
+
+static bool
+close_output (ScoreOutput *out, const char *filename)
+{
+  flush_output (out);
+  if (out->fp == stdout) {
+    if (fflush (out->fp) != 0)
+      out->failed = true;
+  } else {
+    if (fflush (out->fp) != 0 || fsync (fileno (out->fp)) != 0)
+      out->failed = true;
+    if (fclose (out->fp) != 0)
+      out->failed = true;
+    if (!out->failed && rename (out->temp_filename, filename) != 0)
+      out->failed = true;
+    if (out->failed)
+      unlink (out->temp_filename);
+    g_free (out->temp_filename);
+  }
+  g_free (out->buffer);
+
+  if (out->failed)
+    fprintf (stderr, "%s: could not write scores\n", filename);
+  return !out->failed;
+}
+
+static void
+count_score (const Score *, guint64, gpointer data)
+{
+  (*(long *) data)++;
+}
+
+static int
+validate (int argc, char **argv)
+{
+  int status = 0;
+
+  for (int i = 0; i < argc; i++) {
+    ScoreFile file;
+    long good = 0, bad;
+
+    if (!open_input (&file, argv[i])) {
+      status = 1;
+      continue;
+    }
+    bad = read_scores (&file, count_score, &good, false);
+    close_input (&file);
+
+    printf ("%s: %ld scores, %ld bad\n", argv[i], good, bad);
+    if (bad)
+      status = 1;
+  }
+  return status;
+}
+
+static void
+copy_score (const Score *score, guint64, gpointer data)
+{
+  write_score ((ScoreOutput *) data, score);
+}
+
+static int
+convert (const char *in_name, const char *out_name)
+{
+  ScoreFile in;
+  ScoreOutput out;
+  long bad;
+
+  if (!open_input (&in, in_name))
+    return 1;
+  if (!open_output (&out, out_name)) {
+    close_input (&in);
+    return 1;
+  }
+
+  bad = read_scores (&in, copy_score, &out, true);
+  close_input (&in);
+  if (bad)
+    fprintf (stderr, "%s: skipped %ld bad scores\n", in_name, bad);
+  return close_output (&out, out_name) ? 0 : 1;
+}
+
+typedef struct
+{
+  ScoreKey *keys;
+  size_t    count;
+  size_t    allocated;
+  guint32   file;
+} KeyList;
+
+static void
+add_key (const Score *score, guint64 offset, gpointer data)
+{
+  KeyList *list = (KeyList *) data;
+
+  if (list->count == list->allocated) {
+    list->allocated = MAX(list->allocated * 2, 4096);
+    list->keys = g_renew (ScoreKey, list->keys, list->allocated);
+  }
+  list->keys[list->count].amount = score->amount();
+  list->keys[list->count].file = list->file;
+  list->keys[list->count].offset = offset;
+  list->count++;
+}
+
+/* Highest first */
+static bool
+key_before (const ScoreKey &a, const ScoreKey &b)
+{
+  return a.amount > b.amount;
+}
+
+static int
+merge (long limit, const char *out_name, int argc, char **argv)
+{
+  ScoreFile *files = g_new0 (ScoreFile, argc);
+  KeyList list = { NULL, 0, 0, 0 };
+  ScoreOutput out;
+  Score score;
+  int status = 1;
+  long bad = 0;
+
+  for (list.file = 0; list.file < (guint32) argc; list.file++) {
+    if (!open_input (&files[list.file], argv[list.file]))
+      break;
+    bad += read_scores (&files[list.file], add_key, &list, true);
+  }
+  if (bad)
+    fprintf (stderr, "Skipped %ld bad scores\n", bad);
+
+  if (list.file == (guint32) argc && open_output (&out, out_name)) {
+    // Keys are added in the order they're read, so ties stay that way
+    std::stable_sort (list.keys, list.keys + list.count, key_before);
+    if (limit >= 0 && (size_t) limit < list.count)
+      list.count = limit;
+
+    for (size_t i = 0; i < list.count; i++) {
+      score_at (&files[list.keys[i].file], list.keys[i].offset, &score);
+      write_score (&out, &score);
+    }
+    if (close_output (&out, out_name))
+      status = 0;
+  }
+
+  for (int i = 0; i < argc; i++)
+    close_input (&files[i]);
+  g_free (files);
+  g_free (list.keys);
+  return status;
+}
+
+static int
+usage (void)
+{
+  fprintf (stderr,
+           "Usage: spacecastle-scores validate FILE...\n"
+           "       spacecastle-scores convert IN OUT\n"
+           "       spacecastle-scores merge [-n COUNT] OUT IN...\n"
+           "Files ending in .rec hold binary score records; others are text.\n");
+  return 2;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *command = argc > 1 ? argv[1] : "";
+
+  // Without TZ set, glibc checks /etc/localtime on every mktime()
+  setenv ("TZ", ":/etc/localtime", 0);
+  tzset ();
+
+  if (strcmp (command, "validate") == 0 && argc > 2)
+    return validate (argc - 2, argv + 2);
+
+  if (strcmp (command, "convert") == 0 && argc == 4)
+    return convert (argv[2], argv[3]);
+
+  if (strcmp (command, "merge") == 0) {
+    long limit = -1;
+    int i = 2;
+
+    if (argc > 3 && strcmp (argv[2], "-n") == 0) {
+      char *end;
+
+      errno = 0;
+      limit = strtol (argv[3], &end, 10);
+      if (errno || end == argv[3] || *end || limit < 0) {
+        fprintf (stderr, "merge: -n takes a count of scores, not '%s'\n", argv[3]);
+        return 2;
+      }
+      i = 4;
+    }
+    if (argc - i >= 2)
+      return merge (limit, argv[i], argc - i - 1, argv + i + 1);
+  }
+
+  return usage ();
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-basic-offset:2
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=2:tabstop=8:softtabstop=2:fileencoding=utf-8:textwidth=99 :